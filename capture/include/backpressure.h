@@ -0,0 +1,56 @@
+#ifndef __BACKPRESSURE_H__
+#define __BACKPRESSURE_H__
+
+#include "capture_events.h"
+
+/* 默认参数（采样率由 bpf_loader 写入 capture_ctl_map） */
+#define BACKPRESSURE_DEFAULT_SAMPLE_RATE 8
+#define BACKPRESSURE_DEFAULT_LOSS_THRESHOLD 1
+#define BACKPRESSURE_DEFAULT_QUEUE_HIGH 80
+#define BACKPRESSURE_DEFAULT_QUEUE_LOW 20
+#define BACKPRESSURE_DEFAULT_CALM_INTERVALS 10
+#define BACKPRESSURE_CHECK_INTERVAL_MS 500
+
+struct backpressure_config {
+    __u32 loss_threshold;       /* 单个周期内丢失事件数达到该值即升级 */
+    __u32 queue_high_pct;       /* 队列占用率达到该值即升级 */
+    __u32 queue_low_pct;        /* 低于该值且无丢失才算空闲周期 */
+    __u32 calm_intervals;       /* 连续多少个空闲周期后降级 */
+};
+
+/*
+ * 背压状态机：NONE -> SAMPLE -> DROP 逐级升级，持续空闲后逐级回落，
+ * 只根据传入的计数做判断，由调用者负责把结果写入 capture_ctl_map
+ */
+struct backpressure {
+    struct backpressure_config cfg;
+    __u32 mode;                 /* enum capture_shed_mode */
+    __u64 last_loss;            /* 上个周期的累计丢失数 */
+    __u32 calm;                 /* 连续空闲周期数 */
+    __u64 transitions;          /* 模式切换次数 */
+};
+
+/**
+ * 初始化背压状态机
+ * @param bp: 状态机
+ * @param cfg: 阈值配置（为 0 的字段使用默认值）
+ */
+void backpressure_init(struct backpressure *bp, const struct backpressure_config *cfg);
+
+/**
+ * 按一个检查周期的观测更新状态
+ * @param bp: 状态机
+ * @param total_loss: 累计丢失事件数（单调递增）
+ * @param queue_depth: 工作队列当前深度
+ * @param queue_capacity: 工作队列容量
+ * @return: 模式发生变化时返回新模式，否则返回 -1
+ */
+int backpressure_update(struct backpressure *bp, __u64 total_loss,
+                        __u64 queue_depth, __u64 queue_capacity);
+
+/**
+ * 背压模式名称
+ */
+const char *shed_mode_name(__u32 mode);
+
+#endif /* __BACKPRESSURE_H__ */
@@ -0,0 +1,80 @@
+#ifndef __BPF_LOADER_H__
+#define __BPF_LOADER_H__
+
+#include <bpf/libbpf.h>
+#include "capture.h"
+#include "capture_events.h"
+
+#define BPF_LOADER_MAX_LINKS 16
+
+/* ring buffer / perf buffer 两种传输方式对应的 eBPF 对象文件 */
+#define BPF_OBJ_RINGBUF "capture.bpf.o"
+#define BPF_OBJ_PERFBUF "capture_perf.bpf.o"
+
+/* eBPF 侧统计 */
+struct capture_bpf_stats {
+    __u64 counters[CAPTURE_STAT_MAX];   /* 各 CPU 汇总后的计数器 */
+    __u64 sk_state_live;                /* 当前存活的 socket 捕获状态数 */
+};
+
+/* 已加载的 eBPF 对象及其附加点 */
+struct bpf_loader {
+    struct bpf_object *obj;
+    struct bpf_link *links[BPF_LOADER_MAX_LINKS];
+    int link_count;
+    enum event_transport transport;  /* 实际使用的事件传输方式 */
+    enum capture_hook hook;          /* 新连接的检测方式 */
+    int cgroup_fd;                   /* sockops 程序附加的 cgroup */
+};
+
+/**
+ * 按配置查找并加载 eBPF 对象
+ * transport 为 auto 时优先加载 ring buffer 版本，失败后回退到 perf buffer 版本
+ * 只加载与 hook 配置对应的程序（sockops 或 fentry/fexit）
+ * @param loader: 加载器
+ * @param config: 配置信息
+ * @return: 成功返回 0，失败返回负值
+ */
+int bpf_loader_open(struct bpf_loader *loader, const struct capture_config *config);
+
+/**
+ * 附加所有已加载的 eBPF 程序，sockops 程序附加到配置的 cgroup
+ * @param loader: 加载器
+ * @return: 成功附加的程序数量
+ */
+int bpf_loader_attach(struct bpf_loader *loader);
+
+/**
+ * 读取 eBPF 侧统计（汇总各 CPU 计数器）
+ * @param loader: 加载器
+ * @param stats: 用于存储统计结果
+ * @return: 成功返回 0，失败返回负值
+ */
+int bpf_loader_read_stats(struct bpf_loader *loader, struct capture_bpf_stats *stats);
+
+/**
+ * 读取单个计数器在各 CPU 上的值
+ * @param loader: 加载器
+ * @param idx: 计数器下标（enum capture_stat）
+ * @param values: 用于存储各 CPU 的值
+ * @param max_cpus: values 数组长度
+ * @return: 写入的 CPU 数，失败返回负值
+ */
+int bpf_loader_read_stat_per_cpu(struct bpf_loader *loader, __u32 idx,
+                                 __u64 *values, int max_cpus);
+
+/**
+ * 切换内核侧背压模式（enum capture_shed_mode）
+ * @param loader: 加载器
+ * @param mode: 新模式
+ * @return: 成功返回 0，失败返回负值
+ */
+int bpf_loader_set_shed_mode(struct bpf_loader *loader, __u32 mode);
+
+/**
+ * 分离所有 eBPF 程序并释放对象
+ * @param loader: 加载器
+ */
+void bpf_loader_close(struct bpf_loader *loader);
+
+#endif /* __BPF_LOADER_H__ */
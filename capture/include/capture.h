@@ -8,14 +8,69 @@ enum key_provider_mode {
     MODE_TLSHUB = 0,    /* 使用 TLSHub 进行密钥协商 */
     MODE_OPENSSL = 1,   /* 使用 OpenSSL 进行密钥协商 */
     MODE_BORINGSSL = 2, /* 使用 BoringSSL 进行密钥协商 */
+    MODE_STUB = 3,      /* 本地替身：固定延迟后返回由四元组派生的密钥，用于回放压测 */
 };
 
-/* 四元组信息 */
+/* 内核事件传输方式 */
+enum event_transport {
+    EVENT_TRANSPORT_AUTO = 0,     /* 优先 ring buffer，内核不支持时回退到 perf buffer */
+    EVENT_TRANSPORT_RINGBUF = 1,  /* BPF ring buffer（内核 >= 5.8） */
+    EVENT_TRANSPORT_PERFBUF = 2,  /* Per-CPU perf buffer */
+};
+
+/* 新连接的检测方式 */
+enum capture_hook {
+    CAPTURE_HOOK_SOCKOPS = 0,  /* cgroup sockops，连接建立时上报一次 */
+    CAPTURE_HOOK_FENTRY = 1,   /* fentry/fexit tcp_v4_connect/tcp_v6_connect + 首次 tcp_sendmsg */
+};
+
+/* 并发密钥请求的合并粒度 */
+enum key_coalesce {
+    KEY_COALESCE_OFF = 0,   /* 不合并，每个连接各自协商 */
+    KEY_COALESCE_FLOW = 1,  /* 四元组完全相同的请求才合并 */
+    KEY_COALESCE_POD = 2,   /* 同一对 Pod（忽略端口）的请求合并 */
+};
+
+/* 与 TLSHub 之间的传输方式 */
+enum tlshub_transport {
+    TLSHUB_TRANSPORT_NETLINK = 0,  /* Netlink，连接 TLSHub 内核模块 */
+    TLSHUB_TRANSPORT_UNIX = 1,     /* Unix 域 socket（SOCK_SEQPACKET），连接用户态的 TLSHub 端点 */
+    TLSHUB_TRANSPORT_MOCK = 2,     /* 进程内模拟端点，不需要内核模块，用于压测 */
+};
+
+/* unix 传输的默认端点路径 */
+#define TLSHUB_DEFAULT_UNIX_PATH "/run/tlshub/tlshub.sock"
+
+/* 模拟端点的握手耗时分布 */
+enum latency_dist {
+    LATENCY_DIST_FIXED = 0,        /* 固定为平均值 */
+    LATENCY_DIST_UNIFORM = 1,      /* 在平均值 ± spread 内均匀分布 */
+    LATENCY_DIST_EXPONENTIAL = 2,  /* 以平均值为均值的指数分布（长尾） */
+};
+
+/* 本机在连接中的角色 */
+enum flow_role {
+    FLOW_ROLE_CLIENT = 0,   /* 主动连接，本机为客户端 */
+    FLOW_ROLE_SERVER = 1,   /* 被动连接，本机为服务端 */
+};
+
+/*
+ * 四元组信息
+ * 无论本机角色如何，saddr/sport 始终为客户端，daddr/dport 始终为服务端
+ */
 struct flow_tuple {
-    __u32 saddr;        /* 源IP地址 */
-    __u32 daddr;        /* 目的IP地址 */
+    union {
+        __u32 saddr;        /* 源IP地址（网络字节序） */
+        __u32 saddr6[4];    /* 源IPv6地址（family 为 AF_INET6 时有效） */
+    };
+    union {
+        __u32 daddr;        /* 目的IP地址（网络字节序） */
+        __u32 daddr6[4];    /* 目的IPv6地址（family 为 AF_INET6 时有效） */
+    };
     __u16 sport;        /* 源端口 */
     __u16 dport;        /* 目的端口 */
+    __u16 family;       /* AF_INET 或 AF_INET6 */
+    __u16 role;         /* enum flow_role */
 };
 
 /* Socket 连接信息 */
@@ -42,10 +97,91 @@ enum {
     NLMSG_TYPE_QUERY = 4,
 };
 
+/* 连接过滤策略 */
+#define CAPTURE_MAX_POLICY_RULES 64
+#define CAPTURE_MAX_POLICY_PORTS 64
+
+/* 单条地址策略：family 地址族下 addr/prefixlen 网段的 allow 或 deny */
+struct capture_policy_rule {
+    __u16 family;       /* AF_INET 或 AF_INET6 */
+    __u8 prefixlen;     /* 前缀位数 */
+    __u8 action;        /* CAPTURE_POLICY_ALLOW 或 CAPTURE_POLICY_DENY */
+    __u32 addr[4];      /* 网络字节序，IPv4 只使用 addr[0] */
+};
+
 /* 配置信息 */
 struct capture_config {
     enum key_provider_mode mode;
     char pod_node_config_path[256];
+    enum event_transport transport;     /* 内核事件传输方式 */
+    __u32 ringbuf_wakeup_batch;         /* ring buffer 唤醒批量（事件条数） */
+    enum capture_hook hook;             /* 新连接的检测方式 */
+    char cgroup_path[256];              /* sockops 程序附加的 cgroup v2 路径 */
+    struct capture_policy_rule policy_rules[CAPTURE_MAX_POLICY_RULES];  /* 地址过滤策略 */
+    __u32 policy_rule_count;
+    __u16 policy_ports[CAPTURE_MAX_POLICY_PORTS];   /* 只捕获这些目的端口，为空表示不限 */
+    __u32 policy_port_count;
+    __u32 key_workers;                  /* 密钥协商工作线程数 */
+    __u32 key_queue_size;               /* 事件循环与工作线程之间的队列容量 */
+    enum key_coalesce key_coalesce;     /* 并发密钥请求的合并粒度 */
+    __u32 key_cache_size;               /* 协商结果缓存的条目数，0 表示不缓存 */
+    __u32 key_cache_ttl_ms;             /* 缓存条目的有效期 */
+    __u32 key_refresh_lead_ms;          /* 缓存密钥在过期前多久后台刷新，0 表示不刷新 */
+    __u32 key_refresh_jitter_ms;        /* 刷新时间额外提前的随机量上限 */
+    __u32 key_refresh_threads;          /* 后台刷新线程数 */
+    __u32 key_prefetch_rate;            /* 每秒最多预取次数，0 表示不预取 */
+    double key_prefetch_min_score;      /* 预取的最低频率（衰减后的请求数） */
+    __u32 key_prefetch_half_life_ms;    /* 频率的半衰期 */
+    char node_name[256];                /* 本节点名，用于按 Pod-Node 映射预置预取，默认主机名 */
+    __u32 tlshub_pipeline_depth;        /* 单个 TLSHub socket 的在途请求数，0 为每线程 socket */
+    __u32 tlshub_batch_size;            /* 每条 TLSHub 消息最多的请求数，小于 2 为不合并 */
+    __u32 tlshub_batch_delay_us;        /* 批次等待更多请求的最长时间 */
+    enum tlshub_transport tlshub_transport;
+    char tlshub_unix_path[108];         /* Unix 域 socket 传输的端点路径 */
+    __u32 tlshub_timeout_ms;            /* 每次 TLSHub 请求的期限，0 表示不限 */
+    __u32 tlshub_retries;               /* 超时或收发失败后的重试次数 */
+    __u32 tlshub_backoff_ms;            /* 第一次重试前的退避，之后每次加倍 */
+    __u32 tlshub_backoff_max_ms;        /* 退避上限 */
+    int tlshub_breaker;                 /* 是否启用 TLSHub 熔断 */
+    __u32 tlshub_breaker_window_ms;     /* 熔断统计窗口 */
+    __u32 tlshub_breaker_min_requests;  /* 窗口内至少多少次协商才判断是否断开 */
+    __u32 tlshub_breaker_failure_percent;   /* 失败率阈值 */
+    __u32 tlshub_breaker_slow_ms;       /* 协商耗时超过该值视为慢调用，0 表示不按耗时断开 */
+    __u32 tlshub_breaker_slow_percent;  /* 慢调用率阈值 */
+    __u32 tlshub_breaker_open_ms;       /* 断开后的探测间隔 */
+    __u32 tlshub_breaker_half_open_requests;    /* 探测成功后放行的试探请求数 */
+    enum key_provider_mode tlshub_fallback; /* 断开时的后备提供者，MODE_TLSHUB 表示直接失败 */
+    __u32 tlshub_negative_cache_size;   /* 握手负缓存的 Pod 对数，0 表示不启用 */
+    __u32 tlshub_negative_backoff_ms;   /* 握手失败后的初始退避，连续失败时加倍 */
+    __u32 tlshub_negative_backoff_max_ms;   /* 退避上限 */
+    __u32 mock_handshake_us;            /* 模拟端点：握手平均耗时 */
+    enum latency_dist mock_handshake_dist;
+    __u32 mock_handshake_spread_us;     /* 模拟端点：uniform 分布的半宽 */
+    __u32 mock_fetch_us;                /* 模拟端点：fetch 耗时 */
+    __u32 mock_expire_percent;          /* 模拟端点：fetch 返回密钥过期（-2）的比例 */
+    __u32 mock_fail_percent;            /* 模拟端点：握手失败的比例 */
+    __u32 mock_log_every;               /* 模拟端点：每 N 条响应插入一条日志消息 */
+    __u32 mock_hang_percent;            /* 模拟端点：不回复的请求比例 */
+    int mock_legacy;                    /* 模拟端点：不声明协议特性的旧模块 */
+    __u16 priority_ports[CAPTURE_MAX_POLICY_PORTS]; /* 背压时照常上报的服务端口 */
+    __u32 priority_port_count;
+    int backpressure;                   /* 是否启用自适应背压 */
+    __u32 shed_sample_rate;             /* 采样模式下低优先级事件的上报比例（1/N） */
+    __u32 backpressure_loss_threshold;  /* 每个检查周期内丢失多少事件即升级背压 */
+    __u32 backpressure_queue_high;      /* 工作队列占用率（%）达到该值即升级背压 */
+    __u32 backpressure_queue_low;       /* 占用率低于该值且无丢失才视为空闲 */
+    __u32 event_consumers;              /* 每 CPU 消费者线程数，0 表示由事件循环消费 */
+    int log_level;                      /* 运行期日志级别（enum log_level） */
+    int log_format;                     /* enum log_format */
+    char log_file[256];                 /* 日志文件，为空时写 stdout/stderr */
+    __u32 log_rate_limit;               /* 每线程每秒最多日志条数，0 表示不限 */
+    __u32 stub_latency_us;              /* stub 模式每次协商的模拟耗时 */
+    char record_file[256];              /* 非空时把收到的事件录制到该文件 */
+    char replay_file[256];              /* 非空时不加载 eBPF，回放该文件中的事件 */
+    double replay_speed;                /* 回放速度：1 原速，N 倍速，0 最快 */
+    __u32 replay_synthetic;             /* 大于 0 时回放该数量的合成事件 */
+    __u32 replay_rate;                  /* 合成事件到达速率（events/s），0 表示不限 */
+    __u32 replay_pairs;                 /* 合成事件涉及的 Pod 对数 */
 };
 
 #endif /* __CAPTURE_H__ */
@@ -0,0 +1,114 @@
+#ifndef __CAPTURE_EVENTS_H__
+#define __CAPTURE_EVENTS_H__
+
+/*
+ * eBPF 程序与用户态共享的数据结构
+ * 本文件同时被 capture.bpf.c 和用户态代码包含，只能使用 __u8/__u16/__u32/__u64 类型
+ */
+#ifndef __bpf__
+#include <linux/types.h>
+#endif
+
+/* Ring buffer 默认大小（字节，必须是页大小的 2 的幂倍数） */
+#define CAPTURE_RINGBUF_SIZE (256 * 1024)
+
+/* 地址族（与内核 AF_INET/AF_INET6 取值相同，BPF 侧没有 socket.h） */
+#define CAPTURE_AF_INET  2
+#define CAPTURE_AF_INET6 10
+
+/* tcp_connect_event.flags */
+#define CAPTURE_EVENT_F_SERVER (1U << 0)  /* 被动连接（本机为服务端） */
+
+/*
+ * TCP 连接事件
+ * saddr/sport 为本机一侧，daddr/dport 为对端；被动连接中本机是服务端
+ * 地址为网络字节序；IPv4 只使用 saddr/daddr（即 saddr6[0]/daddr6[0]），
+ * IPv4-mapped IPv6 地址在内核侧已还原为 IPv4
+ */
+struct tcp_connect_event {
+    union {
+        __u32 saddr;
+        __u32 saddr6[4];
+    };
+    union {
+        __u32 daddr;
+        __u32 daddr6[4];
+    };
+    __u16 sport;        /* 主机字节序 */
+    __u16 dport;        /* 主机字节序 */
+    __u16 family;       /* CAPTURE_AF_INET 或 CAPTURE_AF_INET6 */
+    __u16 flags;        /* CAPTURE_EVENT_F_* */
+    __u32 pid;
+    __u64 timestamp;
+};
+
+/*
+ * 单条事件在 ring buffer 中占用的空间：
+ * 8 字节记录头 + 事件本身，按 8 字节对齐
+ */
+#define CAPTURE_RINGBUF_RECORD_SIZE \
+    ((8 + sizeof(struct tcp_connect_event) + 7) & ~7)
+
+/* capture_stats 中的计数器下标 */
+enum capture_stat {
+    CAPTURE_STAT_SK_CREATE = 0,     /* sk_state_map 中创建的 socket 状态 */
+    CAPTURE_STAT_SK_DELETE,         /* 连接失败/关闭时删除的 socket 状态 */
+    CAPTURE_STAT_POLICY_ADDR,       /* 地址策略过滤掉的连接 */
+    CAPTURE_STAT_POLICY_PORT,       /* 端口策略过滤掉的连接 */
+    CAPTURE_STAT_CONNECT,           /* 观察到的主动连接（fentry: 发起，sockops: 建立） */
+    CAPTURE_STAT_CONNECT_FAIL,      /* 连接发起失败 */
+    CAPTURE_STAT_SENDMSG,           /* tcp_sendmsg 探针命中次数 */
+    CAPTURE_STAT_EVENT,             /* 提交到用户态的事件 */
+    CAPTURE_STAT_FAMILY_SKIP,       /* 非 IPv4/IPv6 而跳过的连接 */
+    CAPTURE_STAT_ACCEPT,            /* 观察到的被动连接（服务端） */
+    CAPTURE_STAT_EVENT_DROP,        /* 事件通道已满，提交失败的事件 */
+    CAPTURE_STAT_SHED,              /* 背压期间被采样/丢弃的低优先级事件 */
+    CAPTURE_STAT_MAX,
+};
+
+/* 连接过滤策略表容量 */
+#define CAPTURE_POLICY_MAX_RULES 1024
+#define CAPTURE_POLICY_MAX_PORTS 256
+
+/* 策略表中地址前缀的动作 */
+enum capture_policy_action {
+    CAPTURE_POLICY_NONE = 0,    /* 未命中任何前缀 */
+    CAPTURE_POLICY_ALLOW = 1,
+    CAPTURE_POLICY_DENY = 2,
+};
+
+/* capture_ctl.policy_flags */
+#define CAPTURE_POLICY_F_ALLOWLIST (1U << 0)  /* 存在 allow 规则：未命中的地址一律过滤 */
+#define CAPTURE_POLICY_F_PORTS     (1U << 1)  /* 存在端口集合：目的端口不在集合中的连接被过滤 */
+
+/* policy_port_map 的值 */
+#define CAPTURE_PORT_F_CAPTURE  (1U << 0)  /* 在 policy_ports 中 */
+#define CAPTURE_PORT_F_PRIORITY (1U << 1)  /* 在 priority_ports 中：背压时照常上报 */
+
+/* 背压模式：事件通道或用户态处理不过来时，由用户态切换 */
+enum capture_shed_mode {
+    CAPTURE_SHED_NONE = 0,      /* 全部上报 */
+    CAPTURE_SHED_SAMPLE = 1,    /* 低优先级事件按 sample_rate 采样上报 */
+    CAPTURE_SHED_DROP = 2,      /* 只上报高优先级事件 */
+};
+
+/* LPM trie 键，prefixlen 为前缀位数，addr 为网络字节序 */
+struct capture_policy_key_v4 {
+    __u32 prefixlen;
+    __u32 addr;
+};
+
+struct capture_policy_key_v6 {
+    __u32 prefixlen;
+    __u32 addr[4];
+};
+
+/* 运行时控制参数（capture_ctl_map 中唯一的一项，由用户态在加载后写入） */
+struct capture_ctl {
+    __u32 wakeup_batch;     /* ring buffer 每积累多少条事件唤醒一次消费者，<=1 表示每条都唤醒 */
+    __u32 policy_flags;     /* CAPTURE_POLICY_F_* */
+    __u32 shed_mode;        /* enum capture_shed_mode，运行时由用户态更新 */
+    __u32 sample_rate;      /* SAMPLE 模式下每 sample_rate 个低优先级事件上报一个 */
+};
+
+#endif /* __CAPTURE_EVENTS_H__ */
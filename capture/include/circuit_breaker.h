@@ -0,0 +1,135 @@
+#ifndef __CIRCUIT_BREAKER_H__
+#define __CIRCUIT_BREAKER_H__
+
+#include <linux/types.h>
+
+/*
+ * 熔断器
+ * 按滑动时间窗口（CIRCUIT_BREAKER_BUCKETS 个时间片）统计协商的失败数和慢调用数，
+ * 窗口内请求数达到 min_requests 且失败率或慢调用率达到阈值时断开（open）：
+ * 之后的请求立即被拒绝，由调用方快速失败或改用后备提供者。
+ * 断开期间探测线程每隔 open_ms 用最近一次请求的数据在后台探测一次，
+ * 探测成功后半开（half-open），放行最多 half_open_requests 个请求试探，
+ * 全部成功则闭合（closed），任何一个失败则重新断开。
+ */
+
+/* 滑动窗口的时间片数 */
+#define CIRCUIT_BREAKER_BUCKETS 10
+
+/* 默认参数 */
+#define CIRCUIT_BREAKER_DEFAULT_WINDOW_MS 10000
+#define CIRCUIT_BREAKER_DEFAULT_MIN_REQUESTS 10
+#define CIRCUIT_BREAKER_DEFAULT_FAILURE_PERCENT 50
+#define CIRCUIT_BREAKER_DEFAULT_SLOW_MS 500
+#define CIRCUIT_BREAKER_DEFAULT_SLOW_PERCENT 80
+#define CIRCUIT_BREAKER_DEFAULT_OPEN_MS 5000
+#define CIRCUIT_BREAKER_DEFAULT_HALF_OPEN_REQUESTS 5
+
+/* 熔断器状态 */
+enum circuit_breaker_state {
+    CIRCUIT_BREAKER_CLOSED = 0,     /* 正常放行 */
+    CIRCUIT_BREAKER_OPEN = 1,       /* 拒绝所有请求，后台探测恢复 */
+    CIRCUIT_BREAKER_HALF_OPEN = 2,  /* 放行有限的试探请求 */
+};
+
+/* circuit_breaker_allow 的返回值 */
+#define CIRCUIT_BREAKER_REJECT 0    /* 拒绝，不需要 record */
+#define CIRCUIT_BREAKER_PASS 1      /* 正常放行 */
+#define CIRCUIT_BREAKER_TRIAL 2     /* 半开状态下的试探请求 */
+
+/* 熔断器回调 */
+struct circuit_breaker_ops {
+    int (*probe)(void *arg, const void *data);  /* 后台探测，成功返回 0 */
+    void (*thread_exit)(void *arg);             /* 探测线程退出前调用，可为 NULL */
+};
+
+/* 熔断器配置 */
+struct circuit_breaker_config {
+    __u32 window_ms;            /* 统计窗口 */
+    __u32 min_requests;         /* 窗口内至少多少个请求才判断是否断开 */
+    __u32 failure_percent;      /* 失败率阈值（1-100），0 表示不按失败率断开 */
+    __u32 slow_ms;              /* 耗时超过该值视为慢调用，0 表示不按耗时断开 */
+    __u32 slow_percent;         /* 慢调用率阈值（1-100） */
+    __u32 open_ms;              /* 断开后的探测间隔 */
+    __u32 half_open_requests;   /* 半开时放行的试探请求数 */
+    __u32 data_size;            /* 交给 probe 回调的数据大小 */
+};
+
+/* 熔断器统计 */
+struct circuit_breaker_stats {
+    __u64 state;                /* 当前状态（enum circuit_breaker_state） */
+    __u64 opened;               /* 断开次数（含试探失败后重新断开） */
+    __u64 half_opened;          /* 探测成功进入半开的次数 */
+    __u64 closed;               /* 试探全部成功后闭合的次数 */
+    __u64 rejected;             /* 被拒绝的请求数 */
+    __u64 probes;               /* 后台探测次数 */
+    __u64 probe_failures;       /* 失败的探测次数 */
+    __u64 open_ms;              /* 累计断开（含半开）时长 */
+    __u64 window_requests;      /* 当前窗口内的请求数 */
+    __u64 window_failures;      /* 当前窗口内的失败数 */
+    __u64 window_slow;          /* 当前窗口内的慢调用数 */
+};
+
+struct circuit_breaker;
+
+/**
+ * 创建熔断器并启动探测线程
+ * @param config: 熔断器配置
+ * @param ops: 回调
+ * @param arg: 回调参数
+ * @return: 熔断器指针，失败返回 NULL
+ */
+struct circuit_breaker *circuit_breaker_new(const struct circuit_breaker_config *config,
+                                            const struct circuit_breaker_ops *ops, void *arg);
+
+/**
+ * 请求开始前询问是否放行
+ * @param breaker: 熔断器，为 NULL 时总是放行
+ * @return: CIRCUIT_BREAKER_REJECT、CIRCUIT_BREAKER_PASS 或 CIRCUIT_BREAKER_TRIAL
+ */
+int circuit_breaker_allow(struct circuit_breaker *breaker);
+
+/**
+ * 记录一个已放行请求的结果
+ * @param breaker: 熔断器
+ * @param ticket: circuit_breaker_allow 的返回值
+ * @param success: 请求是否成功
+ * @param latency_ns: 请求耗时
+ * @param data: 请求的数据（data_size 字节），保存下来供后台探测使用
+ */
+void circuit_breaker_record(struct circuit_breaker *breaker, int ticket, int success,
+                            __u64 latency_ns, const void *data);
+
+/**
+ * 获取熔断器统计
+ * @param breaker: 熔断器
+ * @param stats: 用于存储统计结果
+ */
+void circuit_breaker_get_stats(struct circuit_breaker *breaker, struct circuit_breaker_stats *stats);
+
+/**
+ * 状态名称
+ * 定义为内联函数，性能报告只需包含本头文件，不必链接熔断器实现
+ * @param state: enum circuit_breaker_state
+ * @return: "closed"、"open" 或 "half-open"
+ */
+static inline const char *circuit_breaker_state_name(int state) {
+    switch (state) {
+        case CIRCUIT_BREAKER_CLOSED:
+            return "closed";
+        case CIRCUIT_BREAKER_OPEN:
+            return "open";
+        case CIRCUIT_BREAKER_HALF_OPEN:
+            return "half-open";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * 停止探测线程（等待进行中的探测结束）并释放熔断器
+ * @param breaker: 熔断器
+ */
+void circuit_breaker_free(struct circuit_breaker *breaker);
+
+#endif /* __CIRCUIT_BREAKER_H__ */
@@ -0,0 +1,104 @@
+#ifndef __EVENT_REPLAY_H__
+#define __EVENT_REPLAY_H__
+
+#include "capture_events.h"
+
+/*
+ * 事件录制与回放
+ * 录制文件由一个文件头和若干定长记录组成，每条记录就是内核上报的
+ * struct tcp_connect_event 原样（timestamp 为内核单调时钟），回放时按相邻事件的
+ * timestamp 差值还原到达间隔。回放不需要 eBPF 和 root 权限，可以在任意机器上
+ * 驱动 handle_tcp_event 之后的整条用户态流水线。
+ */
+
+/* 事件回调，与 event_source 的 event_handler_fn 签名相同（不依赖 libbpf 头文件） */
+typedef void (*event_replay_fn)(void *ctx, const struct tcp_connect_event *event);
+
+#define EVENT_RECORD_MAGIC 0x56454354   /* "TCEV" */
+#define EVENT_RECORD_VERSION 1
+
+/* 录制文件头 */
+struct event_record_header {
+    __u32 magic;
+    __u16 version;
+    __u16 record_size;      /* sizeof(struct tcp_connect_event) */
+    __u64 reserved;
+};
+
+/* 回放配置 */
+struct event_replay_config {
+    const char *path;           /* 录制文件，为 NULL 时生成合成事件 */
+    double speed;               /* 1 为原速，N 为 N 倍速，0 为不等待（最快） */
+    __u32 synthetic_events;     /* 合成事件数 */
+    __u32 synthetic_rate;       /* 合成事件的到达速率（events/s），0 表示不限 */
+    __u32 synthetic_pairs;      /* 合成事件涉及的 Pod 对数 */
+};
+
+#define EVENT_REPLAY_DEFAULT_SYNTHETIC_PAIRS 16
+
+/* 回放统计 */
+struct event_replay_stats {
+    __u64 events;           /* 已注入的事件 */
+    __u64 elapsed_ns;       /* 从第一条到最后一条事件的注入耗时 */
+    __u64 max_lag_ns;       /* 注入时刻落后于计划时刻的最大值 */
+    int done;               /* 是否已注入全部事件 */
+};
+
+struct event_recorder;
+struct event_replay;
+
+/**
+ * 创建录制文件并写入文件头
+ * @param path: 文件路径
+ * @return: 录制器指针，失败返回 NULL
+ */
+struct event_recorder *event_recorder_open(const char *path);
+
+/**
+ * 追加一条事件（线程安全，可由多个消费者线程并发调用）
+ * @param rec: 录制器
+ * @param event: 连接事件
+ * @return: 成功返回 0，失败返回负值
+ */
+int event_recorder_write(struct event_recorder *rec, const struct tcp_connect_event *event);
+
+/**
+ * 写出缓冲数据并关闭录制文件
+ * @param rec: 录制器
+ * @return: 录制的事件数
+ */
+__u64 event_recorder_close(struct event_recorder *rec);
+
+/**
+ * 启动回放线程
+ * 每条事件的 timestamp 改写为注入时刻（CLOCK_MONOTONIC）后交给 handler，
+ * 下游可据此计算事件的端到端处理延迟
+ * @param config: 回放配置
+ * @param handler: 事件回调（与 event_source 的回调相同）
+ * @param ctx: 回调上下文
+ * @return: 回放器指针，失败返回 NULL
+ */
+struct event_replay *event_replay_start(const struct event_replay_config *config,
+                                        event_replay_fn handler, void *ctx);
+
+/**
+ * 获取回放结束通知的文件描述符（eventfd），全部事件注入后可读，供事件循环监听
+ * @param replay: 回放器
+ * @return: 文件描述符
+ */
+int event_replay_fd(struct event_replay *replay);
+
+/**
+ * 获取回放统计
+ * @param replay: 回放器
+ * @param stats: 用于存储统计结果
+ */
+void event_replay_get_stats(struct event_replay *replay, struct event_replay_stats *stats);
+
+/**
+ * 停止回放线程并释放回放器
+ * @param replay: 回放器
+ */
+void event_replay_free(struct event_replay *replay);
+
+#endif /* __EVENT_REPLAY_H__ */
@@ -0,0 +1,102 @@
+#ifndef __EVENT_SOURCE_H__
+#define __EVENT_SOURCE_H__
+
+#include "bpf_loader.h"
+#include "capture_events.h"
+
+/* 每个 CPU 的 perf buffer 页数 */
+#define PERF_BUFFER_PAGES 8
+
+/* 事件回调 */
+typedef void (*event_handler_fn)(void *ctx, const struct tcp_connect_event *event);
+
+/* 事件源统计 */
+struct event_source_stats {
+    __u64 events;   /* 已消费的事件数 */
+    __u64 wakeups;  /* 取到事件的唤醒次数（含各消费者线程） */
+    __u64 lost;     /* perf buffer 写满而丢失的样本数（ring buffer 的丢失由内核侧计数） */
+};
+
+struct event_source;
+
+/**
+ * 为已加载的 eBPF 对象创建事件源（ring buffer 或 perf buffer）
+ * @param loader: 已加载的 eBPF 对象
+ * @param handler: 事件回调
+ * @param ctx: 回调上下文
+ * @return: 事件源指针，失败返回 NULL
+ */
+struct event_source *event_source_new(struct bpf_loader *loader,
+                                      event_handler_fn handler, void *ctx);
+
+/**
+ * 等待并消费事件
+ * @param src: 事件源
+ * @param timeout_ms: 超时时间（毫秒）
+ * @return: 成功返回非负值，失败返回负的错误码
+ */
+int event_source_poll(struct event_source *src, int timeout_ms);
+
+/**
+ * 获取事件源的 epoll 文件描述符
+ * @param src: 事件源
+ * @return: epoll fd
+ */
+int event_source_epoll_fd(struct event_source *src);
+
+/**
+ * 获取事件源统计
+ * @param src: 事件源
+ * @param stats: 用于存储统计结果
+ */
+void event_source_get_stats(struct event_source *src, struct event_source_stats *stats);
+
+/**
+ * 获取 perf buffer 各 CPU 丢失的样本数
+ * @param src: 事件源
+ * @param lost: 用于存储各 CPU 的丢失数
+ * @param max_cpus: lost 数组长度
+ * @return: 写入的 CPU 数，ring buffer 事件源返回 0
+ */
+int event_source_lost_per_cpu(struct event_source *src, __u64 *lost, int max_cpus);
+
+/* event_source_start_consumers 的线程数取该值时，每个 CPU 一个消费者线程 */
+#define EVENT_CONSUMERS_PER_CPU 0xffffffffU
+
+/**
+ * 启动每 CPU 消费者线程（仅 perf buffer）
+ * 各 CPU 的缓冲区均分给 consumers 个线程，每个线程绑定到所负责的 CPU，
+ * 通过 perf_buffer__consume_buffer 只消费这些缓冲区。
+ * 启动后事件回调在消费者线程中并发调用，调用者不应再对该事件源调用 event_source_poll
+ * @param src: 事件源
+ * @param consumers: 线程数，超过缓冲区数时按每 CPU 一个线程
+ * @return: 实际启动的线程数，失败返回负值
+ */
+int event_source_start_consumers(struct event_source *src, __u32 consumers);
+
+/**
+ * 停止每 CPU 消费者线程并等待其退出（未启动时不做任何事）
+ * @param src: 事件源
+ */
+void event_source_stop_consumers(struct event_source *src);
+
+/**
+ * 获取当前线程对应的消费者编号，可用于按消费者分片的下游状态
+ * @return: 消费者线程中返回 0 ~ consumers-1，其他线程返回 -1
+ */
+int event_source_consumer_id(void);
+
+/**
+ * 获取传输方式名称
+ * @param transport: 传输方式
+ * @return: 名称字符串
+ */
+const char *event_transport_name(enum event_transport transport);
+
+/**
+ * 释放事件源
+ * @param src: 事件源
+ */
+void event_source_free(struct event_source *src);
+
+#endif /* __EVENT_SOURCE_H__ */
@@ -0,0 +1,116 @@
+#ifndef __KEY_CACHE_H__
+#define __KEY_CACHE_H__
+
+#include <linux/types.h>
+
+/*
+ * 用户态密钥缓存
+ * 固定容量的开放寻址表：key 的哈希选定一组 KEY_CACHE_WAYS 个槽位，在组内线性探测，
+ * 组满时淘汰组内最久未使用的槽位（近似 LRU）。每个条目带过期时间，过期的条目不再命中，
+ * 查到过期条目的调用者负责刷新。每组一把锁，命中只做一次哈希、组内比较和一次值复制。
+ */
+
+/* key 的最大长度（字节） */
+#define KEY_CACHE_MAX_KEY 48
+
+/* 每组槽位数，即探测长度上限 */
+#define KEY_CACHE_WAYS 8
+
+/* 查询结果 */
+enum key_cache_result {
+    KEY_CACHE_MISS = 0,     /* 没有条目 */
+    KEY_CACHE_HIT = 1,      /* 命中，值已复制 */
+    KEY_CACHE_EXPIRED = 2,  /* 有条目但已过期，需要刷新 */
+};
+
+/* 缓存统计 */
+struct key_cache_stats {
+    __u64 capacity;         /* 槽位数 */
+    __u64 entries;          /* 当前占用的槽位数（含已过期未覆盖的） */
+    __u64 hits;
+    __u64 misses;
+    __u64 expired;          /* 查到过期条目的次数 */
+    __u64 insertions;
+    __u64 evictions;        /* 为新条目淘汰未过期条目的次数 */
+    __u64 invalidations;    /* 主动失效的条目数 */
+};
+
+struct key_cache;
+
+/**
+ * 创建缓存
+ * @param capacity: 槽位数，向上取整到 2 的幂（不小于 KEY_CACHE_WAYS）
+ * @param value_size: 值的大小（字节）
+ * @param ttl_ns: 条目的有效期
+ * @return: 缓存指针，失败返回 NULL
+ */
+struct key_cache *key_cache_new(__u32 capacity, __u32 value_size, __u64 ttl_ns);
+
+/**
+ * 查询 key，命中时刷新其 LRU 位置
+ * @param cache: 缓存
+ * @param key: 条目标识（按字节比较，调用方需清零填充字节）
+ * @param key_len: key 长度，不超过 KEY_CACHE_MAX_KEY
+ * @param value: 命中时用于存储值
+ * @return: enum key_cache_result
+ */
+int key_cache_lookup(struct key_cache *cache, const void *key, __u32 key_len, void *value);
+
+/**
+ * 查询 key，不计入统计也不刷新 LRU 位置（用于刷新前的复查）
+ * @return: 未过期的条目存在时返回 KEY_CACHE_HIT 并复制值，否则返回 KEY_CACHE_MISS
+ */
+int key_cache_peek(struct key_cache *cache, const void *key, __u32 key_len, void *value);
+
+/**
+ * 条目自上次插入以来是否被命中过（后台刷新据此跳过闲置的条目）
+ * @return: 条目未过期且命中过返回 1，否则返回 0
+ */
+int key_cache_touched(struct key_cache *cache, const void *key, __u32 key_len);
+
+/**
+ * 插入或覆盖 key 对应的条目，有效期从现在开始计算
+ * @param cache: 缓存
+ * @param key: 条目标识
+ * @param key_len: key 长度
+ * @param value: 值
+ */
+void key_cache_insert(struct key_cache *cache, const void *key, __u32 key_len, const void *value);
+
+/* key_cache_update 的回调：found 为 0 时 value 已清零，回调在组锁内原地修改 value */
+typedef void (*key_cache_update_fn)(void *value, int found, void *arg);
+
+/**
+ * 在组锁内读出、修改并写回 key 对应的条目（不存在或已过期时按新条目插入），
+ * 有效期从现在开始计算；并发更新同一 key 时不会丢失修改
+ * @param cache: 缓存
+ * @param key: 条目标识
+ * @param key_len: key 长度
+ * @param fn: 修改回调，不能再调用本缓存的其他函数
+ * @param arg: 回调参数
+ */
+void key_cache_update(struct key_cache *cache, const void *key, __u32 key_len,
+                      key_cache_update_fn fn, void *arg);
+
+/**
+ * 删除 key 对应的条目（如 TLSHub 报告密钥过期或刷新失败）
+ * @param cache: 缓存
+ * @param key: 条目标识
+ * @param key_len: key 长度
+ */
+void key_cache_invalidate(struct key_cache *cache, const void *key, __u32 key_len);
+
+/**
+ * 获取缓存统计
+ * @param cache: 缓存
+ * @param stats: 用于存储统计结果
+ */
+void key_cache_get_stats(struct key_cache *cache, struct key_cache_stats *stats);
+
+/**
+ * 释放缓存
+ * @param cache: 缓存
+ */
+void key_cache_free(struct key_cache *cache);
+
+#endif /* __KEY_CACHE_H__ */
@@ -0,0 +1,99 @@
+#ifndef __KEY_PREFETCH_H__
+#define __KEY_PREFETCH_H__
+
+#include <linux/types.h>
+
+/*
+ * 密钥预取
+ * 从前台请求中学习每个 Pod 对的连接频率（按半衰期指数衰减的计数，可由配置预置），
+ * 预取线程每个周期挑出频率不低于阈值、当前又没有缓存密钥的 Pod 对，
+ * 在没有协商进行中（空闲）时按频率从高到低预先协商，每秒的预取次数不超过预算（令牌桶）。
+ * 预取的密钥第一次被前台请求命中计为预取命中，未被使用就过期计为浪费的握手。
+ * 频率表为固定容量的分组开放寻址表（同 key_cache），每组一把锁，满时替换组内频率最低的条目。
+ */
+
+/* key 的最大长度（字节） */
+#define KEY_PREFETCH_MAX_KEY 48
+
+/* 默认预取周期 */
+#define KEY_PREFETCH_DEFAULT_INTERVAL_MS 100
+
+/* 预取回调 */
+struct key_prefetch_ops {
+    int (*cached)(void *arg, const void *key, __u32 key_len);   /* 已有可用密钥时返回非 0 */
+    int (*busy)(void *arg);                 /* 有协商进行中时返回非 0，此时不预取 */
+    int (*prefetch)(void *arg, const void *key, __u32 key_len, const void *data); /* 成功返回 0 */
+    void (*thread_exit)(void *arg);         /* 预取线程退出前调用，可为 NULL */
+};
+
+/* 预取配置 */
+struct key_prefetch_config {
+    __u32 capacity;         /* 最多跟踪的 Pod 对数 */
+    __u32 data_size;        /* 每个条目附带的数据大小（交给 prefetch 回调） */
+    __u32 rate;             /* 每秒最多预取次数 */
+    __u32 interval_ms;      /* 预取周期 */
+    __u32 half_life_ms;     /* 频率的半衰期 */
+    double min_score;       /* 预取的最低频率（衰减后的请求数） */
+};
+
+/* 预取统计 */
+struct key_prefetch_stats {
+    __u64 tracked;          /* 当前跟踪的 Pod 对数 */
+    __u64 seeded;           /* 预置的 Pod 对数 */
+    __u64 prefetched;       /* 成功的预取次数 */
+    __u64 failures;         /* 失败的预取次数 */
+    __u64 hits;             /* 预取的密钥被前台请求命中的次数 */
+    __u64 wasted;           /* 预取的密钥未被使用就过期的次数 */
+    __u64 busy;             /* 因有协商进行中而推迟的周期数 */
+    __u64 throttled;        /* 因预算不足而推迟的预取数 */
+};
+
+struct key_prefetch;
+
+/**
+ * 创建预取器并启动预取线程
+ * @param config: 预取配置
+ * @param ops: 预取回调
+ * @param arg: 回调参数
+ * @return: 预取器指针，失败返回 NULL
+ */
+struct key_prefetch *key_prefetch_new(const struct key_prefetch_config *config,
+                                      const struct key_prefetch_ops *ops, void *arg);
+
+/**
+ * 记录一次前台请求
+ * @param prefetch: 预取器
+ * @param key: Pod 对标识（按字节比较）
+ * @param key_len: key 长度，不超过 KEY_PREFETCH_MAX_KEY
+ * @param data: 交给 prefetch 回调的数据，data_size 字节
+ * @param cache_hit: 请求是否由缓存直接满足（用于统计预取命中）
+ */
+void key_prefetch_observe(struct key_prefetch *prefetch, const void *key, __u32 key_len,
+                          const void *data, int cache_hit);
+
+/**
+ * 预置一个 Pod 对
+ * @param prefetch: 预取器
+ * @param key: Pod 对标识
+ * @param key_len: key 长度
+ * @param data: 交给 prefetch 回调的数据
+ * @param score: 初始频率
+ * @return: 成功返回 0，表满或参数无效返回负值
+ */
+int key_prefetch_seed(struct key_prefetch *prefetch, const void *key, __u32 key_len,
+                      const void *data, double score);
+
+/**
+ * 获取预取统计
+ * @param prefetch: 预取器
+ * @param stats: 用于存储统计结果
+ */
+void key_prefetch_get_stats(struct key_prefetch *prefetch, struct key_prefetch_stats *stats);
+
+/**
+ * 停止预取线程（等待进行中的预取结束）并释放预取器
+ * @param prefetch: 预取器
+ */
+void key_prefetch_free(struct key_prefetch *prefetch);
+
+#endif /* __KEY_PREFETCH_H__ */
@@ -2,6 +2,35 @@
 #define __KEY_PROVIDER_H__
 
 #include "capture.h"
+#include "tlshub_client.h"
+#include "key_cache.h"
+#include "key_refresh.h"
+#include "key_prefetch.h"
+#include "circuit_breaker.h"
+
+/* 熔断器断开、请求被拒绝且没有配置后备提供者 */
+#define KEY_PROVIDER_UNAVAILABLE -4
+
+/* 密钥请求统计（TLSHub 和 stub 模式） */
+struct key_provider_stats {
+    __u64 requests;         /* key_provider_get_key 请求数 */
+    __u64 negotiations;     /* 实际执行的 fetch/handshake 协商次数 */
+    __u64 coalesced;        /* 复用进行中协商结果的请求数 */
+    __u64 inflight;         /* 当前进行中的协商数 */
+    __u64 max_waiters;      /* 单次协商的最多等待者数 */
+    __u64 tlshub_expired;   /* TLSHub 报告密钥过期的次数 */
+    struct key_cache_stats cache;   /* 协商结果缓存统计，未启用时为 0 */
+    struct key_refresh_stats refresh;   /* 后台刷新统计，未启用时为 0 */
+    struct key_prefetch_stats prefetch; /* 预取统计，未启用时为 0 */
+    struct tlshub_request_stats tlshub; /* TLSHub 请求的超时、重试和耗时，非 TLSHub 模式时为 0 */
+    __u64 negative_entries;         /* 握手负缓存中的 Pod 对数（含已过退避期的） */
+    __u64 handshake_failures;       /* TLSHub 回复握手失败的次数 */
+    __u64 handshakes_suppressed;    /* 退避期内在本地以失败应答、未发出的握手数 */
+    __u64 handshakes_retried;       /* 退避结束后重新发出的握手数 */
+    int breaker_enabled;    /* 是否启用了 TLSHub 熔断器 */
+    struct circuit_breaker_stats breaker;   /* TLSHub 熔断器统计，未启用时为 0 */
+    __u64 fallbacks;        /* 熔断器断开期间由后备提供者应答的请求数 */
+};
 
 /**
  * 初始化密钥提供者
@@ -15,9 +44,27 @@ int key_provider_init(enum key_provider_mode mode);
  */
 void key_provider_cleanup(void);
 
+/**
+ * 释放当前线程持有的密钥提供者资源
+ * key_provider_get_key 可在多个线程中并发调用，每个线程退出前应调用
+ */
+void key_provider_thread_cleanup(void);
+
+/**
+ * 获取需要由事件循环监听的文件描述符
+ * @return: 文件描述符，当前模式没有异步消息时返回 -1
+ */
+int key_provider_event_fd(void);
+
+/**
+ * 处理 key_provider_event_fd() 上的待处理消息，不会阻塞
+ * @return: 成功返回非负值，失败返回负值
+ */
+int key_provider_process_events(void);
+
 /**
  * 获取密钥
- * @param tuple: 四元组信息
+ * @param tuple: 四元组信息（客户端 -> 服务端，tuple->role 为本机角色）
  * @param key_info: 用于存储获取的密钥信息
  * @return: 成功返回 0，失败返回负值
  */
@@ -29,6 +76,109 @@ int key_provider_get_key(struct flow_tuple *tuple, struct tls_key_info *key_info
  */
 void key_provider_set_mode(enum key_provider_mode mode);
 
+/**
+ * 设置并发密钥请求的合并粒度（默认按 Pod 对合并）
+ * @param coalesce: 合并粒度
+ */
+void key_provider_set_coalesce(enum key_coalesce coalesce);
+
+/**
+ * 设置 MODE_STUB 每次协商的模拟耗时
+ * @param latency_us: 微秒，0 表示立即返回
+ */
+void key_provider_set_stub_latency(__u32 latency_us);
+
+/**
+ * 设置 TLSHub 单 socket 流水线深度，需在 key_provider_init 之前调用
+ * @param depth: 在途请求上限，0 表示每个工作线程各用一个 socket、一次一个请求
+ */
+void key_provider_set_pipeline_depth(__u32 depth);
+
+/**
+ * 设置 TLSHub 批量请求参数，需在 key_provider_init 之前调用
+ * @param max_entries: 每条消息最多的请求数，小于 2 表示每个请求单独发送
+ * @param delay_us: 批次等待更多请求的最长时间
+ */
+void key_provider_set_batching(__u32 max_entries, __u32 delay_us);
+
+/**
+ * 设置与 TLSHub 之间的传输，需在 key_provider_init 之前调用（默认 netlink）
+ * @param transport: netlink、unix 或 mock
+ * @param unix_path: unix 传输的端点路径，NULL 或空串使用默认路径
+ * @param mock: mock 传输的替身配置
+ */
+void key_provider_set_tlshub_transport(enum tlshub_transport transport, const char *unix_path,
+                                       const struct tlshub_standin_config *mock);
+
+/**
+ * 设置 TLSHub 请求的超时与重试策略，需在 key_provider_init 之前调用
+ * @param policy: 策略，NULL 使用默认值（见 tlshub_client.h）
+ */
+void key_provider_set_tlshub_retry(const struct tlshub_retry_policy *policy);
+
+/**
+ * 取消进行中的 TLSHub 请求，之后的请求立即失败，用于退出时不等待挂起的请求
+ * 可在任意线程中调用，key_provider_cleanup 后恢复
+ */
+void key_provider_cancel(void);
+
+/**
+ * 设置 TLSHub 熔断器，需在 key_provider_init 之前调用（默认按 circuit_breaker.h 的默认参数启用）
+ * @param config: 熔断参数（data_size 被忽略），NULL 表示不启用
+ */
+void key_provider_set_breaker(const struct circuit_breaker_config *config);
+
+/**
+ * 设置熔断器断开时的后备提供者，需在 key_provider_init 之前调用
+ * @param mode: MODE_STUB；MODE_TLSHUB（默认）表示不使用后备，请求立即以 KEY_PROVIDER_UNAVAILABLE 失败。
+ *              MODE_OPENSSL/MODE_BORINGSSL 需要已完成的 TLS 握手，不能作为后备，key_provider_init 会失败
+ */
+void key_provider_set_fallback(enum key_provider_mode mode);
+
+/**
+ * 设置 TLSHub 握手负缓存，需在 key_provider_init 之前调用（默认 1024 个 Pod 对，退避 1-60 秒）
+ * @param capacity: 记录的 Pod 对数，0 表示不启用
+ * @param backoff_ms: 第一次握手失败后的退避，之后每次连续失败加倍
+ * @param backoff_max_ms: 退避上限
+ */
+void key_provider_set_negative_cache(__u32 capacity, __u32 backoff_ms, __u32 backoff_max_ms);
+
+/**
+ * 设置协商结果缓存，需在 key_provider_init 之前调用（TLSHub 和 stub 模式）
+ * @param capacity: 缓存条目数，0 表示不缓存
+ * @param ttl_ms: 条目有效期，过期后下一次请求重新协商
+ */
+void key_provider_set_cache(__u32 capacity, __u32 ttl_ms);
+
+/**
+ * 设置缓存密钥的后台刷新，需在 key_provider_init 之前调用，要求启用缓存
+ * @param lead_ms: 在过期前多久刷新，0 表示不刷新
+ * @param jitter_ms: 额外提前的随机量上限，lead_ms + jitter_ms 需小于缓存有效期
+ * @param threads: 刷新线程数
+ */
+void key_provider_set_refresh(__u32 lead_ms, __u32 jitter_ms, __u32 threads);
+
+/**
+ * 设置密钥预取，需在 key_provider_init 之前调用，要求启用缓存且按 Pod 对合并
+ * @param rate: 每秒最多预取次数，0 表示不预取
+ * @param min_score: 预取的最低频率（按半衰期衰减后的请求数）
+ * @param half_life_ms: 频率的半衰期
+ */
+void key_provider_set_prefetch(__u32 rate, double min_score, __u32 half_life_ms);
+
+/**
+ * 预置一个预取的 Pod 对（如按 Pod-Node 映射），频率设为预取阈值
+ * @param tuple: 四元组信息，端口被忽略
+ * @return: 成功返回 0，未启用预取或表满返回负值
+ */
+int key_provider_prefetch_seed(struct flow_tuple *tuple);
+
+/**
+ * 获取密钥请求统计
+ * @param stats: 用于存储统计结果
+ */
+void key_provider_get_stats(struct key_provider_stats *stats);
+
 /**
  * 获取当前密钥提供者模式
  * @return: 当前模式
@@ -0,0 +1,96 @@
+#ifndef __KEY_REFRESH_H__
+#define __KEY_REFRESH_H__
+
+#include <linux/types.h>
+
+/*
+ * 后台密钥刷新
+ * 跟踪每个缓存密钥的过期时间，在过期前 lead_ms（再提前 0~jitter_ms 的随机抖动，
+ * 避免同一批密钥同时刷新）由后台线程调用刷新回调，前台连接始终命中未过期的密钥。
+ * 刷新时间挂在分层时间轮（timing_wheel.c）上，添加、重新定时和每个 tick 的推进都是 O(1)。
+ * 条目刷新后即从表中移除，回调成功时由调用者用新的过期时间再次调度。
+ */
+
+/* key 的最大长度（字节） */
+#define KEY_REFRESH_MAX_KEY 48
+
+/* 默认时间轮精度 */
+#define KEY_REFRESH_DEFAULT_TICK_MS 10
+
+/* 刷新回调返回值：条目闲置，不再刷新 */
+#define KEY_REFRESH_IDLE 1
+
+/* 刷新回调：成功返回 0，闲置返回 KEY_REFRESH_IDLE，失败返回负值 */
+struct key_refresh_ops {
+    int (*refresh)(void *arg, const void *key, __u32 key_len, const void *data);
+    void (*thread_exit)(void *arg);     /* 刷新线程退出前调用，可为 NULL */
+};
+
+/* 调度器配置 */
+struct key_refresh_config {
+    __u32 capacity;         /* 最多跟踪的条目数 */
+    __u32 data_size;        /* 每个条目附带的数据大小（交给回调） */
+    __u32 tick_ms;          /* 时间轮精度 */
+    __u32 lead_ms;          /* 在过期前多久刷新 */
+    __u32 jitter_ms;        /* 额外提前的随机量上限 */
+    __u32 threads;          /* 刷新线程数 */
+};
+
+/* 调度器统计 */
+struct key_refresh_stats {
+    __u64 tracked;          /* 当前跟踪的条目数 */
+    __u64 scheduled;        /* 调度（含重新定时）次数 */
+    __u64 refreshed;        /* 刷新成功次数 */
+    __u64 failures;         /* 刷新失败次数 */
+    __u64 idle;             /* 因闲置放弃刷新的次数 */
+    __u64 dropped;          /* 表满未能跟踪的次数 */
+    __u64 late;             /* 刷新开始时已过期的次数 */
+    __u64 max_due;          /* 单次推进到期的最多条目数 */
+};
+
+struct key_refresh;
+
+/**
+ * 创建调度器并启动刷新线程
+ * @param config: 调度器配置
+ * @param ops: 刷新回调
+ * @param arg: 回调参数
+ * @return: 调度器指针，失败返回 NULL
+ */
+struct key_refresh *key_refresh_new(const struct key_refresh_config *config,
+                                    const struct key_refresh_ops *ops, void *arg);
+
+/**
+ * 调度 key 的刷新，已跟踪时更新过期时间和数据
+ * @param refresh: 调度器
+ * @param key: 条目标识（按字节比较）
+ * @param key_len: key 长度，不超过 KEY_REFRESH_MAX_KEY
+ * @param data: 交给回调的数据，data_size 字节
+ * @param expires_ns: 条目过期的时间（CLOCK_MONOTONIC）
+ * @return: 成功返回 0，表满或参数无效返回负值
+ */
+int key_refresh_schedule(struct key_refresh *refresh, const void *key, __u32 key_len,
+                         const void *data, __u64 expires_ns);
+
+/**
+ * 取消 key 的刷新
+ * @param refresh: 调度器
+ * @param key: 条目标识
+ * @param key_len: key 长度
+ */
+void key_refresh_cancel(struct key_refresh *refresh, const void *key, __u32 key_len);
+
+/**
+ * 获取调度器统计
+ * @param refresh: 调度器
+ * @param stats: 用于存储统计结果
+ */
+void key_refresh_get_stats(struct key_refresh *refresh, struct key_refresh_stats *stats);
+
+/**
+ * 停止刷新线程（等待进行中的回调结束）并释放调度器
+ * @param refresh: 调度器
+ */
+void key_refresh_free(struct key_refresh *refresh);
+
+#endif /* __KEY_REFRESH_H__ */
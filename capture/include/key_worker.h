@@ -0,0 +1,84 @@
+#ifndef __KEY_WORKER_H__
+#define __KEY_WORKER_H__
+
+#include "capture_events.h"
+#include "event_source.h"
+
+/* 默认工作线程数与队列容量 */
+#define KEY_WORKER_DEFAULT_THREADS 4
+#define KEY_WORKER_DEFAULT_QUEUE_SIZE 1024
+#define KEY_WORKER_MAX_THREADS 64
+/* 分片的最小队列容量，总容量不够时减少分片数 */
+#define KEY_WORKER_MIN_SHARD_SIZE 64
+
+/* 工作线程退出前的回调，用于释放线程私有资源（如 Netlink socket） */
+typedef void (*key_worker_exit_fn)(void *ctx);
+
+/* 工作线程池统计 */
+struct key_worker_stats {
+    __u64 submitted;        /* 成功入队的事件 */
+    __u64 dropped;          /* 队列满（或退出时未处理）而丢弃的事件 */
+    __u64 completed;        /* 已处理完成的事件 */
+    __u64 queue_depth;      /* 当前排队数（各分片之和） */
+    __u64 queue_max_depth;  /* 排队数峰值（各分片峰值之和） */
+    __u64 queue_capacity;   /* 队列容量（各分片之和） */
+    __u64 wait_total_ns;    /* 事件在队列中等待的累计时间 */
+    __u64 wait_max_ns;      /* 单个事件的最长等待时间 */
+    __u64 busy_ns;          /* 所有工作线程处理事件的累计时间 */
+    __u64 stolen;           /* 由其他分片的空闲工作线程取走处理的事件 */
+    __u64 elapsed_ns;       /* 线程池运行时长 */
+    __u32 workers;          /* 工作线程数 */
+    __u32 shards;           /* 队列分片数 */
+};
+
+struct key_worker_pool;
+
+/**
+ * 创建工作线程池并启动工作线程
+ * 分片数大于 1 时每个分片有独立的队列、信号量和计数器，工作线程轮流分配给各分片，
+ * 每 CPU 事件消费者线程只提交到自己编号对应的分片（见 event_source_consumer_id）；
+ * 工作线程自己的分片为空时从其他分片窃取，一个分片的线程被慢协商占住时事件不会一直排队
+ * @param workers: 工作线程数
+ * @param queue_size: 队列总容量，在分片间均分（每个分片向上取整到 2 的幂）
+ * @param shards: 队列分片数，0 或 1 表示不分片，不超过 workers，
+ *                每个分片不足 KEY_WORKER_MIN_SHARD_SIZE 个槽位时相应减少
+ * @param handler: 在工作线程中处理单个事件的回调
+ * @param on_exit: 工作线程退出前的回调，可为 NULL
+ * @param ctx: 回调上下文
+ * @return: 线程池指针，失败返回 NULL
+ */
+struct key_worker_pool *key_worker_pool_new(__u32 workers, __u32 queue_size, __u32 shards,
+                                            event_handler_fn handler,
+                                            key_worker_exit_fn on_exit, void *ctx);
+
+/**
+ * 提交事件（由事件循环或事件消费者线程调用，不会阻塞）
+ * 消费者线程提交到对应的分片，其他线程按端口散列到各分片
+ * @param pool: 线程池
+ * @param event: 连接事件（按值复制入队）
+ * @return: 成功返回 0，队列已满返回 -1（事件被丢弃并计数）
+ */
+int key_worker_submit(struct key_worker_pool *pool, const struct tcp_connect_event *event);
+
+/**
+ * 获取线程池统计
+ * @param pool: 线程池
+ * @param stats: 用于存储统计结果
+ */
+void key_worker_get_stats(struct key_worker_pool *pool, struct key_worker_stats *stats);
+
+/**
+ * 停止线程池
+ * 工作线程处理完当前事件后退出，队列中剩余的事件计入 dropped；
+ * 停止后仍可调用 key_worker_get_stats 获取最终统计
+ * @param pool: 线程池
+ */
+void key_worker_pool_stop(struct key_worker_pool *pool);
+
+/**
+ * 释放线程池（尚未停止时先停止）
+ * @param pool: 线程池
+ */
+void key_worker_pool_free(struct key_worker_pool *pool);
+
+#endif /* __KEY_WORKER_H__ */
@@ -0,0 +1,44 @@
+#ifndef __LATENCY_HIST_H__
+#define __LATENCY_HIST_H__
+
+#include <linux/types.h>
+
+/*
+ * 延迟直方图
+ * 对数-线性分桶：按最高有效位分组，每组再线性分为 LATENCY_HIST_SUB_BUCKETS 个桶，
+ * 相对误差不超过 1/LATENCY_HIST_SUB_BUCKETS。记录只做原子加，可在多个线程中并发调用。
+ */
+
+#define LATENCY_HIST_SUB_BITS 4
+#define LATENCY_HIST_SUB_BUCKETS (1U << LATENCY_HIST_SUB_BITS)
+#define LATENCY_HIST_BUCKETS ((64 - LATENCY_HIST_SUB_BITS + 1) * LATENCY_HIST_SUB_BUCKETS)
+
+struct latency_hist {
+    __u64 buckets[LATENCY_HIST_BUCKETS];
+    __u64 count;
+    __u64 sum_ns;
+    __u64 max_ns;
+};
+
+/**
+ * 清空直方图
+ * @param hist: 直方图
+ */
+void latency_hist_reset(struct latency_hist *hist);
+
+/**
+ * 记录一个样本
+ * @param hist: 直方图
+ * @param ns: 延迟（纳秒）
+ */
+void latency_hist_record(struct latency_hist *hist, __u64 ns);
+
+/**
+ * 计算分位数
+ * @param hist: 直方图
+ * @param quantile: 分位（0-1，如 0.99）
+ * @return: 对应桶的上界（纳秒），没有样本时返回 0
+ */
+__u64 latency_hist_quantile(const struct latency_hist *hist, double quantile);
+
+#endif /* __LATENCY_HIST_H__ */
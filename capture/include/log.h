@@ -0,0 +1,171 @@
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include <linux/types.h>
+
+/*
+ * 异步日志
+ * 调用线程只把格式串指针和参数原值写入本线程私有的无锁环形缓冲区（单生产者单消费者），
+ * 字符串参数按值复制；格式化和写文件都由后台刷新线程完成，热路径上没有 stdio 锁和系统调用。
+ * 低于编译期级别 LOG_COMPILE_LEVEL 的日志连同参数求值一起被编译器删除。
+ *
+ * 格式串必须是字符串常量（记录中只保存指针），最多 LOG_MAX_ARGS 个参数，
+ * 支持 d i u x X o c s p e f g 转换及 hh h l ll z 长度修饰，不支持 * 宽度。
+ * 未调用 log_init 时（如测试工具）直接同步输出到 stdout/stderr。
+ */
+
+enum log_level {
+    LOG_LEVEL_DEBUG = 0,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_OFF,
+};
+
+/* 编译期日志级别，低于该级别的调用不生成代码（make LOG_LEVEL=0 打开 debug 日志） */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_MAX_ARGS 8
+
+/* 输出格式 */
+enum log_format {
+    LOG_FORMAT_TEXT = 0,    /* 时间 级别 [线程] 消息 */
+    LOG_FORMAT_JSON,        /* 每行一个 JSON 对象 */
+};
+
+/* 日志配置 */
+struct log_config {
+    enum log_level level;           /* 运行期级别 */
+    enum log_format format;
+    const char *path;               /* 输出文件，NULL 表示 stdout（WARN 及以上写 stderr） */
+    __u32 ring_size;                /* 每线程环形缓冲区记录数 */
+    __u32 rate_limit;               /* 每线程每秒最多记录数，0 表示不限 */
+    __u32 flush_interval_ms;        /* 后台线程刷新间隔 */
+};
+
+#define LOG_DEFAULT_RING_SIZE 1024
+#define LOG_DEFAULT_RATE_LIMIT 1000
+#define LOG_DEFAULT_FLUSH_INTERVAL_MS 20
+
+/* 日志统计 */
+struct log_stats {
+    __u64 written;          /* 已写出的记录 */
+    __u64 dropped;          /* 环形缓冲区满而丢弃的记录 */
+    __u64 suppressed;       /* 超过速率限制而丢弃的记录 */
+};
+
+/* 单个参数：类型标签和原值 */
+enum log_arg_type {
+    LOG_ARG_INT = 0,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_STR,
+    LOG_ARG_PTR,
+};
+
+struct log_arg {
+    __u8 type;
+    union {
+        unsigned long long i;
+        double d;
+        const char *s;
+        const void *p;
+    };
+};
+
+static inline struct log_arg log_arg_int(unsigned long long v) {
+    return (struct log_arg){ .type = LOG_ARG_INT, .i = v };
+}
+
+static inline struct log_arg log_arg_double(double v) {
+    return (struct log_arg){ .type = LOG_ARG_DOUBLE, .d = v };
+}
+
+static inline struct log_arg log_arg_str(const char *v) {
+    return (struct log_arg){ .type = LOG_ARG_STR, .s = v };
+}
+
+static inline struct log_arg log_arg_ptr(const void *v) {
+    return (struct log_arg){ .type = LOG_ARG_PTR, .p = v };
+}
+
+#define LOG_ARG(x) _Generic((x),                \
+    char *: log_arg_str,                        \
+    const char *: log_arg_str,                  \
+    void *: log_arg_ptr,                        \
+    const void *: log_arg_ptr,                  \
+    float: log_arg_double,                      \
+    double: log_arg_double,                     \
+    default: log_arg_int)(x)
+
+/* 对最多 LOG_MAX_ARGS 个参数逐个套用 LOG_ARG */
+#define LOG_NARG_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+#define LOG_NARG(...) LOG_NARG_(_0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_CAT_(a, b) a##b
+#define LOG_CAT(a, b) LOG_CAT_(a, b)
+#define LOG_MAP_0()
+#define LOG_MAP_1(a) LOG_ARG(a)
+#define LOG_MAP_2(a, ...) LOG_ARG(a), LOG_MAP_1(__VA_ARGS__)
+#define LOG_MAP_3(a, ...) LOG_ARG(a), LOG_MAP_2(__VA_ARGS__)
+#define LOG_MAP_4(a, ...) LOG_ARG(a), LOG_MAP_3(__VA_ARGS__)
+#define LOG_MAP_5(a, ...) LOG_ARG(a), LOG_MAP_4(__VA_ARGS__)
+#define LOG_MAP_6(a, ...) LOG_ARG(a), LOG_MAP_5(__VA_ARGS__)
+#define LOG_MAP_7(a, ...) LOG_ARG(a), LOG_MAP_6(__VA_ARGS__)
+#define LOG_MAP_8(a, ...) LOG_ARG(a), LOG_MAP_7(__VA_ARGS__)
+#define LOG_ARGS(...) LOG_CAT(LOG_MAP_, LOG_NARG(__VA_ARGS__))(__VA_ARGS__)
+
+/* 只用于让编译器按 printf 规则检查格式串和参数类型，不会被调用 */
+static inline __attribute__((format(printf, 1, 2))) void log_check_format(const char *fmt, ...) {
+    (void)fmt;
+}
+
+#define LOG_AT(level, fmt, ...) do {                                            \
+    if ((level) >= LOG_COMPILE_LEVEL) {                                         \
+        const struct log_arg log_args_[] = { { 0 }, LOG_ARGS(__VA_ARGS__) };    \
+        if (0) {                                                                \
+            log_check_format(fmt, ##__VA_ARGS__);                               \
+        }                                                                       \
+        log_emit((level), "" fmt, LOG_NARG(__VA_ARGS__), log_args_ + 1);        \
+    }                                                                           \
+} while (0)
+
+#define log_debug(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define log_info(fmt, ...)  LOG_AT(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define log_warn(fmt, ...)  LOG_AT(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define log_error(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+
+/**
+ * 初始化日志并启动后台刷新线程
+ * @param config: 日志配置（ring_size、flush_interval_ms 为 0 时使用默认值），NULL 表示全部默认
+ * @return: 成功返回 0，失败返回负值（此时日志保持同步输出）
+ */
+int log_init(const struct log_config *config);
+
+/**
+ * 记录一条日志（由 log_* 宏调用）
+ * @param level: 级别
+ * @param fmt: 格式串常量
+ * @param nargs: 参数个数
+ * @param args: 参数
+ */
+void log_emit(enum log_level level, const char *fmt, int nargs, const struct log_arg *args);
+
+/**
+ * 获取日志统计
+ * @param stats: 用于存储统计结果
+ */
+void log_get_stats(struct log_stats *stats);
+
+/**
+ * 停止后台线程，写出所有未刷新的记录并关闭输出文件
+ */
+void log_shutdown(void);
+
+/**
+ * 解析级别名称（debug/info/warn(ing)/error/off）
+ * @return: 级别，无法识别时返回 -1
+ */
+int log_level_parse(const char *name);
+
+#endif /* __LOG_H__ */
@@ -0,0 +1,48 @@
+#ifndef __MPMC_QUEUE_H__
+#define __MPMC_QUEUE_H__
+
+#include <stddef.h>
+
+/*
+ * 有界无锁多生产者多消费者队列
+ * 每个槽位带一个序号，生产者/消费者各自用 CAS 推进 enqueue/dequeue 位置，
+ * 队列满或空时立即返回，不会阻塞调用者
+ */
+struct mpmc_queue;
+
+/**
+ * 创建队列
+ * @param capacity: 槽位数，向上取整到 2 的幂
+ * @param elem_size: 单个元素字节数
+ * @return: 成功返回队列，失败返回 NULL
+ */
+struct mpmc_queue *mpmc_queue_new(size_t capacity, size_t elem_size);
+
+/**
+ * 入队（复制 elem_size 字节）
+ * @return: 成功返回 0，队列已满返回 -1
+ */
+int mpmc_queue_push(struct mpmc_queue *q, const void *elem);
+
+/**
+ * 出队
+ * @return: 成功返回 0，队列为空返回 -1
+ */
+int mpmc_queue_pop(struct mpmc_queue *q, void *elem);
+
+/**
+ * 当前排队元素数（并发修改时为近似值）
+ */
+size_t mpmc_queue_depth(struct mpmc_queue *q);
+
+/**
+ * 队列容量（取整后的槽位数）
+ */
+size_t mpmc_queue_capacity(struct mpmc_queue *q);
+
+/**
+ * 释放队列，调用前须确保没有线程仍在使用
+ */
+void mpmc_queue_free(struct mpmc_queue *q);
+
+#endif /* __MPMC_QUEUE_H__ */
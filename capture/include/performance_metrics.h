@@ -3,6 +3,7 @@
 
 #include <linux/types.h>
 #include <time.h>
+#include <pthread.h>
 #include <sys/time.h>
 
 /* 性能指标类型 */
@@ -71,6 +72,141 @@ struct performance_stats {
     __u64 peak_memory_usage_kb;
 };
 
+/* eBPF socket 捕获状态使用情况 */
+struct bpf_map_metrics {
+    __u64 entries;                 /* 当前存活条目数 */
+    __u64 creates;                 /* 累计创建 */
+    __u64 deletes;                 /* 累计连接失败/关闭时删除 */
+};
+
+/* eBPF 连接过滤统计 */
+struct bpf_policy_metrics {
+    __u64 suppressed_addr;         /* 地址策略过滤掉的连接 */
+    __u64 suppressed_port;         /* 端口策略过滤掉的连接 */
+};
+
+/* eBPF 探针活动统计 */
+struct bpf_probe_metrics {
+    __u64 connects;                /* 观察到的主动连接 */
+    __u64 connect_failures;        /* 连接发起失败 */
+    __u64 sendmsg_hits;            /* tcp_sendmsg 探针命中 */
+    __u64 events_emitted;          /* 提交到用户态的事件 */
+    __u64 family_skipped;          /* 非 IPv4/IPv6 而跳过的连接 */
+    __u64 accepts;                 /* 观察到的被动连接（服务端） */
+};
+
+/* 密钥协商工作线程池统计 */
+struct key_worker_metrics {
+    __u32 workers;                 /* 工作线程数 */
+    __u64 submitted;               /* 入队事件数 */
+    __u64 dropped;                 /* 队列满而丢弃的事件数 */
+    __u64 completed;               /* 处理完成的事件数 */
+    __u64 queue_depth;             /* 当前排队数 */
+    __u64 queue_max_depth;         /* 排队数峰值 */
+    __u64 queue_capacity;          /* 队列容量 */
+    double avg_wait_ms;            /* 平均排队等待时间 */
+    double max_wait_ms;            /* 最长排队等待时间 */
+    double utilization_percent;    /* 工作线程忙碌时间占比 */
+};
+
+/* 密钥请求合并统计 */
+struct key_request_metrics {
+    __u64 requests;                /* 密钥请求数 */
+    __u64 negotiations;            /* 实际发起的协商次数 */
+    __u64 coalesced;               /* 复用进行中协商结果的请求数 */
+    __u64 max_waiters;             /* 单次协商的最多等待者数 */
+    double dedup_ratio_percent;    /* coalesced / requests，即省下的协商往返占比 */
+};
+
+/* 密钥缓存统计 */
+struct key_cache_metrics {
+    __u64 capacity;                /* 缓存槽位数，0 表示未启用 */
+    __u64 entries;                 /* 当前条目数 */
+    __u64 hits;                    /* 命中次数 */
+    __u64 misses;                  /* 未命中次数 */
+    __u64 expired;                 /* 查到过期条目（触发刷新）的次数 */
+    __u64 evictions;               /* 淘汰未过期条目的次数 */
+    __u64 tlshub_expired;          /* TLSHub 报告密钥过期（status -2）的次数 */
+    __u64 refresh_tracked;         /* 后台刷新跟踪的条目数 */
+    __u64 refreshed;               /* 过期前完成的后台刷新次数 */
+    __u64 refresh_failures;        /* 后台刷新失败次数 */
+    __u64 refresh_idle;            /* 因闲置不再刷新的条目数 */
+    __u64 refresh_late;            /* 开始时条目已过期的刷新次数 */
+    double hit_ratio_percent;      /* hits / (hits + misses + expired) */
+};
+
+/* 密钥预取统计 */
+struct key_prefetch_metrics {
+    __u64 tracked;                 /* 跟踪频率的 Pod 对数 */
+    __u64 seeded;                  /* 按 Pod-Node 映射预置的 Pod 对数 */
+    __u64 prefetched;              /* 成功的预取次数 */
+    __u64 failures;                /* 失败的预取次数 */
+    __u64 hits;                    /* 预取的密钥被前台请求命中的次数 */
+    __u64 wasted;                  /* 预取的密钥未被使用就过期的次数（浪费的握手） */
+    __u64 busy;                    /* 因有协商进行中而推迟的周期数 */
+    __u64 throttled;               /* 因预算不足而推迟的预取数 */
+    double hit_ratio_percent;      /* hits / (hits + wasted) */
+};
+
+/* TLSHub 请求统计 */
+struct tlshub_request_metrics {
+    __u64 requests;                /* fetch/handshake 调用数 */
+    __u64 attempts;                /* 含重试在内的尝试数 */
+    __u64 retries;                 /* 重试次数 */
+    __u64 timeouts;                /* 超过期限的尝试 */
+    __u64 errors;                  /* 收发失败的尝试 */
+    __u64 gave_up;                 /* 重试用尽仍失败的调用 */
+    __u64 cancelled;               /* 退出时被取消的调用 */
+    double fetch_p50_ms;           /* fetch 调用耗时（含重试） */
+    double fetch_p99_ms;
+    double fetch_p999_ms;
+    double fetch_max_ms;
+    double handshake_p50_ms;       /* 握手调用耗时（含重试） */
+    double handshake_p99_ms;
+    double handshake_p999_ms;
+    double handshake_max_ms;
+};
+
+/* TLSHub 熔断统计 */
+struct breaker_metrics {
+    __u32 state;                   /* enum circuit_breaker_state */
+    __u64 opened;                  /* 断开次数 */
+    __u64 half_opened;             /* 探测成功进入半开的次数 */
+    __u64 closed;                  /* 恢复闭合的次数 */
+    __u64 rejected;                /* 断开期间被拒绝的协商 */
+    __u64 fallbacks;               /* 由后备提供者应答的请求 */
+    __u64 probes;                  /* 后台探测次数 */
+    __u64 probe_failures;          /* 失败的探测次数 */
+    __u64 open_ms;                 /* 累计断开时长 */
+    __u64 window_requests;         /* 当前窗口内的协商数 */
+    __u64 window_failures;         /* 当前窗口内的失败数 */
+    __u64 window_slow;             /* 当前窗口内的慢调用数 */
+    int enabled;                   /* 是否有统计（TLSHub 模式且启用熔断） */
+};
+
+/* 握手失败退避（负缓存）统计 */
+struct handshake_backoff_metrics {
+    __u64 entries;                 /* 记录的 Pod 对数 */
+    __u64 failures;                /* TLSHub 回复握手失败的次数 */
+    __u64 suppressed;              /* 退避期内在本地应答、未发出的握手 */
+    __u64 retried;                 /* 退避结束后重新发出的握手 */
+};
+
+/* 按 CPU 记录的事件丢失最多覆盖的 CPU 数 */
+#define PERF_METRICS_MAX_CPUS 256
+
+/* 事件丢失与背压统计 */
+struct event_loss_metrics {
+    __u64 perf_lost;               /* perf buffer 溢出丢失的样本（lost_cb） */
+    __u64 kernel_drops;            /* 内核提交事件失败（ring buffer 预留或 perf 输出失败） */
+    __u64 shed;                    /* 背压时内核主动丢弃的低优先级事件 */
+    __u32 shed_mode;               /* 当前背压模式（enum capture_shed_mode） */
+    __u64 shed_transitions;        /* 背压模式切换次数 */
+    __u32 ncpus;                   /* 下面两个数组的有效长度 */
+    __u64 lost_per_cpu[PERF_METRICS_MAX_CPUS];
+    __u64 drops_per_cpu[PERF_METRICS_MAX_CPUS];
+};
+
 /* CPU 统计信息（用于计算使用率） */
 struct cpu_stat {
     unsigned long long user;
@@ -94,6 +230,38 @@ struct perf_metrics_ctx {
     struct timespec start_time;               /* 监控开始时间 */
     int monitoring_enabled;                   /* 是否启用监控 */
     
+    /* eBPF socket 捕获状态 */
+    struct bpf_map_metrics sk_state;          /* sk_state_map */
+    struct bpf_policy_metrics policy;         /* 内核过滤计数 */
+    struct bpf_probe_metrics probes;          /* 探针活动计数 */
+    
+    /* 密钥协商工作线程池 */
+    struct key_worker_metrics workers;
+    
+    /* 密钥请求合并 */
+    struct key_request_metrics key_requests;
+    
+    /* 密钥缓存 */
+    struct key_cache_metrics key_cache;
+    
+    /* 密钥预取 */
+    struct key_prefetch_metrics key_prefetch;
+    
+    /* TLSHub 请求 */
+    struct tlshub_request_metrics tlshub_requests;
+    
+    /* TLSHub 熔断 */
+    struct breaker_metrics breaker;
+    
+    /* 握手失败退避 */
+    struct handshake_backoff_metrics handshake_backoff;
+    
+    /* 事件丢失与背压 */
+    struct event_loss_metrics loss;
+    
+    /* 工作线程与事件循环并发更新指标，所有读写都在锁内进行 */
+    pthread_mutex_t lock;
+    
     /* CPU 监控状态 */
     struct cpu_stat prev_cpu_stat;            /* 上次 CPU 统计 */
     int cpu_first_call;                       /* 是否第一次调用 */
@@ -192,6 +360,94 @@ void perf_metrics_connection_end(struct perf_metrics_ctx *ctx, int conn_index, i
  */
 int perf_metrics_update_system(struct perf_metrics_ctx *ctx);
 
+/**
+ * 更新 eBPF socket 捕获状态使用情况
+ * @param ctx 性能指标上下文
+ * @param sk_state sk_state_map 使用情况
+ */
+void perf_metrics_update_bpf_maps(struct perf_metrics_ctx *ctx,
+                                  const struct bpf_map_metrics *sk_state);
+
+/**
+ * 更新 eBPF 连接过滤统计
+ * @param ctx 性能指标上下文
+ * @param policy 内核中被过滤的连接数
+ */
+void perf_metrics_update_bpf_policy(struct perf_metrics_ctx *ctx,
+                                    const struct bpf_policy_metrics *policy);
+
+/**
+ * 更新 eBPF 探针活动统计
+ * @param ctx 性能指标上下文
+ * @param probes 各 CPU 汇总后的探针计数
+ */
+void perf_metrics_update_bpf_probes(struct perf_metrics_ctx *ctx,
+                                    const struct bpf_probe_metrics *probes);
+
+/**
+ * 更新密钥协商工作线程池统计
+ * @param ctx 性能指标上下文
+ * @param workers 队列深度、等待时间和线程利用率
+ */
+void perf_metrics_update_key_workers(struct perf_metrics_ctx *ctx,
+                                     const struct key_worker_metrics *workers);
+
+/**
+ * 更新密钥请求合并统计
+ * @param ctx 性能指标上下文
+ * @param requests 请求数、实际协商数和合并比例
+ */
+void perf_metrics_update_key_requests(struct perf_metrics_ctx *ctx,
+                                      const struct key_request_metrics *requests);
+
+/**
+ * 更新密钥缓存统计
+ * @param ctx 性能指标上下文
+ * @param cache 命中、未命中、过期和淘汰次数
+ */
+void perf_metrics_update_key_cache(struct perf_metrics_ctx *ctx,
+                                   const struct key_cache_metrics *cache);
+
+/**
+ * 更新密钥预取统计
+ * @param ctx 性能指标上下文
+ * @param prefetch 预取次数、命中和浪费的握手
+ */
+void perf_metrics_update_key_prefetch(struct perf_metrics_ctx *ctx,
+                                      const struct key_prefetch_metrics *prefetch);
+
+/**
+ * 更新 TLSHub 请求统计
+ * @param ctx 性能指标上下文
+ * @param requests 超时、重试计数和调用耗时分位数
+ */
+void perf_metrics_update_tlshub_requests(struct perf_metrics_ctx *ctx,
+                                         const struct tlshub_request_metrics *requests);
+
+/**
+ * 更新 TLSHub 熔断统计
+ * @param ctx 性能指标上下文
+ * @param breaker 熔断状态、状态切换次数、拒绝和后备应答数
+ */
+void perf_metrics_update_breaker(struct perf_metrics_ctx *ctx,
+                                 const struct breaker_metrics *breaker);
+
+/**
+ * 更新握手失败退避统计
+ * @param ctx 性能指标上下文
+ * @param backoff 握手失败、被退避拦下和退避后重试的次数
+ */
+void perf_metrics_update_handshake_backoff(struct perf_metrics_ctx *ctx,
+                                           const struct handshake_backoff_metrics *backoff);
+
+/**
+ * 更新事件丢失与背压统计
+ * @param ctx 性能指标上下文
+ * @param loss 各 CPU 的丢失计数和当前背压模式
+ */
+void perf_metrics_update_event_loss(struct perf_metrics_ctx *ctx,
+                                    const struct event_loss_metrics *loss);
+
 /**
  * 计算统计汇总
  * @param ctx 性能指标上下文
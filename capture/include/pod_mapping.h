@@ -7,12 +7,14 @@
 
 #define MAX_POD_NAME 256
 #define MAX_NODE_NAME 256
+#define MAX_POD_IP 64
 #define MAX_MAPPINGS 1024
 
 /* Pod-Node 映射条目 */
 struct pod_node_mapping {
     char pod_name[MAX_POD_NAME];
     char node_name[MAX_NODE_NAME];
+    char pod_ip[MAX_POD_IP];    /* 可选的第三列，为空表示未配置 */
 };
 
 /* Pod-Node 映射表 */
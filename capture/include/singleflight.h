@@ -0,0 +1,63 @@
+#ifndef __SINGLEFLIGHT_H__
+#define __SINGLEFLIGHT_H__
+
+#include <linux/types.h>
+
+/*
+ * 进行中请求合并（singleflight）
+ * 同一个 key 同时只执行一次回调：第一个调用者执行，期间到达的相同 key 的调用者
+ * 阻塞等待并直接拿到它的返回值和结果。回调完成后 key 即从表中移除，不缓存结果。
+ */
+
+/* key 的最大长度（字节） */
+#define SINGLEFLIGHT_MAX_KEY 64
+
+/* 实际执行的回调，返回值和 result 会原样交给所有等待者 */
+typedef int (*singleflight_fn)(void *arg, void *result);
+
+/* 合并统计 */
+struct singleflight_stats {
+    __u64 calls;            /* singleflight_do 调用次数 */
+    __u64 executions;       /* 实际执行回调的次数 */
+    __u64 shared;           /* 复用其他调用者结果的次数 */
+    __u64 inflight;         /* 当前正在执行的 key 数 */
+    __u64 max_waiters;      /* 单次执行的最多等待者数 */
+};
+
+struct singleflight;
+
+/**
+ * 创建合并组
+ * @param result_size: 回调结果的大小（字节）
+ * @return: 合并组指针，失败返回 NULL
+ */
+struct singleflight *singleflight_new(__u32 result_size);
+
+/**
+ * 执行或加入 key 对应的请求
+ * @param sf: 合并组
+ * @param key: 请求标识（按字节比较，调用方需清零填充字节）
+ * @param key_len: key 长度，不超过 SINGLEFLIGHT_MAX_KEY
+ * @param fn: 没有进行中的相同请求时执行的回调
+ * @param arg: 回调参数
+ * @param result: 用于存储结果，大小为创建时的 result_size
+ * @param shared: 非 NULL 时返回本次是否复用了其他调用者的结果
+ * @return: 回调的返回值，参数错误或内存不足时返回 -1
+ */
+int singleflight_do(struct singleflight *sf, const void *key, __u32 key_len,
+                    singleflight_fn fn, void *arg, void *result, int *shared);
+
+/**
+ * 获取合并统计
+ * @param sf: 合并组
+ * @param stats: 用于存储统计结果
+ */
+void singleflight_get_stats(struct singleflight *sf, struct singleflight_stats *stats);
+
+/**
+ * 释放合并组（调用时不能有进行中的请求）
+ * @param sf: 合并组
+ */
+void singleflight_free(struct singleflight *sf);
+
+#endif /* __SINGLEFLIGHT_H__ */
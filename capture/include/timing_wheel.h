@@ -0,0 +1,71 @@
+#ifndef __TIMING_WHEEL_H__
+#define __TIMING_WHEEL_H__
+
+#include <linux/types.h>
+
+/*
+ * 分层时间轮
+ * TIMING_WHEEL_LEVELS 层，每层 TIMING_WHEEL_SLOTS 个槽位：第 0 层每个槽位 1 个 tick，
+ * 第 n 层每个槽位 256^n 个 tick，最远可定时 2^32 个 tick。定时器挂在到期时间所在层的槽位链表上，
+ * 第 0 层转过一圈时把上一层的一个槽位重新分配到下层（级联）。
+ * 添加、删除均为 O(1)，每个 tick 的推进为 O(1) 加上到期和级联的定时器数。
+ * 时间轮本身不加锁，由调用者保证互斥。
+ */
+
+#define TIMING_WHEEL_BITS 8
+#define TIMING_WHEEL_SLOTS (1U << TIMING_WHEEL_BITS)
+#define TIMING_WHEEL_LEVELS 4
+
+/* 定时器，嵌入到调用者的结构体中 */
+struct timer_node {
+    struct timer_node *next;
+    struct timer_node **pprev;      /* NULL 表示未挂在时间轮上 */
+    __u64 expires;                  /* 到期 tick */
+};
+
+struct timing_wheel {
+    __u64 next_tick;                /* 下一个要处理的 tick */
+    __u64 count;                    /* 挂在时间轮上的定时器数 */
+    struct timer_node *slots[TIMING_WHEEL_LEVELS][TIMING_WHEEL_SLOTS];
+};
+
+/**
+ * 初始化时间轮
+ * @param wheel: 时间轮
+ * @param now_tick: 当前 tick
+ */
+void timing_wheel_init(struct timing_wheel *wheel, __u64 now_tick);
+
+/**
+ * 添加定时器，已到期的定时器在下一次推进时到期
+ * @param wheel: 时间轮
+ * @param node: 未挂在时间轮上的定时器
+ * @param expires: 到期 tick
+ */
+void timing_wheel_add(struct timing_wheel *wheel, struct timer_node *node, __u64 expires);
+
+/**
+ * 删除定时器，未挂在时间轮上时不做任何事
+ * @param wheel: 时间轮
+ * @param node: 定时器
+ */
+void timing_wheel_del(struct timing_wheel *wheel, struct timer_node *node);
+
+/**
+ * 定时器是否挂在时间轮上
+ */
+static inline int timing_wheel_pending(const struct timer_node *node) {
+    return node->pprev != NULL;
+}
+
+/**
+ * 推进到 now_tick（含），取下所有到期的定时器
+ * @param wheel: 时间轮
+ * @param now_tick: 当前 tick
+ * @param expired: 到期的定时器以 next 串成链表返回，已从时间轮上摘下
+ * @return: 到期的定时器数
+ */
+__u32 timing_wheel_advance(struct timing_wheel *wheel, __u64 now_tick,
+                           struct timer_node **expired);
+
+#endif /* __TIMING_WHEEL_H__ */
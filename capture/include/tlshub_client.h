@@ -2,9 +2,115 @@
 #define __TLSHUB_CLIENT_H__
 
 #include "capture.h"
+#include "tlshub_standin.h"
+#include "latency_hist.h"
+
+/* 流水线模式下单个 socket 最多的在途请求数 */
+#define TLSHUB_PIPELINE_MAX_DEPTH 256
+
+/* tlshub_fetch_key 的返回值：TLSHub 报告该节点对的密钥已过期（key_back.status == -2） */
+#define TLSHUB_KEY_EXPIRED -2
+
+/* fetch/handshake 的返回值：每次尝试都超时，或请求已被 tlshub_client_cancel 取消 */
+#define TLSHUB_TIMEOUT -3
+
+/* tlshub_handshake 的返回值：TLSHub 回复 MSG_TYPE_HANDSHAKE_FAILED（与 KEY_PROVIDER_UNAVAILABLE 区分） */
+#define TLSHUB_HANDSHAKE_FAILED -5
+
+/* fetch/handshake 的返回值：IPv6 Pod 对，但模块在初始化时没有声明 TLSHUB_FEATURE_IPV6 */
+#define TLSHUB_UNSUPPORTED -6
+
+/* 默认的请求超时与重试策略 */
+#define TLSHUB_DEFAULT_TIMEOUT_MS 1000
+#define TLSHUB_DEFAULT_RETRIES 2
+#define TLSHUB_DEFAULT_BACKOFF_MS 50
+#define TLSHUB_DEFAULT_BACKOFF_MAX_MS 1000
+
+/* 请求超时与重试策略 */
+struct tlshub_retry_policy {
+    __u32 timeout_ms;       /* 每次尝试的期限（含批次等待），0 表示不限 */
+    __u32 retries;          /* 超时或收发失败后最多重试的次数 */
+    __u32 backoff_ms;       /* 第一次重试前的退避，之后每次加倍 */
+    __u32 backoff_max_ms;   /* 退避上限；实际退避在 [d/2, d] 内随机 */
+};
+
+/* 请求统计：计数和含重试在内的整次调用耗时 */
+struct tlshub_request_stats {
+    __u64 requests;         /* fetch/handshake 调用数 */
+    __u64 attempts;         /* 含重试在内的尝试数 */
+    __u64 retries;          /* 重试次数 */
+    __u64 timeouts;         /* 超过期限的尝试 */
+    __u64 errors;           /* 收发失败的尝试 */
+    __u64 gave_up;          /* 重试用尽仍失败的调用 */
+    __u64 cancelled;        /* 被取消的调用 */
+    struct latency_hist fetch_latency;
+    struct latency_hist handshake_latency;
+};
+
+/* 流水线统计 */
+struct tlshub_pipeline_stats {
+    __u32 depth;            /* 允许的在途请求数 */
+    __u64 requests;         /* 发出的请求 */
+    __u64 responses;        /* 按 seq 交付的响应 */
+    __u64 logs;             /* 收到的日志消息 */
+    __u64 orphans;          /* seq 无法匹配而丢弃的响应 */
+    __u64 reads;            /* socket 读取次数 */
+    __u64 outstanding;      /* 当前在途请求数 */
+    __u64 max_outstanding;  /* 在途请求数峰值 */
+};
+
+/* 批量模式统计 */
+struct tlshub_batch_stats {
+    __u32 max_entries;      /* 每条批量消息最多的请求数 */
+    __u64 batches;          /* 发出的批量消息 */
+    __u64 entries;          /* 批量消息携带的请求 */
+    __u64 full_flushes;     /* 攒满后立即发送的批次 */
+    __u64 deadline_flushes; /* 等待超时后发送的批次 */
+    __u64 fallbacks;        /* 模块不支持批量而改走单条请求的请求数 */
+};
+
+/**
+ * 选择与 TLSHub 通信的传输，需在 tlshub_client_init 之前调用，未调用时使用 netlink
+ * 初始化、每线程 socket、流水线和批量请求都经由所选传输，消息格式不变
+ * @param type: netlink（内核模块）、unix（用户态端点）或 mock（进程内替身，见 tlshub_standin.h）
+ * @param path: unix 传输的端点路径，NULL 或空串使用 TLSHUB_DEFAULT_UNIX_PATH
+ * @param mock: mock 传输的替身配置，NULL 为全 0（立即应答）
+ * @return: 成功返回 0，失败返回负值
+ */
+int tlshub_client_set_transport(enum tlshub_transport type, const char *path,
+                                const struct tlshub_standin_config *mock);
+
+/**
+ * 获取 mock 传输的替身统计
+ * @param stats: 用于存储统计结果
+ * @return: 成功返回 0，未使用 mock 传输或替身未启动时返回负值
+ */
+int tlshub_client_get_mock_stats(struct tlshub_standin_stats *stats);
+
+/**
+ * 设置请求超时与重试策略，需在 tlshub_client_init 之前调用，未调用时使用 TLSHUB_DEFAULT_*
+ * 初始化、fetch 和 handshake 的每次尝试都有期限：超时的请求被放弃（每线程 socket 被关闭重建，
+ * 流水线中的 seq 被释放，迟到的响应计为无主响应），之后按指数退避加随机抖动重试
+ * @param policy: 策略，NULL 恢复默认值
+ */
+void tlshub_client_set_retry_policy(const struct tlshub_retry_policy *policy);
+
+/**
+ * 获取请求统计
+ * @param stats: 用于存储统计结果
+ */
+void tlshub_client_get_request_stats(struct tlshub_request_stats *stats);
+
+/**
+ * 取消所有在途和之后的请求：阻塞在 TLSHub 上的调用立即返回 TLSHUB_TIMEOUT，不再重试
+ * 用于退出时不必等待挂起的请求到期；可在任意线程中调用，tlshub_client_cleanup 后恢复
+ */
+void tlshub_client_cancel(void);
 
 /**
  * 初始化 TLSHub 客户端
+ * 同时读取模块在 INIT_COMPLETE 中声明的协议版本和特性（见 tlshub_proto.h），
+ * 模块不支持 IPv6 时打印警告，之后 IPv6 Pod 对的 fetch/handshake 返回 TLSHUB_UNSUPPORTED
  * @return: 成功返回 0，失败返回负值
  */
 int tlshub_client_init(void);
@@ -14,18 +120,78 @@ int tlshub_client_init(void);
  */
 void tlshub_client_cleanup(void);
 
+/**
+ * 释放当前线程的 socket
+ * fetch/handshake 在每个调用线程中使用各自的 socket，线程退出前应调用
+ */
+void tlshub_client_thread_cleanup(void);
+
+/**
+ * 获取初始化 socket 的文件描述符，供事件循环监听内核推送的消息
+ * @return: 文件描述符，未初始化时返回 -1
+ */
+int tlshub_client_fd(void);
+
+/**
+ * 非阻塞地处理初始化 socket 上的待处理消息（日志等）
+ * @return: 处理的消息数，失败返回负值
+ */
+int tlshub_client_process_messages(void);
+
+/**
+ * 启用流水线模式：经当前传输新建一个 socket 供所有线程共用，
+ * 每个请求带唯一的 nlmsg_seq，最多 depth 个请求同时在途（要求 TLSHub 在响应中回填 nlmsg_seq）
+ * 需在 tlshub_client_init 之后、并发调用 fetch/handshake 之前调用
+ * @param depth: 在途请求上限（1-TLSHUB_PIPELINE_MAX_DEPTH）
+ * @return: 成功返回 0，失败返回负值（此时仍使用每线程 socket）
+ */
+int tlshub_client_enable_pipeline(__u32 depth);
+
+/**
+ * 在已连接的本地 socket（如与本地替身之间的 socketpair）上启用流水线模式，
+ * 不需要 tlshub_client_init，用于测试和基准测试；fd 由 tlshub_client_cleanup 关闭
+ * @param fd: 保留消息边界的已连接 socket（SOCK_SEQPACKET / SOCK_DGRAM）
+ * @param depth: 在途请求上限
+ * @return: 成功返回 0，失败返回负值
+ */
+int tlshub_client_attach_pipeline(int fd, __u32 depth);
+
+/**
+ * 获取流水线统计
+ * @param stats: 用于存储统计结果
+ */
+void tlshub_client_get_pipeline_stats(struct tlshub_pipeline_stats *stats);
+
+/**
+ * 启用批量模式：并发的 fetch/handshake 合成一条批量消息（TLS_SERVICE_BATCH）发送，
+ * 攒满 max_entries 项或第一项等待 delay_us 后发出；启用了流水线时经流水线 socket 发送，
+ * 否则经发送线程自己的 socket。模块未按批量格式响应时自动改回单条请求
+ * @param max_entries: 每条消息最多的请求数（2-TLSHUB_BATCH_MAX）
+ * @param delay_us: 批次最长等待时间
+ * @return: 成功返回 0，失败返回负值
+ */
+int tlshub_client_enable_batching(__u32 max_entries, __u32 delay_us);
+
+/**
+ * 获取批量模式统计
+ * @param stats: 用于存储统计结果
+ */
+void tlshub_client_get_batch_stats(struct tlshub_batch_stats *stats);
+
 /**
  * 根据四元组从 TLSHub 获取密钥
- * @param tuple: 四元组信息
+ * @param tuple: 四元组信息（tuple->role 决定以客户端还是服务端身份获取）
  * @param key_info: 用于存储获取的密钥信息
- * @return: 成功返回 0，失败返回负值
+ * @return: 成功返回 0，密钥已过期返回 TLSHUB_KEY_EXPIRED，超时或已取消返回 TLSHUB_TIMEOUT，
+ *          模块不支持该地址族返回 TLSHUB_UNSUPPORTED，其他失败返回 -1
  */
 int tlshub_fetch_key(struct flow_tuple *tuple, struct tls_key_info *key_info);
 
 /**
  * 通过 TLSHub 发起握手
  * @param tuple: 四元组信息
- * @return: 成功返回 0，失败返回负值
+ * @return: 成功返回 0，TLSHub 报告握手失败返回 TLSHUB_HANDSHAKE_FAILED，
+ *          超时或已取消返回 TLSHUB_TIMEOUT，模块不支持该地址族返回 TLSHUB_UNSUPPORTED，其他失败返回 -1
  */
 int tlshub_handshake(struct flow_tuple *tuple);
 
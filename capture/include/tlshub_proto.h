@@ -0,0 +1,122 @@
+#ifndef __TLSHUB_PROTO_H__
+#define __TLSHUB_PROTO_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <linux/netlink.h>
+
+/*
+ * TLSHub Netlink 消息格式
+ * 请求为 nlmsghdr + struct my_msg，响应为 user_msg_info（fetch 的响应在 msg 中携带 struct key_back）。
+ * 批量请求为 nlmsghdr + struct tlshub_batch_req，响应为 nlmsghdr + struct tlshub_batch_resp。
+ * 客户端（tlshub_client.c）和本地替身（测试工具）共用这些定义。
+ */
+
+#define NETLINK_TEST 31  /* TLSHub Netlink 协议号 */
+#define MAX_PAYLOAD 125
+
+/* TLSHub 消息结构 */
+typedef struct _user_msg_info {
+    struct nlmsghdr hdr;
+    char msg_type;
+    char msg[MAX_PAYLOAD];
+} user_msg_info;
+
+/* TLSHub 消息载荷 */
+struct my_msg {
+    uint32_t client_pod_ip;
+    uint32_t server_pod_ip;
+    unsigned short client_pod_port;
+    unsigned short server_pod_port;
+    char opcode;
+    bool server;
+    /* 以下字段为双栈扩展，追加在末尾以兼容只读取前面字段的内核模块 */
+    unsigned char family;       /* AF_INET 或 AF_INET6 */
+    uint32_t client_pod_ip6[4]; /* family 为 AF_INET6 时有效，网络字节序 */
+    uint32_t server_pod_ip6[4];
+};
+
+/* TLSHub 操作码 */
+enum {
+    TLS_SERVICE_INIT,   // 0
+    TLS_SERVICE_START,  // 1
+    TLS_SERVICE_FETCH,  // 2
+    TLS_SERVICE_BATCH   // 3 批量请求
+};
+
+/* TLSHub 响应消息类型 */
+enum {
+    MSG_TYPE_HANDSHAKE_SUCCESS_FIRST = 0x01,  // 首次握手成功
+    MSG_TYPE_HANDSHAKE_SUCCESS = 0x02,        // 非首次握手成功
+    MSG_TYPE_HANDSHAKE_FAILED = 0x03,         // 握手失败
+    MSG_TYPE_LOG = 0x04,                       // 日志消息
+    MSG_TYPE_ALREADY_CONNECTED = 0x05,         // 已连接
+    MSG_TYPE_INIT_COMPLETE = 0x07,             // 初始化完成
+    MSG_TYPE_BATCH_RESULT = 0x08               // 批量请求的结果
+};
+
+/*
+ * 协议版本与特性：模块在 INIT_COMPLETE 响应的 msg 中携带 struct tlshub_init_info。
+ * 不认识该结构的旧模块不填 msg（全 0，magic 不匹配），视为版本 0、没有任何扩展特性，
+ * 此时 my_msg 末尾的双栈字段会被忽略，客户端必须拒绝 IPv6 Pod 对，
+ * 否则模块会按 client_pod_ip/server_pod_ip（0.0.0.0）协商
+ */
+#define TLSHUB_INIT_MAGIC 0x544c5348U      /* "TLSH" */
+#define TLSHUB_PROTO_VERSION 1
+#define TLSHUB_FEATURE_IPV6 0x00000001U    /* 读取 family 和 *_pod_ip6 字段 */
+
+struct tlshub_init_info {
+    uint32_t magic;             /* TLSHUB_INIT_MAGIC */
+    uint16_t version;           /* 模块实现的协议版本 */
+    uint16_t reserved;
+    uint32_t features;          /* TLSHUB_FEATURE_* */
+};
+
+/* 密钥返回结构 */
+struct key_back {
+    int status; // 0:成功 -1:失败 -2:过期
+    unsigned char masterkey[32];
+};
+
+/* 一条批量消息最多携带的请求数 */
+#define TLSHUB_BATCH_MAX 32
+
+/*
+ * 批量请求：一条消息携带多个四元组，每项按各自的 opcode（FETCH 或 START）处理。
+ * 头部与 struct my_msg 的前 16 字节重叠，opcode 位于相同偏移，
+ * 只认识单条请求的模块会把它当作未知操作码。只发送 count 项。
+ */
+struct tlshub_batch_req {
+    uint32_t reserved0[3];      /* 对应 my_msg 的地址和端口，置 0 */
+    char opcode;                /* TLS_SERVICE_BATCH */
+    unsigned char count;        /* 请求项数（1-TLSHUB_BATCH_MAX） */
+    unsigned short reserved1;
+    struct my_msg entries[TLSHUB_BATCH_MAX];
+};
+
+/* 单项结果 */
+struct tlshub_batch_result {
+    char msg_type;              /* START：握手结果（MSG_TYPE_HANDSHAKE_*）；FETCH：0 */
+    unsigned char reserved[3];
+    struct key_back key;        /* FETCH 的结果 */
+};
+
+/* 批量响应：msg_type 与 user_msg_info.msg_type 偏移相同，结果与请求项一一对应 */
+struct tlshub_batch_resp {
+    char msg_type;              /* MSG_TYPE_BATCH_RESULT */
+    unsigned char count;
+    unsigned short reserved;
+    struct tlshub_batch_result results[TLSHUB_BATCH_MAX];
+};
+
+/* 接收缓冲区，能容纳任意一条响应 */
+union tlshub_msg {
+    struct nlmsghdr hdr;
+    user_msg_info info;
+    struct {
+        struct nlmsghdr hdr;
+        struct tlshub_batch_resp resp;
+    } batch;
+};
+
+#endif /* __TLSHUB_PROTO_H__ */
@@ -0,0 +1,102 @@
+#ifndef __TLSHUB_STANDIN_H__
+#define __TLSHUB_STANDIN_H__
+
+#include "capture.h"
+
+/*
+ * TLSHub 端点的本地替身（模拟端点）
+ * 在已连接的本地 socket 上按 tlshub_proto.h 的格式应答 INIT/START/FETCH 以及批量请求，
+ * 响应回填请求的 nlmsg_seq。可以同时服务多个连接：socketpair 的一端（进程内的 mock 传输、
+ * 基准测试）或 Unix 域 socket 上接受的连接（unix 传输）。不需要内核模块和 root 权限。
+ *
+ * 语义：
+ * - INIT 回复 MSG_TYPE_INIT_COMPLETE，携带协议版本和 TLSHUB_FEATURE_IPV6（legacy 时不携带，模拟旧模块）
+ * - START 首次为一对 Pod 建立连接回复 HANDSHAKE_SUCCESS_FIRST，已建立时回复 ALREADY_CONNECTED，
+ *   按 fail_percent 回复 HANDSHAKE_FAILED；握手结果前总有一条日志消息
+ * - FETCH 在已握手（或未要求握手）时返回由地址派生的密钥，
+ *   按 expire_percent 返回 status -2 并把该 Pod 对标记为未建立，未握手时返回 status -1
+ * - 按 hang_percent 处理 fetch/handshake 请求后不回复（模拟模块中挂起的请求），用于验证客户端的超时与重试
+ *
+ * 时间模型：每条消息先串行处理（message_cost_us + 每项 entry_cost_us，模拟模块与系统调用开销），
+ * 再经过往返延迟（fetch/init 为 latency_us，握手按 handshake_dist 抽样，各消息之间并行）后回复。
+ * 密钥：masterkey 前 4 字节为客户端 IPv4 地址（网络字节序），后 4 字节为服务端地址。
+ */
+
+/* 替身配置 */
+struct tlshub_standin_config {
+    __u32 latency_us;           /* fetch/init 的往返延迟 */
+    __u32 handshake_us;         /* 握手的平均耗时 */
+    enum latency_dist handshake_dist;
+    __u32 handshake_spread_us;  /* uniform 分布的半宽 */
+    __u32 message_cost_us;      /* 每条消息的串行处理耗时 */
+    __u32 entry_cost_us;        /* 每个请求项的串行处理耗时 */
+    __u32 log_every;            /* 每 N 条响应前插入一条同 seq 的日志消息，0 表示只在握手时插入 */
+    __u32 expire_percent;       /* fetch 返回密钥过期的比例（0-100） */
+    __u32 fail_percent;         /* 握手失败的比例（0-100） */
+    __u32 hang_percent;         /* 不回复的 fetch/handshake 消息比例（0-100） */
+    int require_handshake;      /* fetch 前必须先握手（为 0 时任何 Pod 对都能直接取到密钥） */
+    int legacy;                 /* 模拟旧模块：INIT_COMPLETE 不声明协议版本和特性（不支持 IPv6） */
+};
+
+/* 替身统计 */
+struct tlshub_standin_stats {
+    __u64 messages;         /* 收到的请求消息 */
+    __u64 batches;          /* 其中的批量消息 */
+    __u64 entries;          /* 请求项（单条消息计 1 项） */
+    __u64 logs;             /* 发出的日志消息 */
+    __u64 handshakes;       /* 握手请求 */
+    __u64 handshake_failures;
+    __u64 fetches;          /* fetch 请求 */
+    __u64 fetch_misses;     /* 未握手而失败的 fetch */
+    __u64 expired;          /* 返回过期的 fetch */
+    __u64 hung;             /* 未回复的请求消息 */
+    __u64 connections;      /* 当前连接数 */
+};
+
+struct tlshub_standin;
+
+/**
+ * 创建替身并启动其线程，此时还没有连接
+ * @param config: 替身配置
+ * @return: 替身指针，失败返回 NULL
+ */
+struct tlshub_standin *tlshub_standin_new(const struct tlshub_standin_config *config);
+
+/**
+ * 交给替身一个已连接的 socket（SOCK_SEQPACKET），由替身持有，对端关闭或替身停止时关闭
+ * @param standin: 替身
+ * @param fd: socket
+ * @return: 成功返回 0，失败返回负值（fd 已关闭）
+ */
+int tlshub_standin_add_fd(struct tlshub_standin *standin, int fd);
+
+/**
+ * 在 Unix 域 socket 路径上监听，接受的连接都由替身服务
+ * @param standin: 替身
+ * @param path: socket 路径，已存在时先删除
+ * @return: 成功返回 0，失败返回负值
+ */
+int tlshub_standin_listen(struct tlshub_standin *standin, const char *path);
+
+/**
+ * 创建替身并交给它一个已连接的 socket
+ * @param fd: 已连接的 socket（SOCK_SEQPACKET）
+ * @param config: 替身配置
+ * @return: 替身指针，失败返回 NULL
+ */
+struct tlshub_standin *tlshub_standin_start(int fd, const struct tlshub_standin_config *config);
+
+/**
+ * 获取替身统计
+ * @param standin: 替身
+ * @param stats: 用于存储统计结果
+ */
+void tlshub_standin_get_stats(struct tlshub_standin *standin, struct tlshub_standin_stats *stats);
+
+/**
+ * 停止替身线程，关闭所有连接和监听 socket，未回复的请求被丢弃
+ * @param standin: 替身
+ */
+void tlshub_standin_stop(struct tlshub_standin *standin);
+
+#endif /* __TLSHUB_STANDIN_H__ */
@@ -0,0 +1,77 @@
+#include <string.h>
+#include "backpressure.h"
+
+/**
+ * 初始化背压状态机
+ */
+void backpressure_init(struct backpressure *bp, const struct backpressure_config *cfg) {
+    memset(bp, 0, sizeof(*bp));
+    if (cfg) {
+        bp->cfg = *cfg;
+    }
+    
+    if (bp->cfg.loss_threshold == 0) {
+        bp->cfg.loss_threshold = BACKPRESSURE_DEFAULT_LOSS_THRESHOLD;
+    }
+    if (bp->cfg.queue_high_pct == 0 || bp->cfg.queue_high_pct > 100) {
+        bp->cfg.queue_high_pct = BACKPRESSURE_DEFAULT_QUEUE_HIGH;
+    }
+    if (bp->cfg.queue_low_pct >= bp->cfg.queue_high_pct) {
+        bp->cfg.queue_low_pct = bp->cfg.queue_high_pct / 4;
+    }
+    if (bp->cfg.calm_intervals == 0) {
+        bp->cfg.calm_intervals = BACKPRESSURE_DEFAULT_CALM_INTERVALS;
+    }
+    bp->mode = CAPTURE_SHED_NONE;
+}
+
+/**
+ * 按一个检查周期的观测更新状态
+ */
+int backpressure_update(struct backpressure *bp, __u64 total_loss,
+                        __u64 queue_depth, __u64 queue_capacity) {
+    __u64 lost = total_loss >= bp->last_loss ? total_loss - bp->last_loss : 0;
+    __u64 pct = queue_capacity ? queue_depth * 100 / queue_capacity : 0;
+    __u32 next = bp->mode;
+    
+    bp->last_loss = total_loss;
+    
+    if (lost >= bp->cfg.loss_threshold || pct >= bp->cfg.queue_high_pct) {
+        /* 压力仍在：升级一档（已是 DROP 则保持） */
+        bp->calm = 0;
+        if (bp->mode < CAPTURE_SHED_DROP) {
+            next = bp->mode + 1;
+        }
+    } else if (lost == 0 && pct < bp->cfg.queue_low_pct) {
+        /* 持续空闲才降级，避免在阈值附近来回切换 */
+        if (bp->mode != CAPTURE_SHED_NONE && ++bp->calm >= bp->cfg.calm_intervals) {
+            bp->calm = 0;
+            next = bp->mode - 1;
+        }
+    } else {
+        bp->calm = 0;
+    }
+    
+    if (next == bp->mode) {
+        return -1;
+    }
+    bp->mode = next;
+    bp->transitions++;
+    return (int)next;
+}
+
+/**
+ * 背压模式名称
+ */
+const char *shed_mode_name(__u32 mode) {
+    switch (mode) {
+        case CAPTURE_SHED_NONE:
+            return "none";
+        case CAPTURE_SHED_SAMPLE:
+            return "sample";
+        case CAPTURE_SHED_DROP:
+            return "drop";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <bpf/libbpf.h>
+#include <bpf/bpf.h>
+#include "bpf_loader.h"
+#include "capture_events.h"
+
+/*
+ * eBPF 对象文件的查找位置
+ * 1. 当前目录（开发模式）
+ * 2. /usr/local/lib/（安装模式）
+ */
+static const char *bpf_dirs[] = {
+    "",
+    "/usr/local/lib/",
+    NULL
+};
+
+/**
+ * 按检测方式选择需要加载的程序
+ * sockops 模式下不加载 fentry/fexit 程序，数据发送路径上没有任何 eBPF 开销
+ */
+static void select_programs(struct bpf_object *obj, enum capture_hook hook) {
+    struct bpf_program *prog;
+    
+    bpf_object__for_each_program(prog, obj) {
+        bool is_sockops = strcmp(bpf_program__section_name(prog), "sockops") == 0;
+        
+        bpf_program__set_autoload(prog, (hook == CAPTURE_HOOK_SOCKOPS) == is_sockops);
+    }
+}
+
+/**
+ * 查找并加载指定名称的 eBPF 对象
+ */
+static struct bpf_object *load_object(const char *name, const struct capture_config *config) {
+    struct bpf_object *obj;
+    char path[512];
+    int err;
+    
+    for (int i = 0; bpf_dirs[i] != NULL; i++) {
+        snprintf(path, sizeof(path), "%s%s", bpf_dirs[i], name);
+        obj = bpf_object__open_file(path, NULL);
+        if (libbpf_get_error(obj)) {
+            continue;
+        }
+        
+        select_programs(obj, config->hook);
+        err = bpf_object__load(obj);
+        if (err) {
+            fprintf(stderr, "Failed to load eBPF object %s: %d\n", path, err);
+            bpf_object__close(obj);
+            return NULL;
+        }
+        
+        printf("Loaded eBPF program from: %s\n", path);
+        return obj;
+    }
+    
+    fprintf(stderr, "Failed to open eBPF object file %s from any location\n", name);
+    return NULL;
+}
+
+/**
+ * 写入运行时控制参数
+ */
+static int write_ctl(struct bpf_object *obj, const struct capture_config *config) {
+    struct capture_ctl ctl;
+    __u32 key = 0;
+    int ctl_fd;
+    
+    ctl_fd = bpf_object__find_map_fd_by_name(obj, "capture_ctl_map");
+    if (ctl_fd < 0) {
+        fprintf(stderr, "Failed to find capture_ctl_map\n");
+        return -1;
+    }
+    
+    memset(&ctl, 0, sizeof(ctl));
+    ctl.wakeup_batch = config->ringbuf_wakeup_batch;
+    ctl.shed_mode = CAPTURE_SHED_NONE;
+    ctl.sample_rate = config->shed_sample_rate;
+    for (__u32 i = 0; i < config->policy_rule_count; i++) {
+        if (config->policy_rules[i].action == CAPTURE_POLICY_ALLOW) {
+            ctl.policy_flags |= CAPTURE_POLICY_F_ALLOWLIST;
+        }
+    }
+    if (config->policy_port_count > 0) {
+        ctl.policy_flags |= CAPTURE_POLICY_F_PORTS;
+    }
+    
+    if (bpf_map_update_elem(ctl_fd, &key, &ctl, BPF_ANY) < 0) {
+        fprintf(stderr, "Failed to update capture_ctl_map\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 在端口集合中为端口加上标志
+ */
+static int add_port_flag(int port_fd, __u16 port, __u8 flag) {
+    __u8 flags = 0;
+    
+    bpf_map_lookup_elem(port_fd, &port, &flags);
+    flags |= flag;
+    if (bpf_map_update_elem(port_fd, &port, &flags, BPF_ANY) < 0) {
+        fprintf(stderr, "Failed to add port %u\n", port);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 写入连接过滤策略（地址前缀、服务端口集合和高优先级端口）
+ */
+static int write_policy(struct bpf_object *obj, const struct capture_config *config) {
+    int v4_fd, v6_fd, port_fd;
+    
+    v4_fd = bpf_object__find_map_fd_by_name(obj, "policy_v4_map");
+    v6_fd = bpf_object__find_map_fd_by_name(obj, "policy_v6_map");
+    port_fd = bpf_object__find_map_fd_by_name(obj, "policy_port_map");
+    if (v4_fd < 0 || v6_fd < 0 || port_fd < 0) {
+        fprintf(stderr, "Failed to find policy maps\n");
+        return -1;
+    }
+    
+    for (__u32 i = 0; i < config->policy_rule_count; i++) {
+        const struct capture_policy_rule *rule = &config->policy_rules[i];
+        int err;
+        
+        if (rule->family == AF_INET6) {
+            struct capture_policy_key_v6 key = { .prefixlen = rule->prefixlen };
+            
+            memcpy(key.addr, rule->addr, sizeof(key.addr));
+            err = bpf_map_update_elem(v6_fd, &key, &rule->action, BPF_ANY);
+        } else {
+            struct capture_policy_key_v4 key = {
+                .prefixlen = rule->prefixlen,
+                .addr = rule->addr[0],
+            };
+            
+            err = bpf_map_update_elem(v4_fd, &key, &rule->action, BPF_ANY);
+        }
+        if (err < 0) {
+            fprintf(stderr, "Failed to add policy rule %u\n", i);
+            return -1;
+        }
+    }
+    
+    for (__u32 i = 0; i < config->policy_port_count; i++) {
+        if (add_port_flag(port_fd, config->policy_ports[i], CAPTURE_PORT_F_CAPTURE) < 0) {
+            return -1;
+        }
+    }
+    
+    for (__u32 i = 0; i < config->priority_port_count; i++) {
+        if (add_port_flag(port_fd, config->priority_ports[i], CAPTURE_PORT_F_PRIORITY) < 0) {
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * 按配置查找并加载 eBPF 对象
+ */
+int bpf_loader_open(struct bpf_loader *loader, const struct capture_config *config) {
+    memset(loader, 0, sizeof(*loader));
+    loader->cgroup_fd = -1;
+    loader->hook = config->hook;
+    
+    if (loader->hook == CAPTURE_HOOK_SOCKOPS) {
+        loader->cgroup_fd = open(config->cgroup_path, O_RDONLY | O_DIRECTORY);
+        if (loader->cgroup_fd < 0) {
+            fprintf(stderr, "Failed to open cgroup %s\n", config->cgroup_path);
+            return -1;
+        }
+    }
+    
+    if (config->transport != EVENT_TRANSPORT_PERFBUF) {
+        loader->obj = load_object(BPF_OBJ_RINGBUF, config);
+        if (loader->obj) {
+            loader->transport = EVENT_TRANSPORT_RINGBUF;
+        } else if (config->transport == EVENT_TRANSPORT_RINGBUF) {
+            bpf_loader_close(loader);
+            return -1;
+        } else {
+            printf("Ring buffer not available, falling back to perf buffer\n");
+        }
+    }
+    
+    if (!loader->obj) {
+        loader->obj = load_object(BPF_OBJ_PERFBUF, config);
+        if (!loader->obj) {
+            bpf_loader_close(loader);
+            return -1;
+        }
+        loader->transport = EVENT_TRANSPORT_PERFBUF;
+    }
+    
+    if (write_policy(loader->obj, config) < 0 ||
+        write_ctl(loader->obj, config) < 0) {
+        bpf_loader_close(loader);
+        return -1;
+    }
+    
+    return 0;
+}
+
+/**
+ * 附加所有已加载的 eBPF 程序
+ */
+int bpf_loader_attach(struct bpf_loader *loader) {
+    struct bpf_program *prog;
+    
+    bpf_object__for_each_program(prog, loader->obj) {
+        if (!bpf_program__autoload(prog)) {
+            continue;
+        }
+        
+        if (loader->link_count >= BPF_LOADER_MAX_LINKS) {
+            fprintf(stderr, "Too many eBPF programs, skipping %s\n",
+                    bpf_program__name(prog));
+            continue;
+        }
+        
+        if (bpf_program__type(prog) == BPF_PROG_TYPE_SOCK_OPS) {
+            loader->links[loader->link_count] =
+                bpf_program__attach_cgroup(prog, loader->cgroup_fd);
+        } else {
+            loader->links[loader->link_count] = bpf_program__attach(prog);
+        }
+        if (libbpf_get_error(loader->links[loader->link_count])) {
+            fprintf(stderr, "Failed to attach program %s\n", 
+                    bpf_program__name(prog));
+            loader->links[loader->link_count] = NULL;
+            continue;
+        }
+        printf("  Attached: %s\n", bpf_program__name(prog));
+        loader->link_count++;
+    }
+    
+    return loader->link_count;
+}
+
+/**
+ * 读取 eBPF 侧统计
+ */
+int bpf_loader_read_stats(struct bpf_loader *loader, struct capture_bpf_stats *stats) {
+    int ncpus = libbpf_num_possible_cpus();
+    __u64 *values;
+    int stats_fd;
+    
+    memset(stats, 0, sizeof(*stats));
+    if (!loader->obj || ncpus <= 0) {
+        return -1;
+    }
+    
+    stats_fd = bpf_object__find_map_fd_by_name(loader->obj, "capture_stats");
+    if (stats_fd < 0) {
+        return -1;
+    }
+    
+    values = calloc(ncpus, sizeof(__u64));
+    if (!values) {
+        return -1;
+    }
+    
+    for (__u32 idx = 0; idx < CAPTURE_STAT_MAX; idx++) {
+        if (bpf_map_lookup_elem(stats_fd, &idx, values) < 0) {
+            continue;
+        }
+        for (int cpu = 0; cpu < ncpus; cpu++) {
+            stats->counters[idx] += values[cpu];
+        }
+    }
+    free(values);
+    
+    /* SK_STORAGE 不支持遍历，存活条目数由创建/删除计数推算 */
+    if (stats->counters[CAPTURE_STAT_SK_CREATE] > stats->counters[CAPTURE_STAT_SK_DELETE]) {
+        stats->sk_state_live = stats->counters[CAPTURE_STAT_SK_CREATE] -
+                               stats->counters[CAPTURE_STAT_SK_DELETE];
+    }
+    return 0;
+}
+
+/**
+ * 读取单个计数器在各 CPU 上的值
+ */
+int bpf_loader_read_stat_per_cpu(struct bpf_loader *loader, __u32 idx,
+                                 __u64 *values, int max_cpus) {
+    int ncpus = libbpf_num_possible_cpus();
+    __u64 *percpu;
+    int stats_fd, n;
+    
+    if (!loader->obj || ncpus <= 0 || idx >= CAPTURE_STAT_MAX) {
+        return -1;
+    }
+    
+    stats_fd = bpf_object__find_map_fd_by_name(loader->obj, "capture_stats");
+    if (stats_fd < 0) {
+        return -1;
+    }
+    
+    /* 内核按 possible CPU 数返回，调用者的数组可能更小 */
+    percpu = calloc(ncpus, sizeof(__u64));
+    if (!percpu) {
+        return -1;
+    }
+    if (bpf_map_lookup_elem(stats_fd, &idx, percpu) < 0) {
+        free(percpu);
+        return -1;
+    }
+    
+    n = ncpus < max_cpus ? ncpus : max_cpus;
+    memcpy(values, percpu, n * sizeof(__u64));
+    free(percpu);
+    return n;
+}
+
+/**
+ * 切换内核侧背压模式
+ */
+int bpf_loader_set_shed_mode(struct bpf_loader *loader, __u32 mode) {
+    struct capture_ctl ctl;
+    __u32 key = 0;
+    int ctl_fd;
+    
+    if (!loader->obj) {
+        return -1;
+    }
+    
+    ctl_fd = bpf_object__find_map_fd_by_name(loader->obj, "capture_ctl_map");
+    if (ctl_fd < 0 || bpf_map_lookup_elem(ctl_fd, &key, &ctl) < 0) {
+        fprintf(stderr, "Failed to read capture_ctl_map\n");
+        return -1;
+    }
+    
+    /* 只有事件循环线程写 capture_ctl_map，读-改-写不会与其他更新冲突 */
+    ctl.shed_mode = mode;
+    if (bpf_map_update_elem(ctl_fd, &key, &ctl, BPF_ANY) < 0) {
+        fprintf(stderr, "Failed to update capture_ctl_map\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 分离所有 eBPF 程序并释放对象
+ */
+void bpf_loader_close(struct bpf_loader *loader) {
+    for (int i = 0; i < loader->link_count; i++) {
+        if (loader->links[i]) {
+            bpf_link__destroy(loader->links[i]);
+            loader->links[i] = NULL;
+        }
+    }
+    loader->link_count = 0;
+    
+    if (loader->obj) {
+        bpf_object__close(loader->obj);
+        loader->obj = NULL;
+    }
+    
+    if (loader->cgroup_fd >= 0) {
+        close(loader->cgroup_fd);
+        loader->cgroup_fd = -1;
+    }
+}
@@ -1,145 +1,573 @@
-#include <linux/bpf.h>
-#include <linux/if_ether.h>
-#include <linux/ip.h>
-#include <linux/tcp.h>
-#include <linux/in.h>
+/*
+ * CO-RE 版本：结构体定义来自 BTF 生成的 vmlinux.h，字段偏移在加载时由 libbpf
+ * 按目标内核重定位，同一个 capture.bpf.o 可以在不同版本的内核上运行
+ */
+#include "vmlinux.h"
 #include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
 #include <bpf/bpf_endian.h>
+#include "capture_events.h"
 
-#define TCP_SYN_FLAG 0x02
-#define TCP_ACK_FLAG 0x10
+/*
+ * 调试输出：bpf_printk 写全局 trace_pipe，开销大且所有 CPU 串行，
+ * 只在 make DEBUG=1 编译时启用，正常运行依赖 capture_stats 计数器
+ */
+#ifdef CAPTURE_DEBUG
+#define capture_dbg(fmt, ...) bpf_printk(fmt, ##__VA_ARGS__)
+#else
+#define capture_dbg(fmt, ...) do { } while (0)
+#endif
 
-/* 连接跟踪表 */
-struct {
-    __uint(type, BPF_MAP_TYPE_HASH);
-    __type(key, __u64);  /* sock 指针 */
-    __type(value, __u32);  /* 连接状态 */
-    __uint(max_entries, 10240);
-} conn_track_map SEC(".maps");
-
-/* Socket 信息表 */
-struct sock_info {
-    __u32 saddr;
-    __u32 daddr;
-    __u16 sport;
-    __u16 dport;
+/* vmlinux.h 不包含宏定义 */
+#define AF_INET CAPTURE_AF_INET
+#define AF_INET6 CAPTURE_AF_INET6
+
+/*
+ * 每个 socket 的捕获状态
+ * 保存在 socket 自身的本地存储中（SK_STORAGE），查找直接从 sock 取得，
+ * 不经过全局哈希表，也不存在跨 CPU 竞争；socket 释放时内核自动回收
+ */
+struct conn_tuple {
+    __u32 saddr[4];  /* 本地地址，网络字节序，IPv4 只使用 saddr[0] */
+    __u32 daddr[4];  /* 对端地址 */
+    __u16 sport;     /* 本地端口，主机字节序 */
+    __u16 dport;     /* 对端端口，主机字节序 */
+    __u16 family;
+};
+
+struct sock_state {
+    __u32 state;  /* 连接状态：1=连接中, 2=已处理 */
     __u32 pid;
+    struct conn_tuple tuple;
 };
 
 struct {
-    __uint(type, BPF_MAP_TYPE_HASH);
-    __type(key, __u64);  /* sock 指针 */
-    __type(value, struct sock_info);
-    __uint(max_entries, 10240);
-} sock_info_map SEC(".maps");
+    __uint(type, BPF_MAP_TYPE_SK_STORAGE);
+    __uint(map_flags, BPF_F_NO_PREALLOC);
+    __type(key, int);
+    __type(value, struct sock_state);
+} sk_state_map SEC(".maps");
+
+/* 统计计数器，每个 CPU 独立计数，由用户态汇总 */
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __type(key, __u32);
+    __type(value, __u64);
+    __uint(max_entries, CAPTURE_STAT_MAX);
+} capture_stats SEC(".maps");
 
-/* Perf 事件数组，用于向用户态发送事件 */
+#ifdef CAPTURE_USE_PERFBUF
+/* Perf 事件数组，用于向用户态发送事件（不支持 ring buffer 的旧内核） */
 struct {
     __uint(type, BPF_MAP_TYPE_PERF_EVENT_ARRAY);
     __uint(key_size, sizeof(__u32));
     __uint(value_size, sizeof(__u32));
 } events SEC(".maps");
+#else
+/* Ring buffer，所有 CPU 共享，用户态按提交顺序消费 */
+struct {
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, CAPTURE_RINGBUF_SIZE);
+} rb SEC(".maps");
+#endif
 
-/* TCP 连接事件 */
-struct tcp_connect_event {
-    __u32 saddr;
-    __u32 daddr;
-    __u16 sport;
-    __u16 dport;
-    __u32 pid;
-    __u64 timestamp;
-};
+/*
+ * 连接过滤策略：按最长前缀匹配 Pod 网段，值为 enum capture_policy_action
+ * 源地址和目的地址都必须通过，只有 Pod 到 Pod 的连接才会上报
+ */
+struct {
+    __uint(type, BPF_MAP_TYPE_LPM_TRIE);
+    __uint(map_flags, BPF_F_NO_PREALLOC);
+    __type(key, struct capture_policy_key_v4);
+    __type(value, __u8);
+    __uint(max_entries, CAPTURE_POLICY_MAX_RULES);
+} policy_v4_map SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_LPM_TRIE);
+    __uint(map_flags, BPF_F_NO_PREALLOC);
+    __type(key, struct capture_policy_key_v6);
+    __type(value, __u8);
+    __uint(max_entries, CAPTURE_POLICY_MAX_RULES);
+} policy_v6_map SEC(".maps");
+
+/* 服务端口集合（主机字节序），值为 CAPTURE_PORT_F_* */
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __type(key, __u16);
+    __type(value, __u8);
+    __uint(max_entries, CAPTURE_POLICY_MAX_PORTS);
+} policy_port_map SEC(".maps");
+
+/* 运行时控制参数 */
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, struct capture_ctl);
+    __uint(max_entries, 1);
+} capture_ctl_map SEC(".maps");
 
 /**
- * Hook TCP 连接建立
+ * 计数器加一
  */
-SEC("kprobe/tcp_v4_connect")
-int kprobe_tcp_v4_connect(struct pt_regs *ctx) {
-    struct sock *sk = (struct sock *)PT_REGS_PARM1(ctx);
-    __u64 sock_ptr = (__u64)sk;
-    __u32 state = 1;  /* 连接中 */
-    __u32 pid = bpf_get_current_pid_tgid() >> 32;
+static __always_inline void stat_inc(__u32 idx) {
+    __u64 *val = bpf_map_lookup_elem(&capture_stats, &idx);
     
-    /* 记录连接状态 */
-    bpf_map_update_elem(&conn_track_map, &sock_ptr, &state, BPF_ANY);
+    if (val) {
+        (*val)++;
+    }
+}
+
+/**
+ * 判断单个地址是否通过策略
+ */
+static __always_inline bool policy_addr_allowed(__u32 flags, __u16 family, const __u32 *addr) {
+    __u8 *action;
+    
+    if (family == AF_INET6) {
+        struct capture_policy_key_v6 key = { .prefixlen = 128 };
+        
+        __builtin_memcpy(key.addr, addr, sizeof(key.addr));
+        action = bpf_map_lookup_elem(&policy_v6_map, &key);
+    } else {
+        struct capture_policy_key_v4 key = { .prefixlen = 32, .addr = addr[0] };
+        
+        action = bpf_map_lookup_elem(&policy_v4_map, &key);
+    }
     
-    bpf_printk("TCP connect detected, sock=%llx, pid=%u\n", sock_ptr, pid);
+    if (action) {
+        return *action != CAPTURE_POLICY_DENY;
+    }
+    return !(flags & CAPTURE_POLICY_F_ALLOWLIST);
+}
+
+/**
+ * 检查连接是否需要上报
+ * @param service_port: 服务端端口（主动连接为目的端口，被动连接为本地端口）
+ * @return: 需要上报返回 0，否则返回对应的过滤计数器下标
+ */
+static __always_inline __u32 policy_check(__u16 family, const __u32 *saddr,
+                                          const __u32 *daddr, __u16 service_port) {
+    __u32 key = 0;
+    struct capture_ctl *ctl;
+    __u32 flags;
+    
+    ctl = bpf_map_lookup_elem(&capture_ctl_map, &key);
+    flags = ctl ? ctl->policy_flags : 0;
+    
+    if (!policy_addr_allowed(flags, family, saddr) ||
+        !policy_addr_allowed(flags, family, daddr)) {
+        return CAPTURE_STAT_POLICY_ADDR;
+    }
+    
+    if (flags & CAPTURE_POLICY_F_PORTS) {
+        __u8 *port = bpf_map_lookup_elem(&policy_port_map, &service_port);
+        
+        if (!port || !(*port & CAPTURE_PORT_F_CAPTURE)) {
+            return CAPTURE_STAT_POLICY_PORT;
+        }
+    }
     return 0;
 }
 
 /**
- * Hook TCP 连接完成
+ * 背压期间决定是否丢弃事件
+ * 服务端口在 priority_ports 中的连接始终上报，其余连接按 shed_mode 采样或丢弃，
+ * 由内核在源头丢弃低优先级事件，避免事件通道写满后随机丢失
+ * @return: 需要丢弃返回 true
  */
-SEC("kretprobe/tcp_v4_connect")
-int kretprobe_tcp_v4_connect(struct pt_regs *ctx) {
-    __u64 pid_tgid = bpf_get_current_pid_tgid();
-    __u32 pid = pid_tgid >> 32;
-    int ret = PT_REGS_RC(ctx);
+static __always_inline bool shed_event(__u16 service_port) {
+    __u32 key = 0;
+    struct capture_ctl *ctl;
+    __u8 *port;
+    
+    ctl = bpf_map_lookup_elem(&capture_ctl_map, &key);
+    if (!ctl || ctl->shed_mode == CAPTURE_SHED_NONE) {
+        return false;
+    }
+    
+    port = bpf_map_lookup_elem(&policy_port_map, &service_port);
+    if (port && (*port & CAPTURE_PORT_F_PRIORITY)) {
+        return false;
+    }
+    
+    if (ctl->shed_mode == CAPTURE_SHED_SAMPLE &&
+        (ctl->sample_rate <= 1 || bpf_get_prandom_u32() % ctl->sample_rate == 0)) {
+        return false;
+    }
+    
+    stat_inc(CAPTURE_STAT_SHED);
+    return true;
+}
+
+/**
+ * 删除 socket 上的捕获状态并统计删除数
+ */
+static __always_inline void sk_state_delete(struct sock *sk) {
+    if (bpf_sk_storage_delete(&sk_state_map, sk) == 0) {
+        stat_inc(CAPTURE_STAT_SK_DELETE);
+    }
+}
+
+/**
+ * 为一个连接事件分配空间
+ * ring buffer 模式下直接在 ring buffer 中预留，避免额外拷贝；
+ * perf buffer 模式下使用调用者提供的栈空间
+ */
+static __always_inline struct tcp_connect_event *
+event_reserve(struct tcp_connect_event *scratch) {
+#ifdef CAPTURE_USE_PERFBUF
+    return scratch;
+#else
+    return bpf_ringbuf_reserve(&rb, sizeof(struct tcp_connect_event), 0);
+#endif
+}
+
+#ifndef CAPTURE_USE_PERFBUF
+/**
+ * 计算 ring buffer 提交时的唤醒标志
+ * 积压的数据达到 wakeup_batch 条事件时才唤醒消费者，
+ * 不足一批的事件由消费者的 poll 超时兜底取走
+ */
+static __always_inline __u64 ringbuf_wakeup_flags(void) {
+    __u32 key = 0;
+    struct capture_ctl *ctl;
+    
+    ctl = bpf_map_lookup_elem(&capture_ctl_map, &key);
+    if (!ctl || ctl->wakeup_batch <= 1) {
+        return 0;  /* 由内核决定：消费者已追上时每条事件都唤醒 */
+    }
+    
+    if (bpf_ringbuf_query(&rb, BPF_RB_AVAIL_DATA) >=
+        (__u64)ctl->wakeup_batch * CAPTURE_RINGBUF_RECORD_SIZE) {
+        return BPF_RB_FORCE_WAKEUP;
+    }
+    return BPF_RB_NO_WAKEUP;
+}
+#endif
+
+/**
+ * 提交事件到用户态
+ * @return: 成功返回 0，perf buffer 已满返回负值
+ */
+static __always_inline int event_submit(void *ctx, struct tcp_connect_event *event) {
+#ifdef CAPTURE_USE_PERFBUF
+    if (bpf_perf_event_output(ctx, &events, BPF_F_CURRENT_CPU, event, sizeof(*event)) < 0) {
+        stat_inc(CAPTURE_STAT_EVENT_DROP);
+        return -1;
+    }
+#else
+    bpf_ringbuf_submit(event, ringbuf_wakeup_flags());
+#endif
+    stat_inc(CAPTURE_STAT_EVENT);
+    return 0;
+}
+
+/**
+ * 判断 IPv6 地址是否为 IPv4-mapped（::ffff:a.b.c.d）
+ */
+static __always_inline bool ipv6_is_v4mapped(const __u32 *addr) {
+    return addr[0] == 0 && addr[1] == 0 && addr[2] == bpf_htonl(0x0000ffff);
+}
+
+/**
+ * 从 IPv6 地址填充地址族和地址，IPv4-mapped 地址还原为 IPv4
+ */
+static __always_inline void fill_addr6(__u16 *family, __u32 *saddr, __u32 *daddr,
+                                       const __u32 *src6, const __u32 *dst6) {
+    if (ipv6_is_v4mapped(src6) && ipv6_is_v4mapped(dst6)) {
+        *family = AF_INET;
+        saddr[0] = src6[3];
+        daddr[0] = dst6[3];
+        return;
+    }
+    
+    *family = AF_INET6;
+    __builtin_memcpy(saddr, src6, 16);
+    __builtin_memcpy(daddr, dst6, 16);
+}
+
+/**
+ * 从 sock 读取四元组（本地 -> 对端）
+ */
+static __always_inline void read_sock_tuple(struct sock *sk, struct conn_tuple *t) {
+    if (BPF_CORE_READ(sk, __sk_common.skc_family) == AF_INET6) {
+        __u32 src6[4], dst6[4];
+        
+        BPF_CORE_READ_INTO(&src6, sk, __sk_common.skc_v6_rcv_saddr.in6_u.u6_addr32);
+        BPF_CORE_READ_INTO(&dst6, sk, __sk_common.skc_v6_daddr.in6_u.u6_addr32);
+        fill_addr6(&t->family, t->saddr, t->daddr, src6, dst6);
+    } else {
+        t->family = AF_INET;
+        t->saddr[0] = BPF_CORE_READ(sk, __sk_common.skc_rcv_saddr);
+        t->daddr[0] = BPF_CORE_READ(sk, __sk_common.skc_daddr);
+    }
+    t->sport = BPF_CORE_READ(sk, __sk_common.skc_num);
+    t->dport = bpf_ntohs(BPF_CORE_READ(sk, __sk_common.skc_dport));
+}
+
+/**
+ * 生成并提交一个连接事件
+ * @return: 成功返回 0，事件通道已满返回 -1
+ */
+static __always_inline int emit_event(void *ctx, const struct conn_tuple *t,
+                                      __u32 pid, __u16 flags) {
+    struct tcp_connect_event scratch = {0};
+    struct tcp_connect_event *event;
+    
+    event = event_reserve(&scratch);
+    if (!event) {
+        stat_inc(CAPTURE_STAT_EVENT_DROP);
+        return -1;
+    }
+    __builtin_memcpy(event->saddr6, t->saddr, sizeof(event->saddr6));
+    __builtin_memcpy(event->daddr6, t->daddr, sizeof(event->daddr6));
+    event->sport = t->sport;
+    event->dport = t->dport;
+    event->family = t->family;
+    event->flags = flags;
+    event->pid = pid;
+    event->timestamp = bpf_ktime_get_ns();
+    
+    return event_submit(ctx, event);
+}
+
+/**
+ * 连接发起：在 socket 上创建捕获状态
+ */
+static __always_inline void connect_enter(struct sock *sk) {
+    struct sock_state *st;
+    
+    stat_inc(CAPTURE_STAT_CONNECT);
+    
+    st = bpf_sk_storage_get(&sk_state_map, sk, 0, BPF_SK_STORAGE_GET_F_CREATE);
+    if (!st) {
+        return;
+    }
+    if (st->state == 0) {
+        stat_inc(CAPTURE_STAT_SK_CREATE);
+    }
+    st->state = 1;  /* 连接中 */
+}
+
+/**
+ * 连接完成：此时源地址和源端口已经分配，直接记录四元组，首次发送时无需再读取 sock
+ */
+static __always_inline void connect_exit(struct sock *sk, int ret) {
+    struct sock_state *st;
+    __u32 reason;
     
     /* 检查连接是否成功 */
     if (ret != 0) {
-        bpf_printk("TCP connect failed, ret=%d\n", ret);
-        return 0;
+        stat_inc(CAPTURE_STAT_CONNECT_FAIL);
+        sk_state_delete(sk);
+        capture_dbg("TCP connect failed, ret=%d\n", ret);
+        return;
     }
     
-    bpf_printk("TCP connect completed, pid=%u\n", pid);
+    st = bpf_sk_storage_get(&sk_state_map, sk, 0, 0);
+    if (!st) {
+        return;
+    }
+    
+    read_sock_tuple(sk, &st->tuple);
+    st->pid = bpf_get_current_pid_tgid() >> 32;
+    
+    /* 不需要 TLSHub 密钥的连接直接丢弃状态，之后的发送不会再命中 */
+    reason = policy_check(st->tuple.family, st->tuple.saddr, st->tuple.daddr, st->tuple.dport);
+    if (reason) {
+        stat_inc(reason);
+        sk_state_delete(sk);
+        return;
+    }
+    
+    capture_dbg("TCP connect completed, family=%u, pid=%u\n", st->tuple.family, st->pid);
+}
+
+/**
+ * Hook IPv4 TCP 连接建立
+ */
+SEC("fentry/tcp_v4_connect")
+int BPF_PROG(fentry_tcp_v4_connect, struct sock *sk) {
+    connect_enter(sk);
+    capture_dbg("TCP connect detected, sock=%llx\n", (__u64)sk);
+    return 0;
+}
+
+/**
+ * Hook IPv4 TCP 连接完成
+ */
+SEC("fexit/tcp_v4_connect")
+int BPF_PROG(fexit_tcp_v4_connect, struct sock *sk, struct sockaddr *uaddr,
+             int addr_len, int ret) {
+    connect_exit(sk, ret);
+    return 0;
+}
+
+/**
+ * Hook IPv6 TCP 连接建立
+ * 目的地址为 IPv4-mapped 时 tcp_v6_connect 内部会再调用 tcp_v4_connect，
+ * 两处写入的是同一个 socket 的状态，结果一致
+ */
+SEC("fentry/tcp_v6_connect")
+int BPF_PROG(fentry_tcp_v6_connect, struct sock *sk) {
+    connect_enter(sk);
+    capture_dbg("TCPv6 connect detected, sock=%llx\n", (__u64)sk);
+    return 0;
+}
+
+/**
+ * Hook IPv6 TCP 连接完成
+ */
+SEC("fexit/tcp_v6_connect")
+int BPF_PROG(fexit_tcp_v6_connect, struct sock *sk, struct sockaddr *uaddr,
+             int addr_len, int ret) {
+    connect_exit(sk, ret);
     return 0;
 }
 
 /**
- * Hook TCP 数据发送
+ * Hook TCP 数据发送（IPv4/IPv6 共用）
  */
-SEC("kprobe/tcp_sendmsg")
-int kprobe_tcp_sendmsg(struct pt_regs *ctx) {
-    struct sock *sk = (struct sock *)PT_REGS_PARM1(ctx);
-    __u64 sock_ptr = (__u64)sk;
-    __u32 *state;
-    struct sock_info info = {0};
-    struct tcp_connect_event event = {0};
+SEC("fentry/tcp_sendmsg")
+int BPF_PROG(fentry_tcp_sendmsg, struct sock *sk) {
+    struct sock_state *st;
     
-    /* 检查是否是新连接 */
-    state = bpf_map_lookup_elem(&conn_track_map, &sock_ptr);
-    if (!state || *state != 1) {
+    stat_inc(CAPTURE_STAT_SENDMSG);
+    
+    /* 检查是否是新连接（不创建状态，未经过 tcp_v4/v6_connect 的 socket 直接返回） */
+    st = bpf_sk_storage_get(&sk_state_map, sk, 0, 0);
+    if (!st || st->state != 1) {
         return 0;  /* 不是新连接 */
     }
     
-    /* 读取 socket 信息 */
-    __u16 family;
-    bpf_probe_read_kernel(&family, sizeof(family), &sk->__sk_common.skc_family);
+    /* 背压期间被丢弃的低优先级连接同样视为已处理，不再重试 */
+    if (shed_event(st->tuple.dport)) {
+        st->state = 2;
+        return 0;
+    }
     
-    if (family != AF_INET) {
-        return 0;  /* 只处理 IPv4 */
+    /* 发送事件到用户态，四元组已在 fexit 中记录 */
+    if (emit_event(ctx, &st->tuple, st->pid, 0) < 0) {
+        return 0;  /* 事件通道已满，保持状态 1，下次发送时重试 */
     }
     
-    /* 读取四元组信息 */
-    bpf_probe_read_kernel(&info.saddr, sizeof(info.saddr), &sk->__sk_common.skc_rcv_saddr);
-    bpf_probe_read_kernel(&info.daddr, sizeof(info.daddr), &sk->__sk_common.skc_daddr);
-    bpf_probe_read_kernel(&info.sport, sizeof(info.sport), &sk->__sk_common.skc_num);
-    bpf_probe_read_kernel(&info.dport, sizeof(info.dport), &sk->__sk_common.skc_dport);
-    info.dport = bpf_ntohs(info.dport);
-    info.pid = bpf_get_current_pid_tgid() >> 32;
+    /* 更新状态为已处理 */
+    st->state = 2;
     
-    /* 保存 socket 信息 */
-    bpf_map_update_elem(&sock_info_map, &sock_ptr, &info, BPF_ANY);
+    capture_dbg("TCP connection captured: family=%u, sport=%u, dport=%u\n",
+                st->tuple.family, st->tuple.sport, st->tuple.dport);
     
-    /* 发送事件到用户态 */
-    event.saddr = info.saddr;
-    event.daddr = info.daddr;
-    event.sport = info.sport;
-    event.dport = info.dport;
-    event.pid = info.pid;
-    event.timestamp = bpf_ktime_get_ns();
+    return 0;
+}
+
+/**
+ * Hook 服务端 accept：被动连接在 accept() 返回时立即上报，
+ * 服务端节点不必等到自己首次发送就能获取密钥并安装 kTLS RX
+ * inet_csk_accept 的参数在 6.10 中改为 struct proto_accept_arg，
+ * 这里用 kretprobe 只取返回值，避免 fexit 依赖参数布局
+ */
+SEC("kretprobe/inet_csk_accept")
+int BPF_KRETPROBE(kretprobe_inet_csk_accept, struct sock *newsk) {
+    struct conn_tuple t = {0};
+    __u32 reason;
     
-    bpf_perf_event_output(ctx, &events, BPF_F_CURRENT_CPU, &event, sizeof(event));
+    if (!newsk) {
+        return 0;
+    }
+    stat_inc(CAPTURE_STAT_ACCEPT);
     
-    /* 更新状态为已处理 */
-    __u32 new_state = 2;
-    bpf_map_update_elem(&conn_track_map, &sock_ptr, &new_state, BPF_ANY);
+    read_sock_tuple(newsk, &t);
+    if (t.family != AF_INET && t.family != AF_INET6) {
+        stat_inc(CAPTURE_STAT_FAMILY_SKIP);
+        return 0;
+    }
+    
+    reason = policy_check(t.family, t.saddr, t.daddr, t.sport);
+    if (reason) {
+        stat_inc(reason);
+        return 0;
+    }
+    if (shed_event(t.sport)) {
+        return 0;
+    }
     
-    bpf_printk("TCP connection captured: %pI4:%u -> %pI4:%u\n",
-               &info.saddr, info.sport, &info.daddr, info.dport);
+    emit_event(ctx, &t, bpf_get_current_pid_tgid() >> 32, CAPTURE_EVENT_F_SERVER);
+    capture_dbg("TCP connection accepted: family=%u, sport=%u, dport=%u\n",
+                t.family, t.sport, t.dport);
+    return 0;
+}
+
+/**
+ * Hook TCP 状态变化：连接关闭时提前释放捕获状态
+ * 即使不删除，socket 销毁时内核也会回收；这里删除是为了让计数器反映存活条目数
+ */
+SEC("tp_btf/inet_sock_set_state")
+int BPF_PROG(tp_inet_sock_set_state, struct sock *sk, int oldstate, int newstate) {
+    if (newstate != TCP_CLOSE) {
+        return 0;
+    }
     
+    sk_state_delete(sk);
     return 0;
 }
 
+/**
+ * Hook cgroup sockops：连接建立完成时上报一次连接事件
+ * 主动连接在收到 SYN-ACK 时（ACTIVE_ESTABLISHED），被动连接在收到第三次握手的 ACK 时
+ * （PASSIVE_ESTABLISHED）触发，每个连接只触发一次，之后的数据发送不经过任何 eBPF 程序
+ */
+SEC("sockops")
+int sockops_established(struct bpf_sock_ops *skops) {
+    struct conn_tuple t = {0};
+    __u16 flags, service_port;
+    __u32 reason;
+    
+    switch (skops->op) {
+    case BPF_SOCK_OPS_ACTIVE_ESTABLISHED_CB:
+        stat_inc(CAPTURE_STAT_CONNECT);
+        flags = 0;
+        break;
+    case BPF_SOCK_OPS_PASSIVE_ESTABLISHED_CB:
+        stat_inc(CAPTURE_STAT_ACCEPT);
+        flags = CAPTURE_EVENT_F_SERVER;
+        break;
+    default:
+        return 1;
+    }
+    
+    if (skops->family == AF_INET6) {
+        __u32 src6[4] = { skops->local_ip6[0], skops->local_ip6[1],
+                          skops->local_ip6[2], skops->local_ip6[3] };
+        __u32 dst6[4] = { skops->remote_ip6[0], skops->remote_ip6[1],
+                          skops->remote_ip6[2], skops->remote_ip6[3] };
+        
+        fill_addr6(&t.family, t.saddr, t.daddr, src6, dst6);
+    } else if (skops->family == AF_INET) {
+        t.family = AF_INET;
+        t.saddr[0] = skops->local_ip4;
+        t.daddr[0] = skops->remote_ip4;
+    } else {
+        stat_inc(CAPTURE_STAT_FAMILY_SKIP);
+        return 1;
+    }
+    t.sport = skops->local_port;              /* 主机字节序 */
+    t.dport = bpf_ntohl(skops->remote_port);  /* 网络字节序，位于高 16 位 */
+    
+    service_port = (flags & CAPTURE_EVENT_F_SERVER) ? t.sport : t.dport;
+    reason = policy_check(t.family, t.saddr, t.daddr, service_port);
+    if (reason) {
+        stat_inc(reason);
+        return 1;
+    }
+    if (shed_event(service_port)) {
+        return 1;
+    }
+    
+    /* 软中断上下文中没有可用的进程信息 */
+    emit_event(skops, &t, 0, flags);
+    return 1;
+}
+
 char _license[] SEC("license") = "GPL";
@@ -0,0 +1,361 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "circuit_breaker.h"
+#include "log.h"
+
+/* 滑动窗口的一个时间片 */
+struct breaker_bucket {
+    __u64 epoch;            /* 时间片序号（now / bucket_ns），不是当前窗口内的序号时视为空 */
+    __u32 requests;
+    __u32 failures;
+    __u32 slow;
+};
+
+struct circuit_breaker {
+    struct circuit_breaker_config config;
+    struct circuit_breaker_ops ops;
+    void *arg;
+    __u64 bucket_ns;
+    struct breaker_bucket buckets[CIRCUIT_BREAKER_BUCKETS];
+
+    int state;              /* enum circuit_breaker_state，闭合时 allow 只读这一个字段 */
+    __u32 trials;           /* 半开后已放行的试探请求数 */
+    __u32 trial_successes;  /* 半开后成功的试探请求数 */
+    __u64 open_since_ns;    /* 本次断开的开始时间 */
+    __u64 next_probe_ns;    /* 下一次探测的时间 */
+    __u8 *data;             /* 最近一次请求的数据，供探测使用 */
+    int has_data;
+
+    pthread_t thread;
+    pthread_mutex_t lock;   /* 保护以上状态和窗口 */
+    pthread_cond_t cond;    /* 使用 CLOCK_MONOTONIC */
+    int stop;
+    int started;
+
+    struct circuit_breaker_stats stats;
+};
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void stat_add(__u64 *counter, __s64 value) {
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+/* 耗时超过 slow_ms */
+static int is_slow(const struct circuit_breaker *breaker, __u64 latency_ns) {
+    return breaker->config.slow_ms > 0 && latency_ns > (__u64)breaker->config.slow_ms * 1000000ULL;
+}
+
+/* 状态切换，调用者持有锁 */
+static void set_state(struct circuit_breaker *breaker, int state) {
+    __atomic_store_n(&breaker->state, state, __ATOMIC_RELEASE);
+    __atomic_store_n(&breaker->stats.state, (__u64)state, __ATOMIC_RELAXED);
+}
+
+/* 汇总当前窗口，调用者持有锁 */
+static void window_sum(struct circuit_breaker *breaker, __u64 now, __u32 *requests,
+                       __u32 *failures, __u32 *slow) {
+    __u64 epoch = now / breaker->bucket_ns;
+
+    *requests = *failures = *slow = 0;
+    for (__u32 i = 0; i < CIRCUIT_BREAKER_BUCKETS; i++) {
+        struct breaker_bucket *bucket = &breaker->buckets[i];
+
+        if (bucket->epoch + CIRCUIT_BREAKER_BUCKETS > epoch) {
+            *requests += bucket->requests;
+            *failures += bucket->failures;
+            *slow += bucket->slow;
+        }
+    }
+}
+
+/* 断开并安排探测，调用者持有锁 */
+static void trip(struct circuit_breaker *breaker, __u64 now, const char *reason) {
+    if (breaker->state == CIRCUIT_BREAKER_CLOSED) {
+        breaker->open_since_ns = now;
+    }
+    set_state(breaker, CIRCUIT_BREAKER_OPEN);
+    breaker->next_probe_ns = now + (__u64)breaker->config.open_ms * 1000000ULL;
+    stat_add(&breaker->stats.opened, 1);
+    log_warn("Circuit breaker opened (%s), probing every %u ms", reason, breaker->config.open_ms);
+    pthread_cond_broadcast(&breaker->cond);
+}
+
+/* 试探全部成功，闭合并清空窗口，调用者持有锁 */
+static void close_breaker(struct circuit_breaker *breaker, __u64 now) {
+    set_state(breaker, CIRCUIT_BREAKER_CLOSED);
+    memset(breaker->buckets, 0, sizeof(breaker->buckets));
+    stat_add(&breaker->stats.closed, 1);
+    stat_add(&breaker->stats.open_ms, (now - breaker->open_since_ns) / 1000000ULL);
+    log_info("Circuit breaker closed after %u successful trial requests", breaker->trial_successes);
+}
+
+/**
+ * 请求开始前询问是否放行
+ */
+int circuit_breaker_allow(struct circuit_breaker *breaker) {
+    int ticket = CIRCUIT_BREAKER_REJECT;
+
+    if (!breaker) {
+        return CIRCUIT_BREAKER_PASS;
+    }
+
+    switch (__atomic_load_n(&breaker->state, __ATOMIC_ACQUIRE)) {
+        case CIRCUIT_BREAKER_CLOSED:
+            return CIRCUIT_BREAKER_PASS;
+
+        case CIRCUIT_BREAKER_HALF_OPEN:
+            pthread_mutex_lock(&breaker->lock);
+            if (breaker->state == CIRCUIT_BREAKER_CLOSED) {
+                ticket = CIRCUIT_BREAKER_PASS;
+            } else if (breaker->state == CIRCUIT_BREAKER_HALF_OPEN &&
+                       breaker->trials < breaker->config.half_open_requests) {
+                breaker->trials++;
+                ticket = CIRCUIT_BREAKER_TRIAL;
+            }
+            pthread_mutex_unlock(&breaker->lock);
+            break;
+
+        default:
+            break;
+    }
+    if (ticket == CIRCUIT_BREAKER_REJECT) {
+        stat_add(&breaker->stats.rejected, 1);
+    }
+    return ticket;
+}
+
+/**
+ * 记录一个已放行请求的结果
+ */
+void circuit_breaker_record(struct circuit_breaker *breaker, int ticket, int success,
+                            __u64 latency_ns, const void *data) {
+    __u64 now;
+    int slow;
+
+    if (!breaker || ticket == CIRCUIT_BREAKER_REJECT) {
+        return;
+    }
+
+    now = now_ns();
+    slow = is_slow(breaker, latency_ns);
+
+    pthread_mutex_lock(&breaker->lock);
+    if (data && breaker->config.data_size > 0) {
+        memcpy(breaker->data, data, breaker->config.data_size);
+        breaker->has_data = 1;
+    }
+
+    if (ticket == CIRCUIT_BREAKER_TRIAL) {
+        /* 试探请求慢同样视为未恢复 */
+        if (breaker->state == CIRCUIT_BREAKER_HALF_OPEN) {
+            if (!success || slow) {
+                trip(breaker, now, success ? "slow trial request" : "trial request failed");
+            } else if (++breaker->trial_successes >= breaker->config.half_open_requests) {
+                close_breaker(breaker, now);
+            }
+        }
+    } else if (breaker->state == CIRCUIT_BREAKER_CLOSED) {
+        /* 断开前放行、断开后才结束的请求不再计入 */
+        __u64 epoch = now / breaker->bucket_ns;
+        struct breaker_bucket *bucket = &breaker->buckets[epoch % CIRCUIT_BREAKER_BUCKETS];
+        __u32 requests, failures, slow_calls;
+
+        if (bucket->epoch != epoch) {
+            memset(bucket, 0, sizeof(*bucket));
+            bucket->epoch = epoch;
+        }
+        bucket->requests++;
+        bucket->failures += !success;
+        bucket->slow += slow;
+
+        window_sum(breaker, now, &requests, &failures, &slow_calls);
+        if (requests >= breaker->config.min_requests) {
+            if (breaker->config.failure_percent > 0 &&
+                (__u64)failures * 100 >= (__u64)breaker->config.failure_percent * requests) {
+                trip(breaker, now, "failure rate");
+            } else if (breaker->config.slow_ms > 0 && breaker->config.slow_percent > 0 &&
+                       (__u64)slow_calls * 100 >= (__u64)breaker->config.slow_percent * requests) {
+                trip(breaker, now, "slow call rate");
+            }
+        }
+    }
+    pthread_mutex_unlock(&breaker->lock);
+}
+
+/**
+ * 探测线程：断开期间每隔 open_ms 用最近一次请求的数据探测，成功后转为半开
+ */
+static void *probe_thread(void *arg) {
+    struct circuit_breaker *breaker = arg;
+    __u8 *data = NULL;
+
+    if (breaker->config.data_size > 0) {
+        data = malloc(breaker->config.data_size);
+    }
+
+    pthread_mutex_lock(&breaker->lock);
+    while (!breaker->stop) {
+        __u64 now = now_ns();
+        int ret;
+
+        if (breaker->state != CIRCUIT_BREAKER_OPEN) {
+            pthread_cond_wait(&breaker->cond, &breaker->lock);
+            continue;
+        }
+        if (now < breaker->next_probe_ns) {
+            struct timespec ts = {
+                .tv_sec = breaker->next_probe_ns / 1000000000ULL,
+                .tv_nsec = breaker->next_probe_ns % 1000000000ULL,
+            };
+
+            pthread_cond_timedwait(&breaker->cond, &breaker->lock, &ts);
+            continue;
+        }
+
+        /* 没有可用的探测数据时直接放行试探请求；探测成功但慢同样视为未恢复 */
+        ret = 0;
+        if (breaker->has_data && data) {
+            memcpy(data, breaker->data, breaker->config.data_size);
+            pthread_mutex_unlock(&breaker->lock);
+            ret = breaker->ops.probe(breaker->arg, data);
+            if (ret == 0 && is_slow(breaker, now_ns() - now)) {
+                ret = -1;
+            }
+            pthread_mutex_lock(&breaker->lock);
+            stat_add(&breaker->stats.probes, 1);
+        }
+        if (breaker->stop || breaker->state != CIRCUIT_BREAKER_OPEN) {
+            continue;
+        }
+        if (ret == 0) {
+            breaker->trials = 0;
+            breaker->trial_successes = 0;
+            set_state(breaker, CIRCUIT_BREAKER_HALF_OPEN);
+            stat_add(&breaker->stats.half_opened, 1);
+            log_info("Circuit breaker half-open, admitting %u trial requests",
+                     breaker->config.half_open_requests);
+        } else {
+            stat_add(&breaker->stats.probe_failures, 1);
+            breaker->next_probe_ns = now_ns() + (__u64)breaker->config.open_ms * 1000000ULL;
+        }
+    }
+    pthread_mutex_unlock(&breaker->lock);
+
+    free(data);
+    if (breaker->ops.thread_exit) {
+        breaker->ops.thread_exit(breaker->arg);
+    }
+    return NULL;
+}
+
+/**
+ * 创建熔断器并启动探测线程
+ */
+struct circuit_breaker *circuit_breaker_new(const struct circuit_breaker_config *config,
+                                            const struct circuit_breaker_ops *ops, void *arg) {
+    struct circuit_breaker *breaker;
+    pthread_condattr_t attr;
+
+    if (!config || !ops || !ops->probe || config->window_ms < CIRCUIT_BREAKER_BUCKETS ||
+        config->open_ms == 0 || config->failure_percent > 100 || config->slow_percent > 100) {
+        return NULL;
+    }
+
+    breaker = calloc(1, sizeof(*breaker));
+    if (!breaker) {
+        return NULL;
+    }
+    breaker->config = *config;
+    if (breaker->config.min_requests == 0) {
+        breaker->config.min_requests = 1;
+    }
+    if (breaker->config.half_open_requests == 0) {
+        breaker->config.half_open_requests = 1;
+    }
+    breaker->ops = *ops;
+    breaker->arg = arg;
+    breaker->bucket_ns = (__u64)config->window_ms * 1000000ULL / CIRCUIT_BREAKER_BUCKETS;
+    if (config->data_size > 0) {
+        breaker->data = calloc(1, config->data_size);
+        if (!breaker->data) {
+            free(breaker);
+            return NULL;
+        }
+    }
+
+    pthread_mutex_init(&breaker->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&breaker->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&breaker->thread, NULL, probe_thread, breaker) != 0) {
+        fprintf(stderr, "Failed to start circuit breaker probe thread\n");
+        circuit_breaker_free(breaker);
+        return NULL;
+    }
+    breaker->started = 1;
+    return breaker;
+}
+
+/**
+ * 获取熔断器统计
+ */
+void circuit_breaker_get_stats(struct circuit_breaker *breaker, struct circuit_breaker_stats *stats) {
+    __u32 requests, failures, slow;
+    __u64 now;
+
+    if (!breaker || !stats) {
+        return;
+    }
+
+    now = now_ns();
+    pthread_mutex_lock(&breaker->lock);
+    window_sum(breaker, now, &requests, &failures, &slow);
+    stats->state = (__u64)breaker->state;
+    stats->open_ms = __atomic_load_n(&breaker->stats.open_ms, __ATOMIC_RELAXED);
+    if (breaker->state != CIRCUIT_BREAKER_CLOSED) {
+        stats->open_ms += (now - breaker->open_since_ns) / 1000000ULL;
+    }
+    pthread_mutex_unlock(&breaker->lock);
+
+    stats->opened = __atomic_load_n(&breaker->stats.opened, __ATOMIC_RELAXED);
+    stats->half_opened = __atomic_load_n(&breaker->stats.half_opened, __ATOMIC_RELAXED);
+    stats->closed = __atomic_load_n(&breaker->stats.closed, __ATOMIC_RELAXED);
+    stats->rejected = __atomic_load_n(&breaker->stats.rejected, __ATOMIC_RELAXED);
+    stats->probes = __atomic_load_n(&breaker->stats.probes, __ATOMIC_RELAXED);
+    stats->probe_failures = __atomic_load_n(&breaker->stats.probe_failures, __ATOMIC_RELAXED);
+    stats->window_requests = requests;
+    stats->window_failures = failures;
+    stats->window_slow = slow;
+}
+
+/**
+ * 停止探测线程并释放熔断器
+ */
+void circuit_breaker_free(struct circuit_breaker *breaker) {
+    if (!breaker) {
+        return;
+    }
+
+    if (breaker->started) {
+        pthread_mutex_lock(&breaker->lock);
+        breaker->stop = 1;
+        pthread_cond_broadcast(&breaker->cond);
+        pthread_mutex_unlock(&breaker->lock);
+        pthread_join(breaker->thread, NULL);
+    }
+
+    pthread_cond_destroy(&breaker->cond);
+    pthread_mutex_destroy(&breaker->lock);
+    free(breaker->data);
+    free(breaker);
+}
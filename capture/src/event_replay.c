@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/eventfd.h>
+#include "event_replay.h"
+
+/* 回放线程每次最多睡眠的时间，保证停止请求能及时生效 */
+#define REPLAY_MAX_SLEEP_NS 100000000ULL
+
+struct event_recorder {
+    FILE *fp;
+    pthread_mutex_t lock;
+    __u64 count;
+};
+
+struct event_replay {
+    struct event_replay_config config;
+    char path[256];
+    FILE *fp;
+    event_replay_fn handler;
+    void *ctx;
+
+    pthread_t thread;
+    int started;
+    int stop;
+    int done_fd;            /* eventfd，全部事件注入后写入 */
+
+    __u64 events;
+    __u64 elapsed_ns;
+    __u64 max_lag_ns;
+    int done;
+};
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * 创建录制文件并写入文件头
+ */
+struct event_recorder *event_recorder_open(const char *path) {
+    struct event_record_header hdr;
+    struct event_recorder *rec;
+
+    rec = calloc(1, sizeof(*rec));
+    if (!rec) {
+        return NULL;
+    }
+
+    rec->fp = fopen(path, "wb");
+    if (!rec->fp) {
+        fprintf(stderr, "Failed to create record file %s: %s\n", path, strerror(errno));
+        free(rec);
+        return NULL;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = EVENT_RECORD_MAGIC;
+    hdr.version = EVENT_RECORD_VERSION;
+    hdr.record_size = sizeof(struct tcp_connect_event);
+    if (fwrite(&hdr, sizeof(hdr), 1, rec->fp) != 1) {
+        fprintf(stderr, "Failed to write record header to %s\n", path);
+        fclose(rec->fp);
+        free(rec);
+        return NULL;
+    }
+
+    pthread_mutex_init(&rec->lock, NULL);
+    return rec;
+}
+
+/**
+ * 追加一条事件
+ */
+int event_recorder_write(struct event_recorder *rec, const struct tcp_connect_event *event) {
+    int ret = 0;
+
+    if (!rec || !event) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&rec->lock);
+    if (fwrite(event, sizeof(*event), 1, rec->fp) == 1) {
+        rec->count++;
+    } else {
+        ret = -1;
+    }
+    pthread_mutex_unlock(&rec->lock);
+    return ret;
+}
+
+/**
+ * 写出缓冲数据并关闭录制文件
+ */
+__u64 event_recorder_close(struct event_recorder *rec) {
+    __u64 count;
+
+    if (!rec) {
+        return 0;
+    }
+
+    count = rec->count;
+    fclose(rec->fp);
+    pthread_mutex_destroy(&rec->lock);
+    free(rec);
+    return count;
+}
+
+/**
+ * 打开录制文件并检查文件头
+ */
+static FILE *open_record_file(const char *path) {
+    struct event_record_header hdr;
+    FILE *fp;
+
+    fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Failed to open record file %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        hdr.magic != EVENT_RECORD_MAGIC ||
+        hdr.version != EVENT_RECORD_VERSION ||
+        hdr.record_size != sizeof(struct tcp_connect_event)) {
+        fprintf(stderr, "%s is not a capture event record (or was written by another version)\n", path);
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+/**
+ * 生成第 i 条合成事件：synthetic_pairs 个客户端 Pod 连接同一个服务端 Pod 的 443 端口，
+ * 到达间隔由 synthetic_rate 决定
+ */
+static void make_synthetic_event(const struct event_replay_config *config, __u64 i,
+                                 struct tcp_connect_event *event, __u64 *offset_ns) {
+    __u32 pair = (__u32)(i % config->synthetic_pairs);
+
+    memset(event, 0, sizeof(*event));
+    event->family = CAPTURE_AF_INET;
+    event->saddr = htonl(0x0af40100 + 1 + pair);   /* 10.244.1.x */
+    event->daddr = htonl(0x0af40201);              /* 10.244.2.1 */
+    event->sport = (__u16)(32768 + i % 28000);
+    event->dport = 443;
+    event->pid = 1000 + pair;
+
+    *offset_ns = config->synthetic_rate ? i * 1000000000ULL / config->synthetic_rate : 0;
+}
+
+/**
+ * 读取下一条事件及其相对第一条事件的时间偏移
+ * @return: 读到返回 1，没有更多事件返回 0
+ */
+static int next_event(struct event_replay *replay, __u64 index, __u64 *first_ts,
+                      struct tcp_connect_event *event, __u64 *offset_ns) {
+    if (!replay->fp) {
+        if (index >= replay->config.synthetic_events) {
+            return 0;
+        }
+        make_synthetic_event(&replay->config, index, event, offset_ns);
+        return 1;
+    }
+
+    if (fread(event, sizeof(*event), 1, replay->fp) != 1) {
+        return 0;
+    }
+    if (index == 0) {
+        *first_ts = event->timestamp;
+    }
+    *offset_ns = event->timestamp > *first_ts ? event->timestamp - *first_ts : 0;
+    return 1;
+}
+
+/**
+ * 等待到计划注入时刻，期间定期检查停止请求
+ */
+static void wait_until(struct event_replay *replay, __u64 target) {
+    for (;;) {
+        __u64 now = now_ns();
+        __u64 wait;
+        struct timespec ts;
+
+        if (now >= target || __atomic_load_n(&replay->stop, __ATOMIC_RELAXED)) {
+            return;
+        }
+        wait = target - now;
+        if (wait > REPLAY_MAX_SLEEP_NS) {
+            wait = REPLAY_MAX_SLEEP_NS;
+        }
+        ts.tv_sec = wait / 1000000000ULL;
+        ts.tv_nsec = wait % 1000000000ULL;
+        nanosleep(&ts, NULL);
+    }
+}
+
+/**
+ * 回放线程：按计划时刻逐条注入事件
+ */
+static void *replay_main(void *arg) {
+    struct event_replay *replay = arg;
+    struct tcp_connect_event event;
+    __u64 first_ts = 0, offset_ns, start, index = 0;
+    uint64_t one = 1;
+
+    start = now_ns();
+    while (!__atomic_load_n(&replay->stop, __ATOMIC_RELAXED) &&
+           next_event(replay, index, &first_ts, &event, &offset_ns) > 0) {
+        __u64 now;
+
+        if (replay->config.speed > 0) {
+            __u64 target = start + (__u64)(offset_ns / replay->config.speed);
+
+            wait_until(replay, target);
+            now = now_ns();
+            if (now > target && now - target > replay->max_lag_ns) {
+                __atomic_store_n(&replay->max_lag_ns, now - target, __ATOMIC_RELAXED);
+            }
+        } else {
+            now = now_ns();
+        }
+
+        event.timestamp = now;
+        replay->handler(replay->ctx, &event);
+        index++;
+        __atomic_store_n(&replay->events, index, __ATOMIC_RELAXED);
+        __atomic_store_n(&replay->elapsed_ns, now_ns() - start, __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&replay->done, 1, __ATOMIC_RELEASE);
+    if (write(replay->done_fd, &one, sizeof(one)) != sizeof(one)) {
+        perror("write replay eventfd");
+    }
+    return NULL;
+}
+
+/**
+ * 启动回放线程
+ */
+struct event_replay *event_replay_start(const struct event_replay_config *config,
+                                        event_replay_fn handler, void *ctx) {
+    struct event_replay *replay;
+
+    if (!config || !handler) {
+        return NULL;
+    }
+
+    replay = calloc(1, sizeof(*replay));
+    if (!replay) {
+        return NULL;
+    }
+    replay->config = *config;
+    replay->handler = handler;
+    replay->ctx = ctx;
+    replay->done_fd = -1;
+
+    if (config->path) {
+        strncpy(replay->path, config->path, sizeof(replay->path) - 1);
+        replay->config.path = replay->path;
+        replay->fp = open_record_file(replay->path);
+        if (!replay->fp) {
+            free(replay);
+            return NULL;
+        }
+    } else if (replay->config.synthetic_pairs == 0) {
+        replay->config.synthetic_pairs = EVENT_REPLAY_DEFAULT_SYNTHETIC_PAIRS;
+    }
+
+    replay->done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (replay->done_fd < 0) {
+        perror("eventfd");
+        event_replay_free(replay);
+        return NULL;
+    }
+
+    if (pthread_create(&replay->thread, NULL, replay_main, replay) != 0) {
+        fprintf(stderr, "Failed to start replay thread\n");
+        event_replay_free(replay);
+        return NULL;
+    }
+    replay->started = 1;
+    return replay;
+}
+
+/**
+ * 获取回放结束通知的文件描述符
+ */
+int event_replay_fd(struct event_replay *replay) {
+    return replay ? replay->done_fd : -1;
+}
+
+/**
+ * 获取回放统计
+ */
+void event_replay_get_stats(struct event_replay *replay, struct event_replay_stats *stats) {
+    if (!replay || !stats) {
+        return;
+    }
+
+    stats->events = __atomic_load_n(&replay->events, __ATOMIC_RELAXED);
+    stats->elapsed_ns = __atomic_load_n(&replay->elapsed_ns, __ATOMIC_RELAXED);
+    stats->max_lag_ns = __atomic_load_n(&replay->max_lag_ns, __ATOMIC_RELAXED);
+    stats->done = __atomic_load_n(&replay->done, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * 停止回放线程并释放回放器
+ */
+void event_replay_free(struct event_replay *replay) {
+    if (!replay) {
+        return;
+    }
+
+    if (replay->started) {
+        __atomic_store_n(&replay->stop, 1, __ATOMIC_RELAXED);
+        pthread_join(replay->thread, NULL);
+    }
+    if (replay->fp) {
+        fclose(replay->fp);
+    }
+    if (replay->done_fd >= 0) {
+        close(replay->done_fd);
+    }
+    free(replay);
+}
@@ -0,0 +1,499 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <bpf/libbpf.h>
+/* Try to include libbpf_version.h for version detection */
+#ifdef __has_include
+  #if __has_include(<bpf/libbpf_version.h>)
+    #include <bpf/libbpf_version.h>
+  #endif
+#endif
+#include "event_source.h"
+
+#define CACHE_LINE_SIZE 64
+#define CONSUMER_MAX_EVENTS 16
+#define CONSUMER_STOP_TOKEN UINT64_MAX
+
+/*
+ * perf buffer 单个 CPU 的计数，只由消费该 CPU 缓冲区的线程写入；
+ * 按缓存行对齐，多个消费者线程更新各自 CPU 的计数时不会伪共享
+ */
+struct perfbuf_cpu_stats {
+    _Alignas(CACHE_LINE_SIZE) __u64 events;
+    __u64 lost;
+};
+
+/* 每 CPU 消费者线程，负责 [first, first + count) 这一组 perf buffer */
+struct event_consumer {
+    _Alignas(CACHE_LINE_SIZE) struct event_source *src;
+    pthread_t thread;
+    int id;
+    int epoll_fd;
+    size_t first;
+    size_t count;
+    __u64 wakeups;
+};
+
+struct event_source {
+    enum event_transport transport;
+    struct ring_buffer *rb;
+    struct perf_buffer *pb;
+    event_handler_fn handler;
+    void *ctx;
+    struct event_source_stats stats;
+    struct perfbuf_cpu_stats *cpu_stats;    /* perf buffer 各 CPU 的事件和丢失数 */
+    int ncpus;
+    
+    /* 每 CPU 消费者线程（仅 perf buffer） */
+    struct event_consumer *consumers;
+    __u32 consumer_count;
+    int stop_fd;                            /* eventfd，写入后所有消费者线程退出 */
+};
+
+/* 当前线程对应的消费者编号，事件循环线程中为 -1 */
+static __thread int current_consumer = -1;
+
+/**
+ * 单写者计数：只有一个线程写入，其他线程只读，不需要原子读-改-写
+ */
+static inline void counter_add(__u64 *counter, __u64 n) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static inline __u64 counter_read(const __u64 *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/**
+ * Ring buffer 事件回调
+ */
+static int ringbuf_sample(void *ctx, void *data, size_t size) {
+    struct event_source *src = ctx;
+    
+    if (size < sizeof(struct tcp_connect_event)) {
+        return 0;
+    }
+    
+    src->stats.events++;
+    src->handler(src->ctx, data);
+    return 0;
+}
+
+/**
+ * Perf buffer 事件回调
+ */
+static void perfbuf_sample(void *ctx, int cpu, void *data, __u32 size) {
+    struct event_source *src = ctx;
+    
+    if (size < sizeof(struct tcp_connect_event)) {
+        return;
+    }
+    
+    if (cpu >= 0 && cpu < src->ncpus) {
+        counter_add(&src->cpu_stats[cpu].events, 1);
+    }
+    src->handler(src->ctx, data);
+}
+
+/**
+ * Perf buffer 丢失回调：内核写满某个 CPU 的缓冲区后，丢失的样本数随下一次读取上报
+ */
+static void perfbuf_lost(void *ctx, int cpu, __u64 cnt) {
+    struct event_source *src = ctx;
+    
+    if (cpu >= 0 && cpu < src->ncpus) {
+        counter_add(&src->cpu_stats[cpu].lost, cnt);
+    }
+}
+
+/**
+ * 为已加载的 eBPF 对象创建事件源
+ */
+struct event_source *event_source_new(struct bpf_loader *loader,
+                                      event_handler_fn handler, void *ctx) {
+    struct event_source *src;
+    int map_fd;
+    
+    src = calloc(1, sizeof(*src));
+    if (!src) {
+        fprintf(stderr, "Failed to allocate event source\n");
+        return NULL;
+    }
+    
+    src->transport = loader->transport;
+    src->handler = handler;
+    src->ctx = ctx;
+    src->stop_fd = -1;
+    
+    if (src->transport == EVENT_TRANSPORT_RINGBUF) {
+        map_fd = bpf_object__find_map_fd_by_name(loader->obj, "rb");
+        if (map_fd < 0) {
+            fprintf(stderr, "Failed to find rb map\n");
+            goto err;
+        }
+        
+        src->rb = ring_buffer__new(map_fd, ringbuf_sample, src, NULL);
+        if (libbpf_get_error(src->rb)) {
+            fprintf(stderr, "Failed to create ring buffer\n");
+            src->rb = NULL;
+            goto err;
+        }
+    } else {
+        map_fd = bpf_object__find_map_fd_by_name(loader->obj, "events");
+        if (map_fd < 0) {
+            fprintf(stderr, "Failed to find events map\n");
+            goto err;
+        }
+        
+        src->ncpus = libbpf_num_possible_cpus();
+        if (src->ncpus <= 0) {
+            fprintf(stderr, "Failed to get number of possible CPUs\n");
+            goto err;
+        }
+        src->cpu_stats = aligned_alloc(CACHE_LINE_SIZE,
+                                       src->ncpus * sizeof(struct perfbuf_cpu_stats));
+        if (!src->cpu_stats) {
+            fprintf(stderr, "Failed to allocate per-CPU counters\n");
+            goto err;
+        }
+        memset(src->cpu_stats, 0, src->ncpus * sizeof(struct perfbuf_cpu_stats));
+        
+        /* 根据 libbpf 版本使用不同的 API */
+#if defined(LIBBPF_MAJOR_VERSION) && LIBBPF_MAJOR_VERSION >= 1
+        /* libbpf 1.0+ API: 回调函数作为独立参数传递 */
+        src->pb = perf_buffer__new(map_fd, PERF_BUFFER_PAGES, perfbuf_sample,
+                                   perfbuf_lost, src, NULL);
+#else
+        /* libbpf 0.x API: 回调函数通过 opts 结构体传递 */
+        struct perf_buffer_opts pb_opts = {
+            .sample_cb = perfbuf_sample,
+            .lost_cb = perfbuf_lost,
+            .ctx = src,
+        };
+        src->pb = perf_buffer__new(map_fd, PERF_BUFFER_PAGES, &pb_opts);
+#endif
+        if (libbpf_get_error(src->pb)) {
+            fprintf(stderr, "Failed to create perf buffer\n");
+            src->pb = NULL;
+            goto err;
+        }
+    }
+    
+    return src;
+    
+err:
+    free(src->cpu_stats);
+    free(src);
+    return NULL;
+}
+
+/**
+ * 等待并消费事件
+ */
+int event_source_poll(struct event_source *src, int timeout_ms) {
+    int ret;
+    
+    if (src->rb) {
+        ret = ring_buffer__poll(src->rb, timeout_ms);
+    } else {
+        ret = perf_buffer__poll(src->pb, timeout_ms);
+    }
+    
+    if (ret > 0) {
+        src->stats.wakeups++;
+    }
+    return ret;
+}
+
+/**
+ * 获取事件源的 epoll 文件描述符
+ */
+int event_source_epoll_fd(struct event_source *src) {
+    if (src->rb) {
+        return ring_buffer__epoll_fd(src->rb);
+    }
+    return perf_buffer__epoll_fd(src->pb);
+}
+
+/**
+ * 获取事件源统计
+ */
+void event_source_get_stats(struct event_source *src, struct event_source_stats *stats) {
+    *stats = src->stats;
+    
+    /* perf buffer 的事件和丢失数按 CPU 记录，消费者线程的唤醒次数各自记录 */
+    for (int cpu = 0; cpu < src->ncpus; cpu++) {
+        stats->events += counter_read(&src->cpu_stats[cpu].events);
+        stats->lost += counter_read(&src->cpu_stats[cpu].lost);
+    }
+    for (__u32 i = 0; i < src->consumer_count; i++) {
+        stats->wakeups += counter_read(&src->consumers[i].wakeups);
+    }
+}
+
+/**
+ * 获取 perf buffer 各 CPU 丢失的样本数
+ */
+int event_source_lost_per_cpu(struct event_source *src, __u64 *lost, int max_cpus) {
+    int n = src->ncpus < max_cpus ? src->ncpus : max_cpus;
+    
+    for (int cpu = 0; cpu < n; cpu++) {
+        lost[cpu] = counter_read(&src->cpu_stats[cpu].lost);
+    }
+    return n;
+}
+
+/**
+ * 读取在线 CPU 列表（/sys/devices/system/cpu/online，如 "0-3,8-11"）
+ * libbpf 按在线 CPU 的顺序为每个 CPU 创建一个 perf buffer，第 i 个缓冲区对应第 i 个在线 CPU
+ * @return: CPU 个数，失败返回 -1
+ */
+static int read_online_cpus(int *cpus, int max) {
+    char buf[1024];
+    char *p = buf;
+    int n = 0;
+    FILE *fp;
+    
+    fp = fopen("/sys/devices/system/cpu/online", "r");
+    if (!fp) {
+        return -1;
+    }
+    if (!fgets(buf, sizeof(buf), fp)) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    
+    while (*p && *p != '\n') {
+        char *end;
+        long lo = strtol(p, &end, 10), hi = lo;
+        
+        if (end == p) {
+            return -1;
+        }
+        p = end;
+        if (*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = lo; cpu <= hi && n < max; cpu++) {
+            cpus[n++] = (int)cpu;
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return n;
+}
+
+/**
+ * 消费者线程：绑定到所负责的 CPU，只等待并消费这些 CPU 的 perf buffer
+ */
+static void *consumer_main(void *arg) {
+    struct event_consumer *c = arg;
+    struct epoll_event ready[CONSUMER_MAX_EVENTS];
+    
+    current_consumer = c->id;
+    
+    for (;;) {
+        int n = epoll_wait(c->epoll_fd, ready, CONSUMER_MAX_EVENTS, -1);
+        
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+        
+        for (int i = 0; i < n; i++) {
+            if (ready[i].data.u64 == CONSUMER_STOP_TOKEN) {
+                return NULL;
+            }
+            perf_buffer__consume_buffer(c->src->pb, ready[i].data.u64);
+        }
+        if (n > 0) {
+            counter_add(&c->wakeups, 1);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * 启动每 CPU 消费者线程
+ */
+int event_source_start_consumers(struct event_source *src, __u32 consumers) {
+    size_t buffers;
+    int *cpus;
+    int ncpus;
+    
+    if (!src->pb) {
+        fprintf(stderr, "Per-CPU consumers require the perf buffer transport\n");
+        return -EOPNOTSUPP;
+    }
+    if (src->consumers || consumers == 0) {
+        return -EINVAL;
+    }
+    
+    buffers = perf_buffer__buffer_cnt(src->pb);
+    if (consumers > buffers) {
+        consumers = (__u32)buffers;
+    }
+    
+    /* 拿不到在线 CPU 列表时照常启动，只是不绑定 CPU */
+    cpus = calloc(buffers, sizeof(int));
+    ncpus = cpus ? read_online_cpus(cpus, (int)buffers) : -1;
+    if (ncpus != (int)buffers) {
+        fprintf(stderr, "Warning: cannot map perf buffers to CPUs, consumers will not be pinned\n");
+        ncpus = 0;
+    }
+    
+    src->consumers = calloc(consumers, sizeof(struct event_consumer));
+    src->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (!src->consumers || src->stop_fd < 0) {
+        fprintf(stderr, "Failed to allocate event consumers\n");
+        goto err;
+    }
+    
+    for (__u32 i = 0; i < consumers; i++) {
+        struct event_consumer *c = &src->consumers[i];
+        struct epoll_event ev = { .events = EPOLLIN };
+        pthread_attr_t attr;
+        cpu_set_t set;
+        int err;
+        
+        /* 缓冲区尽量均分，每个线程负责一组相邻的 CPU */
+        c->src = src;
+        c->id = (int)i;
+        c->first = buffers * i / consumers;
+        c->count = buffers * (i + 1) / consumers - c->first;
+        c->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (c->epoll_fd < 0) {
+            perror("epoll_create1");
+            goto err;
+        }
+        
+        CPU_ZERO(&set);
+        for (size_t b = c->first; b < c->first + c->count; b++) {
+            ev.data.u64 = b;
+            if (epoll_ctl(c->epoll_fd, EPOLL_CTL_ADD, perf_buffer__buffer_fd(src->pb, b), &ev) < 0) {
+                perror("epoll_ctl");
+                close(c->epoll_fd);
+                goto err;
+            }
+            if (ncpus > 0) {
+                CPU_SET(cpus[b], &set);
+            }
+        }
+        ev.data.u64 = CONSUMER_STOP_TOKEN;
+        if (epoll_ctl(c->epoll_fd, EPOLL_CTL_ADD, src->stop_fd, &ev) < 0) {
+            perror("epoll_ctl");
+            close(c->epoll_fd);
+            goto err;
+        }
+        
+        /* 线程一启动就运行在目标 CPU 上，事件数据和下游状态都留在该 CPU 的缓存中 */
+        pthread_attr_init(&attr);
+        if (ncpus > 0) {
+            pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        }
+        err = pthread_create(&c->thread, &attr, consumer_main, c);
+        pthread_attr_destroy(&attr);
+        if (err) {
+            fprintf(stderr, "Failed to start event consumer %u: %s\n", i, strerror(err));
+            close(c->epoll_fd);
+            goto err;
+        }
+        src->consumer_count++;
+    }
+    
+    free(cpus);
+    printf("Started %u event consumers for %zu perf buffers%s\n",
+           src->consumer_count, buffers, ncpus > 0 ? " (pinned)" : "");
+    return (int)src->consumer_count;
+    
+err:
+    free(cpus);
+    event_source_stop_consumers(src);
+    return -1;
+}
+
+/**
+ * 停止每 CPU 消费者线程
+ */
+void event_source_stop_consumers(struct event_source *src) {
+    __u64 one = 1;
+    
+    if (!src || !src->consumers) {
+        return;
+    }
+    
+    if (src->stop_fd >= 0 && write(src->stop_fd, &one, sizeof(one)) != sizeof(one)) {
+        perror("write");
+    }
+    for (__u32 i = 0; i < src->consumer_count; i++) {
+        pthread_join(src->consumers[i].thread, NULL);
+        close(src->consumers[i].epoll_fd);
+    }
+    
+    /* 把消费者线程的唤醒次数并入事件源，再释放线程状态 */
+    for (__u32 i = 0; i < src->consumer_count; i++) {
+        src->stats.wakeups += src->consumers[i].wakeups;
+    }
+    free(src->consumers);
+    src->consumers = NULL;
+    src->consumer_count = 0;
+    if (src->stop_fd >= 0) {
+        close(src->stop_fd);
+        src->stop_fd = -1;
+    }
+}
+
+/**
+ * 获取当前线程对应的消费者编号
+ */
+int event_source_consumer_id(void) {
+    return current_consumer;
+}
+
+/**
+ * 获取传输方式名称
+ */
+const char *event_transport_name(enum event_transport transport) {
+    switch (transport) {
+        case EVENT_TRANSPORT_AUTO:
+            return "auto";
+        case EVENT_TRANSPORT_RINGBUF:
+            return "ringbuf";
+        case EVENT_TRANSPORT_PERFBUF:
+            return "perfbuf";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * 释放事件源
+ */
+void event_source_free(struct event_source *src) {
+    if (!src) {
+        return;
+    }
+    
+    event_source_stop_consumers(src);
+    if (src->rb) {
+        ring_buffer__free(src->rb);
+    }
+    if (src->pb) {
+        perf_buffer__free(src->pb);
+    }
+    free(src->cpu_stats);
+    free(src);
+}
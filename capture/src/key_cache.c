@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "key_cache.h"
+
+/* 一个槽位，值紧跟在结构体之后 */
+struct key_cache_slot {
+    __u32 hash;             /* 0 表示空槽位 */
+    __u32 key_len;
+    __u64 expires_ns;
+    __u64 last_used_ns;
+    __u8 key[KEY_CACHE_MAX_KEY];
+    __u8 value[];
+};
+
+/* 一组槽位的锁，独占一个缓存行，避免相邻组的锁互相干扰 */
+struct key_cache_group {
+    pthread_mutex_t lock;
+} __attribute__((aligned(64)));
+
+struct key_cache {
+    __u8 *slots;
+    struct key_cache_group *groups;
+    __u32 group_count;      /* 2 的幂 */
+    __u32 slot_size;
+    __u32 value_size;
+    __u64 ttl_ns;
+
+    __u64 entries;
+    __u64 hits;
+    __u64 misses;
+    __u64 expired;
+    __u64 insertions;
+    __u64 evictions;
+    __u64 invalidations;
+};
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* FNV-1a，结果不为 0（0 标记空槽位） */
+static __u32 hash_key(const void *key, __u32 len) {
+    const __u8 *p = key;
+    __u32 h = 2166136261u;
+
+    for (__u32 i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h ? h : 1;
+}
+
+static struct key_cache_slot *get_slot(struct key_cache *cache, __u32 group, __u32 way) {
+    return (struct key_cache_slot *)(cache->slots +
+                                     ((size_t)group * KEY_CACHE_WAYS + way) * cache->slot_size);
+}
+
+/**
+ * 在组内查找 key（持组锁调用），从哈希决定的位置开始线性探测
+ */
+static struct key_cache_slot *find_slot(struct key_cache *cache, __u32 group, __u32 hash,
+                                        const void *key, __u32 key_len) {
+    __u32 start = (hash >> 24) % KEY_CACHE_WAYS;
+
+    for (__u32 i = 0; i < KEY_CACHE_WAYS; i++) {
+        struct key_cache_slot *slot = get_slot(cache, group, (start + i) % KEY_CACHE_WAYS);
+
+        if (slot->hash == hash && slot->key_len == key_len &&
+            memcmp(slot->key, key, key_len) == 0) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+static void stat_add(__u64 *counter, __s64 value) {
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * 创建缓存
+ */
+struct key_cache *key_cache_new(__u32 capacity, __u32 value_size, __u64 ttl_ns) {
+    struct key_cache *cache;
+    __u32 slots = KEY_CACHE_WAYS;
+
+    if (capacity == 0 || capacity > (1U << 24) || value_size == 0) {
+        return NULL;
+    }
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+
+    cache = calloc(1, sizeof(*cache));
+    if (!cache) {
+        return NULL;
+    }
+    cache->group_count = slots / KEY_CACHE_WAYS;
+    cache->value_size = value_size;
+    cache->slot_size = (sizeof(struct key_cache_slot) + value_size + 7) & ~7U;
+    cache->ttl_ns = ttl_ns;
+
+    cache->slots = calloc(slots, cache->slot_size);
+    if (posix_memalign((void **)&cache->groups, 64,
+                       cache->group_count * sizeof(*cache->groups)) != 0) {
+        cache->groups = NULL;
+    }
+    if (!cache->slots || !cache->groups) {
+        free(cache->slots);
+        free(cache->groups);
+        free(cache);
+        return NULL;
+    }
+    for (__u32 i = 0; i < cache->group_count; i++) {
+        pthread_mutex_init(&cache->groups[i].lock, NULL);
+    }
+    return cache;
+}
+
+/**
+ * 查询 key
+ */
+int key_cache_lookup(struct key_cache *cache, const void *key, __u32 key_len, void *value) {
+    struct key_cache_slot *slot;
+    __u32 hash, group;
+    __u64 now;
+    int ret = KEY_CACHE_MISS;
+
+    if (!cache || !key || key_len == 0 || key_len > KEY_CACHE_MAX_KEY) {
+        return KEY_CACHE_MISS;
+    }
+    hash = hash_key(key, key_len);
+    group = hash & (cache->group_count - 1);
+    now = now_ns();
+
+    pthread_mutex_lock(&cache->groups[group].lock);
+    slot = find_slot(cache, group, hash, key, key_len);
+    if (slot && now < slot->expires_ns) {
+        slot->last_used_ns = now;
+        memcpy(value, slot->value, cache->value_size);
+        ret = KEY_CACHE_HIT;
+    } else if (slot) {
+        ret = KEY_CACHE_EXPIRED;
+    }
+    pthread_mutex_unlock(&cache->groups[group].lock);
+
+    stat_add(ret == KEY_CACHE_HIT ? &cache->hits :
+             ret == KEY_CACHE_EXPIRED ? &cache->expired : &cache->misses, 1);
+    return ret;
+}
+
+/**
+ * 查询 key，不计入统计也不刷新 LRU 位置
+ */
+int key_cache_peek(struct key_cache *cache, const void *key, __u32 key_len, void *value) {
+    struct key_cache_slot *slot;
+    __u32 hash, group;
+    int ret = KEY_CACHE_MISS;
+
+    if (!cache || !key || key_len == 0 || key_len > KEY_CACHE_MAX_KEY) {
+        return KEY_CACHE_MISS;
+    }
+    hash = hash_key(key, key_len);
+    group = hash & (cache->group_count - 1);
+
+    pthread_mutex_lock(&cache->groups[group].lock);
+    slot = find_slot(cache, group, hash, key, key_len);
+    if (slot && now_ns() < slot->expires_ns) {
+        memcpy(value, slot->value, cache->value_size);
+        ret = KEY_CACHE_HIT;
+    }
+    pthread_mutex_unlock(&cache->groups[group].lock);
+    return ret;
+}
+
+/**
+ * 条目自上次插入以来是否被命中过
+ */
+int key_cache_touched(struct key_cache *cache, const void *key, __u32 key_len) {
+    struct key_cache_slot *slot;
+    __u32 hash, group;
+    int touched = 0;
+
+    if (!cache || !key || key_len == 0 || key_len > KEY_CACHE_MAX_KEY) {
+        return 0;
+    }
+    hash = hash_key(key, key_len);
+    group = hash & (cache->group_count - 1);
+
+    pthread_mutex_lock(&cache->groups[group].lock);
+    slot = find_slot(cache, group, hash, key, key_len);
+    if (slot && now_ns() < slot->expires_ns) {
+        /* 插入时 last_used = expires - ttl，之后的命中会把它推后 */
+        touched = slot->last_used_ns > slot->expires_ns - cache->ttl_ns;
+    }
+    pthread_mutex_unlock(&cache->groups[group].lock);
+    return touched;
+}
+
+/**
+ * 为 key 选定槽位（调用方持有组锁），slot 为 find_slot 的结果
+ * 选择顺序：同一 key 的槽位、空槽位、最早过期的过期槽位、最久未使用的槽位
+ */
+static struct key_cache_slot *claim_slot(struct key_cache *cache, struct key_cache_slot *slot,
+                                         __u32 group, __u32 hash, const void *key,
+                                         __u32 key_len, __u64 now) {
+    struct key_cache_slot *victim = NULL;
+    __u32 start = (hash >> 24) % KEY_CACHE_WAYS;
+
+    if (!slot) {
+        for (__u32 i = 0; i < KEY_CACHE_WAYS; i++) {
+            struct key_cache_slot *s = get_slot(cache, group, (start + i) % KEY_CACHE_WAYS);
+
+            if (s->hash == 0) {
+                victim = s;
+                break;
+            }
+            if (!victim ||
+                (s->expires_ns <= now && (victim->expires_ns > now ||
+                                          s->expires_ns < victim->expires_ns)) ||
+                (s->expires_ns > now && victim->expires_ns > now &&
+                 s->last_used_ns < victim->last_used_ns)) {
+                victim = s;
+            }
+        }
+        if (victim->hash == 0) {
+            stat_add(&cache->entries, 1);
+        } else if (victim->expires_ns > now) {
+            stat_add(&cache->evictions, 1);
+        }
+        slot = victim;
+        slot->hash = hash;
+        slot->key_len = key_len;
+        memcpy(slot->key, key, key_len);
+    }
+    slot->expires_ns = now + cache->ttl_ns;
+    slot->last_used_ns = now;
+    return slot;
+}
+
+/**
+ * 插入或覆盖 key 对应的条目
+ */
+void key_cache_insert(struct key_cache *cache, const void *key, __u32 key_len, const void *value) {
+    struct key_cache_slot *slot;
+    __u32 hash, group;
+
+    if (!cache || !key || key_len == 0 || key_len > KEY_CACHE_MAX_KEY || !value) {
+        return;
+    }
+    hash = hash_key(key, key_len);
+    group = hash & (cache->group_count - 1);
+
+    pthread_mutex_lock(&cache->groups[group].lock);
+    slot = find_slot(cache, group, hash, key, key_len);
+    slot = claim_slot(cache, slot, group, hash, key, key_len, now_ns());
+    memcpy(slot->value, value, cache->value_size);
+    pthread_mutex_unlock(&cache->groups[group].lock);
+
+    stat_add(&cache->insertions, 1);
+}
+
+/**
+ * 在组锁内读出、修改并写回 key 对应的条目
+ */
+void key_cache_update(struct key_cache *cache, const void *key, __u32 key_len,
+                      key_cache_update_fn fn, void *arg) {
+    struct key_cache_slot *slot;
+    __u32 hash, group;
+    __u64 now;
+    int found;
+
+    if (!cache || !key || key_len == 0 || key_len > KEY_CACHE_MAX_KEY || !fn) {
+        return;
+    }
+    hash = hash_key(key, key_len);
+    group = hash & (cache->group_count - 1);
+    now = now_ns();
+
+    pthread_mutex_lock(&cache->groups[group].lock);
+    slot = find_slot(cache, group, hash, key, key_len);
+    found = slot && now < slot->expires_ns;
+    slot = claim_slot(cache, slot, group, hash, key, key_len, now);
+    if (!found) {
+        memset(slot->value, 0, cache->value_size);
+    }
+    fn(slot->value, found, arg);
+    pthread_mutex_unlock(&cache->groups[group].lock);
+
+    stat_add(&cache->insertions, 1);
+}
+
+/**
+ * 删除 key 对应的条目
+ */
+void key_cache_invalidate(struct key_cache *cache, const void *key, __u32 key_len) {
+    struct key_cache_slot *slot;
+    __u32 hash, group;
+
+    if (!cache || !key || key_len == 0 || key_len > KEY_CACHE_MAX_KEY) {
+        return;
+    }
+    hash = hash_key(key, key_len);
+    group = hash & (cache->group_count - 1);
+
+    pthread_mutex_lock(&cache->groups[group].lock);
+    slot = find_slot(cache, group, hash, key, key_len);
+    if (slot) {
+        slot->hash = 0;
+        slot->key_len = 0;
+        stat_add(&cache->entries, -1);
+        stat_add(&cache->invalidations, 1);
+    }
+    pthread_mutex_unlock(&cache->groups[group].lock);
+}
+
+/**
+ * 获取缓存统计
+ */
+void key_cache_get_stats(struct key_cache *cache, struct key_cache_stats *stats) {
+    if (!cache || !stats) {
+        return;
+    }
+
+    stats->capacity = (__u64)cache->group_count * KEY_CACHE_WAYS;
+    stats->entries = __atomic_load_n(&cache->entries, __ATOMIC_RELAXED);
+    stats->hits = __atomic_load_n(&cache->hits, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&cache->misses, __ATOMIC_RELAXED);
+    stats->expired = __atomic_load_n(&cache->expired, __ATOMIC_RELAXED);
+    stats->insertions = __atomic_load_n(&cache->insertions, __ATOMIC_RELAXED);
+    stats->evictions = __atomic_load_n(&cache->evictions, __ATOMIC_RELAXED);
+    stats->invalidations = __atomic_load_n(&cache->invalidations, __ATOMIC_RELAXED);
+}
+
+/**
+ * 释放缓存
+ */
+void key_cache_free(struct key_cache *cache) {
+    if (!cache) {
+        return;
+    }
+
+    for (__u32 i = 0; i < cache->group_count; i++) {
+        pthread_mutex_destroy(&cache->groups[i].lock);
+    }
+    free(cache->groups);
+    free(cache->slots);
+    free(cache);
+}
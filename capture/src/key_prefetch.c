@@ -0,0 +1,491 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "key_prefetch.h"
+
+/* 每组槽位数 */
+#define PREFETCH_WAYS 8
+
+/* 预取的密钥尚未被前台请求使用 */
+#define SLOT_F_PREFETCHED 0x1
+
+/* 频率降到阈值的 1/16 以下且没有待确认的预取时，条目从表中移除 */
+#define STALE_DIVISOR 16.0
+
+/* 预取白白过期一次，频率减半：再次使用前密钥总会过期的 Pod 对很快跌出预取范围 */
+#define WASTED_PENALTY 0.5
+
+/* 一个槽位，数据紧跟在结构体之后 */
+struct prefetch_slot {
+    __u32 hash;             /* 0 表示空槽位 */
+    __u32 key_len;
+    __u64 updated_ns;       /* score 对应的时间 */
+    double score;
+    __u32 flags;
+    __u8 key[KEY_PREFETCH_MAX_KEY];
+    __u8 data[];
+};
+
+/* 待预取的 Pod 对，数据紧跟在结构体之后 */
+struct prefetch_candidate {
+    double score;
+    __u32 key_len;
+    __u8 key[KEY_PREFETCH_MAX_KEY];
+    __u8 data[];
+};
+
+struct prefetch_group {
+    pthread_mutex_t lock;
+} __attribute__((aligned(64)));
+
+struct key_prefetch {
+    __u8 *slots;
+    struct prefetch_group *groups;
+    __u32 group_count;      /* 2 的幂 */
+    __u32 slot_size;
+    __u8 *candidates;
+    __u32 candidate_size;
+    __u32 max_candidates;   /* 令牌桶容量 */
+    struct key_prefetch_config config;
+    struct key_prefetch_ops ops;
+    void *arg;
+    double half_life_ns;
+    double tokens;
+    __u64 last_cycle_ns;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* 使用 CLOCK_MONOTONIC */
+    int stop;
+    int started;
+
+    struct key_prefetch_stats stats;
+};
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* FNV-1a，结果不为 0（0 标记空槽位） */
+static __u32 hash_key(const void *key, __u32 len) {
+    const __u8 *p = key;
+    __u32 h = 2166136261u;
+
+    for (__u32 i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h ? h : 1;
+}
+
+static void stat_add(__u64 *counter, __s64 value) {
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+static struct prefetch_slot *get_slot(struct key_prefetch *prefetch, __u32 group, __u32 way) {
+    return (struct prefetch_slot *)(prefetch->slots +
+                                    ((size_t)group * PREFETCH_WAYS + way) * prefetch->slot_size);
+}
+
+static struct prefetch_candidate *get_candidate(struct key_prefetch *prefetch, __u32 index) {
+    return (struct prefetch_candidate *)(prefetch->candidates +
+                                         (size_t)index * prefetch->candidate_size);
+}
+
+/* 衰减到 now 的频率 */
+static double current_score(struct key_prefetch *prefetch, const struct prefetch_slot *slot,
+                            __u64 now) {
+    if (now <= slot->updated_ns) {
+        return slot->score;
+    }
+    return slot->score * exp2(-(double)(now - slot->updated_ns) / prefetch->half_life_ns);
+}
+
+/**
+ * 在组内查找 key（持组锁调用）
+ */
+static struct prefetch_slot *find_slot(struct key_prefetch *prefetch, __u32 group, __u32 hash,
+                                       const void *key, __u32 key_len) {
+    for (__u32 i = 0; i < PREFETCH_WAYS; i++) {
+        struct prefetch_slot *slot = get_slot(prefetch, group, i);
+
+        if (slot->hash == hash && slot->key_len == key_len &&
+            memcmp(slot->key, key, key_len) == 0) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * 查找 key，不存在时占用空槽位或替换组内频率最低的条目（持组锁调用）
+ */
+static struct prefetch_slot *get_or_insert(struct key_prefetch *prefetch, __u32 group, __u32 hash,
+                                           const void *key, __u32 key_len, __u64 now) {
+    struct prefetch_slot *slot = find_slot(prefetch, group, hash, key, key_len);
+    double lowest = 0;
+
+    if (slot) {
+        return slot;
+    }
+    for (__u32 i = 0; i < PREFETCH_WAYS; i++) {
+        struct prefetch_slot *s = get_slot(prefetch, group, i);
+        double score;
+
+        if (s->hash == 0) {
+            slot = s;
+            break;
+        }
+        score = current_score(prefetch, s, now);
+        if (!slot || score < lowest) {
+            slot = s;
+            lowest = score;
+        }
+    }
+
+    if (slot->hash == 0) {
+        stat_add(&prefetch->stats.tracked, 1);
+    } else if (slot->flags & SLOT_F_PREFETCHED) {
+        stat_add(&prefetch->stats.wasted, 1);
+    }
+    memset(slot, 0, prefetch->slot_size);
+    slot->hash = hash;
+    slot->key_len = key_len;
+    slot->updated_ns = now;
+    memcpy(slot->key, key, key_len);
+    return slot;
+}
+
+/**
+ * 记录一次前台请求
+ */
+void key_prefetch_observe(struct key_prefetch *prefetch, const void *key, __u32 key_len,
+                          const void *data, int cache_hit) {
+    struct prefetch_slot *slot;
+    __u32 hash, group;
+    __u64 now;
+
+    if (!prefetch || !key || key_len == 0 || key_len > KEY_PREFETCH_MAX_KEY) {
+        return;
+    }
+    hash = hash_key(key, key_len);
+    group = hash & (prefetch->group_count - 1);
+    now = now_ns();
+
+    pthread_mutex_lock(&prefetch->groups[group].lock);
+    slot = get_or_insert(prefetch, group, hash, key, key_len, now);
+    slot->score = current_score(prefetch, slot, now);
+    slot->updated_ns = now;
+    memcpy(slot->data, data, prefetch->config.data_size);
+    if (slot->flags & SLOT_F_PREFETCHED) {
+        /* 第一次使用预取的 Pod 对：密钥还在即为命中，否则已经白白过期 */
+        stat_add(cache_hit ? &prefetch->stats.hits : &prefetch->stats.wasted, 1);
+        if (!cache_hit) {
+            slot->score *= WASTED_PENALTY;
+        }
+        slot->flags &= ~SLOT_F_PREFETCHED;
+    }
+    slot->score += 1.0;
+    pthread_mutex_unlock(&prefetch->groups[group].lock);
+}
+
+/**
+ * 预置一个 Pod 对
+ */
+int key_prefetch_seed(struct key_prefetch *prefetch, const void *key, __u32 key_len,
+                      const void *data, double score) {
+    struct prefetch_slot *slot;
+    __u32 hash, group;
+    __u64 now;
+
+    if (!prefetch || !key || key_len == 0 || key_len > KEY_PREFETCH_MAX_KEY || !data) {
+        return -1;
+    }
+    hash = hash_key(key, key_len);
+    group = hash & (prefetch->group_count - 1);
+    now = now_ns();
+
+    pthread_mutex_lock(&prefetch->groups[group].lock);
+    slot = get_or_insert(prefetch, group, hash, key, key_len, now);
+    if (current_score(prefetch, slot, now) < score) {
+        slot->score = score;
+        slot->updated_ns = now;
+    }
+    memcpy(slot->data, data, prefetch->config.data_size);
+    pthread_mutex_unlock(&prefetch->groups[group].lock);
+
+    stat_add(&prefetch->stats.seeded, 1);
+    return 0;
+}
+
+/**
+ * 把 slot 加入候选（保留频率最高的 limit 个），返回候选数
+ */
+static __u32 add_candidate(struct key_prefetch *prefetch, __u32 count, __u32 limit,
+                           const struct prefetch_slot *slot, double score) {
+    struct prefetch_candidate *c;
+    __u32 index = count;
+
+    if (count == limit) {
+        /* 已满：替换频率最低的候选 */
+        index = 0;
+        for (__u32 i = 1; i < count; i++) {
+            if (get_candidate(prefetch, i)->score < get_candidate(prefetch, index)->score) {
+                index = i;
+            }
+        }
+        if (get_candidate(prefetch, index)->score >= score) {
+            return count;
+        }
+    } else {
+        count++;
+    }
+
+    c = get_candidate(prefetch, index);
+    c->score = score;
+    c->key_len = slot->key_len;
+    memcpy(c->key, slot->key, slot->key_len);
+    memcpy(c->data, slot->data, prefetch->config.data_size);
+    return count;
+}
+
+static int compare_candidates(const void *a, const void *b) {
+    double sa = ((const struct prefetch_candidate *)a)->score;
+    double sb = ((const struct prefetch_candidate *)b)->score;
+
+    return sa < sb ? 1 : sa > sb ? -1 : 0;
+}
+
+/**
+ * 一个预取周期：补充令牌，扫描频率表挑出候选，空闲时按频率从高到低预取
+ */
+static void prefetch_cycle(struct key_prefetch *prefetch) {
+    __u64 now = now_ns();
+    __u32 limit, count = 0, eligible = 0;
+
+    prefetch->tokens += (double)prefetch->config.rate * (now - prefetch->last_cycle_ns) / 1e9;
+    if (prefetch->tokens > prefetch->max_candidates) {
+        prefetch->tokens = prefetch->max_candidates;
+    }
+    prefetch->last_cycle_ns = now;
+    if (prefetch->tokens < 1.0) {
+        return;
+    }
+    if (prefetch->ops.busy && prefetch->ops.busy(prefetch->arg)) {
+        stat_add(&prefetch->stats.busy, 1);
+        return;
+    }
+    limit = (__u32)prefetch->tokens;
+
+    for (__u32 g = 0; g < prefetch->group_count; g++) {
+        pthread_mutex_lock(&prefetch->groups[g].lock);
+        for (__u32 i = 0; i < PREFETCH_WAYS; i++) {
+            struct prefetch_slot *slot = get_slot(prefetch, g, i);
+            double score;
+            int cached;
+
+            if (slot->hash == 0) {
+                continue;
+            }
+            score = current_score(prefetch, slot, now);
+            cached = prefetch->ops.cached(prefetch->arg, slot->key, slot->key_len);
+            if ((slot->flags & SLOT_F_PREFETCHED) && !cached) {
+                /* 预取的密钥没等到前台请求就过期了 */
+                stat_add(&prefetch->stats.wasted, 1);
+                slot->flags &= ~SLOT_F_PREFETCHED;
+                score *= WASTED_PENALTY;
+                slot->score = score;
+                slot->updated_ns = now;
+            }
+            if (score < prefetch->config.min_score / STALE_DIVISOR &&
+                !(slot->flags & SLOT_F_PREFETCHED)) {
+                slot->hash = 0;
+                stat_add(&prefetch->stats.tracked, -1);
+                continue;
+            }
+            if (cached || score < prefetch->config.min_score) {
+                continue;
+            }
+            eligible++;
+            count = add_candidate(prefetch, count, limit, slot, score);
+        }
+        pthread_mutex_unlock(&prefetch->groups[g].lock);
+    }
+    if (eligible > count) {
+        stat_add(&prefetch->stats.throttled, eligible - count);
+    }
+
+    qsort(prefetch->candidates, count, prefetch->candidate_size, compare_candidates);
+    for (__u32 i = 0; i < count && !__atomic_load_n(&prefetch->stop, __ATOMIC_RELAXED); i++) {
+        struct prefetch_candidate *c = get_candidate(prefetch, i);
+        __u32 hash, group;
+        struct prefetch_slot *slot;
+
+        if (i > 0 && prefetch->ops.busy && prefetch->ops.busy(prefetch->arg)) {
+            stat_add(&prefetch->stats.busy, 1);
+            break;
+        }
+        prefetch->tokens -= 1.0;
+        if (prefetch->ops.prefetch(prefetch->arg, c->key, c->key_len, c->data) < 0) {
+            stat_add(&prefetch->stats.failures, 1);
+            continue;
+        }
+        stat_add(&prefetch->stats.prefetched, 1);
+
+        hash = hash_key(c->key, c->key_len);
+        group = hash & (prefetch->group_count - 1);
+        pthread_mutex_lock(&prefetch->groups[group].lock);
+        slot = find_slot(prefetch, group, hash, c->key, c->key_len);
+        if (slot) {
+            slot->flags |= SLOT_F_PREFETCHED;
+        }
+        pthread_mutex_unlock(&prefetch->groups[group].lock);
+    }
+}
+
+/**
+ * 预取线程：每个周期执行一次 prefetch_cycle
+ */
+static void *prefetch_thread(void *arg) {
+    struct key_prefetch *prefetch = arg;
+    __u64 interval_ns = (__u64)prefetch->config.interval_ms * 1000000ULL;
+
+    pthread_mutex_lock(&prefetch->lock);
+    while (!prefetch->stop) {
+        __u64 wake = now_ns() + interval_ns;
+        struct timespec ts = {
+            .tv_sec = wake / 1000000000ULL,
+            .tv_nsec = wake % 1000000000ULL,
+        };
+
+        pthread_cond_timedwait(&prefetch->cond, &prefetch->lock, &ts);
+        if (prefetch->stop) {
+            break;
+        }
+        pthread_mutex_unlock(&prefetch->lock);
+        prefetch_cycle(prefetch);
+        pthread_mutex_lock(&prefetch->lock);
+    }
+    pthread_mutex_unlock(&prefetch->lock);
+
+    if (prefetch->ops.thread_exit) {
+        prefetch->ops.thread_exit(prefetch->arg);
+    }
+    return NULL;
+}
+
+/**
+ * 创建预取器并启动预取线程
+ */
+struct key_prefetch *key_prefetch_new(const struct key_prefetch_config *config,
+                                      const struct key_prefetch_ops *ops, void *arg) {
+    struct key_prefetch *prefetch;
+    pthread_condattr_t attr;
+    __u32 slots = PREFETCH_WAYS;
+
+    if (!config || !ops || !ops->cached || !ops->prefetch || config->capacity == 0 ||
+        config->capacity > (1U << 24) || config->rate == 0 || config->half_life_ms == 0) {
+        return NULL;
+    }
+    while (slots < config->capacity) {
+        slots <<= 1;
+    }
+
+    prefetch = calloc(1, sizeof(*prefetch));
+    if (!prefetch) {
+        return NULL;
+    }
+    prefetch->config = *config;
+    if (prefetch->config.interval_ms == 0) {
+        prefetch->config.interval_ms = KEY_PREFETCH_DEFAULT_INTERVAL_MS;
+    }
+    prefetch->ops = *ops;
+    prefetch->arg = arg;
+    prefetch->group_count = slots / PREFETCH_WAYS;
+    prefetch->slot_size = (sizeof(struct prefetch_slot) + config->data_size + 7) & ~7U;
+    prefetch->candidate_size = (sizeof(struct prefetch_candidate) + config->data_size + 7) & ~7U;
+    prefetch->max_candidates = config->rate;
+    prefetch->half_life_ns = (double)config->half_life_ms * 1e6;
+    prefetch->last_cycle_ns = now_ns();
+
+    prefetch->slots = calloc(slots, prefetch->slot_size);
+    prefetch->candidates = calloc(prefetch->max_candidates, prefetch->candidate_size);
+    if (posix_memalign((void **)&prefetch->groups, 64,
+                       prefetch->group_count * sizeof(*prefetch->groups)) != 0) {
+        prefetch->groups = NULL;
+    }
+    if (!prefetch->slots || !prefetch->candidates || !prefetch->groups) {
+        free(prefetch->slots);
+        free(prefetch->candidates);
+        free(prefetch->groups);
+        free(prefetch);
+        return NULL;
+    }
+    for (__u32 i = 0; i < prefetch->group_count; i++) {
+        pthread_mutex_init(&prefetch->groups[i].lock, NULL);
+    }
+
+    pthread_mutex_init(&prefetch->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&prefetch->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&prefetch->thread, NULL, prefetch_thread, prefetch) != 0) {
+        fprintf(stderr, "Failed to start key prefetch thread\n");
+        key_prefetch_free(prefetch);
+        return NULL;
+    }
+    prefetch->started = 1;
+    return prefetch;
+}
+
+/**
+ * 获取预取统计
+ */
+void key_prefetch_get_stats(struct key_prefetch *prefetch, struct key_prefetch_stats *stats) {
+    if (!prefetch || !stats) {
+        return;
+    }
+
+    stats->tracked = __atomic_load_n(&prefetch->stats.tracked, __ATOMIC_RELAXED);
+    stats->seeded = __atomic_load_n(&prefetch->stats.seeded, __ATOMIC_RELAXED);
+    stats->prefetched = __atomic_load_n(&prefetch->stats.prefetched, __ATOMIC_RELAXED);
+    stats->failures = __atomic_load_n(&prefetch->stats.failures, __ATOMIC_RELAXED);
+    stats->hits = __atomic_load_n(&prefetch->stats.hits, __ATOMIC_RELAXED);
+    stats->wasted = __atomic_load_n(&prefetch->stats.wasted, __ATOMIC_RELAXED);
+    stats->busy = __atomic_load_n(&prefetch->stats.busy, __ATOMIC_RELAXED);
+    stats->throttled = __atomic_load_n(&prefetch->stats.throttled, __ATOMIC_RELAXED);
+}
+
+/**
+ * 停止预取线程并释放预取器
+ */
+void key_prefetch_free(struct key_prefetch *prefetch) {
+    if (!prefetch) {
+        return;
+    }
+
+    if (prefetch->started) {
+        pthread_mutex_lock(&prefetch->lock);
+        __atomic_store_n(&prefetch->stop, 1, __ATOMIC_RELAXED);
+        pthread_cond_broadcast(&prefetch->cond);
+        pthread_mutex_unlock(&prefetch->lock);
+        pthread_join(prefetch->thread, NULL);
+    }
+
+    for (__u32 i = 0; i < prefetch->group_count; i++) {
+        pthread_mutex_destroy(&prefetch->groups[i].lock);
+    }
+    pthread_cond_destroy(&prefetch->cond);
+    pthread_mutex_destroy(&prefetch->lock);
+    free(prefetch->groups);
+    free(prefetch->candidates);
+    free(prefetch->slots);
+    free(prefetch);
+}
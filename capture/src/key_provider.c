@@ -1,14 +1,159 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include "key_provider.h"
 #include "tlshub_client.h"
+#include "singleflight.h"
+#include "key_cache.h"
+#include "key_refresh.h"
+#include "key_prefetch.h"
+#include "circuit_breaker.h"
+#include "log.h"
 
 static enum key_provider_mode current_mode = MODE_TLSHUB;
 static SSL_CTX *ssl_ctx = NULL;
 
+/*
+ * 进行中的 TLSHub 协商按 Pod 对（或四元组）合并：
+ * 同一对 Pod 同时建立的多个连接只发起一次 fetch/handshake，其余请求等待并复用结果
+ */
+static enum key_coalesce coalesce_mode = KEY_COALESCE_POD;
+static struct singleflight *inflight_keys = NULL;
+static __u64 key_requests = 0;
+static __u64 key_negotiations = 0;
+static __u64 key_coalesced = 0;
+static __u64 tlshub_expired = 0;
+
+/*
+ * 协商结果缓存，按合并粒度（Pod 对或四元组）索引，条目在 key_cache_ttl_ms 后过期。
+ * 命中时不经过 singleflight；过期或 TLSHub 报告密钥过期时，由合并后的唯一一次协商刷新
+ */
+static struct key_cache *key_cache = NULL;
+static __u32 key_cache_capacity = 0;
+static __u32 key_cache_ttl_ms = 0;
+
+/*
+ * 后台刷新：被使用过的缓存密钥在过期前 lead（再加随机抖动）由刷新线程重新协商，
+ * 前台连接不再承担过期后的握手；闲置的条目不刷新，到期后自然淘汰
+ */
+static struct key_refresh *key_refresher = NULL;
+static __u32 key_refresh_lead_ms = 0;
+static __u32 key_refresh_jitter_ms = 0;
+static __u32 key_refresh_threads = 0;
+
+/*
+ * 预取：按前台请求学习 Pod 对的连接频率，空闲时在预算内为常用而当前没有缓存密钥的 Pod 对预先协商
+ */
+static struct key_prefetch *key_prefetcher = NULL;
+static __u32 key_prefetch_rate = 0;
+static double key_prefetch_min_score = 0;
+static __u32 key_prefetch_half_life_ms = 0;
+
+/* MODE_STUB 每次协商的模拟耗时 */
+static __u32 stub_latency_us = 0;
+
+/* TLSHub 单 socket 流水线深度，0 表示使用每线程 socket */
+static __u32 tlshub_pipeline_depth = 0;
+
+/* TLSHub 批量请求：每条消息最多的请求数（小于 2 表示不合并）和最长等待时间 */
+static __u32 tlshub_batch_size = 0;
+static __u32 tlshub_batch_delay_us = 0;
+
+/* 与 TLSHub 之间的传输，mock 传输使用进程内替身 */
+static enum tlshub_transport tlshub_transport = TLSHUB_TRANSPORT_NETLINK;
+static char tlshub_unix_path[108];
+static struct tlshub_standin_config tlshub_mock_config;
+
+/* TLSHub 请求的超时与重试策略 */
+static struct tlshub_retry_policy tlshub_retry = {
+    .timeout_ms = TLSHUB_DEFAULT_TIMEOUT_MS,
+    .retries = TLSHUB_DEFAULT_RETRIES,
+    .backoff_ms = TLSHUB_DEFAULT_BACKOFF_MS,
+    .backoff_max_ms = TLSHUB_DEFAULT_BACKOFF_MAX_MS,
+};
+
+/*
+ * TLSHub 熔断：协商的失败率或慢调用率过高时断开，之后的协商立即被拒绝，
+ * 请求改由后备提供者（fallback_mode，目前只支持 MODE_STUB；MODE_TLSHUB 表示不使用后备、直接失败）应答，
+ * 探测线程在后台用最近一次请求的四元组探测恢复
+ */
+static struct circuit_breaker *tlshub_breaker = NULL;
+static int tlshub_breaker_enabled = 1;
+static struct circuit_breaker_config tlshub_breaker_config = {
+    .window_ms = CIRCUIT_BREAKER_DEFAULT_WINDOW_MS,
+    .min_requests = CIRCUIT_BREAKER_DEFAULT_MIN_REQUESTS,
+    .failure_percent = CIRCUIT_BREAKER_DEFAULT_FAILURE_PERCENT,
+    .slow_ms = CIRCUIT_BREAKER_DEFAULT_SLOW_MS,
+    .slow_percent = CIRCUIT_BREAKER_DEFAULT_SLOW_PERCENT,
+    .open_ms = CIRCUIT_BREAKER_DEFAULT_OPEN_MS,
+    .half_open_requests = CIRCUIT_BREAKER_DEFAULT_HALF_OPEN_REQUESTS,
+};
+static enum key_provider_mode fallback_mode = MODE_TLSHUB;
+static __u64 fallback_requests = 0;
+
+/*
+ * 握手负缓存：TLSHub 对某个 Pod 对回复 HANDSHAKE_FAILED 后，在退避期内该 Pod 对的握手
+ * 直接在本地以失败应答，不再发往内核模块和对端节点。退避从 negative_backoff_ms 起，
+ * 每次连续失败加倍，不超过 negative_backoff_max_ms；握手成功即清除。
+ * 条目在 2 倍退避上限内没有新的失败时被遗忘，之后的失败重新从初始退避开始
+ */
+static struct key_cache *negative_cache = NULL;
+static __u32 negative_cache_capacity = 1024;
+static __u32 negative_backoff_ms = 1000;
+static __u32 negative_backoff_max_ms = 60000;
+static __u64 handshake_failures = 0;
+static __u64 handshakes_suppressed = 0;
+static __u64 handshakes_retried = 0;
+
+/* 负缓存条目 */
+struct negative_entry {
+    __u64 until_ns;         /* 退避结束时间 */
+    __u32 failures;         /* 连续失败次数 */
+    __u32 backoff_ms;       /* 当前退避 */
+};
+
+/* 负缓存按 Pod 对索引，与端口和本机角色无关 */
+struct negative_key {
+    __u32 saddr6[4];
+    __u32 daddr6[4];
+    __u32 family;
+};
+
+/* 合并用的请求标识，未使用的字段和填充字节均为 0 */
+struct key_flight_id {
+    __u32 saddr6[4];
+    __u32 daddr6[4];
+    __u16 sport;
+    __u16 dport;
+    __u16 family;
+    __u16 role;
+};
+
+/* singleflight 回调参数 */
+struct key_flight {
+    struct flow_tuple *tuple;
+    const struct key_flight_id *id;
+    int refresh;            /* 后台刷新：不复查缓存，失败时保留仍有效的条目 */
+};
+
+/* 创建协商结果缓存及其后台刷新和预取（未配置时不创建） */
+static int key_cache_setup(void);
+static int key_prefetch_setup(void);
+
+/* 创建 TLSHub 熔断器和后备提供者 */
+static int breaker_setup(void);
+
+/* 创建握手负缓存 */
+static int negative_cache_setup(void);
+
+/* 创建 OpenSSL/BoringSSL 使用的 SSL_CTX */
+static int ssl_setup(void);
+
 /* OpenSSL 密钥协商函数 */
 static int openssl_get_key(struct flow_tuple *tuple, struct tls_key_info *key_info);
 
@@ -24,22 +169,36 @@ int key_provider_init(enum key_provider_mode mode) {
     switch (mode) {
         case MODE_TLSHUB:
             printf("Initializing TLSHub key provider\n");
-            return tlshub_client_init();
+            inflight_keys = singleflight_new(sizeof(struct tls_key_info));
+            if (!inflight_keys || key_cache_setup() < 0 || negative_cache_setup() < 0) {
+                fprintf(stderr, "Failed to create key request table\n");
+                return -1;
+            }
+            tlshub_client_set_retry_policy(&tlshub_retry);
+            if (tlshub_client_set_transport(tlshub_transport, tlshub_unix_path,
+                                            &tlshub_mock_config) < 0 ||
+                tlshub_client_init() < 0) {
+                return -1;
+            }
+            if (tlshub_pipeline_depth > 0 &&
+                tlshub_client_enable_pipeline(tlshub_pipeline_depth) < 0) {
+                fprintf(stderr, "Failed to enable TLSHub pipeline, using per-thread sockets\n");
+            }
+            if (tlshub_batch_size > 1 &&
+                tlshub_client_enable_batching(tlshub_batch_size, tlshub_batch_delay_us) < 0) {
+                fprintf(stderr, "Failed to enable TLSHub batching, sending requests one by one\n");
+            }
+            return breaker_setup();
             
         case MODE_OPENSSL:
             printf("Initializing OpenSSL key provider\n");
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-            /* OpenSSL 1.1.0+ */
-            OPENSSL_init_ssl(OPENSSL_INIT_LOAD_SSL_STRINGS | OPENSSL_INIT_LOAD_CRYPTO_STRINGS, NULL);
-#else
-            /* OpenSSL 1.0.x */
-            SSL_library_init();
-            SSL_load_error_strings();
-            OpenSSL_add_all_algorithms();
-#endif
-            ssl_ctx = SSL_CTX_new(TLS_method());
-            if (!ssl_ctx) {
-                fprintf(stderr, "Failed to create SSL context\n");
+            return ssl_setup();
+            
+        case MODE_STUB:
+            printf("Initializing stub key provider (%u us per negotiation)\n", stub_latency_us);
+            inflight_keys = singleflight_new(sizeof(struct tls_key_info));
+            if (!inflight_keys || key_cache_setup() < 0) {
+                fprintf(stderr, "Failed to create key request table\n");
                 return -1;
             }
             return 0;
@@ -71,7 +230,35 @@ int key_provider_init(enum key_provider_mode mode) {
 void key_provider_cleanup(void) {
     switch (current_mode) {
         case MODE_TLSHUB:
+            /* 预取、刷新和探测线程会访问 TLSHub，先于客户端停止 */
+            key_prefetch_free(key_prefetcher);
+            key_prefetcher = NULL;
+            key_refresh_free(key_refresher);
+            key_refresher = NULL;
+            circuit_breaker_free(tlshub_breaker);
+            tlshub_breaker = NULL;
             tlshub_client_cleanup();
+            singleflight_free(inflight_keys);
+            inflight_keys = NULL;
+            key_cache_free(key_cache);
+            key_cache = NULL;
+            key_cache_free(negative_cache);
+            negative_cache = NULL;
+            if (ssl_ctx) {
+                SSL_CTX_free(ssl_ctx);
+                ssl_ctx = NULL;
+            }
+            break;
+            
+        case MODE_STUB:
+            key_prefetch_free(key_prefetcher);
+            key_prefetcher = NULL;
+            key_refresh_free(key_refresher);
+            key_refresher = NULL;
+            singleflight_free(inflight_keys);
+            inflight_keys = NULL;
+            key_cache_free(key_cache);
+            key_cache = NULL;
             break;
             
         case MODE_OPENSSL:
@@ -91,37 +278,406 @@ void key_provider_cleanup(void) {
 }
 
 /**
- * 获取密钥
+ * 释放当前线程持有的密钥提供者资源
  */
-int key_provider_get_key(struct flow_tuple *tuple, struct tls_key_info *key_info) {
+void key_provider_thread_cleanup(void) {
+    if (current_mode == MODE_TLSHUB) {
+        tlshub_client_thread_cleanup();
+    }
+}
+
+/**
+ * 获取需要由事件循环监听的文件描述符
+ */
+int key_provider_event_fd(void) {
+    if (current_mode == MODE_TLSHUB) {
+        return tlshub_client_fd();
+    }
+    return -1;
+}
+
+/**
+ * 处理异步消息
+ */
+int key_provider_process_events(void) {
+    if (current_mode == MODE_TLSHUB) {
+        return tlshub_client_process_messages();
+    }
+    return 0;
+}
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void make_negative_key(const struct flow_tuple *tuple, struct negative_key *key) {
+    memset(key, 0, sizeof(*key));
+    if (tuple->family == AF_INET6) {
+        memcpy(key->saddr6, tuple->saddr6, sizeof(key->saddr6));
+        memcpy(key->daddr6, tuple->daddr6, sizeof(key->daddr6));
+    } else {
+        key->saddr6[0] = tuple->saddr;
+        key->daddr6[0] = tuple->daddr;
+    }
+    key->family = tuple->family;
+}
+
+/**
+ * 握手前查负缓存：Pod 对仍在退避期内返回 1，此时不发起握手
+ */
+static int negative_suppressed(const struct negative_key *key) {
+    struct negative_entry entry;
+    
+    if (key_cache_peek(negative_cache, key, sizeof(*key), &entry) != KEY_CACHE_HIT) {
+        return 0;
+    }
+    if (now_ns() < entry.until_ns) {
+        __atomic_fetch_add(&handshakes_suppressed, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+    __atomic_fetch_add(&handshakes_retried, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * 负缓存条目的更新回调（在 key_cache 组锁内执行）：退避加倍，不超过上限
+ * 条目按 Pod 对记录，不区分客户端/服务端方向：两个方向在同一次故障中同时失败时，
+ * 后到的失败落在前一个失败设定的退避期内，只计数、不再加倍，一次故障只加倍一次
+ */
+static void negative_backoff(void *value, int found, void *arg) {
+    struct negative_entry *entry = value;
+    __u64 now = now_ns();
+    
+    if (!found) {
+        entry->failures = 1;
+        entry->backoff_ms = negative_backoff_ms;
+    } else if (now < entry->until_ns) {
+        entry->failures++;
+        *(struct negative_entry *)arg = *entry;
+        return;
+    } else {
+        entry->failures++;
+        entry->backoff_ms = entry->backoff_ms >= negative_backoff_max_ms / 2 ?
+                            negative_backoff_max_ms : entry->backoff_ms * 2;
+    }
+    entry->until_ns = now + (__u64)entry->backoff_ms * 1000000ULL;
+    *(struct negative_entry *)arg = *entry;
+}
+
+/**
+ * 记录握手结果：失败时退避加倍（不超过上限），成功时清除条目
+ * 同一 Pod 对的客户端和服务端协商可能同时失败，读改写在 key_cache 组锁内完成
+ */
+static void negative_update(const struct negative_key *key, int ret) {
+    struct negative_entry entry;
+    
+    if (!negative_cache) {
+        return;
+    }
+    if (ret == 0) {
+        key_cache_invalidate(negative_cache, key, sizeof(*key));
+        return;
+    }
+    if (ret != TLSHUB_HANDSHAKE_FAILED) {
+        /* 超时等传输错误由重试和熔断器处理，不代表对端拒绝握手 */
+        return;
+    }
+    
+    __atomic_fetch_add(&handshake_failures, 1, __ATOMIC_RELAXED);
+    key_cache_update(negative_cache, key, sizeof(*key), negative_backoff, &entry);
+    log_debug("TLSHub handshake failed %u times for this pod pair, backing off %u ms",
+              entry.failures, entry.backoff_ms);
+}
+
+/**
+ * 通过 TLSHub 协商密钥：先取密钥，失败则握手后重试
+ * 服务端在 accept 时就会来取，对端节点的握手可能尚未完成，
+ * 此时同样由本节点发起握手（TLSHub 对已建立的节点对返回 ALREADY_CONNECTED）；
+ * 密钥过期（TLSHUB_KEY_EXPIRED）同样通过重新握手刷新。
+ * suppressed 不为 NULL 时先查握手负缓存，退避期内不握手，置 *suppressed 并返回 TLSHUB_HANDSHAKE_FAILED
+ */
+static int tlshub_negotiate(struct flow_tuple *tuple, struct tls_key_info *key_info,
+                            int *suppressed) {
+    struct negative_key negative;
+    int ret;
+    
+    ret = tlshub_fetch_key(tuple, key_info);
+    if (ret == TLSHUB_KEY_EXPIRED) {
+        __atomic_fetch_add(&tlshub_expired, 1, __ATOMIC_RELAXED);
+        log_debug("TLSHub key expired, renegotiating");
+    }
+    if (ret == TLSHUB_TIMEOUT) {
+        /* TLSHub 没有响应，握手同样会超时，不再追加一轮等待 */
+        return ret;
+    }
+    if (ret < 0) {
+        /* 获取失败，发起握手；该 Pod 对最近握手失败过时先等退避结束 */
+        make_negative_key(tuple, &negative);
+        if (suppressed && negative_suppressed(&negative)) {
+            *suppressed = 1;
+            return TLSHUB_HANDSHAKE_FAILED;
+        }
+        log_debug("Fetch key failed, initiating handshake");
+        ret = tlshub_handshake(tuple);
+        negative_update(&negative, ret);
+        if (ret < 0) {
+            log_warn("TLSHub handshake failed");
+            return ret;
+        }
+        
+        /* 握手成功后重试获取密钥 */
+        ret = tlshub_fetch_key(tuple, key_info);
+        if (ret == TLSHUB_KEY_EXPIRED) {
+            __atomic_fetch_add(&tlshub_expired, 1, __ATOMIC_RELAXED);
+        }
+        if (ret < 0) {
+            log_warn("Fetch key failed after handshake");
+            return ret;
+        }
+    }
+    return 0;
+}
+
+/**
+ * 本地替身协商：等待固定时间后返回由四元组派生的确定性密钥，
+ * 同一对端的连接得到相同的密钥，不访问 TLSHub
+ */
+static int stub_negotiate(struct flow_tuple *tuple, struct tls_key_info *key_info) {
+    const __u8 *p = (const __u8 *)tuple->saddr6;
+    __u32 h = 2166136261u;
+    
+    if (stub_latency_us > 0) {
+        usleep(stub_latency_us);
+    }
+    
+    for (size_t i = 0; i < sizeof(tuple->saddr6) + sizeof(tuple->daddr6); i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    memset(key_info, 0, sizeof(*key_info));
+    for (size_t i = 0; i < sizeof(key_info->key); i++) {
+        key_info->key[i] = (__u8)(h >> ((i % 4) * 8)) ^ (__u8)i;
+    }
+    key_info->key_len = 32;
+    key_info->iv_len = 12;
+    return 0;
+}
+
+/**
+ * 执行一次实际协商（TLSHub 或其本地替身），握手被负缓存拦下时置 *suppressed
+ */
+static int negotiate(struct flow_tuple *tuple, struct tls_key_info *key_info, int *suppressed) {
+    __atomic_fetch_add(&key_negotiations, 1, __ATOMIC_RELAXED);
+    
+    if (current_mode == MODE_STUB) {
+        return stub_negotiate(tuple, key_info);
+    }
+    return tlshub_negotiate(tuple, key_info, suppressed);
+}
+
+/**
+ * singleflight 回调：协商前再查一次缓存，
+ * 刚结束的另一次协商可能已经刷新了条目，此时不再重复协商
+ */
+static int negotiate_flight(void *arg, void *result) {
+    struct key_flight *flight = arg;
+    int suppressed = 0;
+    __u64 start;
+    int ticket;
+    int ret;
+    
+    if (!flight->refresh &&
+        key_cache_peek(key_cache, flight->id, sizeof(*flight->id), result) == KEY_CACHE_HIT) {
+        return 0;
+    }
+    
+    /* 熔断器断开时不访问 TLSHub，已缓存的条目保持不变 */
+    ticket = circuit_breaker_allow(tlshub_breaker);
+    if (ticket == CIRCUIT_BREAKER_REJECT) {
+        return KEY_PROVIDER_UNAVAILABLE;
+    }
+    start = now_ns();
+    ret = negotiate(flight->tuple, result, &suppressed);
+    /*
+     * 负缓存拦下的握手只说明该 Pod 对仍在退避，fetch 已正常往返；模块不支持 IPv6 时请求没有发出，
+     * 两者都不计为 TLSHub 失败
+     */
+    circuit_breaker_record(tlshub_breaker, ticket, ret == 0 || suppressed || ret == TLSHUB_UNSUPPORTED,
+                           now_ns() - start, flight->tuple);
+    if (ret == 0) {
+        key_cache_insert(key_cache, flight->id, sizeof(*flight->id), result);
+        key_refresh_schedule(key_refresher, flight->id, sizeof(*flight->id), flight->tuple,
+                             now_ns() + (__u64)key_cache_ttl_ms * 1000000ULL);
+    } else if (!flight->refresh) {
+        key_cache_invalidate(key_cache, flight->id, sizeof(*flight->id));
+        key_refresh_cancel(key_refresher, flight->id, sizeof(*flight->id));
+    }
+    return ret;
+}
+
+/**
+ * 后台刷新回调：条目在上一个有效期内被使用过时重新协商，
+ * 与同一 Pod 对的前台请求经同一个 singleflight 合并
+ */
+static int refresh_key(void *arg, const void *key, __u32 key_len, const void *data) {
+    struct flow_tuple tuple;
+    struct tls_key_info key_info;
+    struct key_flight flight = { &tuple, key, 1 };
+    
+    (void)arg;
+    if (!key_cache_touched(key_cache, key, key_len)) {
+        return KEY_REFRESH_IDLE;
+    }
+    
+    memcpy(&tuple, data, sizeof(tuple));
+    if (coalesce_mode == KEY_COALESCE_OFF || !inflight_keys) {
+        return negotiate_flight(&flight, &key_info);
+    }
+    return singleflight_do(inflight_keys, key, key_len, negotiate_flight,
+                           &flight, &key_info, NULL);
+}
+
+/**
+ * 预取回调：与同一 Pod 对的前台请求经同一个 singleflight 合并，
+ * 协商前复查缓存，成功后写入缓存并调度后台刷新
+ */
+static int prefetch_key(void *arg, const void *key, __u32 key_len, const void *data) {
+    struct flow_tuple tuple;
+    struct tls_key_info key_info;
+    struct key_flight flight = { &tuple, key, 0 };
+    
+    (void)arg;
+    memcpy(&tuple, data, sizeof(tuple));
+    return singleflight_do(inflight_keys, key, key_len, negotiate_flight,
+                           &flight, &key_info, NULL);
+}
+
+/* 预取回调：Pod 对已有未过期的缓存密钥 */
+static int prefetch_cached(void *arg, const void *key, __u32 key_len) {
+    struct tls_key_info key_info;
+    
+    (void)arg;
+    return key_cache_peek(key_cache, key, key_len, &key_info) == KEY_CACHE_HIT;
+}
+
+/* 预取回调：有协商进行中（前台、刷新或预取），此时不预取 */
+static int prefetch_busy(void *arg) {
+    struct singleflight_stats sf;
+    
+    (void)arg;
+    singleflight_get_stats(inflight_keys, &sf);
+    return sf.inflight > 0;
+}
+
+/* 后台线程退出时释放其 TLSHub socket */
+static void background_thread_exit(void *arg) {
+    (void)arg;
+    key_provider_thread_cleanup();
+}
+
+/* 熔断器探测回调：对最近一次请求的 Pod 对完整协商一次，不写入缓存，不受握手负缓存限制 */
+static int probe_tlshub(void *arg, const void *data) {
+    struct flow_tuple tuple;
+    struct tls_key_info key_info;
+    
+    (void)arg;
+    memcpy(&tuple, data, sizeof(tuple));
+    return tlshub_negotiate(&tuple, &key_info, NULL);
+}
+
+/**
+ * 熔断器断开时由后备提供者应答，后备密钥不写入缓存，TLSHub 恢复后即换回 TLSHub 密钥
+ */
+static int fallback_get_key(struct flow_tuple *tuple, struct tls_key_info *key_info) {
+    switch (fallback_mode) {
+        case MODE_STUB:
+            __atomic_fetch_add(&fallback_requests, 1, __ATOMIC_RELAXED);
+            return stub_negotiate(tuple, key_info);
+            
+        default:
+            return KEY_PROVIDER_UNAVAILABLE;
+    }
+}
+
+/**
+ * 按合并粒度生成请求标识（同时作为缓存的 key，OFF 时按四元组）
+ */
+static void make_flight_id(const struct flow_tuple *tuple, struct key_flight_id *id) {
+    memset(id, 0, sizeof(*id));
+    if (tuple->family == AF_INET6) {
+        memcpy(id->saddr6, tuple->saddr6, sizeof(id->saddr6));
+        memcpy(id->daddr6, tuple->daddr6, sizeof(id->daddr6));
+    } else {
+        id->saddr6[0] = tuple->saddr;
+        id->daddr6[0] = tuple->daddr;
+    }
+    if (coalesce_mode != KEY_COALESCE_POD) {
+        id->sport = tuple->sport;
+        id->dport = tuple->dport;
+    }
+    id->family = tuple->family;
+    id->role = tuple->role;
+}
+
+/**
+ * 获取 TLSHub（或替身）密钥：先查缓存，未命中或已过期时与进行中的相同请求合并
+ */
+static int coalesced_get_key(struct flow_tuple *tuple, struct tls_key_info *key_info) {
+    struct key_flight_id id;
+    struct key_flight flight = { tuple, &id, 0 };
+    int shared = 0;
     int ret;
     
+    __atomic_fetch_add(&key_requests, 1, __ATOMIC_RELAXED);
+    
+    make_flight_id(tuple, &id);
+    if (key_cache_lookup(key_cache, &id, sizeof(id), key_info) == KEY_CACHE_HIT) {
+        key_prefetch_observe(key_prefetcher, &id, sizeof(id), tuple, 1);
+        return 0;
+    }
+    key_prefetch_observe(key_prefetcher, &id, sizeof(id), tuple, 0);
+    
+    if (coalesce_mode == KEY_COALESCE_OFF || !inflight_keys) {
+        ret = negotiate_flight(&flight, key_info);
+    } else {
+        ret = singleflight_do(inflight_keys, &id, sizeof(id), negotiate_flight,
+                              &flight, key_info, &shared);
+        if (shared) {
+            __atomic_fetch_add(&key_coalesced, 1, __ATOMIC_RELAXED);
+            log_debug("Reused in-flight TLSHub negotiation (ret: %d)", ret);
+        }
+    }
+    
+    if (ret == KEY_PROVIDER_UNAVAILABLE) {
+        return fallback_get_key(tuple, key_info);
+    }
+    return ret;
+}
+
+/**
+ * 获取密钥
+ */
+int key_provider_get_key(struct flow_tuple *tuple, struct tls_key_info *key_info) {
     if (!tuple || !key_info) {
-        fprintf(stderr, "Invalid parameters for key_provider_get_key\n");
+        log_error("Invalid parameters for key_provider_get_key");
+        return -1;
+    }
+    
+    if (tuple->family != AF_INET && tuple->family != AF_INET6) {
+        log_error("Unsupported address family: %u", tuple->family);
+        return -1;
+    }
+    
+    if (tuple->role != FLOW_ROLE_CLIENT && tuple->role != FLOW_ROLE_SERVER) {
+        log_error("Unsupported flow role: %u", tuple->role);
         return -1;
     }
     
     switch (current_mode) {
         case MODE_TLSHUB:
-            /* 尝试从 TLSHub 获取密钥 */
-            ret = tlshub_fetch_key(tuple, key_info);
-            if (ret < 0) {
-                /* 获取失败，发起握手 */
-                printf("Fetch key failed, initiating handshake\n");
-                ret = tlshub_handshake(tuple);
-                if (ret < 0) {
-                    fprintf(stderr, "TLSHub handshake failed\n");
-                    return ret;
-                }
-                
-                /* 握手成功后重试获取密钥 */
-                ret = tlshub_fetch_key(tuple, key_info);
-                if (ret < 0) {
-                    fprintf(stderr, "Fetch key failed after handshake\n");
-                    return ret;
-                }
-            }
-            return 0;
+        case MODE_STUB:
+            return coalesced_get_key(tuple, key_info);
             
         case MODE_OPENSSL:
             return openssl_get_key(tuple, key_info);
@@ -130,7 +686,7 @@ int key_provider_get_key(struct flow_tuple *tuple, struct tls_key_info *key_info
             return boringssl_get_key(tuple, key_info);
             
         default:
-            fprintf(stderr, "Unknown key provider mode: %d\n", current_mode);
+            log_error("Unknown key provider mode: %d", current_mode);
             return -1;
     }
 }
@@ -143,6 +699,336 @@ void key_provider_set_mode(enum key_provider_mode mode) {
     printf("Key provider mode set to: %d\n", mode);
 }
 
+/**
+ * 设置并发密钥请求的合并粒度
+ */
+void key_provider_set_coalesce(enum key_coalesce coalesce) {
+    coalesce_mode = coalesce;
+}
+
+/**
+ * 设置 MODE_STUB 每次协商的模拟耗时
+ */
+void key_provider_set_stub_latency(__u32 latency_us) {
+    stub_latency_us = latency_us;
+}
+
+/**
+ * 设置 TLSHub 单 socket 流水线深度
+ */
+void key_provider_set_pipeline_depth(__u32 depth) {
+    tlshub_pipeline_depth = depth;
+}
+
+/**
+ * 设置 TLSHub 批量请求参数
+ */
+void key_provider_set_batching(__u32 max_entries, __u32 delay_us) {
+    tlshub_batch_size = max_entries;
+    tlshub_batch_delay_us = delay_us;
+}
+
+/**
+ * 设置与 TLSHub 之间的传输
+ */
+void key_provider_set_tlshub_transport(enum tlshub_transport transport, const char *unix_path,
+                                       const struct tlshub_standin_config *mock) {
+    tlshub_transport = transport;
+    tlshub_unix_path[0] = '\0';
+    if (unix_path) {
+        strncpy(tlshub_unix_path, unix_path, sizeof(tlshub_unix_path) - 1);
+    }
+    memset(&tlshub_mock_config, 0, sizeof(tlshub_mock_config));
+    if (mock) {
+        tlshub_mock_config = *mock;
+    }
+}
+
+/**
+ * 设置 TLSHub 请求的超时与重试策略
+ */
+void key_provider_set_tlshub_retry(const struct tlshub_retry_policy *policy) {
+    if (policy) {
+        tlshub_retry = *policy;
+    } else {
+        tlshub_retry = (struct tlshub_retry_policy){
+            .timeout_ms = TLSHUB_DEFAULT_TIMEOUT_MS,
+            .retries = TLSHUB_DEFAULT_RETRIES,
+            .backoff_ms = TLSHUB_DEFAULT_BACKOFF_MS,
+            .backoff_max_ms = TLSHUB_DEFAULT_BACKOFF_MAX_MS,
+        };
+    }
+}
+
+/**
+ * 取消进行中的 TLSHub 请求
+ */
+void key_provider_cancel(void) {
+    if (current_mode == MODE_TLSHUB) {
+        tlshub_client_cancel();
+    }
+}
+
+/**
+ * 设置 TLSHub 熔断器
+ */
+void key_provider_set_breaker(const struct circuit_breaker_config *config) {
+    tlshub_breaker_enabled = config != NULL;
+    if (config) {
+        tlshub_breaker_config = *config;
+    }
+}
+
+/**
+ * 设置熔断器断开时的后备提供者
+ */
+void key_provider_set_fallback(enum key_provider_mode mode) {
+    fallback_mode = mode;
+}
+
+static int breaker_setup(void) {
+    const char *fallback = "none (fail fast)";
+    
+    if (!tlshub_breaker_enabled) {
+        return 0;
+    }
+    
+    switch (fallback_mode) {
+        case MODE_OPENSSL:
+        case MODE_BORINGSSL:
+            /*
+             * openssl/boringssl 模式从已完成握手的 SSL 会话导出密钥，
+             * 熔断时只有四元组、没有握手，SSL_export_keying_material 必然失败
+             */
+            fprintf(stderr, "tlshub_fallback %s is not supported: it exports keys from a completed "
+                    "TLS handshake, which a tripped breaker never has; use stub or none\n",
+                    fallback_mode == MODE_OPENSSL ? "openssl" : "boringssl");
+            return -1;
+        case MODE_STUB:
+            fallback = "stub";
+            break;
+        default:
+            break;
+    }
+    
+    tlshub_breaker_config.data_size = sizeof(struct flow_tuple);
+    tlshub_breaker = circuit_breaker_new(&tlshub_breaker_config,
+                                         &(struct circuit_breaker_ops){
+                                             .probe = probe_tlshub,
+                                             .thread_exit = background_thread_exit,
+                                         }, NULL);
+    if (!tlshub_breaker) {
+        fprintf(stderr, "Failed to create TLSHub circuit breaker\n");
+        return -1;
+    }
+    printf("TLSHub circuit breaker enabled (%u%% failures or %u%% slower than %u ms over %u ms, "
+           "fallback %s)\n", tlshub_breaker_config.failure_percent,
+           tlshub_breaker_config.slow_percent, tlshub_breaker_config.slow_ms,
+           tlshub_breaker_config.window_ms, fallback);
+    return 0;
+}
+
+static int ssl_setup(void) {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    /* OpenSSL 1.1.0+ */
+    OPENSSL_init_ssl(OPENSSL_INIT_LOAD_SSL_STRINGS | OPENSSL_INIT_LOAD_CRYPTO_STRINGS, NULL);
+#else
+    /* OpenSSL 1.0.x */
+    SSL_library_init();
+    SSL_load_error_strings();
+    OpenSSL_add_all_algorithms();
+#endif
+    ssl_ctx = SSL_CTX_new(TLS_method());
+    if (!ssl_ctx) {
+        fprintf(stderr, "Failed to create SSL context\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 设置握手负缓存
+ */
+void key_provider_set_negative_cache(__u32 capacity, __u32 backoff_ms, __u32 backoff_max_ms) {
+    negative_cache_capacity = capacity;
+    negative_backoff_ms = backoff_ms;
+    negative_backoff_max_ms = backoff_max_ms;
+}
+
+static int negative_cache_setup(void) {
+    if (negative_cache_capacity == 0 || negative_backoff_ms == 0) {
+        return 0;
+    }
+    if (negative_backoff_max_ms < negative_backoff_ms) {
+        negative_backoff_max_ms = negative_backoff_ms;
+    }
+    
+    /* 条目在 2 倍退避上限内没有新的失败即被遗忘 */
+    negative_cache = key_cache_new(negative_cache_capacity, sizeof(struct negative_entry),
+                                   (__u64)negative_backoff_max_ms * 2000000ULL);
+    if (!negative_cache) {
+        fprintf(stderr, "Failed to create handshake negative cache\n");
+        return -1;
+    }
+    printf("Handshake negative cache enabled (%u pod pairs, backoff %u-%u ms)\n",
+           negative_cache_capacity, negative_backoff_ms, negative_backoff_max_ms);
+    return 0;
+}
+
+/**
+ * 设置协商结果缓存
+ */
+void key_provider_set_cache(__u32 capacity, __u32 ttl_ms) {
+    key_cache_capacity = capacity;
+    key_cache_ttl_ms = ttl_ms;
+}
+
+static int key_cache_setup(void) {
+    if (key_cache_capacity == 0 || key_cache_ttl_ms == 0) {
+        return 0;
+    }
+    
+    key_cache = key_cache_new(key_cache_capacity, sizeof(struct tls_key_info),
+                              (__u64)key_cache_ttl_ms * 1000000ULL);
+    if (!key_cache) {
+        fprintf(stderr, "Failed to create key cache\n");
+        return -1;
+    }
+    printf("Key cache enabled (%u entries, ttl %u ms)\n", key_cache_capacity, key_cache_ttl_ms);
+    
+    if (key_refresh_lead_ms == 0 || key_refresh_threads == 0) {
+        return key_prefetch_setup();
+    }
+    if (key_refresh_lead_ms + key_refresh_jitter_ms >= key_cache_ttl_ms) {
+        fprintf(stderr, "Key refresh lead + jitter must be shorter than the cache ttl, refresh disabled\n");
+        return key_prefetch_setup();
+    }
+    
+    key_refresher = key_refresh_new(&(struct key_refresh_config){
+                                        .capacity = key_cache_capacity,
+                                        .data_size = sizeof(struct flow_tuple),
+                                        .tick_ms = KEY_REFRESH_DEFAULT_TICK_MS,
+                                        .lead_ms = key_refresh_lead_ms,
+                                        .jitter_ms = key_refresh_jitter_ms,
+                                        .threads = key_refresh_threads,
+                                    },
+                                    &(struct key_refresh_ops){
+                                        .refresh = refresh_key,
+                                        .thread_exit = background_thread_exit,
+                                    }, NULL);
+    if (!key_refresher) {
+        fprintf(stderr, "Failed to start key refresh\n");
+        return -1;
+    }
+    printf("Key refresh enabled (%u ms before expiry, jitter %u ms, %u threads)\n",
+           key_refresh_lead_ms, key_refresh_jitter_ms, key_refresh_threads);
+    return key_prefetch_setup();
+}
+
+/**
+ * 创建预取器（在密钥缓存之后，未配置时不创建）
+ */
+static int key_prefetch_setup(void) {
+    if (key_prefetch_rate == 0) {
+        return 0;
+    }
+    if (coalesce_mode != KEY_COALESCE_POD) {
+        fprintf(stderr, "Key prefetch requires key_coalesce = pod, prefetch disabled\n");
+        return 0;
+    }
+    
+    key_prefetcher = key_prefetch_new(&(struct key_prefetch_config){
+                                          .capacity = key_cache_capacity,
+                                          .data_size = sizeof(struct flow_tuple),
+                                          .rate = key_prefetch_rate,
+                                          .interval_ms = KEY_PREFETCH_DEFAULT_INTERVAL_MS,
+                                          .half_life_ms = key_prefetch_half_life_ms,
+                                          .min_score = key_prefetch_min_score,
+                                      },
+                                      &(struct key_prefetch_ops){
+                                          .cached = prefetch_cached,
+                                          .busy = prefetch_busy,
+                                          .prefetch = prefetch_key,
+                                          .thread_exit = background_thread_exit,
+                                      }, NULL);
+    if (!key_prefetcher) {
+        fprintf(stderr, "Failed to start key prefetch\n");
+        return -1;
+    }
+    printf("Key prefetch enabled (%u per second, min score %.1f, half-life %u ms)\n",
+           key_prefetch_rate, key_prefetch_min_score, key_prefetch_half_life_ms);
+    return 0;
+}
+
+/**
+ * 设置后台刷新
+ */
+void key_provider_set_refresh(__u32 lead_ms, __u32 jitter_ms, __u32 threads) {
+    key_refresh_lead_ms = lead_ms;
+    key_refresh_jitter_ms = jitter_ms;
+    key_refresh_threads = threads;
+}
+
+/**
+ * 设置密钥预取
+ */
+void key_provider_set_prefetch(__u32 rate, double min_score, __u32 half_life_ms) {
+    key_prefetch_rate = rate;
+    key_prefetch_min_score = min_score;
+    key_prefetch_half_life_ms = half_life_ms;
+}
+
+/**
+ * 预置一个预取的 Pod 对
+ */
+int key_provider_prefetch_seed(struct flow_tuple *tuple) {
+    struct key_flight_id id;
+    
+    if (!key_prefetcher || !tuple) {
+        return -1;
+    }
+    
+    make_flight_id(tuple, &id);
+    return key_prefetch_seed(key_prefetcher, &id, sizeof(id), tuple, key_prefetch_min_score);
+}
+
+/**
+ * 获取密钥请求统计
+ */
+void key_provider_get_stats(struct key_provider_stats *stats) {
+    struct key_cache_stats negative;
+    struct singleflight_stats sf;
+    
+    if (!stats) {
+        return;
+    }
+    
+    memset(stats, 0, sizeof(*stats));
+    stats->requests = __atomic_load_n(&key_requests, __ATOMIC_RELAXED);
+    stats->negotiations = __atomic_load_n(&key_negotiations, __ATOMIC_RELAXED);
+    stats->coalesced = __atomic_load_n(&key_coalesced, __ATOMIC_RELAXED);
+    stats->tlshub_expired = __atomic_load_n(&tlshub_expired, __ATOMIC_RELAXED);
+    if (inflight_keys) {
+        singleflight_get_stats(inflight_keys, &sf);
+        stats->inflight = sf.inflight;
+        stats->max_waiters = sf.max_waiters;
+    }
+    key_cache_get_stats(key_cache, &stats->cache);
+    key_refresh_get_stats(key_refresher, &stats->refresh);
+    key_prefetch_get_stats(key_prefetcher, &stats->prefetch);
+    if (current_mode == MODE_TLSHUB) {
+        tlshub_client_get_request_stats(&stats->tlshub);
+    }
+    key_cache_get_stats(negative_cache, &negative);
+    stats->negative_entries = negative.entries;
+    stats->handshake_failures = __atomic_load_n(&handshake_failures, __ATOMIC_RELAXED);
+    stats->handshakes_suppressed = __atomic_load_n(&handshakes_suppressed, __ATOMIC_RELAXED);
+    stats->handshakes_retried = __atomic_load_n(&handshakes_retried, __ATOMIC_RELAXED);
+    stats->breaker_enabled = tlshub_breaker != NULL;
+    circuit_breaker_get_stats(tlshub_breaker, &stats->breaker);
+    stats->fallbacks = __atomic_load_n(&fallback_requests, __ATOMIC_RELAXED);
+}
+
 /**
  * 获取当前密钥提供者模式
  */
@@ -167,14 +1053,14 @@ static int openssl_get_key(struct flow_tuple *tuple, struct tls_key_info *key_in
     int ret;
     
     if (!ssl_ctx) {
-        fprintf(stderr, "SSL context not initialized\n");
+        log_error("SSL context not initialized");
         return -1;
     }
     
     /* 创建 SSL 对象 */
     ssl = SSL_new(ssl_ctx);
     if (!ssl) {
-        fprintf(stderr, "Failed to create SSL object\n");
+        log_error("Failed to create SSL object");
         return -1;
     }
     
@@ -187,7 +1073,7 @@ static int openssl_get_key(struct flow_tuple *tuple, struct tls_key_info *key_in
     ret = SSL_export_keying_material(ssl, key_material, sizeof(key_material),
                                       "EXPORTER-TLS-Capture", 21, NULL, 0, 0);
     if (ret != 1) {
-        fprintf(stderr, "Failed to export keying material\n");
+        log_warn("Failed to export keying material");
         SSL_free(ssl);
         return -1;
     }
@@ -199,7 +1085,7 @@ static int openssl_get_key(struct flow_tuple *tuple, struct tls_key_info *key_in
     key_info->iv_len = 12;
     
     SSL_free(ssl);
-    printf("OpenSSL key negotiation completed\n");
+    log_debug("OpenSSL key negotiation completed");
     return 0;
 }
 
@@ -209,6 +1095,6 @@ static int openssl_get_key(struct flow_tuple *tuple, struct tls_key_info *key_in
 static int boringssl_get_key(struct flow_tuple *tuple, struct tls_key_info *key_info) {
     /* BoringSSL 实现与 OpenSSL 类似 */
     /* 这里简化为调用 OpenSSL 函数 */
-    printf("Using BoringSSL for key negotiation\n");
+    log_debug("Using BoringSSL for key negotiation");
     return openssl_get_key(tuple, key_info);
 }
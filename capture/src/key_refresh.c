@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "key_refresh.h"
+#include "timing_wheel.h"
+
+/* 跟踪的条目，数据紧跟在结构体之后 */
+struct refresh_entry {
+    struct timer_node timer;        /* 必须是第一个成员 */
+    struct refresh_entry *hash_next;
+    __u32 hash;
+    __u32 key_len;
+    __u64 expires_ns;
+    __u8 key[KEY_REFRESH_MAX_KEY];
+    __u8 data[];
+};
+
+struct key_refresh {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;            /* 使用 CLOCK_MONOTONIC */
+    struct timing_wheel wheel;
+    struct refresh_entry **buckets;
+    __u32 bucket_mask;
+    struct timer_node *ready;       /* 已到期、等待刷新线程处理的条目 */
+    struct key_refresh_config config;
+    struct key_refresh_ops ops;
+    void *arg;
+    __u64 base_ns;                  /* tick 0 对应的时间 */
+    __u64 tick_ns;
+    unsigned int seed;
+    int stop;
+    pthread_t *threads;
+    __u32 started;
+
+    struct key_refresh_stats stats;
+};
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* FNV-1a */
+static __u32 hash_key(const void *key, __u32 len) {
+    const __u8 *p = key;
+    __u32 h = 2166136261u;
+
+    for (__u32 i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static __u64 to_tick(struct key_refresh *refresh, __u64 ns) {
+    return ns > refresh->base_ns ? (ns - refresh->base_ns) / refresh->tick_ns : 0;
+}
+
+/**
+ * 查找 key 所在的链表位置（持锁调用），不存在时返回的位置指向 NULL
+ */
+static struct refresh_entry **find_entry(struct key_refresh *refresh, __u32 hash,
+                                         const void *key, __u32 key_len) {
+    struct refresh_entry **pp = &refresh->buckets[hash & refresh->bucket_mask];
+
+    while (*pp) {
+        struct refresh_entry *e = *pp;
+
+        if (e->hash == hash && e->key_len == key_len && memcmp(e->key, key, key_len) == 0) {
+            break;
+        }
+        pp = &e->hash_next;
+    }
+    return pp;
+}
+
+/**
+ * 推进时间轮，把到期条目移出哈希表放入待处理链表（持锁调用）
+ */
+static void collect_due(struct key_refresh *refresh, __u64 now_tick) {
+    struct timer_node *due;
+    __u32 count;
+
+    count = timing_wheel_advance(&refresh->wheel, now_tick, &due);
+    if (count > refresh->stats.max_due) {
+        refresh->stats.max_due = count;
+    }
+    while (due) {
+        struct timer_node *next = due->next;
+        struct refresh_entry *e = (struct refresh_entry *)due;
+
+        *find_entry(refresh, e->hash, e->key, e->key_len) = e->hash_next;
+        refresh->stats.tracked--;
+        due->next = refresh->ready;
+        refresh->ready = due;
+        due = next;
+    }
+}
+
+/**
+ * 调用刷新回调（不持锁）
+ */
+static void run_refresh(struct key_refresh *refresh, struct refresh_entry *e) {
+    int ret;
+
+    if (now_ns() >= e->expires_ns) {
+        __atomic_fetch_add(&refresh->stats.late, 1, __ATOMIC_RELAXED);
+    }
+
+    ret = refresh->ops.refresh(refresh->arg, e->key, e->key_len, e->data);
+    if (ret == KEY_REFRESH_IDLE) {
+        __atomic_fetch_add(&refresh->stats.idle, 1, __ATOMIC_RELAXED);
+    } else if (ret < 0) {
+        __atomic_fetch_add(&refresh->stats.failures, 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&refresh->stats.refreshed, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * 刷新线程：处理待刷新条目，没有时推进时间轮或等到下一个 tick
+ */
+static void *refresh_thread(void *arg) {
+    struct key_refresh *refresh = arg;
+
+    pthread_mutex_lock(&refresh->lock);
+    while (!refresh->stop) {
+        struct refresh_entry *e = (struct refresh_entry *)refresh->ready;
+        __u64 now, wake;
+        struct timespec ts;
+
+        if (e) {
+            refresh->ready = e->timer.next;
+            pthread_mutex_unlock(&refresh->lock);
+            run_refresh(refresh, e);
+            free(e);
+            pthread_mutex_lock(&refresh->lock);
+            continue;
+        }
+
+        now = now_ns();
+        if (to_tick(refresh, now) >= refresh->wheel.next_tick) {
+            collect_due(refresh, to_tick(refresh, now));
+            if (refresh->ready && refresh->ready->next) {
+                /* 不止一个条目，唤醒其他刷新线程分担 */
+                pthread_cond_broadcast(&refresh->cond);
+            }
+            continue;
+        }
+
+        wake = refresh->base_ns + refresh->wheel.next_tick * refresh->tick_ns;
+        ts.tv_sec = wake / 1000000000ULL;
+        ts.tv_nsec = wake % 1000000000ULL;
+        pthread_cond_timedwait(&refresh->cond, &refresh->lock, &ts);
+    }
+    pthread_mutex_unlock(&refresh->lock);
+
+    if (refresh->ops.thread_exit) {
+        refresh->ops.thread_exit(refresh->arg);
+    }
+    return NULL;
+}
+
+/**
+ * 创建调度器并启动刷新线程
+ */
+struct key_refresh *key_refresh_new(const struct key_refresh_config *config,
+                                    const struct key_refresh_ops *ops, void *arg) {
+    struct key_refresh *refresh;
+    pthread_condattr_t attr;
+    __u32 buckets = 1;
+
+    if (!config || !ops || !ops->refresh || config->capacity == 0 || config->threads == 0) {
+        return NULL;
+    }
+    while (buckets < config->capacity && buckets < (1U << 24)) {
+        buckets <<= 1;
+    }
+
+    refresh = calloc(1, sizeof(*refresh));
+    if (!refresh) {
+        return NULL;
+    }
+    refresh->buckets = calloc(buckets, sizeof(*refresh->buckets));
+    refresh->threads = calloc(config->threads, sizeof(*refresh->threads));
+    if (!refresh->buckets || !refresh->threads) {
+        free(refresh->buckets);
+        free(refresh->threads);
+        free(refresh);
+        return NULL;
+    }
+    refresh->bucket_mask = buckets - 1;
+    refresh->config = *config;
+    refresh->ops = *ops;
+    refresh->arg = arg;
+    refresh->tick_ns = (__u64)(config->tick_ms ? config->tick_ms : KEY_REFRESH_DEFAULT_TICK_MS) * 1000000ULL;
+    refresh->base_ns = now_ns();
+    refresh->seed = (unsigned int)refresh->base_ns;
+    timing_wheel_init(&refresh->wheel, 0);
+
+    pthread_mutex_init(&refresh->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&refresh->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    for (__u32 i = 0; i < config->threads; i++) {
+        if (pthread_create(&refresh->threads[i], NULL, refresh_thread, refresh) != 0) {
+            fprintf(stderr, "Failed to start key refresh thread\n");
+            key_refresh_free(refresh);
+            return NULL;
+        }
+        refresh->started++;
+    }
+    return refresh;
+}
+
+/**
+ * 调度 key 的刷新
+ */
+int key_refresh_schedule(struct key_refresh *refresh, const void *key, __u32 key_len,
+                         const void *data, __u64 expires_ns) {
+    struct refresh_entry **pp, *e;
+    __u64 refresh_ns, advance_ns;
+    __u32 hash;
+
+    if (!refresh || !key || key_len == 0 || key_len > KEY_REFRESH_MAX_KEY) {
+        return -1;
+    }
+    hash = hash_key(key, key_len);
+
+    pthread_mutex_lock(&refresh->lock);
+    pp = find_entry(refresh, hash, key, key_len);
+    e = *pp;
+    if (e) {
+        timing_wheel_del(&refresh->wheel, &e->timer);
+    } else {
+        if (refresh->stats.tracked >= refresh->config.capacity) {
+            refresh->stats.dropped++;
+            pthread_mutex_unlock(&refresh->lock);
+            return -1;
+        }
+        e = calloc(1, sizeof(*e) + refresh->config.data_size);
+        if (!e) {
+            pthread_mutex_unlock(&refresh->lock);
+            return -1;
+        }
+        e->hash = hash;
+        e->key_len = key_len;
+        memcpy(e->key, key, key_len);
+        *pp = e;
+        refresh->stats.tracked++;
+    }
+    if (data) {
+        memcpy(e->data, data, refresh->config.data_size);
+    }
+    e->expires_ns = expires_ns;
+
+    /* 过期前 lead 再提前 [0, jitter) 的随机量 */
+    advance_ns = (__u64)refresh->config.lead_ms * 1000000ULL;
+    if (refresh->config.jitter_ms > 0) {
+        advance_ns += (__u64)(rand_r(&refresh->seed) % (refresh->config.jitter_ms * 1000U)) * 1000ULL;
+    }
+    refresh_ns = expires_ns > advance_ns ? expires_ns - advance_ns : 0;
+    timing_wheel_add(&refresh->wheel, &e->timer, to_tick(refresh, refresh_ns));
+    refresh->stats.scheduled++;
+    pthread_mutex_unlock(&refresh->lock);
+    return 0;
+}
+
+/**
+ * 取消 key 的刷新
+ */
+void key_refresh_cancel(struct key_refresh *refresh, const void *key, __u32 key_len) {
+    struct refresh_entry **pp, *e;
+
+    if (!refresh || !key || key_len == 0 || key_len > KEY_REFRESH_MAX_KEY) {
+        return;
+    }
+
+    pthread_mutex_lock(&refresh->lock);
+    pp = find_entry(refresh, hash_key(key, key_len), key, key_len);
+    e = *pp;
+    if (e) {
+        *pp = e->hash_next;
+        timing_wheel_del(&refresh->wheel, &e->timer);
+        refresh->stats.tracked--;
+    }
+    pthread_mutex_unlock(&refresh->lock);
+    free(e);
+}
+
+/**
+ * 获取调度器统计
+ */
+void key_refresh_get_stats(struct key_refresh *refresh, struct key_refresh_stats *stats) {
+    if (!refresh || !stats) {
+        return;
+    }
+
+    pthread_mutex_lock(&refresh->lock);
+    *stats = refresh->stats;
+    pthread_mutex_unlock(&refresh->lock);
+    stats->refreshed = __atomic_load_n(&refresh->stats.refreshed, __ATOMIC_RELAXED);
+    stats->failures = __atomic_load_n(&refresh->stats.failures, __ATOMIC_RELAXED);
+    stats->idle = __atomic_load_n(&refresh->stats.idle, __ATOMIC_RELAXED);
+    stats->late = __atomic_load_n(&refresh->stats.late, __ATOMIC_RELAXED);
+}
+
+/**
+ * 停止刷新线程并释放调度器
+ */
+void key_refresh_free(struct key_refresh *refresh) {
+    struct timer_node *node;
+
+    if (!refresh) {
+        return;
+    }
+
+    pthread_mutex_lock(&refresh->lock);
+    refresh->stop = 1;
+    pthread_cond_broadcast(&refresh->cond);
+    pthread_mutex_unlock(&refresh->lock);
+    for (__u32 i = 0; i < refresh->started; i++) {
+        pthread_join(refresh->threads[i], NULL);
+    }
+
+    for (__u32 i = 0; i <= refresh->bucket_mask; i++) {
+        struct refresh_entry *e = refresh->buckets[i];
+
+        while (e) {
+            struct refresh_entry *next = e->hash_next;
+
+            free(e);
+            e = next;
+        }
+    }
+    node = refresh->ready;
+    while (node) {
+        struct timer_node *next = node->next;
+
+        free(node);
+        node = next;
+    }
+
+    pthread_cond_destroy(&refresh->cond);
+    pthread_mutex_destroy(&refresh->lock);
+    free(refresh->buckets);
+    free(refresh->threads);
+    free(refresh);
+}
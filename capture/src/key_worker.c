@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include "key_worker.h"
+#include "mpmc_queue.h"
+
+/* 分片模式下空闲工作线程检查其他分片积压的间隔 */
+#define KEY_WORKER_STEAL_INTERVAL_NS 10000000ULL
+
+/* 队列元素：事件及其入队时间 */
+struct key_work_item {
+    struct tcp_connect_event event;
+    __u64 enqueue_ns;
+};
+
+/*
+ * 分片：独立的队列、信号量和计数器，按缓存行对齐，
+ * 不同消费者线程提交到不同分片时互不争用
+ */
+struct key_worker_shard {
+    _Alignas(64) struct mpmc_queue *queue;
+    sem_t ready;                    /* 已入队、尚未被取走的事件数 */
+    __u32 workers;                  /* 服务该分片的工作线程数 */
+
+    atomic_ullong submitted;
+    atomic_ullong dropped;
+    atomic_ullong completed;
+    atomic_ullong max_depth;
+    atomic_ullong wait_total_ns;
+    atomic_ullong wait_max_ns;
+    atomic_ullong busy_ns;
+    atomic_ullong stolen;           /* 被其他分片的工作线程取走处理的事件 */
+};
+
+/* 工作线程参数 */
+struct key_worker_thread {
+    struct key_worker_pool *pool;
+    struct key_worker_shard *shard;     /* 优先服务的分片 */
+    __u32 index;                        /* 该分片的编号 */
+    pthread_t thread;
+};
+
+struct key_worker_pool {
+    struct key_worker_shard *shards;
+    __u32 nr_shards;
+    struct key_worker_thread *threads;
+    __u32 started;
+    atomic_int stop;
+
+    event_handler_fn handler;
+    key_worker_exit_fn on_exit;
+    void *ctx;
+
+    __u64 start_ns;
+};
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void atomic_max(atomic_ullong *target, __u64 value) {
+    unsigned long long cur = atomic_load_explicit(target, memory_order_relaxed);
+
+    while (value > cur &&
+           !atomic_compare_exchange_weak_explicit(target, &cur, value,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+        ;
+    }
+}
+
+/**
+ * 等待下一个事件，返回取得事件的分片（拿到了该分片信号量的一个计数），出错返回 NULL
+ * 分片模式下先取自己的分片，再从其他分片窃取，都为空时在自己的分片上限时休眠，
+ * 避免一个分片的工作线程卡在慢协商上时，该分片的事件在其他线程空闲时仍然排队
+ */
+static struct key_worker_shard *next_work(struct key_worker_thread *self) {
+    struct key_worker_pool *pool = self->pool;
+    struct key_worker_shard *own = self->shard;
+    struct timespec deadline;
+
+    for (;;) {
+        if (pool->nr_shards == 1) {
+            if (sem_wait(&own->ready) == 0) {
+                return own;
+            }
+            if (errno != EINTR) {
+                return NULL;
+            }
+            continue;
+        }
+
+        if (sem_trywait(&own->ready) == 0) {
+            return own;
+        }
+        for (__u32 i = 1; i < pool->nr_shards; i++) {
+            struct key_worker_shard *other = &pool->shards[(self->index + i) % pool->nr_shards];
+
+            if (sem_trywait(&other->ready) == 0) {
+                atomic_fetch_add_explicit(&other->stolen, 1, memory_order_relaxed);
+                return other;
+            }
+        }
+        if (atomic_load(&pool->stop)) {
+            return own;
+        }
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += KEY_WORKER_STEAL_INTERVAL_NS;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        if (sem_timedwait(&own->ready, &deadline) == 0) {
+            return own;
+        }
+        if (errno != ETIMEDOUT && errno != EINTR) {
+            return NULL;
+        }
+    }
+}
+
+/**
+ * 工作线程：等待事件、出队并调用处理回调
+ */
+static void *worker_main(void *arg) {
+    struct key_worker_thread *self = arg;
+    struct key_worker_pool *pool = self->pool;
+    struct key_worker_shard *shard;
+    struct key_work_item item;
+
+    for (;;) {
+        __u64 start, wait;
+
+        shard = next_work(self);
+        if (!shard || atomic_load(&pool->stop)) {
+            break;
+        }
+        /*
+         * 信号量计数对应已完成的入队，但多个生产者时前一个位置可能尚未写完，
+         * 此时让出 CPU 稍后重试，而不是丢掉这次唤醒
+         */
+        while (mpmc_queue_pop(shard->queue, &item) < 0) {
+            sched_yield();
+        }
+
+        start = now_ns();
+        wait = start - item.enqueue_ns;
+        atomic_fetch_add_explicit(&shard->wait_total_ns, wait, memory_order_relaxed);
+        atomic_max(&shard->wait_max_ns, wait);
+
+        pool->handler(pool->ctx, &item.event);
+
+        atomic_fetch_add_explicit(&shard->busy_ns, now_ns() - start, memory_order_relaxed);
+        atomic_fetch_add_explicit(&shard->completed, 1, memory_order_relaxed);
+    }
+
+    if (pool->on_exit) {
+        pool->on_exit(pool->ctx);
+    }
+    return NULL;
+}
+
+/**
+ * 释放分片的队列和信号量
+ */
+static void free_shards(struct key_worker_pool *pool) {
+    for (__u32 i = 0; i < pool->nr_shards; i++) {
+        sem_destroy(&pool->shards[i].ready);
+        mpmc_queue_free(pool->shards[i].queue);
+    }
+    free(pool->shards);
+}
+
+/**
+ * 创建工作线程池并启动工作线程
+ */
+struct key_worker_pool *key_worker_pool_new(__u32 workers, __u32 queue_size, __u32 shards,
+                                            event_handler_fn handler,
+                                            key_worker_exit_fn on_exit, void *ctx) {
+    struct key_worker_pool *pool;
+    __u32 shard_size;
+
+    if (!handler || workers == 0 || workers > KEY_WORKER_MAX_THREADS || queue_size == 0) {
+        fprintf(stderr, "Invalid key worker pool parameters (workers: %u, queue: %u)\n",
+                workers, queue_size);
+        return NULL;
+    }
+    /* 每个分片至少一个工作线程和 KEY_WORKER_MIN_SHARD_SIZE 个槽位，队列容量在分片间均分 */
+    if (shards == 0) {
+        shards = 1;
+    }
+    if (shards > workers) {
+        shards = workers;
+    }
+    while (shards > 1 && queue_size / shards < KEY_WORKER_MIN_SHARD_SIZE) {
+        shards--;
+    }
+    shard_size = queue_size / shards ? queue_size / shards : 1;
+
+    pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        fprintf(stderr, "Failed to allocate key worker pool\n");
+        return NULL;
+    }
+
+    pool->shards = aligned_alloc(_Alignof(struct key_worker_shard),
+                                 shards * sizeof(struct key_worker_shard));
+    pool->threads = calloc(workers, sizeof(struct key_worker_thread));
+    if (!pool->shards || !pool->threads) {
+        fprintf(stderr, "Failed to initialize key worker pool\n");
+        free(pool->shards);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+    memset(pool->shards, 0, shards * sizeof(struct key_worker_shard));
+
+    for (; pool->nr_shards < shards; pool->nr_shards++) {
+        struct key_worker_shard *shard = &pool->shards[pool->nr_shards];
+
+        shard->queue = mpmc_queue_new(shard_size, sizeof(struct key_work_item));
+        if (!shard->queue || sem_init(&shard->ready, 0, 0) < 0) {
+            fprintf(stderr, "Failed to initialize key worker pool\n");
+            mpmc_queue_free(shard->queue);
+            free_shards(pool);
+            free(pool->threads);
+            free(pool);
+            return NULL;
+        }
+    }
+
+    pool->handler = handler;
+    pool->on_exit = on_exit;
+    pool->ctx = ctx;
+    pool->start_ns = now_ns();
+
+    for (__u32 i = 0; i < workers; i++) {
+        struct key_worker_thread *t = &pool->threads[pool->started];
+        int err;
+
+        t->pool = pool;
+        t->index = i % shards;
+        t->shard = &pool->shards[t->index];
+        err = pthread_create(&t->thread, NULL, worker_main, t);
+        if (err) {
+            fprintf(stderr, "Failed to start key worker %u: %s\n", i, strerror(err));
+            break;
+        }
+        t->shard->workers++;
+        pool->started++;
+    }
+
+    /* 线程未能全部启动时，没有工作线程的分片上的事件无人处理 */
+    for (__u32 i = 0; i < shards; i++) {
+        if (pool->shards[i].workers == 0) {
+            key_worker_pool_free(pool);
+            return NULL;
+        }
+    }
+
+    if (shards > 1) {
+        printf("Key worker pool started (%u workers, %u shards, queue capacity %zu per shard)\n",
+               pool->started, shards, mpmc_queue_capacity(pool->shards[0].queue));
+    } else {
+        printf("Key worker pool started (%u workers, queue capacity %zu)\n",
+               pool->started, mpmc_queue_capacity(pool->shards[0].queue));
+    }
+    return pool;
+}
+
+/**
+ * 提交事件
+ * 在事件消费者线程中提交到该消费者对应的分片；其他线程（事件循环、回放）
+ * 按端口散列到各分片，避免只有一个分片有事件
+ */
+int key_worker_submit(struct key_worker_pool *pool, const struct tcp_connect_event *event) {
+    struct key_worker_shard *shard;
+    struct key_work_item item;
+    int id = event_source_consumer_id();
+
+    if (id >= 0) {
+        shard = &pool->shards[(__u32)id % pool->nr_shards];
+    } else {
+        shard = &pool->shards[(__u32)(event->sport ^ event->dport) % pool->nr_shards];
+    }
+    item.event = *event;
+    item.enqueue_ns = now_ns();
+
+    if (mpmc_queue_push(shard->queue, &item) < 0) {
+        atomic_fetch_add_explicit(&shard->dropped, 1, memory_order_relaxed);
+        return -1;
+    }
+
+    atomic_fetch_add_explicit(&shard->submitted, 1, memory_order_relaxed);
+    atomic_max(&shard->max_depth, mpmc_queue_depth(shard->queue));
+    sem_post(&shard->ready);
+    return 0;
+}
+
+/**
+ * 获取线程池统计（各分片累加，峰值为各分片峰值之和）
+ */
+void key_worker_get_stats(struct key_worker_pool *pool, struct key_worker_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!pool) {
+        return;
+    }
+
+    for (__u32 i = 0; i < pool->nr_shards; i++) {
+        struct key_worker_shard *shard = &pool->shards[i];
+        __u64 wait_max = atomic_load(&shard->wait_max_ns);
+
+        stats->submitted += atomic_load(&shard->submitted);
+        stats->dropped += atomic_load(&shard->dropped);
+        stats->completed += atomic_load(&shard->completed);
+        stats->queue_depth += mpmc_queue_depth(shard->queue);
+        stats->queue_max_depth += atomic_load(&shard->max_depth);
+        stats->queue_capacity += mpmc_queue_capacity(shard->queue);
+        stats->wait_total_ns += atomic_load(&shard->wait_total_ns);
+        if (wait_max > stats->wait_max_ns) {
+            stats->wait_max_ns = wait_max;
+        }
+        stats->busy_ns += atomic_load(&shard->busy_ns);
+        stats->stolen += atomic_load(&shard->stolen);
+    }
+    stats->elapsed_ns = now_ns() - pool->start_ns;
+    stats->workers = pool->started;
+    stats->shards = pool->nr_shards;
+}
+
+/**
+ * 停止线程池
+ */
+void key_worker_pool_stop(struct key_worker_pool *pool) {
+    struct key_work_item item;
+
+    if (!pool || atomic_exchange(&pool->stop, 1)) {
+        return;
+    }
+
+    for (__u32 i = 0; i < pool->started; i++) {
+        sem_post(&pool->threads[i].shard->ready);
+    }
+    for (__u32 i = 0; i < pool->started; i++) {
+        pthread_join(pool->threads[i].thread, NULL);
+    }
+
+    for (__u32 i = 0; i < pool->nr_shards; i++) {
+        struct key_worker_shard *shard = &pool->shards[i];
+
+        while (mpmc_queue_pop(shard->queue, &item) == 0) {
+            atomic_fetch_add_explicit(&shard->dropped, 1, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * 释放线程池
+ */
+void key_worker_pool_free(struct key_worker_pool *pool) {
+    if (!pool) {
+        return;
+    }
+
+    key_worker_pool_stop(pool);
+    free_shards(pool);
+    free(pool->threads);
+    free(pool);
+}
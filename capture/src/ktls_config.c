@@ -1,10 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/socket.h>
 #include <netinet/tcp.h>
 #include <linux/tls.h>
 #include "ktls_config.h"
+#include "log.h"
 
 /**
  * 为 Socket 配置 KTLS
@@ -15,18 +17,18 @@ int configure_ktls(int sockfd, struct tls_key_info *key_info) {
     /* 启用 KTLS 发送 */
     ret = enable_ktls_tx(sockfd, key_info);
     if (ret < 0) {
-        fprintf(stderr, "Failed to enable KTLS TX\n");
+        log_warn("Failed to enable KTLS TX on socket %d", sockfd);
         return ret;
     }
     
     /* 启用 KTLS 接收 */
     ret = enable_ktls_rx(sockfd, key_info);
     if (ret < 0) {
-        fprintf(stderr, "Failed to enable KTLS RX\n");
+        log_warn("Failed to enable KTLS RX on socket %d", sockfd);
         return ret;
     }
     
-    printf("KTLS configured successfully for socket %d\n", sockfd);
+    log_debug("KTLS configured successfully for socket %d", sockfd);
     return 0;
 }
 
@@ -40,7 +42,7 @@ int enable_ktls_tx(int sockfd, struct tls_key_info *key_info) {
     /* 首先启用 TLS ULP (Upper Layer Protocol) */
     ret = setsockopt(sockfd, SOL_TCP, TCP_ULP, "tls", sizeof("tls"));
     if (ret < 0) {
-        perror("Failed to set TCP_ULP");
+        log_warn("Failed to set TCP_ULP: %s", strerror(errno));
         return ret;
     }
     
@@ -62,7 +64,7 @@ int enable_ktls_tx(int sockfd, struct tls_key_info *key_info) {
         memcpy(crypto_info.iv, key_info->iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE, 
                TLS_CIPHER_AES_GCM_128_IV_SIZE);
     } else {
-        fprintf(stderr, "Warning: IV length insufficient, using zero padding\n");
+        log_warn("IV length insufficient, using zero padding");
         memcpy(crypto_info.salt, key_info->iv, 
                key_info->iv_len < 4 ? key_info->iv_len : 4);
     }
@@ -70,11 +72,11 @@ int enable_ktls_tx(int sockfd, struct tls_key_info *key_info) {
     /* 配置发送密钥 */
     ret = setsockopt(sockfd, SOL_TLS, TLS_TX, &crypto_info, sizeof(crypto_info));
     if (ret < 0) {
-        perror("Failed to set TLS_TX");
+        log_warn("Failed to set TLS_TX: %s", strerror(errno));
         return ret;
     }
     
-    printf("KTLS TX enabled for socket %d\n", sockfd);
+    log_debug("KTLS TX enabled for socket %d", sockfd);
     return 0;
 }
 
@@ -103,7 +105,7 @@ int enable_ktls_rx(int sockfd, struct tls_key_info *key_info) {
         memcpy(crypto_info.iv, key_info->iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE, 
                TLS_CIPHER_AES_GCM_128_IV_SIZE);
     } else {
-        fprintf(stderr, "Warning: IV length insufficient, using zero padding\n");
+        log_warn("IV length insufficient, using zero padding");
         memcpy(crypto_info.salt, key_info->iv, 
                key_info->iv_len < 4 ? key_info->iv_len : 4);
     }
@@ -111,10 +113,10 @@ int enable_ktls_rx(int sockfd, struct tls_key_info *key_info) {
     /* 配置接收密钥 */
     ret = setsockopt(sockfd, SOL_TLS, TLS_RX, &crypto_info, sizeof(crypto_info));
     if (ret < 0) {
-        perror("Failed to set TLS_RX");
+        log_warn("Failed to set TLS_RX: %s", strerror(errno));
         return ret;
     }
     
-    printf("KTLS RX enabled for socket %d\n", sockfd);
+    log_debug("KTLS RX enabled for socket %d", sockfd);
     return 0;
 }
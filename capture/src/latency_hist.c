@@ -0,0 +1,87 @@
+#include <string.h>
+#include "latency_hist.h"
+
+/*
+ * 小于 LATENCY_HIST_SUB_BUCKETS 的值每个值一个桶；
+ * 其余值按最高有效位 msb 分组，组内由 msb 之后的 LATENCY_HIST_SUB_BITS 位定位
+ */
+static __u32 bucket_index(__u64 ns) {
+    __u32 msb, shift;
+
+    if (ns < LATENCY_HIST_SUB_BUCKETS) {
+        return (__u32)ns;
+    }
+    msb = 63 - __builtin_clzll(ns);
+    shift = msb - LATENCY_HIST_SUB_BITS;
+    return (shift + 1) * LATENCY_HIST_SUB_BUCKETS +
+           (__u32)((ns >> shift) & (LATENCY_HIST_SUB_BUCKETS - 1));
+}
+
+/* 桶内的最大值 */
+static __u64 bucket_upper(__u32 index) {
+    __u32 group = index / LATENCY_HIST_SUB_BUCKETS;
+    __u64 sub = index % LATENCY_HIST_SUB_BUCKETS;
+    __u32 shift;
+
+    if (group == 0) {
+        return sub;
+    }
+    shift = group - 1;
+    return ((LATENCY_HIST_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+/**
+ * 清空直方图
+ */
+void latency_hist_reset(struct latency_hist *hist) {
+    memset(hist, 0, sizeof(*hist));
+}
+
+/**
+ * 记录一个样本
+ */
+void latency_hist_record(struct latency_hist *hist, __u64 ns) {
+    __u64 cur;
+
+    __atomic_fetch_add(&hist->buckets[bucket_index(ns)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum_ns, ns, __ATOMIC_RELAXED);
+
+    cur = __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED);
+    while (ns > cur &&
+           !__atomic_compare_exchange_n(&hist->max_ns, &cur, ns, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        ;
+    }
+}
+
+/**
+ * 计算分位数
+ */
+__u64 latency_hist_quantile(const struct latency_hist *hist, double quantile) {
+    __u64 count = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+    __u64 max = __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED);
+    __u64 rank, seen = 0;
+
+    if (count == 0) {
+        return 0;
+    }
+    if (quantile <= 0) {
+        quantile = 0;
+    } else if (quantile > 1) {
+        quantile = 1;
+    }
+    rank = (__u64)(quantile * count);
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    for (__u32 i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        seen += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+        if (seen >= rank) {
+            __u64 upper = bucket_upper(i);
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
@@ -0,0 +1,617 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include "log.h"
+
+#define CACHE_LINE_SIZE 64
+#define LOG_STR_BYTES 192
+#define LOG_LINE_MAX 1024
+#define LOG_SPEC_MAX 32
+
+/*
+ * 一条日志记录：格式串指针、参数原值，字符串参数复制到 strs 中（args[i].i 为偏移）
+ */
+struct log_record {
+    __u64 ts_ns;
+    const char *fmt;
+    __u32 tid;
+    __u8 level;
+    __u8 nargs;
+    __u16 str_used;
+    struct log_arg args[LOG_MAX_ARGS];
+    char strs[LOG_STR_BYTES];
+};
+
+/*
+ * 每线程环形缓冲区：只有所属线程写入 head，只有刷新线程写入 tail
+ */
+struct log_ring {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+
+    /* 生产者私有 */
+    _Alignas(CACHE_LINE_SIZE) __u64 rate_second;
+    __u32 rate_count;
+    atomic_ullong dropped;
+    atomic_ullong suppressed;
+
+    /* 刷新线程私有 */
+    _Alignas(CACHE_LINE_SIZE) __u64 dropped_reported;
+    __u64 suppressed_reported;
+
+    size_t mask;
+    __u32 tid;
+    atomic_int closed;              /* 所属线程已退出，取空后释放 */
+    struct log_ring *next;
+    struct log_record *records;
+};
+
+static struct {
+    struct log_config cfg;
+    atomic_int level;
+    atomic_int running;
+    _Atomic(struct log_ring *) rings;
+    pthread_t flusher;
+    pthread_key_t key;
+    int key_created;
+    FILE *out;                      /* 输出文件，NULL 表示 stdout/stderr */
+    atomic_ullong written;
+    atomic_ullong dropped;
+    atomic_ullong suppressed;
+} g_log = { .level = LOG_LEVEL_INFO };
+
+/* 线程的环形缓冲区在线程退出前一直有效（log_shutdown 也只释放已退出线程的缓冲区） */
+static __thread struct log_ring *t_ring;
+
+/* 缓冲区已交给刷新线程释放；之后运行的其他 TLS 析构函数中的日志直接丢弃 */
+static __thread int t_released;
+
+static const char *level_names[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+static const char *level_json_names[] = { "debug", "info", "warn", "error" };
+
+static __u32 current_tid(void) {
+    return (__u32)syscall(SYS_gettid);
+}
+
+static __u64 realtime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * 线程退出时标记其环形缓冲区，由刷新线程取空后释放
+ * 在退出线程中执行，同时清除线程私有指针，避免之后的析构函数写入已释放的缓冲区
+ */
+static void ring_release(void *arg) {
+    struct log_ring *ring = arg;
+
+    t_ring = NULL;
+    t_released = 1;
+    atomic_store_explicit(&ring->closed, 1, memory_order_release);
+}
+
+/**
+ * 为当前线程创建环形缓冲区并加入全局链表
+ */
+static struct log_ring *ring_create(void) {
+    struct log_ring *ring;
+    size_t size = 2;
+
+    while (size < g_log.cfg.ring_size) {
+        size <<= 1;
+    }
+
+    ring = aligned_alloc(CACHE_LINE_SIZE, sizeof(*ring));
+    if (!ring) {
+        return NULL;
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->records = calloc(size, sizeof(struct log_record));
+    if (!ring->records) {
+        free(ring);
+        return NULL;
+    }
+    ring->mask = size - 1;
+    ring->tid = current_tid();
+
+    /* 新节点只会插在链表头，刷新线程摘除非头节点时不会与之冲突 */
+    ring->next = atomic_load_explicit(&g_log.rings, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&g_log.rings, &ring->next, ring,
+                                                  memory_order_release,
+                                                  memory_order_relaxed)) {
+        ;
+    }
+    pthread_setspecific(g_log.key, ring);
+    return ring;
+}
+
+/**
+ * 填充记录：复制参数，字符串参数复制到记录内（放不下时截断）
+ */
+static void record_fill(struct log_record *r, enum log_level level, const char *fmt,
+                        int nargs, const struct log_arg *args, __u64 ts_ns, __u32 tid) {
+    r->ts_ns = ts_ns;
+    r->fmt = fmt;
+    r->tid = tid;
+    r->level = (__u8)level;
+    r->nargs = (__u8)(nargs < LOG_MAX_ARGS ? nargs : LOG_MAX_ARGS);
+    r->str_used = 0;
+
+    for (int i = 0; i < r->nargs; i++) {
+        r->args[i] = args[i];
+        if (args[i].type == LOG_ARG_STR) {
+            const char *s = args[i].s ? args[i].s : "(null)";
+            size_t room = LOG_STR_BYTES - r->str_used;
+            size_t len = strnlen(s, room ? room - 1 : 0);
+
+            r->args[i].i = r->str_used;
+            if (room == 0) {
+                r->args[i].i = LOG_STR_BYTES - 1;
+                continue;
+            }
+            memcpy(r->strs + r->str_used, s, len);
+            r->strs[r->str_used + len] = '\0';
+            r->str_used += len + 1;
+        }
+    }
+}
+
+/**
+ * 按一个转换说明格式化单个参数
+ * spec 为完整的转换说明（如 "%-8llu"），length 为长度修饰，conv 为转换字符
+ */
+static int format_arg(char *buf, size_t len, const char *spec, const char *length, char conv,
+                      const struct log_record *r, const struct log_arg *arg) {
+    unsigned long long v = arg->i;
+
+    switch (conv) {
+        case 'd':
+        case 'i':
+            if (strcmp(length, "hh") == 0) {
+                return snprintf(buf, len, spec, (signed char)v);
+            } else if (strcmp(length, "h") == 0) {
+                return snprintf(buf, len, spec, (short)v);
+            } else if (strcmp(length, "l") == 0) {
+                return snprintf(buf, len, spec, (long)v);
+            } else if (strcmp(length, "ll") == 0 || strcmp(length, "j") == 0) {
+                return snprintf(buf, len, spec, (long long)v);
+            } else if (strcmp(length, "z") == 0 || strcmp(length, "t") == 0) {
+                return snprintf(buf, len, spec, (ssize_t)v);
+            }
+            return snprintf(buf, len, spec, (int)v);
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            if (strcmp(length, "hh") == 0) {
+                return snprintf(buf, len, spec, (unsigned char)v);
+            } else if (strcmp(length, "h") == 0) {
+                return snprintf(buf, len, spec, (unsigned short)v);
+            } else if (strcmp(length, "l") == 0) {
+                return snprintf(buf, len, spec, (unsigned long)v);
+            } else if (strcmp(length, "ll") == 0 || strcmp(length, "j") == 0) {
+                return snprintf(buf, len, spec, v);
+            } else if (strcmp(length, "z") == 0 || strcmp(length, "t") == 0) {
+                return snprintf(buf, len, spec, (size_t)v);
+            }
+            return snprintf(buf, len, spec, (unsigned int)v);
+        case 'c':
+            return snprintf(buf, len, spec, (int)v);
+        case 's':
+            return snprintf(buf, len, spec,
+                            arg->type == LOG_ARG_STR ? r->strs + arg->i : "?");
+        case 'p':
+            return snprintf(buf, len, spec, arg->p);
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (strcmp(length, "L") == 0) {
+                return snprintf(buf, len, spec, (long double)arg->d);
+            }
+            return snprintf(buf, len, spec, arg->d);
+        default:
+            return snprintf(buf, len, "%s", spec);
+    }
+}
+
+/**
+ * 按格式串和记录中的参数生成消息（在刷新线程中执行）
+ */
+static size_t format_message(const struct log_record *r, char *buf, size_t len) {
+    const char *p = r->fmt;
+    size_t out = 0;
+    int argi = 0;
+
+    while (*p && out + 1 < len) {
+        char spec[LOG_SPEC_MAX], length[3] = "";
+        size_t sl = 0, ll = 0;
+        int n;
+
+        if (*p != '%') {
+            buf[out++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            buf[out++] = '%';
+            p += 2;
+            continue;
+        }
+
+        /* 转换说明：% [标志] [宽度] [.精度] [长度] 转换字符 */
+        spec[sl++] = *p++;
+        while (*p && strchr("-+ #0", *p) && sl < LOG_SPEC_MAX - 4) {
+            spec[sl++] = *p++;
+        }
+        while (*p && (*p == '.' || (*p >= '0' && *p <= '9')) && sl < LOG_SPEC_MAX - 4) {
+            spec[sl++] = *p++;
+        }
+        while (*p && strchr("hlzjtL", *p) && ll < 2) {
+            length[ll++] = *p;
+            spec[sl++] = *p++;
+        }
+        length[ll] = '\0';
+        if (!*p) {
+            break;
+        }
+        spec[sl++] = *p++;
+        spec[sl] = '\0';
+
+        if (argi >= r->nargs) {
+            n = snprintf(buf + out, len - out, "%s", spec);
+        } else {
+            n = format_arg(buf + out, len - out, spec, length, spec[sl - 1], r, &r->args[argi++]);
+        }
+        if (n < 0) {
+            break;
+        }
+        out += (size_t)n < len - out ? (size_t)n : len - out - 1;
+    }
+
+    /* 消息末尾的换行由输出格式统一添加 */
+    while (out > 0 && buf[out - 1] == '\n') {
+        out--;
+    }
+    buf[out] = '\0';
+    return out;
+}
+
+/**
+ * 以 JSON 字符串形式写出消息
+ */
+static void write_json_string(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+
+        if (c == '"' || c == '\\') {
+            fputc('\\', fp);
+            fputc(c, fp);
+        } else if (c == '\n') {
+            fputs("\\n", fp);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+/**
+ * 格式化并写出一条记录
+ */
+static void write_record(const struct log_record *r) {
+    char msg[LOG_LINE_MAX];
+    char ts[32];
+    time_t sec = (time_t)(r->ts_ns / 1000000000ULL);
+    struct tm tm;
+    FILE *fp = g_log.out;
+
+    if (!fp) {
+        fp = r->level >= LOG_LEVEL_WARN ? stderr : stdout;
+    }
+
+    format_message(r, msg, sizeof(msg));
+    gmtime_r(&sec, &tm);
+    strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", &tm);
+
+    if (g_log.cfg.format == LOG_FORMAT_JSON) {
+        fprintf(fp, "{\"ts\":\"%s.%06lluZ\",\"level\":\"%s\",\"tid\":%u,\"msg\":",
+                ts, (r->ts_ns % 1000000000ULL) / 1000, level_json_names[r->level], r->tid);
+        write_json_string(fp, msg);
+        fputs("}\n", fp);
+    } else {
+        fprintf(fp, "%s.%06lluZ %-5s [%u] %s\n",
+                ts, (r->ts_ns % 1000000000ULL) / 1000, level_names[r->level], r->tid, msg);
+    }
+}
+
+/**
+ * 写出一条由日志模块自身产生的记录（丢弃/限流提示）
+ */
+static void write_notice(__u32 tid, const char *fmt, unsigned long long count) {
+    struct log_record r;
+    struct log_arg arg = log_arg_int(count);
+
+    record_fill(&r, LOG_LEVEL_WARN, fmt, 1, &arg, realtime_ns(), tid);
+    write_record(&r);
+}
+
+/**
+ * 取空一个环形缓冲区，并报告新增的丢弃和限流数
+ * @return: 写出的记录数
+ */
+static __u64 drain_ring(struct log_ring *ring) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    __u64 n = 0, dropped, suppressed;
+
+    while (tail != head) {
+        write_record(&ring->records[tail & ring->mask]);
+        tail++;
+        n++;
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+        if (tail == head) {
+            head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        }
+    }
+
+    dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    if (dropped != ring->dropped_reported) {
+        write_notice(ring->tid, "%llu log records dropped (ring full)",
+                     dropped - ring->dropped_reported);
+        atomic_fetch_add(&g_log.dropped, dropped - ring->dropped_reported);
+        ring->dropped_reported = dropped;
+    }
+    suppressed = atomic_load_explicit(&ring->suppressed, memory_order_relaxed);
+    if (suppressed != ring->suppressed_reported) {
+        write_notice(ring->tid, "%llu log records suppressed (rate limit)",
+                     suppressed - ring->suppressed_reported);
+        atomic_fetch_add(&g_log.suppressed, suppressed - ring->suppressed_reported);
+        ring->suppressed_reported = suppressed;
+    }
+    return n;
+}
+
+static void ring_free(struct log_ring *ring) {
+    free(ring->records);
+    free(ring);
+}
+
+/**
+ * 取空所有环形缓冲区，释放已退出线程的缓冲区
+ */
+static void drain_all(void) {
+    struct log_ring *head = atomic_load_explicit(&g_log.rings, memory_order_acquire);
+    struct log_ring *prev = NULL, *ring = head;
+    __u64 n = 0;
+
+    while (ring) {
+        struct log_ring *next = ring->next;
+        int closed = atomic_load_explicit(&ring->closed, memory_order_acquire);
+
+        n += drain_ring(ring);
+
+        /*
+         * 链表头可能正被新线程 CAS 插入：头节点同样用 CAS 摘除，
+         * 失败说明已有新节点插在前面，留到下一轮作为非头节点摘除
+         */
+        if (closed && prev) {
+            prev->next = next;
+            ring_free(ring);
+        } else if (closed &&
+                   atomic_compare_exchange_strong_explicit(&g_log.rings, &head, next,
+                                                           memory_order_acq_rel,
+                                                           memory_order_acquire)) {
+            head = next;
+            ring_free(ring);
+        } else {
+            prev = ring;
+        }
+        ring = next;
+    }
+
+    if (n > 0) {
+        atomic_fetch_add(&g_log.written, n);
+        fflush(g_log.out ? g_log.out : stdout);
+        if (!g_log.out) {
+            fflush(stderr);
+        }
+    }
+}
+
+/**
+ * 后台刷新线程
+ */
+static void *flusher_main(void *arg) {
+    struct timespec interval = {
+        .tv_sec = g_log.cfg.flush_interval_ms / 1000,
+        .tv_nsec = (long)(g_log.cfg.flush_interval_ms % 1000) * 1000000L,
+    };
+
+    (void)arg;
+    while (atomic_load(&g_log.running)) {
+        drain_all();
+        nanosleep(&interval, NULL);
+    }
+    return NULL;
+}
+
+/**
+ * 初始化日志并启动后台刷新线程
+ */
+int log_init(const struct log_config *config) {
+    int err;
+
+    if (atomic_load(&g_log.running)) {
+        return 0;
+    }
+
+    memset(&g_log.cfg, 0, sizeof(g_log.cfg));
+    if (config) {
+        g_log.cfg = *config;
+    }
+    if (g_log.cfg.ring_size == 0) {
+        g_log.cfg.ring_size = LOG_DEFAULT_RING_SIZE;
+    }
+    if (g_log.cfg.flush_interval_ms == 0) {
+        g_log.cfg.flush_interval_ms = LOG_DEFAULT_FLUSH_INTERVAL_MS;
+    }
+    atomic_store(&g_log.level, g_log.cfg.level);
+
+    if (g_log.cfg.path) {
+        g_log.out = fopen(g_log.cfg.path, "a");
+        if (!g_log.out) {
+            fprintf(stderr, "Failed to open log file %s: %s\n", g_log.cfg.path, strerror(errno));
+            return -1;
+        }
+    }
+
+    if (!g_log.key_created) {
+        if (pthread_key_create(&g_log.key, ring_release) != 0) {
+            fprintf(stderr, "Failed to create log thread key\n");
+            goto err;
+        }
+        g_log.key_created = 1;
+    }
+
+    atomic_store(&g_log.running, 1);
+    err = pthread_create(&g_log.flusher, NULL, flusher_main, NULL);
+    if (err) {
+        fprintf(stderr, "Failed to start log flusher: %s\n", strerror(err));
+        atomic_store(&g_log.running, 0);
+        goto err;
+    }
+    return 0;
+
+err:
+    if (g_log.out) {
+        fclose(g_log.out);
+        g_log.out = NULL;
+    }
+    return -1;
+}
+
+/**
+ * 记录一条日志
+ */
+void log_emit(enum log_level level, const char *fmt, int nargs, const struct log_arg *args) {
+    struct log_ring *ring;
+    size_t head, tail;
+    __u64 ts_ns;
+
+    if ((int)level < atomic_load_explicit(&g_log.level, memory_order_relaxed) ||
+        level >= LOG_LEVEL_OFF) {
+        return;
+    }
+    ts_ns = realtime_ns();
+
+    /* 未启动后台线程时同步输出 */
+    if (!atomic_load_explicit(&g_log.running, memory_order_acquire)) {
+        struct log_record r;
+
+        record_fill(&r, level, fmt, nargs, args, ts_ns, current_tid());
+        write_record(&r);
+        return;
+    }
+
+    ring = t_ring;
+    if (!ring) {
+        if (t_released) {
+            atomic_fetch_add(&g_log.dropped, 1);
+            return;
+        }
+        ring = ring_create();
+        if (!ring) {
+            atomic_fetch_add(&g_log.dropped, 1);
+            return;
+        }
+        t_ring = ring;
+    }
+
+    /* 每线程每秒限流，超出部分只计数，由刷新线程汇总提示 */
+    if (g_log.cfg.rate_limit) {
+        __u64 second = ts_ns / 1000000000ULL;
+
+        if (second != ring->rate_second) {
+            ring->rate_second = second;
+            ring->rate_count = 0;
+        }
+        if (++ring->rate_count > g_log.cfg.rate_limit) {
+            atomic_store_explicit(&ring->suppressed,
+                                  atomic_load_explicit(&ring->suppressed, memory_order_relaxed) + 1,
+                                  memory_order_relaxed);
+            return;
+        }
+    }
+
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail > ring->mask) {
+        atomic_store_explicit(&ring->dropped,
+                              atomic_load_explicit(&ring->dropped, memory_order_relaxed) + 1,
+                              memory_order_relaxed);
+        return;
+    }
+
+    record_fill(&ring->records[head & ring->mask], level, fmt, nargs, args, ts_ns, ring->tid);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * 获取日志统计
+ */
+void log_get_stats(struct log_stats *stats) {
+    stats->written = atomic_load(&g_log.written);
+    stats->dropped = atomic_load(&g_log.dropped);
+    stats->suppressed = atomic_load(&g_log.suppressed);
+}
+
+/**
+ * 停止后台线程并写出剩余记录
+ * 之后的日志同步输出；仍存活线程的缓冲区保留，线程私有指针不会悬空
+ */
+void log_shutdown(void) {
+    if (!atomic_exchange(&g_log.running, 0)) {
+        return;
+    }
+    pthread_join(g_log.flusher, NULL);
+    drain_all();
+
+    if (g_log.out) {
+        fclose(g_log.out);
+        g_log.out = NULL;
+    }
+}
+
+/**
+ * 解析级别名称
+ */
+int log_level_parse(const char *name) {
+    if (strcasecmp(name, "debug") == 0) {
+        return LOG_LEVEL_DEBUG;
+    } else if (strcasecmp(name, "info") == 0) {
+        return LOG_LEVEL_INFO;
+    } else if (strcasecmp(name, "warn") == 0 || strcasecmp(name, "warning") == 0) {
+        return LOG_LEVEL_WARN;
+    } else if (strcasecmp(name, "error") == 0) {
+        return LOG_LEVEL_ERROR;
+    } else if (strcasecmp(name, "off") == 0) {
+        return LOG_LEVEL_OFF;
+    }
+    return -1;
+}
@@ -1,86 +1,156 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
 #include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <arpa/inet.h>
 #include <bpf/libbpf.h>
 #include <bpf/bpf.h>
-/* Try to include libbpf_version.h for version detection */
-#ifdef __has_include
-  #if __has_include(<bpf/libbpf_version.h>)
-    #include <bpf/libbpf_version.h>
-  #endif
-#endif
 #include "capture.h"
+#include "capture_events.h"
+#include "bpf_loader.h"
+#include "event_source.h"
+#include "event_replay.h"
+#include "latency_hist.h"
+#include "key_worker.h"
+#include "backpressure.h"
 #include "key_provider.h"
 #include "ktls_config.h"
 #include "pod_mapping.h"
 #include "performance_metrics.h"
+#include "log.h"
 
 #define DEFAULT_CONFIG_FILE "/etc/tlshub/capture.conf"
 #define DEFAULT_POD_NODE_CONFIG "/etc/tlshub/pod_node_mapping.conf"
 #define DEFAULT_MAX_CONNECTIONS 1000
 #define PERF_UPDATE_INTERVAL_SEC 5
+#define DEFAULT_RINGBUF_WAKEUP_BATCH 1
+#define DEFAULT_CGROUP_PATH "/sys/fs/cgroup"
+#define EVENT_FLUSH_INTERVAL_MS 100
+#define MAX_LOOP_EVENTS 8
 
-static volatile int keep_running = 1;
-static struct bpf_object *obj = NULL;
-static struct bpf_link *links[10] = {NULL};
-static int link_count = 0;
+/* 事件循环中各文件描述符的标识（epoll_event.data.u32） */
+enum loop_source {
+    LOOP_EVENTS = 0,    /* ring buffer / perf buffer */
+    LOOP_NETLINK,       /* TLSHub 内核推送的消息 */
+    LOOP_METRICS,       /* 周期性更新性能指标 */
+    LOOP_FLUSH,         /* 取走未达到唤醒批量的 ring buffer 事件 */
+    LOOP_SIGNAL,        /* SIGINT / SIGTERM */
+    LOOP_BACKPRESSURE,  /* 检查事件丢失并调整内核背压模式 */
+    LOOP_REPLAY,        /* 回放线程已注入全部事件 */
+};
+
+static struct bpf_loader loader = { .cgroup_fd = -1 };
 static struct pod_node_table *pod_node_table = NULL;
 static struct perf_metrics_ctx *perf_ctx = NULL;
+static struct key_worker_pool *key_workers = NULL;
+static struct backpressure backpressure;
+static struct event_recorder *recorder = NULL;
 
-/* TCP 连接事件 */
-struct tcp_connect_event {
-    __u32 saddr;
-    __u32 daddr;
-    __u16 sport;
-    __u16 dport;
-    __u32 pid;
-    __u64 timestamp;
-};
+/* 回放时统计事件注入到密钥就绪的端到端延迟 */
+static int replaying = 0;
+static struct latency_hist pipeline_latency;
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * 将文件描述符加入事件循环
+ */
+static int loop_add(int epoll_fd, int fd, enum loop_source source) {
+    struct epoll_event ev;
+    
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = source;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 创建周期性 timerfd
+ */
+static int create_timer(long interval_ms) {
+    struct itimerspec its;
+    int fd;
+    
+    fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        perror("timerfd_create");
+        return -1;
+    }
+    
+    its.it_interval.tv_sec = interval_ms / 1000;
+    its.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+    its.it_value = its.it_interval;
+    if (timerfd_settime(fd, 0, &its, NULL) < 0) {
+        perror("timerfd_settime");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
 
 /**
- * 信号处理函数
+ * 读取 timerfd 的到期次数，清除可读状态
  */
-static void sig_handler(int sig) {
-    keep_running = 0;
-    printf("\nReceived signal %d, shutting down...\n", sig);
+static void drain_timer(int fd) {
+    uint64_t expirations;
+    
+    if (read(fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        perror("read timerfd");
+    }
 }
 
 /**
- * 处理 TCP 连接事件
+ * 处理 TCP 连接事件（在密钥协商工作线程中执行）
  */
-static void handle_tcp_event(void *ctx, int cpu, void *data, __u32 data_sz) {
-    struct tcp_connect_event *event = (struct tcp_connect_event *)data;
+static void process_tcp_event(void *ctx, const struct tcp_connect_event *event) {
     struct flow_tuple tuple;
     struct tls_key_info key_info;
+    char saddr_str[INET6_ADDRSTRLEN];
+    char daddr_str[INET6_ADDRSTRLEN];
     int sockfd;
     int ret;
     int conn_index = -1;
     __u64 connection_id;
     
-    printf("\n=== New TCP Connection Detected ===\n");
-    printf("Source: %u.%u.%u.%u:%u\n",
-           (event->saddr) & 0xFF,
-           (event->saddr >> 8) & 0xFF,
-           (event->saddr >> 16) & 0xFF,
-           (event->saddr >> 24) & 0xFF,
-           event->sport);
-    printf("Destination: %u.%u.%u.%u:%u\n",
-           (event->daddr) & 0xFF,
-           (event->daddr >> 8) & 0xFF,
-           (event->daddr >> 16) & 0xFF,
-           (event->daddr >> 24) & 0xFF,
-           event->dport);
-    printf("PID: %u\n", event->pid);
-    printf("Timestamp: %llu\n", event->timestamp);
-    
-    /* 准备四元组信息 */
-    tuple.saddr = event->saddr;
-    tuple.daddr = event->daddr;
-    tuple.sport = event->sport;
-    tuple.dport = event->dport;
+    /* 准备四元组信息：事件中是本机 -> 对端，四元组统一为客户端 -> 服务端 */
+    memset(&tuple, 0, sizeof(tuple));
+    tuple.family = event->family == CAPTURE_AF_INET6 ? AF_INET6 : AF_INET;
+    if (event->flags & CAPTURE_EVENT_F_SERVER) {
+        tuple.role = FLOW_ROLE_SERVER;
+        memcpy(tuple.saddr6, event->daddr6, sizeof(tuple.saddr6));
+        memcpy(tuple.daddr6, event->saddr6, sizeof(tuple.daddr6));
+        tuple.sport = event->dport;
+        tuple.dport = event->sport;
+    } else {
+        tuple.role = FLOW_ROLE_CLIENT;
+        memcpy(tuple.saddr6, event->saddr6, sizeof(tuple.saddr6));
+        memcpy(tuple.daddr6, event->daddr6, sizeof(tuple.daddr6));
+        tuple.sport = event->sport;
+        tuple.dport = event->dport;
+    }
+    
+    inet_ntop(tuple.family, tuple.saddr6, saddr_str, sizeof(saddr_str));
+    inet_ntop(tuple.family, tuple.daddr6, daddr_str, sizeof(daddr_str));
+    
+    log_info("New TCP connection (%s): %s:%u -> %s:%u pid %u ts %llu",
+             tuple.role == FLOW_ROLE_SERVER ? "server" : "client",
+             saddr_str, tuple.sport, daddr_str, tuple.dport, event->pid, event->timestamp);
     
     /* 性能指标：记录连接开始 */
     if (perf_ctx) {
@@ -94,7 +164,7 @@ static void handle_tcp_event(void *ctx, int cpu, void *data, __u32 data_sz) {
     }
     
     /* 获取密钥 */
-    printf("Fetching TLS key...\n");
+    log_debug("Fetching TLS key...");
     
     /* 性能指标：开始测量密钥协商时间 */
     if (perf_ctx && conn_index >= 0) {
@@ -103,13 +173,19 @@ static void handle_tcp_event(void *ctx, int cpu, void *data, __u32 data_sz) {
     
     ret = key_provider_get_key(&tuple, &key_info);
     
+    /* 回放时事件的 timestamp 为注入时刻，这里即为排队 + 协商的端到端延迟 */
+    if (replaying) {
+        latency_hist_record(&pipeline_latency, now_ns() - event->timestamp);
+    }
+    
     /* 性能指标：结束测量密钥协商时间 */
     if (perf_ctx && conn_index >= 0) {
         perf_metrics_key_negotiation_end(perf_ctx, conn_index);
     }
     
     if (ret < 0) {
-        fprintf(stderr, "Failed to get TLS key\n");
+        log_warn("Failed to get TLS key for %s:%u -> %s:%u",
+                 saddr_str, tuple.sport, daddr_str, tuple.dport);
         /* 性能指标：记录连接失败 */
         if (perf_ctx && conn_index >= 0) {
             perf_metrics_connection_end(perf_ctx, conn_index, 0);
@@ -117,8 +193,8 @@ static void handle_tcp_event(void *ctx, int cpu, void *data, __u32 data_sz) {
         return;
     }
     
-    printf("TLS key obtained successfully (key_len: %u, iv_len: %u)\n",
-           key_info.key_len, key_info.iv_len);
+    log_debug("TLS key obtained successfully (key_len: %u, iv_len: %u)",
+              key_info.key_len, key_info.iv_len);
     
     /* 性能指标：结束测量连接建立延迟 */
     if (perf_ctx && conn_index >= 0) {
@@ -130,17 +206,16 @@ static void handle_tcp_event(void *ctx, int cpu, void *data, __u32 data_sz) {
      * 在实际实现中，可能需要通过 /proc/<pid>/fd 或其他方式
      * 这里仅作为示例
      */
-    printf("Note: Socket fd retrieval not implemented in this example\n");
-    printf("In production, KTLS would be configured here\n");
+    log_debug("Socket fd retrieval not implemented, KTLS would be configured here");
     
     /* 配置 KTLS (如果能获取到 sockfd) */
     /*
     ret = configure_ktls(sockfd, &key_info);
     if (ret < 0) {
-        fprintf(stderr, "Failed to configure KTLS\n");
+        log_warn("Failed to configure KTLS");
         return;
     }
-    printf("KTLS configured successfully\n");
+    log_debug("KTLS configured successfully");
     */
     
     /* 性能指标：记录连接成功 */
@@ -149,17 +224,505 @@ static void handle_tcp_event(void *ctx, int cpu, void *data, __u32 data_sz) {
     }
 }
 
+/**
+ * 解析 Pod IP，填入四元组的一端，返回地址族，失败返回 0
+ */
+static int parse_pod_ip(const char *ip, __u32 addr6[4]) {
+    if (inet_pton(AF_INET, ip, addr6) == 1) {
+        return AF_INET;
+    }
+    if (inet_pton(AF_INET6, ip, addr6) == 1) {
+        return AF_INET6;
+    }
+    return 0;
+}
+
+/**
+ * 按 Pod-Node 映射预置密钥预取：本节点上的每个 Pod 作为客户端访问其他节点上的每个 Pod，
+ * 只有配置了 Pod IP 的条目参与
+ */
+static void seed_key_prefetch(const char *node_name) {
+    struct flow_tuple tuple;
+    int seeded = 0;
+    
+    if (!pod_node_table || !node_name[0]) {
+        return;
+    }
+    
+    for (int i = 0; i < pod_node_table->count; i++) {
+        const struct pod_node_mapping *local = &pod_node_table->mappings[i];
+        
+        if (strcmp(local->node_name, node_name) != 0 || !local->pod_ip[0]) {
+            continue;
+        }
+        for (int j = 0; j < pod_node_table->count; j++) {
+            const struct pod_node_mapping *peer = &pod_node_table->mappings[j];
+            
+            if (strcmp(peer->node_name, node_name) == 0 || !peer->pod_ip[0]) {
+                continue;
+            }
+            memset(&tuple, 0, sizeof(tuple));
+            tuple.family = parse_pod_ip(local->pod_ip, tuple.saddr6);
+            if (!tuple.family || parse_pod_ip(peer->pod_ip, tuple.daddr6) != tuple.family) {
+                continue;
+            }
+            tuple.role = FLOW_ROLE_CLIENT;
+            if (key_provider_prefetch_seed(&tuple) == 0) {
+                seeded++;
+            }
+        }
+    }
+    printf("Seeded %d pod pairs for key prefetch (node %s)\n", seeded, node_name);
+}
+
+/**
+ * 工作线程退出前释放线程私有的密钥提供者资源
+ */
+static void key_worker_exit(void *ctx) {
+    (void)ctx;
+    key_provider_thread_cleanup();
+}
+
+/**
+ * 事件回调：只把事件交给工作线程池，不在事件循环中等待密钥协商
+ * 启用每 CPU 消费者时会在多个线程中并发调用，每个消费者提交到工作线程池中自己的分片
+ */
+static void handle_tcp_event(void *ctx, const struct tcp_connect_event *event) {
+    (void)ctx;
+    
+    if (recorder && event_recorder_write(recorder, event) < 0) {
+        log_warn("Failed to record connection event (pid %u)", event->pid);
+    }
+    
+    if (key_worker_submit(key_workers, event) < 0) {
+        log_warn("Key worker queue full, dropping connection event (pid %u)", event->pid);
+    }
+}
+
+/**
+ * 将工作线程池的队列深度、等待时间和利用率同步到性能指标
+ */
+static void update_key_worker_metrics(struct perf_metrics_ctx *ctx) {
+    struct key_worker_stats stats;
+    struct key_worker_metrics metrics;
+    
+    if (!key_workers) {
+        return;
+    }
+    
+    key_worker_get_stats(key_workers, &stats);
+    
+    memset(&metrics, 0, sizeof(metrics));
+    metrics.workers = stats.workers;
+    metrics.submitted = stats.submitted;
+    metrics.dropped = stats.dropped;
+    metrics.completed = stats.completed;
+    metrics.queue_depth = stats.queue_depth;
+    metrics.queue_max_depth = stats.queue_max_depth;
+    metrics.queue_capacity = stats.queue_capacity;
+    if (stats.completed > 0) {
+        metrics.avg_wait_ms = perf_ns_to_ms(stats.wait_total_ns) / stats.completed;
+    }
+    metrics.max_wait_ms = perf_ns_to_ms(stats.wait_max_ns);
+    if (stats.elapsed_ns > 0 && stats.workers > 0) {
+        metrics.utilization_percent = (double)stats.busy_ns * 100.0 /
+                                      ((double)stats.elapsed_ns * stats.workers);
+    }
+    perf_metrics_update_key_workers(ctx, &metrics);
+}
+
+/**
+ * 等待工作线程处理完所有已入队的事件，收到退出信号时不再等待
+ */
+static void wait_key_workers_idle(int signal_fd) {
+    struct key_worker_stats stats;
+    struct pollfd pfd = { .fd = signal_fd, .events = POLLIN };
+    
+    for (;;) {
+        key_worker_get_stats(key_workers, &stats);
+        if (stats.completed >= stats.submitted) {
+            break;
+        }
+        if (poll(&pfd, 1, 1) > 0) {
+            printf("Interrupted, %llu events still queued\n", stats.submitted - stats.completed);
+            break;
+        }
+    }
+}
+
+/**
+ * 打印回放结果：注入速率、流水线吞吐和端到端延迟分位数
+ */
+static void print_replay_report(const struct event_replay_stats *stats) {
+    struct key_worker_stats workers;
+    double seconds = stats->elapsed_ns / 1e9;
+    
+    key_worker_get_stats(key_workers, &workers);
+    
+    printf("\n========== Replay Report ==========\n");
+    printf("  Events injected:  %llu%s\n", stats->events, stats->done ? "" : " (interrupted)");
+    printf("  Injection time:   %.3f s (max lag %.3f ms)\n", seconds, stats->max_lag_ns / 1e6);
+    printf("  Completed:        %llu (%llu dropped, queue full)\n", workers.completed, workers.dropped);
+    if (seconds > 0) {
+        printf("  Throughput:       %.0f events/s\n", workers.completed / seconds);
+    }
+    if (pipeline_latency.count > 0) {
+        printf("  Latency (ms):     avg %.3f  p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n",
+               pipeline_latency.sum_ns / 1e6 / pipeline_latency.count,
+               latency_hist_quantile(&pipeline_latency, 0.50) / 1e6,
+               latency_hist_quantile(&pipeline_latency, 0.90) / 1e6,
+               latency_hist_quantile(&pipeline_latency, 0.99) / 1e6,
+               latency_hist_quantile(&pipeline_latency, 0.999) / 1e6,
+               pipeline_latency.max_ns / 1e6);
+    }
+    printf("===================================\n");
+}
+
+/**
+ * 将密钥请求合并统计（省下的协商往返）、密钥缓存、预取、TLSHub 请求、熔断和握手退避统计同步到性能指标
+ */
+static void update_key_request_metrics(struct perf_metrics_ctx *ctx) {
+    struct key_provider_stats stats;
+    struct key_request_metrics metrics;
+    struct key_cache_metrics cache;
+    struct key_prefetch_metrics prefetch;
+    struct tlshub_request_metrics tlshub;
+    struct breaker_metrics breaker;
+    struct handshake_backoff_metrics backoff;
+    __u64 lookups;
+    
+    key_provider_get_stats(&stats);
+    
+    memset(&metrics, 0, sizeof(metrics));
+    metrics.requests = stats.requests;
+    metrics.negotiations = stats.negotiations;
+    metrics.coalesced = stats.coalesced;
+    metrics.max_waiters = stats.max_waiters;
+    if (stats.requests > 0) {
+        metrics.dedup_ratio_percent = (double)stats.coalesced * 100.0 / stats.requests;
+    }
+    perf_metrics_update_key_requests(ctx, &metrics);
+    
+    memset(&cache, 0, sizeof(cache));
+    cache.capacity = stats.cache.capacity;
+    cache.entries = stats.cache.entries;
+    cache.hits = stats.cache.hits;
+    cache.misses = stats.cache.misses;
+    cache.expired = stats.cache.expired;
+    cache.evictions = stats.cache.evictions;
+    cache.tlshub_expired = stats.tlshub_expired;
+    cache.refresh_tracked = stats.refresh.tracked;
+    cache.refreshed = stats.refresh.refreshed;
+    cache.refresh_failures = stats.refresh.failures;
+    cache.refresh_idle = stats.refresh.idle;
+    cache.refresh_late = stats.refresh.late;
+    lookups = stats.cache.hits + stats.cache.misses + stats.cache.expired;
+    if (lookups > 0) {
+        cache.hit_ratio_percent = (double)stats.cache.hits * 100.0 / lookups;
+    }
+    perf_metrics_update_key_cache(ctx, &cache);
+    
+    if (stats.prefetch.seeded > 0 || stats.prefetch.tracked > 0) {
+        memset(&prefetch, 0, sizeof(prefetch));
+        prefetch.tracked = stats.prefetch.tracked;
+        prefetch.seeded = stats.prefetch.seeded;
+        prefetch.prefetched = stats.prefetch.prefetched;
+        prefetch.failures = stats.prefetch.failures;
+        prefetch.hits = stats.prefetch.hits;
+        prefetch.wasted = stats.prefetch.wasted;
+        prefetch.busy = stats.prefetch.busy;
+        prefetch.throttled = stats.prefetch.throttled;
+        if (stats.prefetch.hits + stats.prefetch.wasted > 0) {
+            prefetch.hit_ratio_percent = (double)stats.prefetch.hits * 100.0 /
+                                         (stats.prefetch.hits + stats.prefetch.wasted);
+        }
+        perf_metrics_update_key_prefetch(ctx, &prefetch);
+    }
+    
+    if (stats.tlshub.requests > 0) {
+        memset(&tlshub, 0, sizeof(tlshub));
+        tlshub.requests = stats.tlshub.requests;
+        tlshub.attempts = stats.tlshub.attempts;
+        tlshub.retries = stats.tlshub.retries;
+        tlshub.timeouts = stats.tlshub.timeouts;
+        tlshub.errors = stats.tlshub.errors;
+        tlshub.gave_up = stats.tlshub.gave_up;
+        tlshub.cancelled = stats.tlshub.cancelled;
+        tlshub.fetch_p50_ms = latency_hist_quantile(&stats.tlshub.fetch_latency, 0.50) / 1e6;
+        tlshub.fetch_p99_ms = latency_hist_quantile(&stats.tlshub.fetch_latency, 0.99) / 1e6;
+        tlshub.fetch_p999_ms = latency_hist_quantile(&stats.tlshub.fetch_latency, 0.999) / 1e6;
+        tlshub.fetch_max_ms = stats.tlshub.fetch_latency.max_ns / 1e6;
+        tlshub.handshake_p50_ms = latency_hist_quantile(&stats.tlshub.handshake_latency, 0.50) / 1e6;
+        tlshub.handshake_p99_ms = latency_hist_quantile(&stats.tlshub.handshake_latency, 0.99) / 1e6;
+        tlshub.handshake_p999_ms = latency_hist_quantile(&stats.tlshub.handshake_latency, 0.999) / 1e6;
+        tlshub.handshake_max_ms = stats.tlshub.handshake_latency.max_ns / 1e6;
+        perf_metrics_update_tlshub_requests(ctx, &tlshub);
+    }
+    
+    if (stats.breaker_enabled) {
+        memset(&breaker, 0, sizeof(breaker));
+        breaker.enabled = 1;
+        breaker.state = (__u32)stats.breaker.state;
+        breaker.opened = stats.breaker.opened;
+        breaker.half_opened = stats.breaker.half_opened;
+        breaker.closed = stats.breaker.closed;
+        breaker.rejected = stats.breaker.rejected;
+        breaker.fallbacks = stats.fallbacks;
+        breaker.probes = stats.breaker.probes;
+        breaker.probe_failures = stats.breaker.probe_failures;
+        breaker.open_ms = stats.breaker.open_ms;
+        breaker.window_requests = stats.breaker.window_requests;
+        breaker.window_failures = stats.breaker.window_failures;
+        breaker.window_slow = stats.breaker.window_slow;
+        perf_metrics_update_breaker(ctx, &breaker);
+    }
+    
+    if (stats.handshake_failures > 0) {
+        memset(&backoff, 0, sizeof(backoff));
+        backoff.entries = stats.negative_entries;
+        backoff.failures = stats.handshake_failures;
+        backoff.suppressed = stats.handshakes_suppressed;
+        backoff.retried = stats.handshakes_retried;
+        perf_metrics_update_handshake_backoff(ctx, &backoff);
+    }
+}
+
+/**
+ * 将 eBPF 侧计数器（探针活动、socket 捕获状态、内核过滤）同步到性能指标
+ */
+static void update_bpf_map_metrics(struct perf_metrics_ctx *ctx) {
+    struct capture_bpf_stats stats;
+    struct bpf_map_metrics sk_state;
+    struct bpf_policy_metrics policy;
+    struct bpf_probe_metrics probes;
+    
+    if (bpf_loader_read_stats(&loader, &stats) < 0) {
+        return;
+    }
+    
+    sk_state.entries = stats.sk_state_live;
+    sk_state.creates = stats.counters[CAPTURE_STAT_SK_CREATE];
+    sk_state.deletes = stats.counters[CAPTURE_STAT_SK_DELETE];
+    perf_metrics_update_bpf_maps(ctx, &sk_state);
+    
+    policy.suppressed_addr = stats.counters[CAPTURE_STAT_POLICY_ADDR];
+    policy.suppressed_port = stats.counters[CAPTURE_STAT_POLICY_PORT];
+    perf_metrics_update_bpf_policy(ctx, &policy);
+    
+    probes.connects = stats.counters[CAPTURE_STAT_CONNECT];
+    probes.connect_failures = stats.counters[CAPTURE_STAT_CONNECT_FAIL];
+    probes.sendmsg_hits = stats.counters[CAPTURE_STAT_SENDMSG];
+    probes.events_emitted = stats.counters[CAPTURE_STAT_EVENT];
+    probes.family_skipped = stats.counters[CAPTURE_STAT_FAMILY_SKIP];
+    probes.accepts = stats.counters[CAPTURE_STAT_ACCEPT];
+    perf_metrics_update_bpf_probes(ctx, &probes);
+}
+
+/**
+ * 汇总事件丢失计数
+ * perf buffer 模式下 bpf_perf_event_output 失败与 lost_cb 报告的是同一批样本，
+ * 取两者较大值，避免重复计算
+ */
+static __u64 total_event_loss(struct event_source *events) {
+    struct event_source_stats event_stats;
+    struct capture_bpf_stats stats;
+    struct key_worker_stats workers;
+    __u64 kernel_drops = 0;
+    
+    event_source_get_stats(events, &event_stats);
+    if (bpf_loader_read_stats(&loader, &stats) == 0) {
+        kernel_drops = stats.counters[CAPTURE_STAT_EVENT_DROP];
+    }
+    key_worker_get_stats(key_workers, &workers);
+    
+    return (event_stats.lost > kernel_drops ? event_stats.lost : kernel_drops) + workers.dropped;
+}
+
+/**
+ * 检查一个周期内的事件丢失和队列深度，必要时切换内核背压模式
+ */
+static void check_backpressure(struct event_source *events) {
+    struct key_worker_stats workers;
+    int mode;
+    
+    key_worker_get_stats(key_workers, &workers);
+    mode = backpressure_update(&backpressure, total_event_loss(events),
+                               workers.queue_depth, workers.queue_capacity);
+    if (mode < 0) {
+        return;
+    }
+    
+    log_warn("Backpressure: switching to %s (queue %llu/%llu)", shed_mode_name(mode),
+             workers.queue_depth, workers.queue_capacity);
+    bpf_loader_set_shed_mode(&loader, mode);
+}
+
+/**
+ * 将各 CPU 的事件丢失计数和背压状态同步到性能指标
+ */
+static void update_event_loss_metrics(struct perf_metrics_ctx *ctx, struct event_source *events) {
+    struct event_loss_metrics loss;
+    struct event_source_stats event_stats;
+    struct capture_bpf_stats stats;
+    int n;
+    
+    memset(&loss, 0, sizeof(loss));
+    event_source_get_stats(events, &event_stats);
+    loss.perf_lost = event_stats.lost;
+    if (bpf_loader_read_stats(&loader, &stats) == 0) {
+        loss.kernel_drops = stats.counters[CAPTURE_STAT_EVENT_DROP];
+        loss.shed = stats.counters[CAPTURE_STAT_SHED];
+    }
+    loss.shed_mode = backpressure.mode;
+    loss.shed_transitions = backpressure.transitions;
+    
+    n = event_source_lost_per_cpu(events, loss.lost_per_cpu, PERF_METRICS_MAX_CPUS);
+    if (n > 0) {
+        loss.ncpus = n;
+    }
+    n = bpf_loader_read_stat_per_cpu(&loader, CAPTURE_STAT_EVENT_DROP,
+                                     loss.drops_per_cpu, PERF_METRICS_MAX_CPUS);
+    if (n > 0 && (__u32)n > loss.ncpus) {
+        loss.ncpus = n;
+    }
+    perf_metrics_update_event_loss(ctx, &loss);
+}
+
+/**
+ * 解析 CIDR（如 10.244.0.0/16、fd00:10:244::/64）并追加一条地址策略
+ * 不带前缀长度时视为单个主机地址
+ */
+static int add_policy_rule(struct capture_config *config, const char *cidr, __u8 action) {
+    struct capture_policy_rule *rule;
+    char addr[INET6_ADDRSTRLEN];
+    const char *slash;
+    int max_prefix;
+    long prefixlen;
+    size_t len;
+    
+    if (config->policy_rule_count >= CAPTURE_MAX_POLICY_RULES) {
+        fprintf(stderr, "Too many policy rules, ignoring %s\n", cidr);
+        return -1;
+    }
+    rule = &config->policy_rules[config->policy_rule_count];
+    memset(rule, 0, sizeof(*rule));
+    
+    slash = strchr(cidr, '/');
+    len = slash ? (size_t)(slash - cidr) : strlen(cidr);
+    if (len >= sizeof(addr)) {
+        fprintf(stderr, "Invalid policy address: %s\n", cidr);
+        return -1;
+    }
+    memcpy(addr, cidr, len);
+    addr[len] = '\0';
+    
+    if (inet_pton(AF_INET, addr, rule->addr) == 1) {
+        rule->family = AF_INET;
+        max_prefix = 32;
+    } else if (inet_pton(AF_INET6, addr, rule->addr) == 1) {
+        rule->family = AF_INET6;
+        max_prefix = 128;
+    } else {
+        fprintf(stderr, "Invalid policy address: %s\n", cidr);
+        return -1;
+    }
+    
+    prefixlen = slash ? strtol(slash + 1, NULL, 10) : max_prefix;
+    if (prefixlen < 0 || prefixlen > max_prefix) {
+        fprintf(stderr, "Invalid policy prefix length: %s\n", cidr);
+        return -1;
+    }
+    
+    rule->prefixlen = (__u8)prefixlen;
+    rule->action = action;
+    config->policy_rule_count++;
+    return 0;
+}
+
+/**
+ * 解析逗号分隔的端口列表（如 443,8443），用于 policy_ports 和 priority_ports
+ */
+static void add_ports(__u16 *ports, __u32 *count, char *list, const char *what) {
+    char *saveptr = NULL;
+    
+    for (char *tok = strtok_r(list, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+        unsigned long port = strtoul(tok, NULL, 10);
+        
+        if (port == 0 || port > 65535) {
+            fprintf(stderr, "Invalid %s port: %s\n", what, tok);
+            continue;
+        }
+        if (*count >= CAPTURE_MAX_POLICY_PORTS) {
+            fprintf(stderr, "Too many %s ports, ignoring %s\n", what, tok);
+            break;
+        }
+        ports[(*count)++] = (__u16)port;
+    }
+}
+
 /**
  * 加载配置文件
  */
 static int load_config(const char *config_file, struct capture_config *config) {
     FILE *fp;
     char line[512];
+    __u32 submitters;
     
     /* 设置默认值 */
+    memset(config, 0, sizeof(*config));
     config->mode = MODE_TLSHUB;
     strncpy(config->pod_node_config_path, DEFAULT_POD_NODE_CONFIG, 
             sizeof(config->pod_node_config_path) - 1);
+    config->transport = EVENT_TRANSPORT_AUTO;
+    config->ringbuf_wakeup_batch = DEFAULT_RINGBUF_WAKEUP_BATCH;
+    config->hook = CAPTURE_HOOK_SOCKOPS;
+    strncpy(config->cgroup_path, DEFAULT_CGROUP_PATH, sizeof(config->cgroup_path) - 1);
+    config->key_workers = KEY_WORKER_DEFAULT_THREADS;
+    config->key_queue_size = KEY_WORKER_DEFAULT_QUEUE_SIZE;
+    config->key_coalesce = KEY_COALESCE_POD;
+    config->key_cache_size = 4096;
+    config->key_cache_ttl_ms = 30000;
+    config->key_refresh_lead_ms = 2000;
+    config->key_refresh_jitter_ms = 1000;
+    config->key_refresh_threads = 2;
+    config->key_prefetch_min_score = 3.0;
+    config->key_prefetch_half_life_ms = 60000;
+    if (gethostname(config->node_name, sizeof(config->node_name) - 1) < 0) {
+        config->node_name[0] = '\0';
+    }
+    config->tlshub_batch_delay_us = 100;
+    config->tlshub_transport = TLSHUB_TRANSPORT_NETLINK;
+    config->tlshub_timeout_ms = TLSHUB_DEFAULT_TIMEOUT_MS;
+    config->tlshub_retries = TLSHUB_DEFAULT_RETRIES;
+    config->tlshub_backoff_ms = TLSHUB_DEFAULT_BACKOFF_MS;
+    config->tlshub_backoff_max_ms = TLSHUB_DEFAULT_BACKOFF_MAX_MS;
+    config->tlshub_breaker = 1;
+    config->tlshub_breaker_window_ms = CIRCUIT_BREAKER_DEFAULT_WINDOW_MS;
+    config->tlshub_breaker_min_requests = CIRCUIT_BREAKER_DEFAULT_MIN_REQUESTS;
+    config->tlshub_breaker_failure_percent = CIRCUIT_BREAKER_DEFAULT_FAILURE_PERCENT;
+    config->tlshub_breaker_slow_ms = CIRCUIT_BREAKER_DEFAULT_SLOW_MS;
+    config->tlshub_breaker_slow_percent = CIRCUIT_BREAKER_DEFAULT_SLOW_PERCENT;
+    config->tlshub_breaker_open_ms = CIRCUIT_BREAKER_DEFAULT_OPEN_MS;
+    config->tlshub_breaker_half_open_requests = CIRCUIT_BREAKER_DEFAULT_HALF_OPEN_REQUESTS;
+    config->tlshub_fallback = MODE_TLSHUB;
+    config->tlshub_negative_cache_size = 1024;
+    config->tlshub_negative_backoff_ms = 1000;
+    config->tlshub_negative_backoff_max_ms = 60000;
+    strncpy(config->tlshub_unix_path, TLSHUB_DEFAULT_UNIX_PATH, sizeof(config->tlshub_unix_path) - 1);
+    config->mock_handshake_us = 2000;
+    config->mock_handshake_dist = LATENCY_DIST_EXPONENTIAL;
+    config->mock_fetch_us = 50;
+    config->mock_log_every = 16;
+    config->log_level = LOG_LEVEL_INFO;
+    config->log_format = LOG_FORMAT_TEXT;
+    config->log_rate_limit = LOG_DEFAULT_RATE_LIMIT;
+    config->backpressure = 1;
+    config->shed_sample_rate = BACKPRESSURE_DEFAULT_SAMPLE_RATE;
+    config->backpressure_loss_threshold = BACKPRESSURE_DEFAULT_LOSS_THRESHOLD;
+    config->backpressure_queue_high = BACKPRESSURE_DEFAULT_QUEUE_HIGH;
+    config->backpressure_queue_low = BACKPRESSURE_DEFAULT_QUEUE_LOW;
+    config->replay_speed = 1.0;
+    config->replay_pairs = EVENT_REPLAY_DEFAULT_SYNTHETIC_PAIRS;
     
     fp = fopen(config_file, "r");
     if (!fp) {
@@ -183,15 +746,226 @@ static int load_config(const char *config_file, struct capture_config *config) {
                     config->mode = MODE_OPENSSL;
                 } else if (strcmp(value, "boringssl") == 0) {
                     config->mode = MODE_BORINGSSL;
+                } else if (strcmp(value, "stub") == 0) {
+                    config->mode = MODE_STUB;
                 }
             } else if (strcmp(key, "pod_node_config") == 0) {
                 strncpy(config->pod_node_config_path, value, 
                         sizeof(config->pod_node_config_path) - 1);
+            } else if (strcmp(key, "event_transport") == 0) {
+                if (strcmp(value, "auto") == 0) {
+                    config->transport = EVENT_TRANSPORT_AUTO;
+                } else if (strcmp(value, "ringbuf") == 0) {
+                    config->transport = EVENT_TRANSPORT_RINGBUF;
+                } else if (strcmp(value, "perfbuf") == 0) {
+                    config->transport = EVENT_TRANSPORT_PERFBUF;
+                }
+            } else if (strcmp(key, "ringbuf_wakeup_batch") == 0) {
+                config->ringbuf_wakeup_batch = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "capture_hook") == 0) {
+                if (strcmp(value, "sockops") == 0) {
+                    config->hook = CAPTURE_HOOK_SOCKOPS;
+                } else if (strcmp(value, "fentry") == 0 || strcmp(value, "kprobe") == 0) {
+                    /* kprobe 为旧配置值，已由 fentry/fexit 取代 */
+                    config->hook = CAPTURE_HOOK_FENTRY;
+                }
+            } else if (strcmp(key, "cgroup_path") == 0) {
+                strncpy(config->cgroup_path, value, sizeof(config->cgroup_path) - 1);
+            } else if (strcmp(key, "policy_allow") == 0) {
+                add_policy_rule(config, value, CAPTURE_POLICY_ALLOW);
+            } else if (strcmp(key, "policy_deny") == 0) {
+                add_policy_rule(config, value, CAPTURE_POLICY_DENY);
+            } else if (strcmp(key, "policy_ports") == 0) {
+                add_ports(config->policy_ports, &config->policy_port_count, value, "policy");
+            } else if (strcmp(key, "priority_ports") == 0) {
+                add_ports(config->priority_ports, &config->priority_port_count, value, "priority");
+            } else if (strcmp(key, "key_workers") == 0) {
+                config->key_workers = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "key_queue_size") == 0) {
+                config->key_queue_size = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "key_coalesce") == 0) {
+                if (strcmp(value, "off") == 0) {
+                    config->key_coalesce = KEY_COALESCE_OFF;
+                } else if (strcmp(value, "flow") == 0) {
+                    config->key_coalesce = KEY_COALESCE_FLOW;
+                } else if (strcmp(value, "pod") == 0) {
+                    config->key_coalesce = KEY_COALESCE_POD;
+                }
+            } else if (strcmp(key, "key_cache_size") == 0) {
+                config->key_cache_size = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "key_cache_ttl_ms") == 0) {
+                config->key_cache_ttl_ms = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "key_refresh_lead_ms") == 0) {
+                config->key_refresh_lead_ms = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "key_refresh_jitter_ms") == 0) {
+                config->key_refresh_jitter_ms = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "key_refresh_threads") == 0) {
+                config->key_refresh_threads = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "key_prefetch_rate") == 0) {
+                config->key_prefetch_rate = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "key_prefetch_min_score") == 0) {
+                config->key_prefetch_min_score = strtod(value, NULL);
+            } else if (strcmp(key, "key_prefetch_half_life_ms") == 0) {
+                config->key_prefetch_half_life_ms = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "node_name") == 0) {
+                strncpy(config->node_name, value, sizeof(config->node_name) - 1);
+            } else if (strcmp(key, "tlshub_pipeline_depth") == 0) {
+                config->tlshub_pipeline_depth = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_batch_size") == 0) {
+                config->tlshub_batch_size = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_batch_delay_us") == 0) {
+                config->tlshub_batch_delay_us = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_transport") == 0) {
+                if (strcmp(value, "netlink") == 0) {
+                    config->tlshub_transport = TLSHUB_TRANSPORT_NETLINK;
+                } else if (strcmp(value, "unix") == 0) {
+                    config->tlshub_transport = TLSHUB_TRANSPORT_UNIX;
+                } else if (strcmp(value, "mock") == 0) {
+                    config->tlshub_transport = TLSHUB_TRANSPORT_MOCK;
+                }
+            } else if (strcmp(key, "tlshub_unix_path") == 0) {
+                strncpy(config->tlshub_unix_path, value, sizeof(config->tlshub_unix_path) - 1);
+            } else if (strcmp(key, "tlshub_timeout_ms") == 0) {
+                config->tlshub_timeout_ms = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_retries") == 0) {
+                config->tlshub_retries = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_backoff_ms") == 0) {
+                config->tlshub_backoff_ms = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_backoff_max_ms") == 0) {
+                config->tlshub_backoff_max_ms = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_breaker") == 0) {
+                config->tlshub_breaker = strcmp(value, "on") == 0 || strcmp(value, "true") == 0 ||
+                                         strcmp(value, "1") == 0;
+            } else if (strcmp(key, "tlshub_breaker_window_ms") == 0) {
+                config->tlshub_breaker_window_ms = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_breaker_min_requests") == 0) {
+                config->tlshub_breaker_min_requests = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_breaker_failure_percent") == 0) {
+                config->tlshub_breaker_failure_percent = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_breaker_slow_ms") == 0) {
+                config->tlshub_breaker_slow_ms = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_breaker_slow_percent") == 0) {
+                config->tlshub_breaker_slow_percent = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_breaker_open_ms") == 0) {
+                config->tlshub_breaker_open_ms = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_breaker_half_open_requests") == 0) {
+                config->tlshub_breaker_half_open_requests = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_fallback") == 0) {
+                if (strcmp(value, "none") == 0) {
+                    config->tlshub_fallback = MODE_TLSHUB;
+                } else if (strcmp(value, "openssl") == 0) {
+                    config->tlshub_fallback = MODE_OPENSSL;
+                } else if (strcmp(value, "boringssl") == 0) {
+                    config->tlshub_fallback = MODE_BORINGSSL;
+                } else if (strcmp(value, "stub") == 0) {
+                    config->tlshub_fallback = MODE_STUB;
+                }
+            } else if (strcmp(key, "tlshub_negative_cache_size") == 0) {
+                config->tlshub_negative_cache_size = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_negative_backoff_ms") == 0) {
+                config->tlshub_negative_backoff_ms = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "tlshub_negative_backoff_max_ms") == 0) {
+                config->tlshub_negative_backoff_max_ms = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "mock_handshake_us") == 0) {
+                config->mock_handshake_us = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "mock_handshake_dist") == 0) {
+                if (strcmp(value, "fixed") == 0) {
+                    config->mock_handshake_dist = LATENCY_DIST_FIXED;
+                } else if (strcmp(value, "uniform") == 0) {
+                    config->mock_handshake_dist = LATENCY_DIST_UNIFORM;
+                } else if (strcmp(value, "exponential") == 0) {
+                    config->mock_handshake_dist = LATENCY_DIST_EXPONENTIAL;
+                }
+            } else if (strcmp(key, "mock_handshake_spread_us") == 0) {
+                config->mock_handshake_spread_us = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "mock_fetch_us") == 0) {
+                config->mock_fetch_us = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "mock_expire_percent") == 0) {
+                config->mock_expire_percent = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "mock_fail_percent") == 0) {
+                config->mock_fail_percent = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "mock_log_every") == 0) {
+                config->mock_log_every = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "mock_hang_percent") == 0) {
+                config->mock_hang_percent = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "mock_legacy") == 0) {
+                config->mock_legacy = strcmp(value, "on") == 0 || strcmp(value, "true") == 0 ||
+                                      strcmp(value, "1") == 0;
+            } else if (strcmp(key, "event_consumers") == 0) {
+                if (strcmp(value, "percpu") == 0) {
+                    config->event_consumers = EVENT_CONSUMERS_PER_CPU;
+                } else {
+                    config->event_consumers = (__u32)strtoul(value, NULL, 10);
+                }
+            } else if (strcmp(key, "log_level") == 0) {
+                int level = log_level_parse(value);
+                if (level >= 0) {
+                    config->log_level = level;
+                }
+            } else if (strcmp(key, "log_format") == 0) {
+                config->log_format = strcmp(value, "json") == 0 ? LOG_FORMAT_JSON : LOG_FORMAT_TEXT;
+            } else if (strcmp(key, "log_file") == 0) {
+                strncpy(config->log_file, value, sizeof(config->log_file) - 1);
+            } else if (strcmp(key, "log_rate_limit") == 0) {
+                config->log_rate_limit = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "stub_latency_us") == 0) {
+                config->stub_latency_us = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "record_file") == 0) {
+                strncpy(config->record_file, value, sizeof(config->record_file) - 1);
+            } else if (strcmp(key, "replay_file") == 0) {
+                strncpy(config->replay_file, value, sizeof(config->replay_file) - 1);
+            } else if (strcmp(key, "replay_speed") == 0) {
+                config->replay_speed = strtod(value, NULL);
+            } else if (strcmp(key, "replay_synthetic") == 0) {
+                config->replay_synthetic = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "replay_rate") == 0) {
+                config->replay_rate = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "replay_pairs") == 0) {
+                config->replay_pairs = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "backpressure") == 0) {
+                config->backpressure = strcmp(value, "on") == 0 || strcmp(value, "true") == 0 ||
+                                       strcmp(value, "1") == 0;
+            } else if (strcmp(key, "shed_sample_rate") == 0) {
+                config->shed_sample_rate = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "backpressure_loss_threshold") == 0) {
+                config->backpressure_loss_threshold = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "backpressure_queue_high") == 0) {
+                config->backpressure_queue_high = (__u32)strtoul(value, NULL, 10);
+            } else if (strcmp(key, "backpressure_queue_low") == 0) {
+                config->backpressure_queue_low = (__u32)strtoul(value, NULL, 10);
             }
         }
     }
     
     fclose(fp);
+    
+    /* 每 CPU 消费依赖 perf buffer 的每 CPU 缓冲区，ring buffer 只有一个共享缓冲区 */
+    if (config->event_consumers > 0) {
+        if (config->transport == EVENT_TRANSPORT_AUTO) {
+            config->transport = EVENT_TRANSPORT_PERFBUF;
+        } else if (config->transport == EVENT_TRANSPORT_RINGBUF) {
+            fprintf(stderr, "event_consumers requires perfbuf, ignoring with ringbuf\n");
+            config->event_consumers = 0;
+        }
+    }
+    
+    /*
+     * 同时在途的请求不会多于发起请求的线程数，更大的批次只会等到超时：
+     * 工作线程之外，后台刷新线程、预取线程和熔断探测线程也经同一批次发送
+     */
+    submitters = config->key_workers;
+    if (config->key_refresh_lead_ms > 0) {
+        submitters += config->key_refresh_threads;
+    }
+    if (config->key_prefetch_rate > 0) {
+        submitters++;
+    }
+    if (config->tlshub_breaker) {
+        submitters++;
+    }
+    if (config->tlshub_batch_size > submitters) {
+        config->tlshub_batch_size = submitters;
+    }
     return 0;
 }
 
@@ -199,10 +973,20 @@ static int load_config(const char *config_file, struct capture_config *config) {
  * 主函数
  */
 int main(int argc, char **argv) {
-    struct bpf_program *prog;
-    struct perf_buffer *pb = NULL;
+    struct event_source *events = NULL;
+    struct event_source_stats event_stats;
+    struct event_replay *replay = NULL;
+    struct event_replay_stats replay_stats;
+    int replay_mode;
     struct capture_config config;
     const char *config_file = DEFAULT_CONFIG_FILE;
+    int epoll_fd = -1, signal_fd = -1, metrics_fd = -1, flush_fd = -1, backpressure_fd = -1;
+    int netlink_fd;
+    int worker_shards;
+    int running = 1;
+    sigset_t mask;
+    struct log_config log_cfg;
+    struct log_stats log_stats;
     int err = 0;
     
     /* 解析命令行参数 */
@@ -210,6 +994,18 @@ int main(int argc, char **argv) {
         config_file = argv[1];
     }
     
+    /*
+     * 在创建任何线程之前屏蔽 SIGINT/SIGTERM，工作线程继承该屏蔽字，
+     * 信号只通过主线程事件循环中的 signalfd 处理
+     */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0) {
+        perror("sigprocmask");
+        return 1;
+    }
+    
     printf("TLShub Traffic Capture Module\n");
     printf("==============================\n\n");
     
@@ -221,11 +1017,115 @@ int main(int argc, char **argv) {
         return 1;
     }
     
+    replay_mode = config.replay_file[0] || config.replay_synthetic > 0;
+    
     printf("Configuration:\n");
     printf("  Mode: %d\n", config.mode);
     printf("  Pod-Node Config: %s\n", config.pod_node_config_path);
+    printf("  Event Transport: %s\n", event_transport_name(config.transport));
+    printf("  Ring Buffer Wakeup Batch: %u\n", config.ringbuf_wakeup_batch);
+    if (config.event_consumers == EVENT_CONSUMERS_PER_CPU) {
+        printf("  Event Consumers: per CPU\n");
+    } else if (config.event_consumers > 0) {
+        printf("  Event Consumers: %u\n", config.event_consumers);
+    }
+    printf("  Capture Hook: %s\n", config.hook == CAPTURE_HOOK_SOCKOPS ? "sockops" : "fentry");
+    if (config.hook == CAPTURE_HOOK_SOCKOPS) {
+        printf("  Cgroup: %s\n", config.cgroup_path);
+    }
+    printf("  Policy: %u address rules, %u ports\n",
+           config.policy_rule_count, config.policy_port_count);
+    printf("  Key Workers: %u (queue size %u)\n", config.key_workers, config.key_queue_size);
+    printf("  Key Coalescing: %s\n", config.key_coalesce == KEY_COALESCE_OFF ? "off" :
+           config.key_coalesce == KEY_COALESCE_FLOW ? "flow" : "pod");
+    if ((config.mode == MODE_TLSHUB || config.mode == MODE_STUB) &&
+        config.key_cache_size > 0 && config.key_cache_ttl_ms > 0) {
+        printf("  Key Cache: %u entries (ttl %u ms)\n", config.key_cache_size, config.key_cache_ttl_ms);
+        if (config.key_refresh_lead_ms > 0) {
+            printf("  Key Refresh: %u ms before expiry (jitter %u ms, %u threads)\n",
+                   config.key_refresh_lead_ms, config.key_refresh_jitter_ms, config.key_refresh_threads);
+        }
+        if (config.key_prefetch_rate > 0) {
+            printf("  Key Prefetch: %u per second (min score %.1f, half-life %u ms, node %s)\n",
+                   config.key_prefetch_rate, config.key_prefetch_min_score,
+                   config.key_prefetch_half_life_ms, config.node_name);
+        }
+    }
+    if (config.mode == MODE_TLSHUB && config.tlshub_transport == TLSHUB_TRANSPORT_UNIX) {
+        printf("  TLSHub Transport: unix (%s)\n", config.tlshub_unix_path);
+    } else if (config.mode == MODE_TLSHUB && config.tlshub_transport == TLSHUB_TRANSPORT_MOCK) {
+        printf("  TLSHub Transport: mock (handshake %u us %s, fetch %u us, %u%% expired, %u%% failed, "
+               "%u%% hung)\n",
+               config.mock_handshake_us,
+               config.mock_handshake_dist == LATENCY_DIST_FIXED ? "fixed" :
+               config.mock_handshake_dist == LATENCY_DIST_UNIFORM ? "uniform" : "exponential",
+               config.mock_fetch_us, config.mock_expire_percent, config.mock_fail_percent,
+               config.mock_hang_percent);
+    }
+    if (config.mode == MODE_TLSHUB) {
+        printf("  TLSHub Requests: timeout %u ms, %u retries, backoff %u-%u ms\n",
+               config.tlshub_timeout_ms, config.tlshub_retries,
+               config.tlshub_backoff_ms, config.tlshub_backoff_max_ms);
+        if (config.tlshub_breaker) {
+            printf("  TLSHub Breaker: %u%% failures or %u%% over %u ms in %u ms (min %u), "
+                   "probe every %u ms, fallback %s\n",
+                   config.tlshub_breaker_failure_percent, config.tlshub_breaker_slow_percent,
+                   config.tlshub_breaker_slow_ms, config.tlshub_breaker_window_ms,
+                   config.tlshub_breaker_min_requests, config.tlshub_breaker_open_ms,
+                   config.tlshub_fallback == MODE_OPENSSL ? "openssl" :
+                   config.tlshub_fallback == MODE_BORINGSSL ? "boringssl" :
+                   config.tlshub_fallback == MODE_STUB ? "stub" : "none");
+        }
+        if (config.tlshub_negative_cache_size > 0) {
+            printf("  Handshake Backoff: %u pod pairs, %u-%u ms after a failed handshake\n",
+                   config.tlshub_negative_cache_size, config.tlshub_negative_backoff_ms,
+                   config.tlshub_negative_backoff_max_ms);
+        }
+    }
+    if (config.mode == MODE_TLSHUB && config.tlshub_pipeline_depth > 0) {
+        printf("  TLSHub Pipeline: depth %u on one socket\n", config.tlshub_pipeline_depth);
+    }
+    if (config.mode == MODE_TLSHUB && config.tlshub_batch_size > 1) {
+        printf("  TLSHub Batching: up to %u requests per message, %u us delay\n",
+               config.tlshub_batch_size, config.tlshub_batch_delay_us);
+    }
+    if (config.backpressure) {
+        printf("  Backpressure: on (sample 1/%u, %u priority ports)\n",
+               config.shed_sample_rate, config.priority_port_count);
+    } else {
+        printf("  Backpressure: off\n");
+    }
+    printf("  Log: level %d, %s, rate limit %u/s per thread%s%s\n",
+           config.log_level, config.log_format == LOG_FORMAT_JSON ? "json" : "text",
+           config.log_rate_limit, config.log_file[0] ? ", file " : "", config.log_file);
+    if (config.record_file[0]) {
+        printf("  Record: %s\n", config.record_file);
+    }
+    if (replay_mode) {
+        if (config.replay_file[0]) {
+            printf("  Replay: %s", config.replay_file);
+        } else {
+            printf("  Replay: %u synthetic events, %u pod pairs, %u events/s",
+                   config.replay_synthetic, config.replay_pairs, config.replay_rate);
+        }
+        if (config.replay_speed > 0) {
+            printf(" at %.2fx\n", config.replay_speed);
+        } else {
+            printf(" at max speed\n");
+        }
+    }
     printf("\n");
     
+    /* 启动异步日志，连接处理路径上的日志由后台线程格式化并写出 */
+    memset(&log_cfg, 0, sizeof(log_cfg));
+    log_cfg.level = config.log_level;
+    log_cfg.format = config.log_format;
+    log_cfg.path = config.log_file[0] ? config.log_file : NULL;
+    log_cfg.rate_limit = config.log_rate_limit;
+    if (log_init(&log_cfg) < 0) {
+        fprintf(stderr, "Warning: asynchronous logging disabled\n");
+    }
+    
     /* 初始化 Pod-Node 映射表 */
     printf("Initializing Pod-Node mapping...\n");
     pod_node_table = init_pod_node_mapping(config.pod_node_config_path);
@@ -238,11 +1138,55 @@ int main(int argc, char **argv) {
     
     /* 初始化密钥提供者 */
     printf("Initializing key provider (mode: %d)...\n", config.mode);
+    key_provider_set_coalesce(config.key_coalesce);
+    key_provider_set_stub_latency(config.stub_latency_us);
+    key_provider_set_cache(config.key_cache_size, config.key_cache_ttl_ms);
+    key_provider_set_refresh(config.key_refresh_lead_ms, config.key_refresh_jitter_ms,
+                             config.key_refresh_threads);
+    key_provider_set_prefetch(config.key_prefetch_rate, config.key_prefetch_min_score,
+                              config.key_prefetch_half_life_ms);
+    key_provider_set_pipeline_depth(config.tlshub_pipeline_depth);
+    key_provider_set_batching(config.tlshub_batch_size, config.tlshub_batch_delay_us);
+    key_provider_set_tlshub_transport(config.tlshub_transport, config.tlshub_unix_path,
+                                      &(struct tlshub_standin_config){
+                                          .latency_us = config.mock_fetch_us,
+                                          .handshake_us = config.mock_handshake_us,
+                                          .handshake_dist = config.mock_handshake_dist,
+                                          .handshake_spread_us = config.mock_handshake_spread_us,
+                                          .log_every = config.mock_log_every,
+                                          .expire_percent = config.mock_expire_percent,
+                                          .fail_percent = config.mock_fail_percent,
+                                          .hang_percent = config.mock_hang_percent,
+                                          .require_handshake = 1,
+                                          .legacy = config.mock_legacy,
+                                      });
+    key_provider_set_tlshub_retry(&(struct tlshub_retry_policy){
+                                      .timeout_ms = config.tlshub_timeout_ms,
+                                      .retries = config.tlshub_retries,
+                                      .backoff_ms = config.tlshub_backoff_ms,
+                                      .backoff_max_ms = config.tlshub_backoff_max_ms,
+                                  });
+    key_provider_set_breaker(config.tlshub_breaker ? &(struct circuit_breaker_config){
+                                 .window_ms = config.tlshub_breaker_window_ms,
+                                 .min_requests = config.tlshub_breaker_min_requests,
+                                 .failure_percent = config.tlshub_breaker_failure_percent,
+                                 .slow_ms = config.tlshub_breaker_slow_ms,
+                                 .slow_percent = config.tlshub_breaker_slow_percent,
+                                 .open_ms = config.tlshub_breaker_open_ms,
+                                 .half_open_requests = config.tlshub_breaker_half_open_requests,
+                             } : NULL);
+    key_provider_set_fallback(config.tlshub_fallback);
+    key_provider_set_negative_cache(config.tlshub_negative_cache_size,
+                                    config.tlshub_negative_backoff_ms,
+                                    config.tlshub_negative_backoff_max_ms);
     err = key_provider_init(config.mode);
     if (err < 0) {
         fprintf(stderr, "Failed to initialize key provider\n");
         goto cleanup;
     }
+    if (config.key_prefetch_rate > 0) {
+        seed_key_prefetch(config.node_name);
+    }
     
     /* 初始化性能指标模块 */
     printf("Initializing performance metrics module...\n");
@@ -252,86 +1196,147 @@ int main(int argc, char **argv) {
     }
     printf("\n");
     
-    /* 加载 eBPF 程序 */
-    printf("Loading eBPF program...\n");
-    /* 
-     * 尝试从多个位置查找 eBPF 对象文件
-     * 1. 当前目录（开发模式）
-     * 2. /usr/local/lib/（安装模式）
-     */
-    const char *bpf_paths[] = {
-        "capture.bpf.o",
-        "/usr/local/lib/capture.bpf.o",
-        NULL
-    };
-    
-    obj = NULL;
-    for (int i = 0; bpf_paths[i] != NULL; i++) {
-        obj = bpf_object__open_file(bpf_paths[i], NULL);
-        if (!libbpf_get_error(obj)) {
-            printf("Loaded eBPF program from: %s\n", bpf_paths[i]);
-            break;
+    /* 启动密钥协商工作线程池，每 CPU 消费者各自提交到独立的队列分片 */
+    printf("Starting key negotiation workers...\n");
+    if (config.event_consumers == EVENT_CONSUMERS_PER_CPU) {
+        worker_shards = libbpf_num_possible_cpus();
+    } else {
+        worker_shards = (int)config.event_consumers;
+    }
+    key_workers = key_worker_pool_new(config.key_workers, config.key_queue_size,
+                                      worker_shards > 0 ? (__u32)worker_shards : 1,
+                                      process_tcp_event, key_worker_exit, NULL);
+    if (!key_workers) {
+        fprintf(stderr, "Failed to start key negotiation workers\n");
+        err = -1;
+        goto cleanup;
+    }
+    printf("\n");
+    
+    /* 录制收到的事件，供之后离线回放 */
+    if (config.record_file[0]) {
+        recorder = event_recorder_open(config.record_file);
+        if (!recorder) {
+            fprintf(stderr, "Warning: event recording disabled\n");
         }
-        obj = NULL;  /* Reset for next iteration */
     }
     
-    if (!obj || libbpf_get_error(obj)) {
-        fprintf(stderr, "Failed to open eBPF object file from any location\n");
+    /* 回放模式下事件来自回放线程，不加载 eBPF，也不需要 root 权限 */
+    if (!replay_mode) {
+        /* 加载 eBPF 程序 */
+        printf("Loading eBPF program...\n");
+        err = bpf_loader_open(&loader, &config);
+        if (err < 0) {
+            fprintf(stderr, "Failed to load eBPF program\n");
+            goto cleanup;
+        }
+        
+        /* 附加 eBPF 程序 */
+        printf("Attaching eBPF programs...\n");
+        bpf_loader_attach(&loader);
+        
+        /* 设置事件源 */
+        printf("Setting up %s event source...\n", event_transport_name(loader.transport));
+        events = event_source_new(&loader, handle_tcp_event, NULL);
+        if (!events) {
+            err = -1;
+            goto cleanup;
+        }
+    }
+    
+    /* 建立事件循环：事件通道、TLSHub Netlink、定时器和信号 */
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        perror("epoll_create1");
         err = -1;
         goto cleanup;
     }
     
-    err = bpf_object__load(obj);
-    if (err) {
-        fprintf(stderr, "Failed to load eBPF object: %d\n", err);
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd < 0) {
+        perror("signalfd");
+        err = -1;
         goto cleanup;
     }
     
-    /* 附加 eBPF 程序 */
-    printf("Attaching eBPF programs...\n");
-    bpf_object__for_each_program(prog, obj) {
-        links[link_count] = bpf_program__attach(prog);
-        if (libbpf_get_error(links[link_count])) {
-            fprintf(stderr, "Failed to attach program %s\n", 
-                    bpf_program__name(prog));
-            links[link_count] = NULL;
-            continue;
+    if (loop_add(epoll_fd, signal_fd, LOOP_SIGNAL) < 0) {
+        err = -1;
+        goto cleanup;
+    }
+    
+    /*
+     * 每 CPU 消费者线程各自等待并消费所负责 CPU 的 perf buffer，
+     * 启动失败时退回由事件循环统一消费
+     */
+    if (events && (config.event_consumers == 0 ||
+                   event_source_start_consumers(events, config.event_consumers) < 0)) {
+        if (loop_add(epoll_fd, event_source_epoll_fd(events), LOOP_EVENTS) < 0) {
+            err = -1;
+            goto cleanup;
         }
-        printf("  Attached: %s\n", bpf_program__name(prog));
-        link_count++;
     }
     
-    /* 设置 perf buffer */
-    printf("Setting up perf buffer...\n");
-    int events_fd = bpf_object__find_map_fd_by_name(obj, "events");
-    if (events_fd < 0) {
-        fprintf(stderr, "Failed to find events map\n");
-        err = -1;
-        goto cleanup;
+    /* 定期更新系统性能指标 */
+    if (perf_ctx) {
+        metrics_fd = create_timer(PERF_UPDATE_INTERVAL_SEC * 1000L);
+        if (metrics_fd < 0 || loop_add(epoll_fd, metrics_fd, LOOP_METRICS) < 0) {
+            err = -1;
+            goto cleanup;
+        }
     }
     
-    /* 根据 libbpf 版本使用不同的 API */
-#if defined(LIBBPF_MAJOR_VERSION) && LIBBPF_MAJOR_VERSION >= 1
-    /* libbpf 1.0+ API: 回调函数作为独立参数传递 */
-    pb = perf_buffer__new(events_fd, 8, handle_tcp_event, NULL, NULL, NULL);
-#else
-    /* libbpf 0.x API: 回调函数通过 opts 结构体传递 */
-    struct perf_buffer_opts pb_opts = {
-        .sample_cb = handle_tcp_event,
-        .lost_cb = NULL,
-        .ctx = NULL,
-    };
-    pb = perf_buffer__new(events_fd, 8, &pb_opts);
-#endif
-    if (libbpf_get_error(pb)) {
-        fprintf(stderr, "Failed to create perf buffer\n");
+    netlink_fd = key_provider_event_fd();
+    if (netlink_fd >= 0 && loop_add(epoll_fd, netlink_fd, LOOP_NETLINK) < 0) {
         err = -1;
         goto cleanup;
     }
     
-    /* 注册信号处理 */
-    signal(SIGINT, sig_handler);
-    signal(SIGTERM, sig_handler);
+    /*
+     * ring buffer 按批唤醒时，不足一批的事件不会触发唤醒，
+     * 由低频定时器兜底取走，保证最大延迟不超过 EVENT_FLUSH_INTERVAL_MS
+     */
+    if (loader.transport == EVENT_TRANSPORT_RINGBUF && config.ringbuf_wakeup_batch > 1) {
+        flush_fd = create_timer(EVENT_FLUSH_INTERVAL_MS);
+        if (flush_fd < 0 || loop_add(epoll_fd, flush_fd, LOOP_FLUSH) < 0) {
+            err = -1;
+            goto cleanup;
+        }
+    }
+    
+    /* 周期性检查事件丢失，超过阈值时让内核采样或丢弃低优先级事件 */
+    if (config.backpressure && events) {
+        struct backpressure_config bp_cfg = {
+            .loss_threshold = config.backpressure_loss_threshold,
+            .queue_high_pct = config.backpressure_queue_high,
+            .queue_low_pct = config.backpressure_queue_low,
+        };
+        
+        backpressure_init(&backpressure, &bp_cfg);
+        backpressure_fd = create_timer(BACKPRESSURE_CHECK_INTERVAL_MS);
+        if (backpressure_fd < 0 || loop_add(epoll_fd, backpressure_fd, LOOP_BACKPRESSURE) < 0) {
+            err = -1;
+            goto cleanup;
+        }
+    }
+    
+    /* 回放线程按录制时的间隔（或合成速率）把事件交给与内核事件相同的回调 */
+    if (replay_mode) {
+        struct event_replay_config rp_cfg = {
+            .path = config.replay_file[0] ? config.replay_file : NULL,
+            .speed = config.replay_speed,
+            .synthetic_events = config.replay_synthetic,
+            .synthetic_rate = config.replay_rate,
+            .synthetic_pairs = config.replay_pairs,
+        };
+        
+        latency_hist_reset(&pipeline_latency);
+        replaying = 1;
+        replay = event_replay_start(&rp_cfg, handle_tcp_event, NULL);
+        if (!replay || loop_add(epoll_fd, event_replay_fd(replay), LOOP_REPLAY) < 0) {
+            err = -1;
+            goto cleanup;
+        }
+    }
     
     printf("\nCapture module is running. Press Ctrl+C to stop.\n");
     printf("Monitoring TCP connections...\n");
@@ -340,21 +1345,72 @@ int main(int argc, char **argv) {
     }
     printf("\n");
     
-    /* 主循环 */
-    time_t last_perf_update = time(NULL);
-    while (keep_running) {
-        err = perf_buffer__poll(pb, 100);
-        if (err < 0 && err != -EINTR) {
-            fprintf(stderr, "Error polling perf buffer: %d\n", err);
+    /* 主循环：只在有事件、消息、定时器到期或信号时唤醒 */
+    while (running) {
+        struct epoll_event ready[MAX_LOOP_EVENTS];
+        int n;
+        
+        n = epoll_wait(epoll_fd, ready, MAX_LOOP_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            err = -errno;
             break;
         }
         
-        /* 定期更新系统性能指标 */
-        if (perf_ctx) {
-            time_t now = time(NULL);
-            if (now - last_perf_update >= PERF_UPDATE_INTERVAL_SEC) {
+        for (int i = 0; i < n; i++) {
+            switch (ready[i].data.u32) {
+            case LOOP_FLUSH:
+                drain_timer(flush_fd);
+                /* fall through */
+            case LOOP_EVENTS:
+                err = event_source_poll(events, 0);
+                if (err < 0 && err != -EINTR) {
+                    fprintf(stderr, "Error polling event source: %d\n", err);
+                    running = 0;
+                }
+                break;
+                
+            case LOOP_NETLINK:
+                if (key_provider_process_events() < 0) {
+                    fprintf(stderr, "Error processing TLSHub messages\n");
+                }
+                break;
+                
+            case LOOP_METRICS:
+                drain_timer(metrics_fd);
                 perf_metrics_update_system(perf_ctx);
-                last_perf_update = now;
+                update_bpf_map_metrics(perf_ctx);
+                update_key_worker_metrics(perf_ctx);
+                update_key_request_metrics(perf_ctx);
+                if (events) {
+                    update_event_loss_metrics(perf_ctx, events);
+                }
+                break;
+                
+            case LOOP_BACKPRESSURE:
+                drain_timer(backpressure_fd);
+                check_backpressure(events);
+                break;
+                
+            case LOOP_REPLAY:
+                /* 等工作线程处理完已入队的事件再退出，否则它们会被计为丢弃 */
+                printf("Replay finished, waiting for key workers...\n");
+                wait_key_workers_idle(signal_fd);
+                running = 0;
+                break;
+                
+            case LOOP_SIGNAL: {
+                struct signalfd_siginfo si;
+                
+                if (read(signal_fd, &si, sizeof(si)) == sizeof(si)) {
+                    printf("\nReceived signal %u, shutting down...\n", si.ssi_signo);
+                    running = 0;
+                }
+                break;
+            }
             }
         }
     }
@@ -362,9 +1418,35 @@ int main(int argc, char **argv) {
 cleanup:
     printf("\nCleaning up...\n");
     
+    /* 先停止事件消费者线程和回放线程，不再向工作线程提交新事件 */
+    event_source_stop_consumers(events);
+    memset(&replay_stats, 0, sizeof(replay_stats));
+    if (replay) {
+        event_replay_get_stats(replay, &replay_stats);
+        event_replay_free(replay);
+    }
+    if (recorder) {
+        printf("Recorded %llu events to %s\n", event_recorder_close(recorder), config.record_file);
+        recorder = NULL;
+    }
+    
+    /* 停止工作线程：挂起在 TLSHub 上的请求被取消，不等到期限；未处理的事件计为丢弃 */
+    key_provider_cancel();
+    key_worker_pool_stop(key_workers);
+    
+    if (replay_mode) {
+        print_replay_report(&replay_stats);
+    }
+    
     /* 打印性能报告 */
     if (perf_ctx) {
         printf("\nGenerating performance report...\n");
+        update_bpf_map_metrics(perf_ctx);
+        update_key_worker_metrics(perf_ctx);
+        update_key_request_metrics(perf_ctx);
+        if (events) {
+            update_event_loss_metrics(perf_ctx, events);
+        }
         perf_metrics_print_report(perf_ctx);
         
         /* 导出性能指标到文件 */
@@ -377,20 +1459,35 @@ cleanup:
         perf_metrics_export_csv(perf_ctx, csv_file);
     }
     
-    if (pb) {
-        perf_buffer__free(pb);
+    if (events) {
+        event_source_get_stats(events, &event_stats);
+        printf("Event source (%s): %llu events, %llu wakeups, %llu lost\n",
+               event_transport_name(loader.transport),
+               event_stats.events, event_stats.wakeups, event_stats.lost);
+        event_source_free(events);
     }
     
-    /* 分离所有 eBPF 程序 */
-    for (int i = 0; i < link_count; i++) {
-        if (links[i]) {
-            bpf_link__destroy(links[i]);
-        }
-    }
+    key_worker_pool_free(key_workers);
     
-    if (obj) {
-        bpf_object__close(obj);
+    /* 关闭事件循环 */
+    if (backpressure_fd >= 0) {
+        close(backpressure_fd);
+    }
+    if (flush_fd >= 0) {
+        close(flush_fd);
+    }
+    if (metrics_fd >= 0) {
+        close(metrics_fd);
+    }
+    if (signal_fd >= 0) {
+        close(signal_fd);
     }
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+    
+    /* 分离所有 eBPF 程序 */
+    bpf_loader_close(&loader);
     
     /* 清理密钥提供者 */
     key_provider_cleanup();
@@ -405,6 +1502,12 @@ cleanup:
         free_pod_node_mapping(pod_node_table);
     }
     
+    /* 所有线程都已退出，写出剩余日志 */
+    log_shutdown();
+    log_get_stats(&log_stats);
+    printf("Log: %llu written, %llu dropped, %llu suppressed\n",
+           log_stats.written, log_stats.dropped, log_stats.suppressed);
+    
     printf("Shutdown complete\n");
     return err < 0 ? 1 : 0;
 }
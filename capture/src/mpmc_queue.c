@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "mpmc_queue.h"
+
+#define CACHE_LINE_SIZE 64
+
+/*
+ * 槽位：seq 表示该槽位当前可被哪个位置的生产者/消费者使用
+ *   seq == pos      空闲，可由位置为 pos 的生产者写入
+ *   seq == pos + 1  已写入，可由位置为 pos 的消费者读取
+ * 数据紧随 seq 之后存放
+ */
+struct mpmc_cell {
+    atomic_size_t seq;
+    unsigned char data[];
+};
+
+struct mpmc_queue {
+    /* 生产者与消费者的位置分别独占一个缓存行，避免伪共享 */
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t enqueue_pos;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t dequeue_pos;
+    _Alignas(CACHE_LINE_SIZE) size_t mask;
+    size_t elem_size;
+    size_t cell_size;
+    unsigned char *cells;
+};
+
+static inline struct mpmc_cell *cell_at(struct mpmc_queue *q, size_t pos) {
+    return (struct mpmc_cell *)(q->cells + (pos & q->mask) * q->cell_size);
+}
+
+/**
+ * 创建队列
+ */
+struct mpmc_queue *mpmc_queue_new(size_t capacity, size_t elem_size) {
+    struct mpmc_queue *q;
+    size_t size = 2;
+
+    if (capacity == 0 || elem_size == 0) {
+        fprintf(stderr, "Invalid queue parameters\n");
+        return NULL;
+    }
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    q = aligned_alloc(CACHE_LINE_SIZE, sizeof(*q));
+    if (!q) {
+        fprintf(stderr, "Failed to allocate queue\n");
+        return NULL;
+    }
+    memset(q, 0, sizeof(*q));
+
+    q->mask = size - 1;
+    q->elem_size = elem_size;
+    q->cell_size = (sizeof(struct mpmc_cell) + elem_size + sizeof(size_t) - 1) &
+                   ~(sizeof(size_t) - 1);
+    q->cells = calloc(size, q->cell_size);
+    if (!q->cells) {
+        fprintf(stderr, "Failed to allocate queue cells\n");
+        free(q);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&cell_at(q, i)->seq, i);
+    }
+    atomic_init(&q->enqueue_pos, 0);
+    atomic_init(&q->dequeue_pos, 0);
+
+    return q;
+}
+
+/**
+ * 入队
+ */
+int mpmc_queue_push(struct mpmc_queue *q, const void *elem) {
+    struct mpmc_cell *cell;
+    size_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+
+    for (;;) {
+        size_t seq;
+        intptr_t diff;
+
+        cell = cell_at(q, pos);
+        seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+            /* CAS 失败时 pos 已被更新为最新值，重试 */
+        } else if (diff < 0) {
+            /* 该槽位上一轮的数据尚未被消费：队列已满 */
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    memcpy(cell->data, elem, q->elem_size);
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * 出队
+ */
+int mpmc_queue_pop(struct mpmc_queue *q, void *elem) {
+    struct mpmc_cell *cell;
+    size_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+
+    for (;;) {
+        size_t seq;
+        intptr_t diff;
+
+        cell = cell_at(q, pos);
+        seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* 该槽位尚未写入：队列为空 */
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+        }
+    }
+
+    memcpy(elem, cell->data, q->elem_size);
+    /* 标记为下一轮（pos + 容量）的生产者可用 */
+    atomic_store_explicit(&cell->seq, pos + q->mask + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * 当前排队元素数
+ */
+size_t mpmc_queue_depth(struct mpmc_queue *q) {
+    size_t head = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+
+    return tail > head ? tail - head : 0;
+}
+
+/**
+ * 队列容量
+ */
+size_t mpmc_queue_capacity(struct mpmc_queue *q) {
+    return q->mask + 1;
+}
+
+/**
+ * 释放队列
+ */
+void mpmc_queue_free(struct mpmc_queue *q) {
+    if (!q) {
+        return;
+    }
+    free(q->cells);
+    free(q);
+}
@@ -4,8 +4,11 @@
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
+#include <pthread.h>
 #include <sys/time.h>
 #include "performance_metrics.h"
+#include "backpressure.h"
+#include "circuit_breaker.h"
 
 /**
  * 读取 /proc/stat 获取 CPU 统计信息
@@ -118,6 +121,8 @@ struct perf_metrics_ctx* perf_metrics_init(__u32 max_connections) {
     memset(&ctx->prev_cpu_stat, 0, sizeof(struct cpu_stat));
     ctx->cpu_first_call = 1;
     
+    pthread_mutex_init(&ctx->lock, NULL);
+    
     /* 记录开始时间 */
     clock_gettime(CLOCK_MONOTONIC, &ctx->start_time);
     
@@ -138,6 +143,7 @@ void perf_metrics_cleanup(struct perf_metrics_ctx *ctx) {
         free(ctx->conn_metrics);
     }
     
+    pthread_mutex_destroy(&ctx->lock);
     free(ctx);
 }
 
@@ -180,7 +186,9 @@ int perf_metrics_connection_start(struct perf_metrics_ctx *ctx, __u64 connection
         return -1;
     }
     
+    pthread_mutex_lock(&ctx->lock);
     if (ctx->current_connections >= ctx->max_connections) {
+        pthread_mutex_unlock(&ctx->lock);
         fprintf(stderr, "Warning: Maximum connections reached, cannot track new connection\n");
         return -1;
     }
@@ -193,6 +201,7 @@ int perf_metrics_connection_start(struct perf_metrics_ctx *ctx, __u64 connection
     
     ctx->stats.total_connections++;
     ctx->system_metrics.active_connections++;
+    pthread_mutex_unlock(&ctx->lock);
     
     return index;
 }
@@ -201,48 +210,72 @@ int perf_metrics_connection_start(struct perf_metrics_ctx *ctx, __u64 connection
  * 记录连接建立延迟开始
  */
 void perf_metrics_connection_latency_start(struct perf_metrics_ctx *ctx, int conn_index) {
-    if (!ctx || !ctx->monitoring_enabled || conn_index < 0 || 
-        conn_index >= (int)ctx->current_connections) {
+    if (!ctx || !ctx->monitoring_enabled || conn_index < 0) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    if (conn_index >= (int)ctx->current_connections) {
+        pthread_mutex_unlock(&ctx->lock);
         return;
     }
     
     perf_timepoint_start(&ctx->conn_metrics[conn_index].connection_latency);
+    pthread_mutex_unlock(&ctx->lock);
 }
 
 /**
  * 记录连接建立延迟结束
  */
 void perf_metrics_connection_latency_end(struct perf_metrics_ctx *ctx, int conn_index) {
-    if (!ctx || !ctx->monitoring_enabled || conn_index < 0 || 
-        conn_index >= (int)ctx->current_connections) {
+    if (!ctx || !ctx->monitoring_enabled || conn_index < 0) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    if (conn_index >= (int)ctx->current_connections) {
+        pthread_mutex_unlock(&ctx->lock);
         return;
     }
     
     perf_timepoint_end(&ctx->conn_metrics[conn_index].connection_latency);
+    pthread_mutex_unlock(&ctx->lock);
 }
 
 /**
  * 记录密钥协商开始
  */
 void perf_metrics_key_negotiation_start(struct perf_metrics_ctx *ctx, int conn_index) {
-    if (!ctx || !ctx->monitoring_enabled || conn_index < 0 || 
-        conn_index >= (int)ctx->current_connections) {
+    if (!ctx || !ctx->monitoring_enabled || conn_index < 0) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    if (conn_index >= (int)ctx->current_connections) {
+        pthread_mutex_unlock(&ctx->lock);
         return;
     }
     
     perf_timepoint_start(&ctx->conn_metrics[conn_index].key_negotiation);
+    pthread_mutex_unlock(&ctx->lock);
 }
 
 /**
  * 记录密钥协商结束
  */
 void perf_metrics_key_negotiation_end(struct perf_metrics_ctx *ctx, int conn_index) {
-    if (!ctx || !ctx->monitoring_enabled || conn_index < 0 || 
-        conn_index >= (int)ctx->current_connections) {
+    if (!ctx || !ctx->monitoring_enabled || conn_index < 0) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    if (conn_index >= (int)ctx->current_connections) {
+        pthread_mutex_unlock(&ctx->lock);
         return;
     }
     
     perf_timepoint_end(&ctx->conn_metrics[conn_index].key_negotiation);
+    pthread_mutex_unlock(&ctx->lock);
 }
 
 /**
@@ -252,8 +285,13 @@ void perf_metrics_record_data_transfer(struct perf_metrics_ctx *ctx, int conn_in
                                        __u64 bytes_sent, __u64 bytes_received) {
     struct connection_metrics *cm;
     
-    if (!ctx || !ctx->monitoring_enabled || conn_index < 0 || 
-        conn_index >= (int)ctx->current_connections) {
+    if (!ctx || !ctx->monitoring_enabled || conn_index < 0) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    if (conn_index >= (int)ctx->current_connections) {
+        pthread_mutex_unlock(&ctx->lock);
         return;
     }
     
@@ -280,14 +318,20 @@ void perf_metrics_record_data_transfer(struct perf_metrics_ctx *ctx, int conn_in
         double time_seconds = (double)time_diff_ns / 1000000000.0;
         cm->throughput_mbps = ((double)total_bytes * 8.0) / (time_seconds * 1000000.0);
     }
+    pthread_mutex_unlock(&ctx->lock);
 }
 
 /**
  * 记录连接结束
  */
 void perf_metrics_connection_end(struct perf_metrics_ctx *ctx, int conn_index, int success) {
-    if (!ctx || !ctx->monitoring_enabled || conn_index < 0 || 
-        conn_index >= (int)ctx->current_connections) {
+    if (!ctx || !ctx->monitoring_enabled || conn_index < 0) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    if (conn_index >= (int)ctx->current_connections) {
+        pthread_mutex_unlock(&ctx->lock);
         return;
     }
     
@@ -300,6 +344,7 @@ void perf_metrics_connection_end(struct perf_metrics_ctx *ctx, int conn_index, i
     if (ctx->system_metrics.active_connections > 0) {
         ctx->system_metrics.active_connections--;
     }
+    pthread_mutex_unlock(&ctx->lock);
 }
 
 /**
@@ -319,6 +364,8 @@ int perf_metrics_update_system(struct perf_metrics_ctx *ctx) {
         return -1;
     }
     
+    pthread_mutex_lock(&ctx->lock);
+    
     /* 计算 CPU 使用率（第一次调用时跳过） */
     if (!ctx->cpu_first_call) {
         ctx->system_metrics.cpu_usage_percent = calculate_cpu_usage(&ctx->prev_cpu_stat, &curr_cpu_stat);
@@ -335,6 +382,7 @@ int perf_metrics_update_system(struct perf_metrics_ctx *ctx) {
     
     /* 读取内存使用情况 */
     if (read_memory_usage(&rss_kb, &vms_kb) < 0) {
+        pthread_mutex_unlock(&ctx->lock);
         fprintf(stderr, "Failed to read memory usage\n");
         return -1;
     }
@@ -350,14 +398,15 @@ int perf_metrics_update_system(struct perf_metrics_ctx *ctx) {
     
     /* 记录测量时间 */
     clock_gettime(CLOCK_MONOTONIC, &ctx->system_metrics.measurement_time);
+    pthread_mutex_unlock(&ctx->lock);
     
     return 0;
 }
 
 /**
- * 计算统计汇总
+ * 计算统计汇总（调用者持有 ctx->lock）
  */
-void perf_metrics_calculate_stats(struct perf_metrics_ctx *ctx) {
+static void calculate_stats_locked(struct perf_metrics_ctx *ctx) {
     __u32 i;
     __u32 latency_count = 0;
     __u32 negotiation_count = 0;
@@ -451,6 +500,173 @@ void perf_metrics_calculate_stats(struct perf_metrics_ctx *ctx) {
     /* peak_memory_usage_kb 已在 perf_metrics_update_system 中更新 */
 }
 
+/**
+ * 计算统计汇总
+ */
+void perf_metrics_calculate_stats(struct perf_metrics_ctx *ctx) {
+    if (!ctx) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    calculate_stats_locked(ctx);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * 更新 eBPF socket 捕获状态使用情况
+ */
+void perf_metrics_update_bpf_maps(struct perf_metrics_ctx *ctx,
+                                  const struct bpf_map_metrics *sk_state) {
+    if (!ctx || !ctx->monitoring_enabled) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    ctx->sk_state = *sk_state;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * 更新 eBPF 连接过滤统计
+ */
+void perf_metrics_update_bpf_policy(struct perf_metrics_ctx *ctx,
+                                    const struct bpf_policy_metrics *policy) {
+    if (!ctx || !ctx->monitoring_enabled) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    ctx->policy = *policy;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * 更新 eBPF 探针活动统计
+ */
+void perf_metrics_update_bpf_probes(struct perf_metrics_ctx *ctx,
+                                    const struct bpf_probe_metrics *probes) {
+    if (!ctx || !ctx->monitoring_enabled) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    ctx->probes = *probes;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * 更新密钥协商工作线程池统计
+ */
+void perf_metrics_update_key_workers(struct perf_metrics_ctx *ctx,
+                                     const struct key_worker_metrics *workers) {
+    if (!ctx || !ctx->monitoring_enabled) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    ctx->workers = *workers;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * 更新密钥请求合并统计
+ */
+void perf_metrics_update_key_requests(struct perf_metrics_ctx *ctx,
+                                      const struct key_request_metrics *requests) {
+    if (!ctx || !ctx->monitoring_enabled) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    ctx->key_requests = *requests;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * 更新密钥缓存统计
+ */
+void perf_metrics_update_key_cache(struct perf_metrics_ctx *ctx,
+                                   const struct key_cache_metrics *cache) {
+    if (!ctx || !ctx->monitoring_enabled) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    ctx->key_cache = *cache;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * 更新密钥预取统计
+ */
+void perf_metrics_update_key_prefetch(struct perf_metrics_ctx *ctx,
+                                      const struct key_prefetch_metrics *prefetch) {
+    if (!ctx || !ctx->monitoring_enabled) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    ctx->key_prefetch = *prefetch;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * 更新 TLSHub 请求统计
+ */
+void perf_metrics_update_tlshub_requests(struct perf_metrics_ctx *ctx,
+                                         const struct tlshub_request_metrics *requests) {
+    if (!ctx || !ctx->monitoring_enabled) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    ctx->tlshub_requests = *requests;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * 更新 TLSHub 熔断统计
+ */
+void perf_metrics_update_breaker(struct perf_metrics_ctx *ctx,
+                                 const struct breaker_metrics *breaker) {
+    if (!ctx || !ctx->monitoring_enabled) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    ctx->breaker = *breaker;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * 更新握手失败退避统计
+ */
+void perf_metrics_update_handshake_backoff(struct perf_metrics_ctx *ctx,
+                                           const struct handshake_backoff_metrics *backoff) {
+    if (!ctx || !ctx->monitoring_enabled) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    ctx->handshake_backoff = *backoff;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * 更新事件丢失与背压统计
+ */
+void perf_metrics_update_event_loss(struct perf_metrics_ctx *ctx,
+                                    const struct event_loss_metrics *loss) {
+    if (!ctx || !ctx->monitoring_enabled) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    ctx->loss = *loss;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
 /**
  * 打印性能统计报告
  */
@@ -459,8 +675,10 @@ void perf_metrics_print_report(struct perf_metrics_ctx *ctx) {
         return;
     }
     
+    pthread_mutex_lock(&ctx->lock);
+    
     /* 先计算统计数据 */
-    perf_metrics_calculate_stats(ctx);
+    calculate_stats_locked(ctx);
     
     printf("\n");
     printf("╔════════════════════════════════════════════════════════════════╗\n");
@@ -514,6 +732,140 @@ void perf_metrics_print_report(struct perf_metrics_ctx *ctx) {
            ctx->system_metrics.memory_vms_kb,
            (double)ctx->system_metrics.memory_vms_kb / 1024.0);
     printf("\n");
+    
+    /* 密钥协商工作线程池 */
+    printf("【密钥协商线程池】\n");
+    printf("  工作线程:       %u\n", ctx->workers.workers);
+    printf("  入队/完成:      %llu / %llu\n", ctx->workers.submitted, ctx->workers.completed);
+    printf("  队列满丢弃:     %llu\n", ctx->workers.dropped);
+    printf("  队列深度:       %llu (峰值 %llu / 容量 %llu)\n",
+           ctx->workers.queue_depth, ctx->workers.queue_max_depth, ctx->workers.queue_capacity);
+    printf("  平均等待:       %.3f ms\n", ctx->workers.avg_wait_ms);
+    printf("  最长等待:       %.3f ms\n", ctx->workers.max_wait_ms);
+    printf("  线程利用率:     %.2f%%\n", ctx->workers.utilization_percent);
+    printf("\n");
+    
+    /* 密钥请求合并 */
+    printf("【密钥请求合并】\n");
+    printf("  请求/实际协商:  %llu / %llu\n",
+           ctx->key_requests.requests, ctx->key_requests.negotiations);
+    printf("  合并请求:       %llu (最多 %llu 个等待者)\n",
+           ctx->key_requests.coalesced, ctx->key_requests.max_waiters);
+    printf("  去重比例:       %.2f%%\n", ctx->key_requests.dedup_ratio_percent);
+    printf("\n");
+    
+    /* 密钥缓存 */
+    if (ctx->key_cache.capacity > 0) {
+        printf("【密钥缓存】\n");
+        printf("  条目/容量:      %llu / %llu\n",
+               ctx->key_cache.entries, ctx->key_cache.capacity);
+        printf("  命中/未命中:    %llu / %llu\n", ctx->key_cache.hits, ctx->key_cache.misses);
+        printf("  过期刷新:       %llu (TLSHub 报告过期 %llu)\n",
+               ctx->key_cache.expired, ctx->key_cache.tlshub_expired);
+        printf("  淘汰:           %llu\n", ctx->key_cache.evictions);
+        printf("  后台刷新:       %llu (失败 %llu, 迟到 %llu, 闲置停止 %llu, 跟踪 %llu)\n",
+               ctx->key_cache.refreshed, ctx->key_cache.refresh_failures,
+               ctx->key_cache.refresh_late, ctx->key_cache.refresh_idle,
+               ctx->key_cache.refresh_tracked);
+        printf("  命中率:         %.2f%%\n", ctx->key_cache.hit_ratio_percent);
+        printf("\n");
+    }
+    
+    /* 密钥预取 */
+    if (ctx->key_prefetch.tracked > 0 || ctx->key_prefetch.seeded > 0) {
+        printf("【密钥预取】\n");
+        printf("  跟踪 Pod 对:    %llu (预置 %llu)\n",
+               ctx->key_prefetch.tracked, ctx->key_prefetch.seeded);
+        printf("  预取/失败:      %llu / %llu\n",
+               ctx->key_prefetch.prefetched, ctx->key_prefetch.failures);
+        printf("  命中/浪费握手:  %llu / %llu\n", ctx->key_prefetch.hits, ctx->key_prefetch.wasted);
+        printf("  预取命中率:     %.2f%%\n", ctx->key_prefetch.hit_ratio_percent);
+        printf("  推迟:           忙 %llu 个周期, 超出预算 %llu 次\n",
+               ctx->key_prefetch.busy, ctx->key_prefetch.throttled);
+        printf("\n");
+    }
+    
+    /* TLSHub 请求 */
+    if (ctx->tlshub_requests.requests > 0) {
+        printf("【TLSHub 请求】\n");
+        printf("  调用/尝试:      %llu / %llu\n",
+               ctx->tlshub_requests.requests, ctx->tlshub_requests.attempts);
+        printf("  超时/出错:      %llu / %llu\n",
+               ctx->tlshub_requests.timeouts, ctx->tlshub_requests.errors);
+        printf("  重试/放弃:      %llu / %llu (取消 %llu)\n", ctx->tlshub_requests.retries,
+               ctx->tlshub_requests.gave_up, ctx->tlshub_requests.cancelled);
+        printf("  fetch 耗时:     p50 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, 最大 %.3f ms\n",
+               ctx->tlshub_requests.fetch_p50_ms, ctx->tlshub_requests.fetch_p99_ms,
+               ctx->tlshub_requests.fetch_p999_ms, ctx->tlshub_requests.fetch_max_ms);
+        printf("  握手耗时:       p50 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, 最大 %.3f ms\n",
+               ctx->tlshub_requests.handshake_p50_ms, ctx->tlshub_requests.handshake_p99_ms,
+               ctx->tlshub_requests.handshake_p999_ms, ctx->tlshub_requests.handshake_max_ms);
+        printf("\n");
+    }
+    
+    /* TLSHub 熔断 */
+    if (ctx->breaker.enabled) {
+        printf("【TLSHub 熔断】\n");
+        printf("  当前状态:       %s\n", circuit_breaker_state_name((int)ctx->breaker.state));
+        printf("  断开/半开/恢复: %llu / %llu / %llu\n",
+               ctx->breaker.opened, ctx->breaker.half_opened, ctx->breaker.closed);
+        printf("  拒绝/后备应答:  %llu / %llu\n", ctx->breaker.rejected, ctx->breaker.fallbacks);
+        printf("  探测/失败:      %llu / %llu\n", ctx->breaker.probes, ctx->breaker.probe_failures);
+        printf("  累计断开:       %.3f 秒\n", ctx->breaker.open_ms / 1000.0);
+        printf("  当前窗口:       %llu 次协商, 失败 %llu, 慢调用 %llu\n", ctx->breaker.window_requests,
+               ctx->breaker.window_failures, ctx->breaker.window_slow);
+        printf("\n");
+    }
+    
+    /* 握手失败退避 */
+    if (ctx->handshake_backoff.failures > 0) {
+        printf("【握手失败退避】\n");
+        printf("  记录 Pod 对:    %llu\n", ctx->handshake_backoff.entries);
+        printf("  握手失败:       %llu\n", ctx->handshake_backoff.failures);
+        printf("  拦下/退避后重试: %llu / %llu\n", ctx->handshake_backoff.suppressed,
+               ctx->handshake_backoff.retried);
+        printf("\n");
+    }
+    
+    /* 事件丢失与背压 */
+    printf("【事件丢失与背压】\n");
+    printf("  perf 溢出丢失:  %llu\n", ctx->loss.perf_lost);
+    printf("  内核提交失败:   %llu\n", ctx->loss.kernel_drops);
+    printf("  背压丢弃:       %llu\n", ctx->loss.shed);
+    printf("  背压模式:       %s (切换 %llu 次)\n",
+           shed_mode_name(ctx->loss.shed_mode), ctx->loss.shed_transitions);
+    for (__u32 cpu = 0; cpu < ctx->loss.ncpus; cpu++) {
+        if (ctx->loss.lost_per_cpu[cpu] || ctx->loss.drops_per_cpu[cpu]) {
+            printf("    CPU %-3u       丢失 %llu / 提交失败 %llu\n", cpu,
+                   ctx->loss.lost_per_cpu[cpu], ctx->loss.drops_per_cpu[cpu]);
+        }
+    }
+    printf("\n");
+    
+    /* eBPF 探针活动 */
+    printf("【eBPF 探针活动】\n");
+    printf("  主动连接:       %llu\n", ctx->probes.connects);
+    printf("  被动连接:       %llu\n", ctx->probes.accepts);
+    printf("  连接失败:       %llu\n", ctx->probes.connect_failures);
+    printf("  sendmsg 命中:   %llu\n", ctx->probes.sendmsg_hits);
+    printf("  提交事件:       %llu\n", ctx->probes.events_emitted);
+    printf("  跳过(地址族):   %llu\n", ctx->probes.family_skipped);
+    printf("\n");
+    
+    /* eBPF socket 捕获状态 */
+    printf("【eBPF Socket 状态】\n");
+    printf("  存活条目:       %llu\n", ctx->sk_state.entries);
+    printf("  累计创建:       %llu\n", ctx->sk_state.creates);
+    printf("  累计删除:       %llu\n", ctx->sk_state.deletes);
+    printf("\n");
+    
+    /* 内核过滤 */
+    printf("【内核过滤】\n");
+    printf("  地址策略过滤:   %llu\n", ctx->policy.suppressed_addr);
+    printf("  端口策略过滤:   %llu\n", ctx->policy.suppressed_port);
+    printf("\n");
+    
+    pthread_mutex_unlock(&ctx->lock);
 }
 
 /**
@@ -533,8 +885,10 @@ int perf_metrics_export_json(struct perf_metrics_ctx *ctx, const char *filename)
         return -1;
     }
     
+    pthread_mutex_lock(&ctx->lock);
+    
     /* 先计算统计数据 */
-    perf_metrics_calculate_stats(ctx);
+    calculate_stats_locked(ctx);
     
     fprintf(fp, "{\n");
     fprintf(fp, "  \"timestamp\": %ld,\n", time(NULL));
@@ -556,6 +910,134 @@ int perf_metrics_export_json(struct perf_metrics_ctx *ctx, const char *filename)
     fprintf(fp, "    \"memory_usage_kb\": %llu\n", ctx->stats.avg_memory_usage_kb);
     fprintf(fp, "  },\n");
     
+    fprintf(fp, "  \"key_workers\": {\n");
+    fprintf(fp, "    \"workers\": %u,\n", ctx->workers.workers);
+    fprintf(fp, "    \"submitted\": %llu,\n", ctx->workers.submitted);
+    fprintf(fp, "    \"completed\": %llu,\n", ctx->workers.completed);
+    fprintf(fp, "    \"dropped\": %llu,\n", ctx->workers.dropped);
+    fprintf(fp, "    \"queue_depth\": %llu,\n", ctx->workers.queue_depth);
+    fprintf(fp, "    \"queue_max_depth\": %llu,\n", ctx->workers.queue_max_depth);
+    fprintf(fp, "    \"queue_capacity\": %llu,\n", ctx->workers.queue_capacity);
+    fprintf(fp, "    \"avg_wait_ms\": %.3f,\n", ctx->workers.avg_wait_ms);
+    fprintf(fp, "    \"max_wait_ms\": %.3f,\n", ctx->workers.max_wait_ms);
+    fprintf(fp, "    \"utilization_percent\": %.2f\n", ctx->workers.utilization_percent);
+    fprintf(fp, "  },\n");
+    
+    fprintf(fp, "  \"key_requests\": {\n");
+    fprintf(fp, "    \"requests\": %llu,\n", ctx->key_requests.requests);
+    fprintf(fp, "    \"negotiations\": %llu,\n", ctx->key_requests.negotiations);
+    fprintf(fp, "    \"coalesced\": %llu,\n", ctx->key_requests.coalesced);
+    fprintf(fp, "    \"max_waiters\": %llu,\n", ctx->key_requests.max_waiters);
+    fprintf(fp, "    \"dedup_ratio_percent\": %.2f\n", ctx->key_requests.dedup_ratio_percent);
+    fprintf(fp, "  },\n");
+    
+    fprintf(fp, "  \"key_cache\": {\n");
+    fprintf(fp, "    \"capacity\": %llu,\n", ctx->key_cache.capacity);
+    fprintf(fp, "    \"entries\": %llu,\n", ctx->key_cache.entries);
+    fprintf(fp, "    \"hits\": %llu,\n", ctx->key_cache.hits);
+    fprintf(fp, "    \"misses\": %llu,\n", ctx->key_cache.misses);
+    fprintf(fp, "    \"expired\": %llu,\n", ctx->key_cache.expired);
+    fprintf(fp, "    \"evictions\": %llu,\n", ctx->key_cache.evictions);
+    fprintf(fp, "    \"tlshub_expired\": %llu,\n", ctx->key_cache.tlshub_expired);
+    fprintf(fp, "    \"refresh_tracked\": %llu,\n", ctx->key_cache.refresh_tracked);
+    fprintf(fp, "    \"refreshed\": %llu,\n", ctx->key_cache.refreshed);
+    fprintf(fp, "    \"refresh_failures\": %llu,\n", ctx->key_cache.refresh_failures);
+    fprintf(fp, "    \"refresh_late\": %llu,\n", ctx->key_cache.refresh_late);
+    fprintf(fp, "    \"refresh_idle\": %llu,\n", ctx->key_cache.refresh_idle);
+    fprintf(fp, "    \"hit_ratio_percent\": %.2f\n", ctx->key_cache.hit_ratio_percent);
+    fprintf(fp, "  },\n");
+    
+    fprintf(fp, "  \"key_prefetch\": {\n");
+    fprintf(fp, "    \"tracked\": %llu,\n", ctx->key_prefetch.tracked);
+    fprintf(fp, "    \"seeded\": %llu,\n", ctx->key_prefetch.seeded);
+    fprintf(fp, "    \"prefetched\": %llu,\n", ctx->key_prefetch.prefetched);
+    fprintf(fp, "    \"failures\": %llu,\n", ctx->key_prefetch.failures);
+    fprintf(fp, "    \"hits\": %llu,\n", ctx->key_prefetch.hits);
+    fprintf(fp, "    \"wasted\": %llu,\n", ctx->key_prefetch.wasted);
+    fprintf(fp, "    \"busy\": %llu,\n", ctx->key_prefetch.busy);
+    fprintf(fp, "    \"throttled\": %llu,\n", ctx->key_prefetch.throttled);
+    fprintf(fp, "    \"hit_ratio_percent\": %.2f\n", ctx->key_prefetch.hit_ratio_percent);
+    fprintf(fp, "  },\n");
+    
+    fprintf(fp, "  \"tlshub_requests\": {\n");
+    fprintf(fp, "    \"requests\": %llu,\n", ctx->tlshub_requests.requests);
+    fprintf(fp, "    \"attempts\": %llu,\n", ctx->tlshub_requests.attempts);
+    fprintf(fp, "    \"retries\": %llu,\n", ctx->tlshub_requests.retries);
+    fprintf(fp, "    \"timeouts\": %llu,\n", ctx->tlshub_requests.timeouts);
+    fprintf(fp, "    \"errors\": %llu,\n", ctx->tlshub_requests.errors);
+    fprintf(fp, "    \"gave_up\": %llu,\n", ctx->tlshub_requests.gave_up);
+    fprintf(fp, "    \"cancelled\": %llu,\n", ctx->tlshub_requests.cancelled);
+    fprintf(fp, "    \"fetch_p50_ms\": %.3f,\n", ctx->tlshub_requests.fetch_p50_ms);
+    fprintf(fp, "    \"fetch_p99_ms\": %.3f,\n", ctx->tlshub_requests.fetch_p99_ms);
+    fprintf(fp, "    \"fetch_p999_ms\": %.3f,\n", ctx->tlshub_requests.fetch_p999_ms);
+    fprintf(fp, "    \"fetch_max_ms\": %.3f,\n", ctx->tlshub_requests.fetch_max_ms);
+    fprintf(fp, "    \"handshake_p50_ms\": %.3f,\n", ctx->tlshub_requests.handshake_p50_ms);
+    fprintf(fp, "    \"handshake_p99_ms\": %.3f,\n", ctx->tlshub_requests.handshake_p99_ms);
+    fprintf(fp, "    \"handshake_p999_ms\": %.3f,\n", ctx->tlshub_requests.handshake_p999_ms);
+    fprintf(fp, "    \"handshake_max_ms\": %.3f\n", ctx->tlshub_requests.handshake_max_ms);
+    fprintf(fp, "  },\n");
+    
+    fprintf(fp, "  \"tlshub_breaker\": {\n");
+    fprintf(fp, "    \"enabled\": %s,\n", ctx->breaker.enabled ? "true" : "false");
+    fprintf(fp, "    \"state\": \"%s\",\n", circuit_breaker_state_name((int)ctx->breaker.state));
+    fprintf(fp, "    \"opened\": %llu,\n", ctx->breaker.opened);
+    fprintf(fp, "    \"half_opened\": %llu,\n", ctx->breaker.half_opened);
+    fprintf(fp, "    \"closed\": %llu,\n", ctx->breaker.closed);
+    fprintf(fp, "    \"rejected\": %llu,\n", ctx->breaker.rejected);
+    fprintf(fp, "    \"fallbacks\": %llu,\n", ctx->breaker.fallbacks);
+    fprintf(fp, "    \"probes\": %llu,\n", ctx->breaker.probes);
+    fprintf(fp, "    \"probe_failures\": %llu,\n", ctx->breaker.probe_failures);
+    fprintf(fp, "    \"open_ms\": %llu,\n", ctx->breaker.open_ms);
+    fprintf(fp, "    \"window_requests\": %llu,\n", ctx->breaker.window_requests);
+    fprintf(fp, "    \"window_failures\": %llu,\n", ctx->breaker.window_failures);
+    fprintf(fp, "    \"window_slow\": %llu\n", ctx->breaker.window_slow);
+    fprintf(fp, "  },\n");
+    
+    fprintf(fp, "  \"handshake_backoff\": {\n");
+    fprintf(fp, "    \"entries\": %llu,\n", ctx->handshake_backoff.entries);
+    fprintf(fp, "    \"failures\": %llu,\n", ctx->handshake_backoff.failures);
+    fprintf(fp, "    \"suppressed\": %llu,\n", ctx->handshake_backoff.suppressed);
+    fprintf(fp, "    \"retried\": %llu\n", ctx->handshake_backoff.retried);
+    fprintf(fp, "  },\n");
+    
+    fprintf(fp, "  \"event_loss\": {\n");
+    fprintf(fp, "    \"perf_lost\": %llu,\n", ctx->loss.perf_lost);
+    fprintf(fp, "    \"kernel_drops\": %llu,\n", ctx->loss.kernel_drops);
+    fprintf(fp, "    \"shed\": %llu,\n", ctx->loss.shed);
+    fprintf(fp, "    \"shed_mode\": \"%s\",\n", shed_mode_name(ctx->loss.shed_mode));
+    fprintf(fp, "    \"shed_transitions\": %llu,\n", ctx->loss.shed_transitions);
+    fprintf(fp, "    \"lost_per_cpu\": [");
+    for (__u32 cpu = 0; cpu < ctx->loss.ncpus; cpu++) {
+        fprintf(fp, "%s%llu", cpu ? ", " : "", ctx->loss.lost_per_cpu[cpu]);
+    }
+    fprintf(fp, "],\n");
+    fprintf(fp, "    \"drops_per_cpu\": [");
+    for (__u32 cpu = 0; cpu < ctx->loss.ncpus; cpu++) {
+        fprintf(fp, "%s%llu", cpu ? ", " : "", ctx->loss.drops_per_cpu[cpu]);
+    }
+    fprintf(fp, "]\n");
+    fprintf(fp, "  },\n");
+    
+    fprintf(fp, "  \"probes\": {\n");
+    fprintf(fp, "    \"connects\": %llu,\n", ctx->probes.connects);
+    fprintf(fp, "    \"accepts\": %llu,\n", ctx->probes.accepts);
+    fprintf(fp, "    \"connect_failures\": %llu,\n", ctx->probes.connect_failures);
+    fprintf(fp, "    \"sendmsg_hits\": %llu,\n", ctx->probes.sendmsg_hits);
+    fprintf(fp, "    \"events_emitted\": %llu,\n", ctx->probes.events_emitted);
+    fprintf(fp, "    \"family_skipped\": %llu\n", ctx->probes.family_skipped);
+    fprintf(fp, "  },\n");
+    
+    fprintf(fp, "  \"sk_state\": {\n");
+    fprintf(fp, "    \"entries\": %llu,\n", ctx->sk_state.entries);
+    fprintf(fp, "    \"creates\": %llu,\n", ctx->sk_state.creates);
+    fprintf(fp, "    \"deletes\": %llu\n", ctx->sk_state.deletes);
+    fprintf(fp, "  },\n");
+    
+    fprintf(fp, "  \"policy\": {\n");
+    fprintf(fp, "    \"suppressed_addr\": %llu,\n", ctx->policy.suppressed_addr);
+    fprintf(fp, "    \"suppressed_port\": %llu\n", ctx->policy.suppressed_port);
+    fprintf(fp, "  },\n");
+    
     fprintf(fp, "  \"connections\": [\n");
     for (i = 0; i < ctx->current_connections; i++) {
         struct connection_metrics *cm = &ctx->conn_metrics[i];
@@ -573,6 +1055,7 @@ int perf_metrics_export_json(struct perf_metrics_ctx *ctx, const char *filename)
     fprintf(fp, "  ]\n");
     fprintf(fp, "}\n");
     
+    pthread_mutex_unlock(&ctx->lock);
     fclose(fp);
     printf("Performance metrics exported to %s\n", filename);
     
@@ -600,6 +1083,7 @@ int perf_metrics_export_csv(struct perf_metrics_ctx *ctx, const char *filename)
     fprintf(fp, "connection_id,connection_latency_ms,key_negotiation_ms,bytes_sent,bytes_received,throughput_mbps\n");
     
     /* 数据行 */
+    pthread_mutex_lock(&ctx->lock);
     for (i = 0; i < ctx->current_connections; i++) {
         struct connection_metrics *cm = &ctx->conn_metrics[i];
         fprintf(fp, "%llu,%.3f,%.3f,%llu,%llu,%.2f\n",
@@ -610,6 +1094,7 @@ int perf_metrics_export_csv(struct perf_metrics_ctx *ctx, const char *filename)
                 cm->bytes_received,
                 cm->throughput_mbps);
     }
+    pthread_mutex_unlock(&ctx->lock);
     
     fclose(fp);
     printf("Performance metrics exported to %s\n", filename);
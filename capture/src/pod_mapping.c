@@ -12,6 +12,8 @@ struct pod_node_table* init_pod_node_mapping(const char *config_file) {
     char line[512];
     char pod_name[MAX_POD_NAME];
     char node_name[MAX_NODE_NAME];
+    char pod_ip[MAX_POD_IP];
+    int fields;
     
     /* 分配映射表内存 */
     table = (struct pod_node_table*)malloc(sizeof(struct pod_node_table));
@@ -30,17 +32,21 @@ struct pod_node_table* init_pod_node_mapping(const char *config_file) {
     }
     
     /* 读取配置文件内容 */
-    /* 格式：pod_name node_name */
+    /* 格式：pod_name node_name [pod_ip] */
     while (fgets(line, sizeof(line), fp) != NULL && table->count < MAX_MAPPINGS) {
         /* 跳过空行和注释 */
         if (line[0] == '\n' || line[0] == '#') {
             continue;
         }
         
-        /* 解析 pod_name 和 node_name */
-        if (sscanf(line, "%s %s", pod_name, node_name) == 2) {
+        /* 解析 pod_name、node_name 和可选的 pod_ip */
+        fields = sscanf(line, "%255s %255s %63s", pod_name, node_name, pod_ip);
+        if (fields >= 2) {
             strncpy(table->mappings[table->count].pod_name, pod_name, MAX_POD_NAME - 1);
             strncpy(table->mappings[table->count].node_name, node_name, MAX_NODE_NAME - 1);
+            if (fields == 3 && pod_ip[0] != '#') {
+                strncpy(table->mappings[table->count].pod_ip, pod_ip, MAX_POD_IP - 1);
+            }
             table->count++;
         }
     }
@@ -91,11 +97,12 @@ void print_pod_node_mapping(struct pod_node_table *table) {
     }
     
     printf("Pod-Node Mapping Table (%d entries):\n", table->count);
-    printf("%-30s %-30s\n", "Pod Name", "Node Name");
-    printf("------------------------------------------------------------\n");
+    printf("%-30s %-30s %s\n", "Pod Name", "Node Name", "Pod IP");
+    printf("------------------------------------------------------------------------\n");
     for (i = 0; i < table->count; i++) {
-        printf("%-30s %-30s\n", 
+        printf("%-30s %-30s %s\n", 
                table->mappings[i].pod_name,
-               table->mappings[i].node_name);
+               table->mappings[i].node_name,
+               table->mappings[i].pod_ip[0] ? table->mappings[i].pod_ip : "-");
     }
 }
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "singleflight.h"
+
+/* 哈希桶数，进行中的 key 数量与工作线程数同量级 */
+#define SINGLEFLIGHT_BUCKETS 64
+
+/* 一次进行中的执行，由执行者和所有等待者共同持有 */
+struct singleflight_call {
+    struct singleflight_call *next;
+    __u32 hash;
+    __u32 key_len;
+    __u8 key[SINGLEFLIGHT_MAX_KEY];
+    __u32 refs;             /* 执行者 + 等待者 */
+    __u32 waiters;
+    int done;
+    int ret;
+    pthread_cond_t cond;
+    __u8 result[];
+};
+
+struct singleflight {
+    pthread_mutex_t lock;
+    struct singleflight_call *buckets[SINGLEFLIGHT_BUCKETS];
+    __u32 result_size;
+
+    __u64 calls;
+    __u64 executions;
+    __u64 shared;
+    __u64 inflight;
+    __u64 max_waiters;
+};
+
+/* FNV-1a */
+static __u32 hash_key(const void *key, __u32 len) {
+    const __u8 *p = key;
+    __u32 h = 2166136261u;
+
+    for (__u32 i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static struct singleflight_call **find_call(struct singleflight *sf, const void *key,
+                                            __u32 key_len, __u32 hash) {
+    struct singleflight_call **pp = &sf->buckets[hash % SINGLEFLIGHT_BUCKETS];
+
+    for (; *pp; pp = &(*pp)->next) {
+        struct singleflight_call *c = *pp;
+
+        if (c->hash == hash && c->key_len == key_len && memcmp(c->key, key, key_len) == 0) {
+            break;
+        }
+    }
+    return pp;
+}
+
+/* 在锁内调用 */
+static void put_call(struct singleflight_call *call) {
+    if (--call->refs == 0) {
+        pthread_cond_destroy(&call->cond);
+        free(call);
+    }
+}
+
+/**
+ * 创建合并组
+ */
+struct singleflight *singleflight_new(__u32 result_size) {
+    struct singleflight *sf;
+
+    sf = calloc(1, sizeof(*sf));
+    if (!sf) {
+        return NULL;
+    }
+    if (pthread_mutex_init(&sf->lock, NULL) != 0) {
+        free(sf);
+        return NULL;
+    }
+    sf->result_size = result_size;
+    return sf;
+}
+
+/**
+ * 执行或加入 key 对应的请求
+ */
+int singleflight_do(struct singleflight *sf, const void *key, __u32 key_len,
+                    singleflight_fn fn, void *arg, void *result, int *shared) {
+    struct singleflight_call **pp, *call;
+    __u32 hash;
+    int ret;
+
+    if (!sf || !key || key_len == 0 || key_len > SINGLEFLIGHT_MAX_KEY || !fn) {
+        return -1;
+    }
+    hash = hash_key(key, key_len);
+
+    pthread_mutex_lock(&sf->lock);
+    sf->calls++;
+    pp = find_call(sf, key, key_len, hash);
+    if (*pp) {
+        /* 已有相同请求在执行，等它完成后复用结果 */
+        call = *pp;
+        call->refs++;
+        call->waiters++;
+        if (call->waiters > sf->max_waiters) {
+            sf->max_waiters = call->waiters;
+        }
+        sf->shared++;
+        while (!call->done) {
+            pthread_cond_wait(&call->cond, &sf->lock);
+        }
+        ret = call->ret;
+        if (result) {
+            memcpy(result, call->result, sf->result_size);
+        }
+        put_call(call);
+        pthread_mutex_unlock(&sf->lock);
+        if (shared) {
+            *shared = 1;
+        }
+        return ret;
+    }
+
+    call = calloc(1, sizeof(*call) + sf->result_size);
+    if (!call) {
+        sf->calls--;
+        pthread_mutex_unlock(&sf->lock);
+        return -1;
+    }
+    call->hash = hash;
+    call->key_len = key_len;
+    memcpy(call->key, key, key_len);
+    call->refs = 1;
+    pthread_cond_init(&call->cond, NULL);
+    *pp = call;
+    sf->executions++;
+    sf->inflight++;
+    pthread_mutex_unlock(&sf->lock);
+
+    /* 锁外执行，等待者只在 call->cond 上阻塞 */
+    ret = fn(arg, call->result);
+
+    pthread_mutex_lock(&sf->lock);
+    call->ret = ret;
+    call->done = 1;
+    /* 从表中摘除，之后到达的调用者会发起新的执行 */
+    pp = find_call(sf, key, key_len, hash);
+    if (*pp == call) {
+        *pp = call->next;
+    }
+    sf->inflight--;
+    pthread_cond_broadcast(&call->cond);
+    if (result) {
+        memcpy(result, call->result, sf->result_size);
+    }
+    put_call(call);
+    pthread_mutex_unlock(&sf->lock);
+
+    if (shared) {
+        *shared = 0;
+    }
+    return ret;
+}
+
+/**
+ * 获取合并统计
+ */
+void singleflight_get_stats(struct singleflight *sf, struct singleflight_stats *stats) {
+    if (!sf || !stats) {
+        return;
+    }
+
+    pthread_mutex_lock(&sf->lock);
+    stats->calls = sf->calls;
+    stats->executions = sf->executions;
+    stats->shared = sf->shared;
+    stats->inflight = sf->inflight;
+    stats->max_waiters = sf->max_waiters;
+    pthread_mutex_unlock(&sf->lock);
+}
+
+/**
+ * 释放合并组
+ */
+void singleflight_free(struct singleflight *sf) {
+    if (!sf) {
+        return;
+    }
+    pthread_mutex_destroy(&sf->lock);
+    free(sf);
+}
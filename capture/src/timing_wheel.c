@@ -0,0 +1,136 @@
+#include <string.h>
+#include "timing_wheel.h"
+
+#define SLOT_MASK (TIMING_WHEEL_SLOTS - 1)
+
+/* 最远可定时的 tick 数 */
+#define MAX_DELTA ((1ULL << (TIMING_WHEEL_BITS * TIMING_WHEEL_LEVELS)) - 1)
+
+static void slot_insert(struct timer_node **head, struct timer_node *node) {
+    node->next = *head;
+    if (node->next) {
+        node->next->pprev = &node->next;
+    }
+    node->pprev = head;
+    *head = node;
+}
+
+static void slot_remove(struct timer_node *node) {
+    *node->pprev = node->next;
+    if (node->next) {
+        node->next->pprev = node->pprev;
+    }
+    node->next = NULL;
+    node->pprev = NULL;
+}
+
+/**
+ * 按距离下一个 tick 的远近选择层和槽位
+ */
+static struct timer_node **select_slot(struct timing_wheel *wheel, __u64 expires) {
+    __u64 delta;
+    int level;
+
+    if (expires < wheel->next_tick) {
+        expires = wheel->next_tick;
+    }
+    delta = expires - wheel->next_tick;
+    if (delta > MAX_DELTA) {
+        expires = wheel->next_tick + MAX_DELTA;
+        delta = MAX_DELTA;
+    }
+
+    for (level = 0; level < TIMING_WHEEL_LEVELS - 1; level++) {
+        if (delta < (1ULL << (TIMING_WHEEL_BITS * (level + 1)))) {
+            break;
+        }
+    }
+    return &wheel->slots[level][(expires >> (TIMING_WHEEL_BITS * level)) & SLOT_MASK];
+}
+
+/**
+ * 初始化时间轮
+ */
+void timing_wheel_init(struct timing_wheel *wheel, __u64 now_tick) {
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->next_tick = now_tick + 1;
+}
+
+/**
+ * 添加定时器
+ */
+void timing_wheel_add(struct timing_wheel *wheel, struct timer_node *node, __u64 expires) {
+    node->expires = expires;
+    slot_insert(select_slot(wheel, expires), node);
+    wheel->count++;
+}
+
+/**
+ * 删除定时器
+ */
+void timing_wheel_del(struct timing_wheel *wheel, struct timer_node *node) {
+    if (!timing_wheel_pending(node)) {
+        return;
+    }
+    slot_remove(node);
+    wheel->count--;
+}
+
+/**
+ * 把 level 层的 index 槽位重新分配到下层，返回 index
+ * （为 0 表示该层也转过了一圈，需要继续级联上一层）
+ */
+static __u32 cascade(struct timing_wheel *wheel, int level, __u32 index) {
+    struct timer_node *node = wheel->slots[level][index];
+
+    wheel->slots[level][index] = NULL;
+    while (node) {
+        struct timer_node *next = node->next;
+
+        node->pprev = NULL;
+        slot_insert(select_slot(wheel, node->expires), node);
+        node = next;
+    }
+    return index;
+}
+
+/**
+ * 推进到 now_tick，取下所有到期的定时器
+ */
+__u32 timing_wheel_advance(struct timing_wheel *wheel, __u64 now_tick,
+                           struct timer_node **expired) {
+    struct timer_node *list = NULL;
+    __u32 count = 0;
+
+    while (wheel->next_tick <= now_tick) {
+        __u32 index = wheel->next_tick & SLOT_MASK;
+        struct timer_node *node;
+
+        if (index == 0) {
+            for (int level = 1; level < TIMING_WHEEL_LEVELS; level++) {
+                __u32 upper = (wheel->next_tick >> (TIMING_WHEEL_BITS * level)) & SLOT_MASK;
+
+                if (cascade(wheel, level, upper) != 0) {
+                    break;
+                }
+            }
+        }
+
+        node = wheel->slots[0][index];
+        wheel->slots[0][index] = NULL;
+        while (node) {
+            struct timer_node *next = node->next;
+
+            node->pprev = NULL;
+            node->next = list;
+            list = node;
+            count++;
+            node = next;
+        }
+        wheel->next_tick++;
+    }
+
+    wheel->count -= count;
+    *expired = list;
+    return count;
+}
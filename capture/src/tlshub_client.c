@@ -3,174 +3,1398 @@
 #include <string.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <linux/netlink.h>
 #include <sys/syscall.h>
 #include <arpa/inet.h>
 #include "tlshub_client.h"
+#include "tlshub_proto.h"
+#include "log.h"
 
-#define NETLINK_TEST 31  /* TLSHub Netlink 协议号 */
-#define MAX_PAYLOAD 125
-
-/* TLSHub 消息结构 */
-typedef struct _user_msg_info {
-    struct nlmsghdr hdr;
-    char msg_type;
-    char msg[MAX_PAYLOAD];
-} user_msg_info;
-
-/* TLSHub 消息载荷 */
-struct my_msg {
-    uint32_t client_pod_ip;
-    uint32_t server_pod_ip;
-    unsigned short client_pod_port;
-    unsigned short server_pod_port;
-    char opcode;
-    bool server;
+/* 每个线程独立的上下文，netlink 传输下内核按 nl_pid（线程 ID）回送响应 */
+typedef struct {
+    int sk_fd;
+    __u32 port_id;          /* 请求中的 nlmsg_pid */
+    int detached;           /* 放弃过请求：之后改用单独的、由内核分配端口号的 socket */
+    __u32 seq;              /* 上一个请求的 nlmsg_seq */
+} netlink_context_t;
+
+/*
+ * 传输层：与 TLSHub 交换消息的 socket 如何创建、消息如何发送
+ * - netlink: 内核模块（默认）
+ * - unix: Unix 域 SOCK_SEQPACKET socket 上的用户态 TLSHub 端点
+ * - mock: 进程内的替身（tlshub_standin.c），每个 socket 是一对 socketpair 的一端
+ * 各传输的消息格式相同（tlshub_proto.h），初始化、每线程、流水线和批量路径都经由当前传输收发
+ */
+struct transport_ops {
+    const char *name;
+    /* 创建 socket，bind_tid 为 1 时以线程 ID 作为端口号，*port_id 返回请求中使用的 nlmsg_pid */
+    int (*open)(int bind_tid, __u32 *port_id);
+    ssize_t (*send)(int fd, const void *buf, size_t len);
+};
+
+/* 初始化用的 socket，由调用 tlshub_client_init 的线程持有 */
+static int netlink_sock = -1;
+static __u32 init_port_id;
+static const struct sockaddr_nl dest_addr = { .nl_family = AF_NETLINK };
+
+/* fetch/handshake 使用的线程私有 socket，首次使用时创建 */
+static __thread netlink_context_t g_netlink_ctx = { .sk_fd = -1 };
+
+/*
+ * 流水线模式：所有线程共用一个 socket，请求带唯一的 nlmsg_seq，
+ * 一个 socket 上可同时有 depth 个请求在途，响应按 seq 交给对应的等待者。
+ * 不使用单独的接收线程：等待响应的线程中同一时刻只有一个（leader）在 socket 上阻塞读取，
+ * 把读到的响应分发给其他等待者，自己的响应到达后把读取权交给下一个等待者。
+ * seq 低 8 位为槽位下标，高位为该槽位的使用次数，分发时 O(1) 定位并校验。
+ */
+struct pipeline_slot {
+    __u32 seq;              /* 0 表示空闲 */
+    __u32 generation;
+    int done;
+    int ret;                /* 0 表示收到响应，负值表示 socket 出错 */
+    pthread_cond_t cond;
+    void *resp;             /* 调用者的响应缓冲区 */
+    size_t resp_size;
 };
 
-/* TLSHub 操作码 */
-enum {
-    TLS_SERVICE_INIT,   // 0
-    TLS_SERVICE_START,  // 1 
-    TLS_SERVICE_FETCH   // 2
+static struct {
+    int fd;
+    ssize_t (*send)(int fd, const void *buf, size_t len);
+    __u32 port_id;                  /* 请求中的 nlmsg_pid */
+    __u32 depth;
+    struct pipeline_slot *slots;
+    __u32 outstanding;
+    __u32 next_slot;
+    int leader;                     /* 是否已有线程在读取 socket */
+    pthread_mutex_t lock;
+    pthread_cond_t slot_free;
+    struct tlshub_pipeline_stats stats;
+} pipeline = {
+    .fd = -1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .slot_free = PTHREAD_COND_INITIALIZER,
 };
 
-/* TLSHub 响应消息类型 */
-enum {
-    MSG_TYPE_HANDSHAKE_SUCCESS_FIRST = 0x01,  // 首次握手成功
-    MSG_TYPE_HANDSHAKE_SUCCESS = 0x02,        // 非首次握手成功
-    MSG_TYPE_HANDSHAKE_FAILED = 0x03,         // 握手失败
-    MSG_TYPE_LOG = 0x04,                       // 日志消息
-    MSG_TYPE_ALREADY_CONNECTED = 0x05,         // 已连接
-    MSG_TYPE_INIT_COMPLETE = 0x07              // 初始化完成
+/*
+ * 批量模式：并发的 fetch/handshake 先进入当前打开的批次，
+ * 第一个加入批次的线程负责发送：批次满 max_entries 项或等待 delay 后封口，
+ * 以一条批量消息发出，收到批量响应后把各项结果交给对应的调用者。
+ * 封口后新来的请求进入下一个批次，多个批次可以同时在途。
+ */
+struct key_batch {
+    struct my_msg entries[TLSHUB_BATCH_MAX];
+    struct tlshub_batch_result results[TLSHUB_BATCH_MAX];
+    __u32 count;
+    __u32 refs;             /* 尚未取走结果的调用者数 */
+    int done;
+    int ret;
+    pthread_cond_t cond;
 };
 
-/* 密钥返回结构 */
-struct key_back {
-    int status; // 0:成功 -1:失败 -2:过期
-    unsigned char masterkey[32];
+/* batch_submit 返回该值表示模块不支持批量请求，调用者改走单条请求 */
+#define BATCH_FALLBACK 1
+
+static struct {
+    __u32 max_entries;              /* 0 表示未启用 */
+    __u64 delay_ns;
+    int unsupported;                /* 模块未按批量格式响应 */
+    struct key_batch *open;         /* 正在收集请求的批次 */
+    pthread_mutex_t lock;
+    struct tlshub_batch_stats stats;
+} batcher = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
 };
 
-static int netlink_sock = -1;
-static struct sockaddr_nl dest_addr;
+/*
+ * 请求期限与重试：每次尝试都有期限（CLOCK_MONOTONIC 纳秒，0 表示不限），
+ * 等待响应时 poll socket 和 cancel_fd，不再无限期阻塞在 recv 中。
+ * 一次尝试的结果除 0 和 -1（收发失败）外还有以下两种
+ */
+#define CALL_TIMEOUT -2         /* 超过期限 */
+#define CALL_CANCELLED -3       /* 已被 tlshub_client_cancel 取消 */
+
+static struct tlshub_retry_policy retry_policy = {
+    .timeout_ms = TLSHUB_DEFAULT_TIMEOUT_MS,
+    .retries = TLSHUB_DEFAULT_RETRIES,
+    .backoff_ms = TLSHUB_DEFAULT_BACKOFF_MS,
+    .backoff_max_ms = TLSHUB_DEFAULT_BACKOFF_MAX_MS,
+};
+
+/* 取消后 cancelled 置 1，并写 cancel_fd（eventfd，之后一直可读）唤醒所有 poll */
+static int cancelled;
+static int cancel_fd = -1;
+
+static struct tlshub_request_stats request_stats;
+
+/**
+ * 将四元组填入 TLSHub 消息
+ * 字节序说明：
+ * - tuple 中的 IP 已经是网络字节序，原样传给内核，内核用 ntohl() 转换为主机序
+ * - tuple 中的端口是主机序，需要转换为网络序
+ * IPv6 连接的 client_pod_ip/server_pod_ip 置 0，地址放在 *_ip6 中
+ * tuple 始终是客户端 -> 服务端，本机为服务端时置 server 标志
+ */
+static void fill_msg_tuple(struct my_msg *mmsg, const struct flow_tuple *tuple) {
+    if (tuple->family == AF_INET6) {
+        mmsg->family = AF_INET6;
+        memcpy(mmsg->client_pod_ip6, tuple->saddr6, sizeof(mmsg->client_pod_ip6));
+        memcpy(mmsg->server_pod_ip6, tuple->daddr6, sizeof(mmsg->server_pod_ip6));
+    } else {
+        mmsg->family = AF_INET;
+        mmsg->client_pod_ip = tuple->saddr;
+        mmsg->server_pod_ip = tuple->daddr;
+    }
+    mmsg->client_pod_port = htons(tuple->sport);
+    mmsg->server_pod_port = htons(tuple->dport);
+    mmsg->server = tuple->role == FLOW_ROLE_SERVER;
+}
 
 pid_t gettid(void)
 {
     return syscall(SYS_gettid);
 }
 
+static __u64 now_ns(void) {
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void stat_add(__u64 *counter, __u64 value) {
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+static int is_cancelled(void) {
+    return __atomic_load_n(&cancelled, __ATOMIC_RELAXED);
+}
+
 /**
- * 初始化 TLSHub 客户端
+ * 创建取消用的 eventfd（已创建时直接返回）
  */
-int tlshub_client_init(void) {
+static void cancel_fd_open(void) {
+    if (cancel_fd < 0) {
+        cancel_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    }
+}
+
+/**
+ * 按当前策略计算一次尝试的期限
+ */
+static __u64 attempt_deadline(void) {
+    if (retry_policy.timeout_ms == 0) {
+        return 0;
+    }
+    return now_ns() + (__u64)retry_policy.timeout_ms * 1000000ULL;
+}
+
+/**
+ * 等待 fd 可读，直到期限到达或请求被取消；fd 为负时只等待期限和取消
+ * @return: 可读返回 0，超时返回 CALL_TIMEOUT，已取消返回 CALL_CANCELLED，出错返回 -1
+ */
+static int wait_readable(int fd, __u64 deadline_ns) {
+    struct pollfd pfd[2] = {
+        { .fd = fd, .events = POLLIN },
+        { .fd = cancel_fd, .events = POLLIN },
+    };
+    int timeout_ms;
+    int n;
+    
+    for (;;) {
+        if (is_cancelled()) {
+            return CALL_CANCELLED;
+        }
+        timeout_ms = -1;
+        if (deadline_ns) {
+            __u64 now = now_ns();
+    
+            if (now >= deadline_ns) {
+                return CALL_TIMEOUT;
+            }
+            timeout_ms = (int)((deadline_ns - now + 999999) / 1000000);
+        }
+    
+        n = poll(pfd, cancel_fd >= 0 ? 2 : 1, timeout_ms);
+        if (n < 0 && errno != EINTR) {
+            return -1;
+        }
+        if (n > 0 && pfd[0].revents) {
+            /* 包括 POLLERR/POLLHUP，由随后的 recv 报告错误 */
+            return 0;
+        }
+    }
+}
+
+/**
+ * 初始化一个使用 CLOCK_MONOTONIC 的条件变量，供 cond_wait_until 使用
+ */
+static void cond_init_monotonic(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/**
+ * 等待条件变量直到期限（0 表示不限）
+ * @return: 超过期限返回 ETIMEDOUT，否则返回 0
+ */
+static int cond_wait_until(pthread_cond_t *cond, pthread_mutex_t *lock, __u64 deadline_ns) {
+    struct timespec ts;
+    
+    if (deadline_ns == 0) {
+        pthread_cond_wait(cond, lock);
+        return 0;
+    }
+    ts.tv_sec = deadline_ns / 1000000000ULL;
+    ts.tv_nsec = deadline_ns % 1000000000ULL;
+    return pthread_cond_timedwait(cond, lock, &ts) == ETIMEDOUT ? ETIMEDOUT : 0;
+}
+
+/**
+ * 第 attempt 次失败后的退避：backoff_ms 每次加倍直到 backoff_max_ms，
+ * 实际等待在 [d/2, d] 内随机，避免同时超时的请求同时重试
+ * @return: 等待期间被取消返回 CALL_CANCELLED，否则返回 0
+ */
+static int backoff_wait(__u32 attempt) {
+    static __thread unsigned int seed;
+    __u64 delay_ns = (__u64)retry_policy.backoff_ms * 1000000ULL;
+    __u64 max_ns = (__u64)retry_policy.backoff_max_ms * 1000000ULL;
+    
+    if (seed == 0) {
+        seed = (unsigned int)(gettid() ^ now_ns()) | 1;
+    }
+    for (__u32 i = 0; i < attempt && delay_ns < max_ns; i++) {
+        delay_ns <<= 1;
+    }
+    if (delay_ns > max_ns) {
+        delay_ns = max_ns;
+    }
+    if (delay_ns == 0) {
+        return is_cancelled() ? CALL_CANCELLED : 0;
+    }
+    
+    delay_ns = delay_ns / 2 + (__u64)rand_r(&seed) % (delay_ns / 2 + 1);
+    return wait_readable(-1, now_ns() + delay_ns) == CALL_CANCELLED ? CALL_CANCELLED : 0;
+}
+
+/* 持有初始化 socket 的线程 */
+static pid_t init_tid;
+
+/* 模块在 INIT_COMPLETE 中声明的协议版本和特性，旧模块均为 0 */
+static __u32 module_version;
+static __u32 module_features;
+
+/* unix 传输的端点路径 */
+static char unix_path[108] = TLSHUB_DEFAULT_UNIX_PATH;
+
+/* mock 传输的替身，首次创建 socket 时启动，tlshub_client_cleanup 时停止 */
+static struct tlshub_standin_config mock_config;
+static struct tlshub_standin *mock_standin;
+static pthread_mutex_t mock_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static ssize_t netlink_send(int fd, const void *buf, size_t len) {
+    return sendto(fd, buf, len, 0, (const struct sockaddr*)&dest_addr, sizeof(dest_addr));
+}
+
+static int netlink_open(int bind_tid, __u32 *port_id) {
     struct sockaddr_nl src_addr;
-    struct nlmsghdr *nlh = NULL;
-    user_msg_info u_info;
-    int ret;
-    socklen_t len;
+    socklen_t len = sizeof(src_addr);
+    int fd;
     
-    /* 创建 Netlink socket */
-    netlink_sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_TEST);
-    if (netlink_sock < 0) {
+    fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_TEST);
+    if (fd < 0) {
         perror("Failed to create netlink socket");
         return -1;
     }
     
-    /* 绑定本地地址 */
+    /* nl_pid 为 0 时由内核分配唯一的端口号 */
     memset(&src_addr, 0, sizeof(src_addr));
     src_addr.nl_family = AF_NETLINK;
-    src_addr.nl_pid = gettid();
+    src_addr.nl_pid = bind_tid ? gettid() : 0;
     src_addr.nl_groups = 0;
-    
-    if (bind(netlink_sock, (struct sockaddr*)&src_addr, sizeof(src_addr)) < 0) {
+    if (bind(fd, (struct sockaddr*)&src_addr, sizeof(src_addr)) < 0 ||
+        getsockname(fd, (struct sockaddr*)&src_addr, &len) < 0) {
         perror("Failed to bind netlink socket");
-        close(netlink_sock);
-        netlink_sock = -1;
+        close(fd);
         return -1;
     }
+    *port_id = src_addr.nl_pid;
+    return fd;
+}
+
+static ssize_t socket_send(int fd, const void *buf, size_t len) {
+    return send(fd, buf, len, MSG_NOSIGNAL);
+}
+
+static int unix_open(int bind_tid, __u32 *port_id) {
+    struct sockaddr_un addr;
+    int fd;
     
-    /* 设置目标地址（内核） */
-    memset(&dest_addr, 0, sizeof(dest_addr));
-    dest_addr.nl_family = AF_NETLINK;
-    dest_addr.nl_pid = 0;
-    dest_addr.nl_groups = 0;
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("Failed to create unix socket");
+        return -1;
+    }
     
-    /* 分配并初始化 Netlink 消息 */
-    nlh = (struct nlmsghdr*)malloc(NLMSG_SPACE(MAX_PAYLOAD));
-    if (!nlh) {
-        fprintf(stderr, "Failed to allocate netlink message\n");
-        close(netlink_sock);
-        netlink_sock = -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, unix_path);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "Failed to connect to TLSHub endpoint %s: %s\n", unix_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    *port_id = bind_tid ? (__u32)gettid() : 0;
+    return fd;
+}
+
+static int mock_open(int bind_tid, __u32 *port_id) {
+    int sv[2];
+    
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        perror("Failed to create socketpair");
+        return -1;
+    }
+    
+    pthread_mutex_lock(&mock_lock);
+    if (!mock_standin) {
+        mock_standin = tlshub_standin_new(&mock_config);
+    }
+    if (!mock_standin || tlshub_standin_add_fd(mock_standin, sv[1]) < 0) {
+        pthread_mutex_unlock(&mock_lock);
+        fprintf(stderr, "Failed to connect to the mock TLSHub endpoint\n");
+        if (!mock_standin) {
+            close(sv[1]);
+        }
+        close(sv[0]);
+        return -1;
+    }
+    pthread_mutex_unlock(&mock_lock);
+    
+    *port_id = bind_tid ? (__u32)gettid() : 0;
+    return sv[0];
+}
+
+static const struct transport_ops transports[] = {
+    [TLSHUB_TRANSPORT_NETLINK] = { "netlink", netlink_open, netlink_send },
+    [TLSHUB_TRANSPORT_UNIX] = { "unix", unix_open, socket_send },
+    [TLSHUB_TRANSPORT_MOCK] = { "mock", mock_open, socket_send },
+};
+
+static const struct transport_ops *transport = &transports[TLSHUB_TRANSPORT_NETLINK];
+
+/**
+ * 为当前线程创建 socket（已创建时直接返回）
+ * 初始化 socket 已占用调用 tlshub_client_init 的线程 ID，该线程直接复用它
+ */
+static int netlink_ctx_init(netlink_context_t *ctx) {
+    if (ctx->sk_fd >= 0) {
+        return 0;
+    }
+    
+    if (netlink_sock >= 0 && init_tid == gettid() && !ctx->detached) {
+        ctx->sk_fd = netlink_sock;
+        ctx->port_id = init_port_id;
+        return 0;
+    }
+    
+    /*
+     * 线程 ID 仍被初始化 socket 占用，或该线程放弃过请求时由内核分配端口号：
+     * 模块按端口号回送，被放弃请求的迟到响应发往已关闭的旧端口，不会进入新 socket
+     */
+    ctx->sk_fd = transport->open(!ctx->detached, &ctx->port_id);
+    return ctx->sk_fd < 0 ? -1 : 0;
+}
+
+/**
+ * 放弃当前线程的 socket：被放弃的请求的响应可能随后才到，
+ * 关闭 socket 以免被当作下一个请求的响应，下次使用时以新的端口号重建。初始化 socket 不关闭
+ */
+static void netlink_ctx_reset(netlink_context_t *ctx) {
+    if (ctx->sk_fd >= 0 && ctx->sk_fd != netlink_sock) {
+        close(ctx->sk_fd);
+    }
+    ctx->sk_fd = -1;
+    ctx->detached = 1;
+}
+
+/**
+ * 返回线程私有上下文，失败返回 NULL
+ */
+static netlink_context_t *netlink_ctx_get(void) {
+    netlink_context_t *ctx = &g_netlink_ctx;
+    
+    if (netlink_sock < 0) {
+        fprintf(stderr, "TLSHub client not initialized\n");
+        return NULL;
+    }
+    if (netlink_ctx_init(ctx) < 0) {
+        return NULL;
+    }
+    return ctx;
+}
+
+/**
+ * 流水线模式是否已启用
+ */
+static int pipeline_enabled(void) {
+    return pipeline.slots != NULL;
+}
+
+/**
+ * 发送一个带 seq 的请求
+ */
+static int pipeline_send(const void *payload, size_t len, __u32 seq) {
+    struct {
+        struct nlmsghdr hdr;
+        struct tlshub_batch_req msg;
+    } req;
+    ssize_t ret;
+    
+    memset(&req.hdr, 0, sizeof(req.hdr));
+    req.hdr.nlmsg_len = sizeof(struct nlmsghdr) + len;
+    req.hdr.nlmsg_seq = seq;
+    req.hdr.nlmsg_pid = pipeline.port_id;
+    memcpy(&req.msg, payload, len);
+    
+    do {
+        ret = pipeline.send(pipeline.fd, &req, req.hdr.nlmsg_len);
+    } while (ret < 0 && errno == EINTR);
+    
+    return ret == (ssize_t)req.hdr.nlmsg_len ? 0 : -1;
+}
+
+/**
+ * 把读到的消息交给 seq 对应的等待者（持锁调用）
+ * 日志消息不结束请求；seq 对不上的响应计数后丢弃
+ */
+static void pipeline_dispatch(const union tlshub_msg *buf, size_t len) {
+    const user_msg_info *msg = &buf->info;
+    __u32 seq = msg->hdr.nlmsg_seq;
+    struct pipeline_slot *slot = NULL;
+    
+    if (seq != 0 && (seq & 0xff) < pipeline.depth &&
+        pipeline.slots[seq & 0xff].seq == seq && !pipeline.slots[seq & 0xff].done) {
+        slot = &pipeline.slots[seq & 0xff];
+    }
+    
+    if (msg->msg_type == MSG_TYPE_LOG) {
+        pipeline.stats.logs++;
+        if (slot) {
+            log_debug("TLSHub log (seq %u): %s", seq, msg->msg);
+        } else {
+            log_info("TLSHub log: %s", msg->msg);
+        }
+        return;
+    }
+    
+    if (!slot) {
+        pipeline.stats.orphans++;
+        log_warn("Dropping TLSHub response with unknown seq %u (type 0x%02x)",
+                 seq, (unsigned char)msg->msg_type);
+        return;
+    }
+    
+    pipeline.stats.responses++;
+    memcpy(slot->resp, buf, len < slot->resp_size ? len : slot->resp_size);
+    slot->ret = 0;
+    slot->done = 1;
+    pthread_cond_signal(&slot->cond);
+}
+
+/**
+ * socket 出错或取消时结束所有在途请求（持锁调用）
+ */
+static void pipeline_fail_all(int ret) {
+    for (__u32 i = 0; i < pipeline.depth; i++) {
+        struct pipeline_slot *slot = &pipeline.slots[i];
+    
+        if (slot->seq != 0 && !slot->done) {
+            slot->ret = ret;
+            slot->done = 1;
+            pthread_cond_signal(&slot->cond);
+        }
+    }
+}
+
+/**
+ * 唤醒一个仍在等待的线程接替读取（持锁调用）
+ */
+static void pipeline_wake_leader(void) {
+    for (__u32 i = 0; i < pipeline.depth; i++) {
+        struct pipeline_slot *slot = &pipeline.slots[i];
+    
+        if (slot->seq != 0 && !slot->done) {
+            pthread_cond_signal(&slot->cond);
+            return;
+        }
+    }
+}
+
+/**
+ * 发送请求（payload 为 nlmsghdr 之后的部分）并等待 seq 匹配的响应，
+ * 响应（含 nlmsghdr）最多复制 resp_size 字节到 resp。
+ * 超过期限时释放槽位，该 seq 迟到的响应按无主响应丢弃
+ * @return: 成功返回 0，失败返回 -1、CALL_TIMEOUT 或 CALL_CANCELLED
+ */
+static int pipeline_call(const void *payload, size_t len, void *resp, size_t resp_size,
+                         __u64 deadline_ns) {
+    struct pipeline_slot *slot = NULL;
+    union tlshub_msg msg;
+    __u32 idx = 0;
+    int ret;
+    
+    pthread_mutex_lock(&pipeline.lock);
+    while (pipeline.fd >= 0 && pipeline.outstanding >= pipeline.depth && !is_cancelled()) {
+        if (cond_wait_until(&pipeline.slot_free, &pipeline.lock, deadline_ns) == ETIMEDOUT) {
+            pthread_mutex_unlock(&pipeline.lock);
+            return CALL_TIMEOUT;
+        }
+    }
+    if (is_cancelled()) {
+        pthread_mutex_unlock(&pipeline.lock);
+        return CALL_CANCELLED;
+    }
+    if (pipeline.fd < 0) {
+        pthread_mutex_unlock(&pipeline.lock);
+        return -1;
+    }
+    
+    /* 占用一个空闲槽位，seq = 使用次数 << 8 | 下标，不会为 0 */
+    for (__u32 i = 0; i < pipeline.depth; i++) {
+        idx = (pipeline.next_slot + i) % pipeline.depth;
+        if (pipeline.slots[idx].seq == 0) {
+            slot = &pipeline.slots[idx];
+            break;
+        }
+    }
+    pipeline.next_slot = (idx + 1) % pipeline.depth;
+    if (++slot->generation >= (1U << 24)) {
+        slot->generation = 1;
+    }
+    slot->seq = (slot->generation << 8) | idx;
+    slot->done = 0;
+    slot->resp = resp;
+    slot->resp_size = resp_size;
+    pipeline.outstanding++;
+    pipeline.stats.requests++;
+    if (pipeline.outstanding > pipeline.stats.max_outstanding) {
+        pipeline.stats.max_outstanding = pipeline.outstanding;
+    }
+    pthread_mutex_unlock(&pipeline.lock);
+    
+    ret = pipeline_send(payload, len, slot->seq);
+    
+    pthread_mutex_lock(&pipeline.lock);
+    if (ret < 0) {
+        log_error("Failed to send TLSHub request (seq %u): %s", slot->seq, strerror(errno));
+        slot->ret = -1;
+        slot->done = 1;
+    }
+    
+    while (!slot->done) {
+        ssize_t n = 0;
+        int err = 0;
+    
+        if (pipeline.leader) {
+            if (cond_wait_until(&slot->cond, &pipeline.lock, deadline_ns) == ETIMEDOUT &&
+                !slot->done) {
+                slot->ret = CALL_TIMEOUT;
+                slot->done = 1;
+            }
+            continue;
+        }
+    
+        /* 成为 leader：锁外等待到自己的期限，读到一条消息后回来分发 */
+        pipeline.leader = 1;
+        pthread_mutex_unlock(&pipeline.lock);
+        ret = wait_readable(pipeline.fd, deadline_ns);
+        if (ret == 0) {
+            n = recv(pipeline.fd, &msg, sizeof(msg), MSG_DONTWAIT);
+            err = errno;
+        }
+        pthread_mutex_lock(&pipeline.lock);
+        pipeline.leader = 0;
+    
+        if (ret == CALL_CANCELLED) {
+            pipeline_fail_all(CALL_CANCELLED);
+        } else if (ret < 0) {
+            /* 自己的期限已到，放弃读取权，由下面唤醒的等待者接替 */
+            slot->ret = ret;
+            slot->done = 1;
+        } else if (n < 0 && (err == EINTR || err == EAGAIN)) {
+            continue;
+        } else if (n < (ssize_t)sizeof(struct nlmsghdr) + 1) {
+            pipeline.stats.reads++;
+            log_error("Failed to receive TLSHub response: %s",
+                      n < 0 ? strerror(err) : "short message");
+            pipeline_fail_all(-1);
+        } else {
+            pipeline.stats.reads++;
+            pipeline_dispatch(&msg, n);
+        }
+    }
+    
+    ret = slot->ret;
+    slot->seq = 0;
+    pipeline.outstanding--;
+    pthread_cond_signal(&pipeline.slot_free);
+    if (!pipeline.leader) {
+        pipeline_wake_leader();
+    }
+    pthread_mutex_unlock(&pipeline.lock);
+    return ret;
+}
+
+/**
+ * 在 fd 上建立流水线
+ */
+static int pipeline_setup(int fd, ssize_t (*send_fn)(int, const void *, size_t),
+                          __u32 port_id, __u32 depth) {
+    struct pipeline_slot *slots;
+    
+    if (depth == 0 || depth > TLSHUB_PIPELINE_MAX_DEPTH) {
+        fprintf(stderr, "Invalid TLSHub pipeline depth: %u (1-%d)\n",
+                depth, TLSHUB_PIPELINE_MAX_DEPTH);
+        return -1;
+    }
+    
+    slots = calloc(depth, sizeof(*slots));
+    if (!slots) {
+        return -1;
+    }
+    for (__u32 i = 0; i < depth; i++) {
+        cond_init_monotonic(&slots[i].cond);
+    }
+    cancel_fd_open();
+    
+    pthread_mutex_lock(&pipeline.lock);
+    pthread_cond_destroy(&pipeline.slot_free);
+    cond_init_monotonic(&pipeline.slot_free);
+    pipeline.fd = fd;
+    pipeline.send = send_fn;
+    pipeline.port_id = port_id;
+    pipeline.depth = depth;
+    pipeline.slots = slots;
+    pipeline.outstanding = 0;
+    pipeline.next_slot = 0;
+    pipeline.leader = 0;
+    memset(&pipeline.stats, 0, sizeof(pipeline.stats));
+    pipeline.stats.depth = depth;
+    pthread_mutex_unlock(&pipeline.lock);
+    return 0;
+}
+
+/**
+ * 关闭流水线 socket（调用时不能有在途请求）
+ */
+static void pipeline_teardown(void) {
+    pthread_mutex_lock(&pipeline.lock);
+    if (pipeline.fd >= 0) {
+        close(pipeline.fd);
+        pipeline.fd = -1;
+    }
+    if (pipeline.slots) {
+        for (__u32 i = 0; i < pipeline.depth; i++) {
+            pthread_cond_destroy(&pipeline.slots[i].cond);
+        }
+        free(pipeline.slots);
+        pipeline.slots = NULL;
+    }
+    pthread_cond_broadcast(&pipeline.slot_free);
+    pthread_mutex_unlock(&pipeline.lock);
+}
+
+/**
+ * 在当前传输的新 socket 上启用流水线模式
+ */
+int tlshub_client_enable_pipeline(__u32 depth) {
+    __u32 port_id;
+    int fd;
+    
+    if (netlink_sock < 0) {
+        fprintf(stderr, "TLSHub client not initialized\n");
+        return -1;
+    }
+    
+    /* 不绑定线程 ID，之后所有请求都以分配到的端口号作为 nlmsg_pid */
+    fd = transport->open(0, &port_id);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    if (pipeline_setup(fd, transport->send, port_id, depth) < 0) {
+        close(fd);
+        return -1;
+    }
+    printf("TLSHub pipeline enabled (%s, port %u, depth %u)\n", transport->name, port_id, depth);
+    return 0;
+}
+
+/**
+ * 在已连接的本地 socket 上启用流水线模式
+ */
+int tlshub_client_attach_pipeline(int fd, __u32 depth) {
+    return pipeline_setup(fd, socket_send, 0, depth);
+}
+
+/**
+ * 获取流水线统计
+ */
+void tlshub_client_get_pipeline_stats(struct tlshub_pipeline_stats *stats) {
+    if (!stats) {
+        return;
+    }
+    
+    pthread_mutex_lock(&pipeline.lock);
+    *stats = pipeline.stats;
+    stats->outstanding = pipeline.outstanding;
+    pthread_mutex_unlock(&pipeline.lock);
+}
+
+/**
+ * 在当前线程的 socket 上发送请求并等待响应，跳过其间的日志消息
+ * 超时、取消或出错时放弃该 socket，下一个请求在新 socket 上发送。
+ * 请求带本线程递增的 nlmsg_seq，回填了 seq 但与之不符的响应是更早请求的迟到响应，丢弃；
+ * 未回填 seq（为 0）的模块仍按顺序匹配
+ * @return: 成功返回 0，失败返回 -1、CALL_TIMEOUT 或 CALL_CANCELLED
+ */
+static int netlink_call(const void *payload, size_t len, union tlshub_msg *resp,
+                        __u64 deadline_ns) {
+    netlink_context_t *ctx;
+    struct {
+        struct nlmsghdr hdr;
+        struct tlshub_batch_req msg;
+    } req;
+    ssize_t n;
+    int ret;
+    
+    ctx = netlink_ctx_get();
+    if (!ctx) {
+        return -1;
+    }
+    
+    if (++ctx->seq == 0) {
+        ctx->seq = 1;
+    }
+    memset(&req.hdr, 0, sizeof(req.hdr));
+    req.hdr.nlmsg_len = sizeof(struct nlmsghdr) + len;
+    req.hdr.nlmsg_seq = ctx->seq;
+    req.hdr.nlmsg_pid = ctx->port_id;
+    memcpy(&req.msg, payload, len);
+    if (transport->send(ctx->sk_fd, &req, req.hdr.nlmsg_len) < 0) {
+        log_error("Failed to send TLSHub request: %s", strerror(errno));
+        netlink_ctx_reset(ctx);
         return -1;
     }
     
-    memset(nlh, 0, NLMSG_SPACE(MAX_PAYLOAD));
-    nlh->nlmsg_len = sizeof(struct nlmsghdr) + sizeof(struct my_msg);
-    nlh->nlmsg_flags = 0;
-    nlh->nlmsg_type = 0;
-    nlh->nlmsg_seq = 0;
-    nlh->nlmsg_pid = gettid();
+    for (;;) {
+        ret = wait_readable(ctx->sk_fd, deadline_ns);
+        if (ret < 0) {
+            netlink_ctx_reset(ctx);
+            return ret;
+        }
+        n = recv(ctx->sk_fd, resp, sizeof(*resp), MSG_DONTWAIT);
+        if (n < (ssize_t)sizeof(struct nlmsghdr) + 1) {
+            if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            log_error("Failed to receive TLSHub response: %s",
+                      n < 0 ? strerror(errno) : "short message");
+            netlink_ctx_reset(ctx);
+            return -1;
+        }
+        if (resp->info.hdr.nlmsg_seq != 0 && resp->info.hdr.nlmsg_seq != ctx->seq) {
+            log_debug("Discarding stale TLSHub response (seq %u, expected %u)",
+                      resp->info.hdr.nlmsg_seq, ctx->seq);
+            continue;
+        }
+        if (resp->info.msg_type != MSG_TYPE_LOG) {
+            return 0;
+        }
+        log_info("TLSHub log: %s", resp->info.msg);
+    }
+}
+
+/**
+ * 批量模式是否已启用
+ */
+static int batching_enabled(void) {
+    return __atomic_load_n(&batcher.max_entries, __ATOMIC_RELAXED) > 0;
+}
+
+static struct key_batch *batch_new(void) {
+    struct key_batch *b;
+    
+    b = calloc(1, sizeof(*b));
+    if (!b) {
+        return NULL;
+    }
+    cond_init_monotonic(&b->cond);
+    return b;
+}
+
+static void batch_free(struct key_batch *b) {
+    pthread_cond_destroy(&b->cond);
+    free(b);
+}
+
+/**
+ * 以一条批量消息发送已封口的批次并取回各项结果
+ * @return: 成功返回 0，失败返回 -1、CALL_TIMEOUT 或 CALL_CANCELLED，模块不支持批量时返回 BATCH_FALLBACK
+ */
+static int batch_roundtrip(struct key_batch *b, __u64 deadline_ns) {
+    struct tlshub_batch_req req;
+    union tlshub_msg resp;
+    size_t len;
+    int ret;
+    
+    memset(&req, 0, offsetof(struct tlshub_batch_req, entries));
+    req.opcode = TLS_SERVICE_BATCH;
+    req.count = (unsigned char)b->count;
+    memcpy(req.entries, b->entries, b->count * sizeof(struct my_msg));
+    len = offsetof(struct tlshub_batch_req, entries) + b->count * sizeof(struct my_msg);
+    
+    memset(&resp, 0, sizeof(resp));
+    if (pipeline_enabled()) {
+        ret = pipeline_call(&req, len, &resp, sizeof(resp), deadline_ns);
+    } else {
+        ret = netlink_call(&req, len, &resp, deadline_ns);
+    }
+    if (ret < 0) {
+        return ret;
+    }
+    
+    if (resp.batch.resp.msg_type != MSG_TYPE_BATCH_RESULT ||
+        resp.batch.resp.count != b->count) {
+        return BATCH_FALLBACK;
+    }
+    memcpy(b->results, resp.batch.resp.results, b->count * sizeof(struct tlshub_batch_result));
+    return 0;
+}
+
+/**
+ * 把一个请求加入当前批次并等待结果
+ * 批次以负责发送的线程（最早加入）的期限收发，不晚于其他成员的期限，成员只需等待它返回
+ * @return: 成功返回 0，失败返回 -1、CALL_TIMEOUT 或 CALL_CANCELLED，需要改走单条请求时返回 BATCH_FALLBACK
+ */
+static int batch_submit(const struct my_msg *mmsg, struct tlshub_batch_result *result,
+                        __u64 deadline_ns) {
+    struct key_batch *b;
+    __u32 idx;
+    int flusher = 0;
+    int ret;
+    
+    pthread_mutex_lock(&batcher.lock);
+    if (batcher.unsupported || batcher.max_entries == 0) {
+        pthread_mutex_unlock(&batcher.lock);
+        return BATCH_FALLBACK;
+    }
+    
+    b = batcher.open;
+    if (!b) {
+        b = batch_new();
+        if (!b) {
+            pthread_mutex_unlock(&batcher.lock);
+            return BATCH_FALLBACK;
+        }
+        batcher.open = b;
+        flusher = 1;
+    }
+    idx = b->count++;
+    b->entries[idx] = *mmsg;
+    b->refs++;
+    if (b->count >= batcher.max_entries) {
+        /* 批次已满，封口并唤醒负责发送的线程 */
+        batcher.open = NULL;
+        pthread_cond_broadcast(&b->cond);
+    }
+    
+    if (flusher) {
+        struct timespec deadline;
+        __u64 ns;
+        
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        ns = (__u64)deadline.tv_nsec + batcher.delay_ns;
+        deadline.tv_sec += ns / 1000000000ULL;
+        deadline.tv_nsec = ns % 1000000000ULL;
+        while (batcher.open == b) {
+            if (pthread_cond_timedwait(&b->cond, &batcher.lock, &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+        if (batcher.open == b) {
+            batcher.open = NULL;
+            batcher.stats.deadline_flushes++;
+        } else {
+            batcher.stats.full_flushes++;
+        }
+        batcher.stats.batches++;
+        batcher.stats.entries += b->count;
+        pthread_mutex_unlock(&batcher.lock);
+        
+        ret = batch_roundtrip(b, deadline_ns);
+        
+        pthread_mutex_lock(&batcher.lock);
+        if (ret == BATCH_FALLBACK && !batcher.unsupported) {
+            batcher.unsupported = 1;
+            log_warn("TLSHub module does not support batched requests, sending them one by one");
+        }
+        if (ret == BATCH_FALLBACK) {
+            batcher.stats.fallbacks += b->count;
+        }
+        b->ret = ret;
+        b->done = 1;
+        pthread_cond_broadcast(&b->cond);
+    } else {
+        while (!b->done) {
+            pthread_cond_wait(&b->cond, &batcher.lock);
+        }
+    }
+    
+    ret = b->ret;
+    if (ret == 0) {
+        *result = b->results[idx];
+    }
+    if (--b->refs == 0) {
+        batch_free(b);
+    }
+    pthread_mutex_unlock(&batcher.lock);
+    return ret;
+}
+
+/**
+ * 启用批量模式
+ */
+int tlshub_client_enable_batching(__u32 max_entries, __u32 delay_us) {
+    if (max_entries < 2 || max_entries > TLSHUB_BATCH_MAX) {
+        fprintf(stderr, "Invalid TLSHub batch size: %u (2-%d)\n", max_entries, TLSHUB_BATCH_MAX);
+        return -1;
+    }
+    
+    pthread_mutex_lock(&batcher.lock);
+    batcher.delay_ns = (__u64)delay_us * 1000;
+    batcher.unsupported = 0;
+    memset(&batcher.stats, 0, sizeof(batcher.stats));
+    batcher.stats.max_entries = max_entries;
+    __atomic_store_n(&batcher.max_entries, max_entries, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&batcher.lock);
+    return 0;
+}
+
+/**
+ * 获取批量模式统计
+ */
+void tlshub_client_get_batch_stats(struct tlshub_batch_stats *stats) {
+    if (!stats) {
+        return;
+    }
+    
+    pthread_mutex_lock(&batcher.lock);
+    *stats = batcher.stats;
+    pthread_mutex_unlock(&batcher.lock);
+}
+
+/**
+ * 选择与 TLSHub 通信的传输
+ */
+int tlshub_client_set_transport(enum tlshub_transport type, const char *path,
+                                const struct tlshub_standin_config *mock) {
+    if (netlink_sock >= 0 || pipeline_enabled()) {
+        fprintf(stderr, "TLSHub transport must be chosen before the client is initialized\n");
+        return -1;
+    }
+    
+    switch (type) {
+    case TLSHUB_TRANSPORT_NETLINK:
+        break;
+    case TLSHUB_TRANSPORT_UNIX:
+        if (path && *path) {
+            if (strlen(path) >= sizeof(unix_path)) {
+                fprintf(stderr, "TLSHub unix socket path too long: %s\n", path);
+                return -1;
+            }
+            strcpy(unix_path, path);
+        }
+        break;
+    case TLSHUB_TRANSPORT_MOCK:
+        memset(&mock_config, 0, sizeof(mock_config));
+        if (mock) {
+            mock_config = *mock;
+        }
+        break;
+    default:
+        fprintf(stderr, "Unknown TLSHub transport: %d\n", type);
+        return -1;
+    }
+    
+    transport = &transports[type];
+    return 0;
+}
+
+/**
+ * 获取 mock 传输的替身统计
+ */
+int tlshub_client_get_mock_stats(struct tlshub_standin_stats *stats) {
+    int ret = -1;
+    
+    if (!stats) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&mock_lock);
+    if (mock_standin) {
+        tlshub_standin_get_stats(mock_standin, stats);
+        ret = 0;
+    }
+    pthread_mutex_unlock(&mock_lock);
+    return ret;
+}
+
+/**
+ * 设置请求超时与重试策略
+ */
+void tlshub_client_set_retry_policy(const struct tlshub_retry_policy *policy) {
+    if (!policy) {
+        retry_policy = (struct tlshub_retry_policy){
+            .timeout_ms = TLSHUB_DEFAULT_TIMEOUT_MS,
+            .retries = TLSHUB_DEFAULT_RETRIES,
+            .backoff_ms = TLSHUB_DEFAULT_BACKOFF_MS,
+            .backoff_max_ms = TLSHUB_DEFAULT_BACKOFF_MAX_MS,
+        };
+        return;
+    }
+    
+    retry_policy = *policy;
+    if (retry_policy.backoff_max_ms < retry_policy.backoff_ms) {
+        retry_policy.backoff_max_ms = retry_policy.backoff_ms;
+    }
+}
+
+/**
+ * 获取请求统计
+ */
+void tlshub_client_get_request_stats(struct tlshub_request_stats *stats) {
+    if (!stats) {
+        return;
+    }
+    
+    memcpy(stats, &request_stats, sizeof(*stats));
+    stats->requests = __atomic_load_n(&request_stats.requests, __ATOMIC_RELAXED);
+    stats->attempts = __atomic_load_n(&request_stats.attempts, __ATOMIC_RELAXED);
+    stats->retries = __atomic_load_n(&request_stats.retries, __ATOMIC_RELAXED);
+    stats->timeouts = __atomic_load_n(&request_stats.timeouts, __ATOMIC_RELAXED);
+    stats->errors = __atomic_load_n(&request_stats.errors, __ATOMIC_RELAXED);
+    stats->gave_up = __atomic_load_n(&request_stats.gave_up, __ATOMIC_RELAXED);
+    stats->cancelled = __atomic_load_n(&request_stats.cancelled, __ATOMIC_RELAXED);
+}
+
+/**
+ * 取消所有在途和之后的请求
+ */
+void tlshub_client_cancel(void) {
+    __u64 one = 1;
+    
+    __atomic_store_n(&cancelled, 1, __ATOMIC_RELAXED);
+    if (cancel_fd >= 0 && write(cancel_fd, &one, sizeof(one)) != sizeof(one)) {
+        log_warn("Failed to signal TLSHub request cancellation: %s", strerror(errno));
+    }
+    
+    /* 在条件变量上等待的流水线请求不 poll，直接结束 */
+    pthread_mutex_lock(&pipeline.lock);
+    if (pipeline.slots) {
+        pipeline_fail_all(CALL_CANCELLED);
+    }
+    pthread_cond_broadcast(&pipeline.slot_free);
+    pthread_mutex_unlock(&pipeline.lock);
+}
+
+/**
+ * 发送一次初始化消息并等待 INIT_COMPLETE
+ * @return: 成功返回 0，失败返回 -1、CALL_TIMEOUT 或 CALL_CANCELLED
+ */
+static int init_attempt(__u64 deadline_ns) {
+    struct {
+        struct nlmsghdr hdr;
+        struct my_msg msg;
+    } req;
+    union tlshub_msg resp;
+    ssize_t n;
+    int ret;
     
     /* 准备初始化消息 */
-    struct my_msg mmsg;
-    memset(&mmsg, 0, sizeof(mmsg));
-    mmsg.opcode = TLS_SERVICE_INIT;
-    mmsg.server = true;
-    memcpy(NLMSG_DATA(nlh), &mmsg, sizeof(struct my_msg));
+    memset(&req, 0, sizeof(req));
+    req.hdr.nlmsg_len = sizeof(struct nlmsghdr) + sizeof(struct my_msg);
+    req.hdr.nlmsg_pid = init_port_id;
+    req.msg.opcode = TLS_SERVICE_INIT;
+    req.msg.server = true;
+    req.msg.family = AF_INET;
     
     /* 发送初始化消息 */
-    ret = sendto(netlink_sock, nlh, nlh->nlmsg_len, 0,
-                 (struct sockaddr*)&dest_addr, sizeof(struct sockaddr_nl));
-    if (!ret) {
-        fprintf(stderr, "Failed to send init message\n");
-        free(nlh);
-        close(netlink_sock);
-        netlink_sock = -1;
+    if (transport->send(netlink_sock, &req, req.hdr.nlmsg_len) < 0) {
+        fprintf(stderr, "Failed to send init message: %s\n", strerror(errno));
         return -1;
     }
     
     /* 等待初始化响应 */
     while (1) {
-        memset(&u_info, 0, sizeof(u_info));
-        len = sizeof(struct sockaddr_nl);
-        ret = recvfrom(netlink_sock, &u_info, sizeof(user_msg_info), 0,
-                       (struct sockaddr*)&dest_addr, &len);
-        if (!ret) {
-            fprintf(stderr, "Failed to receive init response\n");
-            free(nlh);
-            close(netlink_sock);
-            netlink_sock = -1;
+        ret = wait_readable(netlink_sock, deadline_ns);
+        if (ret < 0) {
+            return ret;
+        }
+        memset(&resp, 0, sizeof(resp));
+        n = recv(netlink_sock, &resp, sizeof(resp), MSG_DONTWAIT);
+        if (n < (ssize_t)sizeof(struct nlmsghdr) + 1) {
+            if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            fprintf(stderr, "Failed to receive init response: %s\n",
+                    n < 0 ? strerror(errno) : "short message");
             return -1;
         }
-        
-        switch (u_info.msg_type) {
-        case MSG_TYPE_INIT_COMPLETE:
-            printf("TLSHub client initialized successfully\n");
-            free(nlh);
+    
+        switch (resp.info.msg_type) {
+        case MSG_TYPE_INIT_COMPLETE: {
+            struct tlshub_init_info info;
+            
+            memcpy(&info, resp.info.msg, sizeof(info));
+            if (info.magic == TLSHUB_INIT_MAGIC) {
+                module_version = info.version;
+                module_features = info.features;
+            } else {
+                module_version = 0;
+                module_features = 0;
+            }
             return 0;
+        }
         case MSG_TYPE_LOG:
-            printf("TLSHub log: %s\n", u_info.msg);
+            printf("TLSHub log: %s\n", resp.info.msg);
             break;
         default:
-            fprintf(stderr, "Unexpected message type during init: 0x%02x\n", u_info.msg_type);
+            fprintf(stderr, "Unexpected message type during init: 0x%02x\n", resp.info.msg_type);
             break;
         }
     }
+}
+
+/**
+ * 初始化 TLSHub 客户端
+ * 初始化消息同样按重试策略限时、重试，模块无响应时不会一直阻塞
+ */
+int tlshub_client_init(void) {
+    int ret;
     
-    free(nlh);
-    return 0;
+    /* 创建初始化 socket，以线程 ID 作为端口号 */
+    netlink_sock = transport->open(1, &init_port_id);
+    if (netlink_sock < 0) {
+        return -1;
+    }
+    cancel_fd_open();
+    
+    for (__u32 attempt = 0;; attempt++) {
+        ret = init_attempt(attempt_deadline());
+        if (ret == 0) {
+            printf("TLSHub client initialized successfully (%s transport, protocol version %u, "
+                   "features 0x%x)\n", transport->name, module_version, module_features);
+            if (!(module_features & TLSHUB_FEATURE_IPV6)) {
+                fprintf(stderr, "Warning: TLSHub module does not support IPv6 pod pairs, "
+                        "IPv6 connections will not get keys\n");
+            }
+            init_tid = gettid();
+            return 0;
+        }
+        if (ret == CALL_CANCELLED || attempt >= retry_policy.retries) {
+            break;
+        }
+        fprintf(stderr, "TLSHub init %s, retrying\n", ret == CALL_TIMEOUT ? "timed out" : "failed");
+        if (backoff_wait(attempt) == CALL_CANCELLED) {
+            break;
+        }
+    }
+    
+    fprintf(stderr, "Failed to initialize TLSHub client\n");
+    close(netlink_sock);
+    netlink_sock = -1;
+    return -1;
+}
+
+/**
+ * 释放当前线程的 socket
+ */
+void tlshub_client_thread_cleanup(void) {
+    netlink_context_t *ctx = &g_netlink_ctx;
+    
+    if (ctx->sk_fd >= 0 && ctx->sk_fd != netlink_sock) {
+        close(ctx->sk_fd);
+    }
+    ctx->sk_fd = -1;
+    ctx->detached = 0;
 }
 
 /**
  * 清理 TLSHub 客户端
  */
 void tlshub_client_cleanup(void) {
+    tlshub_client_thread_cleanup();
+    __atomic_store_n(&batcher.max_entries, 0, __ATOMIC_RELAXED);
+    pipeline_teardown();
     if (netlink_sock >= 0) {
         close(netlink_sock);
         netlink_sock = -1;
         printf("TLSHub client cleaned up\n");
     }
+    
+    pthread_mutex_lock(&mock_lock);
+    if (mock_standin) {
+        tlshub_standin_stop(mock_standin);
+        mock_standin = NULL;
+    }
+    pthread_mutex_unlock(&mock_lock);
+    
+    if (cancel_fd >= 0) {
+        close(cancel_fd);
+        cancel_fd = -1;
+    }
+    __atomic_store_n(&cancelled, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * 获取初始化 socket 的文件描述符
+ */
+int tlshub_client_fd(void) {
+    return netlink_sock;
+}
+
+/**
+ * 非阻塞地处理初始化 socket 上的所有待处理消息
+ * fetch/handshake 的响应发往各工作线程自己的 socket，这里只会收到内核主动推送的消息
+ */
+int tlshub_client_process_messages(void) {
+    user_msg_info u_info;
+    int count = 0;
+    ssize_t ret;
+    
+    if (netlink_sock < 0) {
+        return -1;
+    }
+    
+    while (1) {
+        memset(&u_info, 0, sizeof(u_info));
+        ret = recv(netlink_sock, &u_info, sizeof(user_msg_info), MSG_DONTWAIT);
+        if (ret < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Failed to receive netlink message");
+            return -1;
+        }
+        if (ret == 0) {
+            break;
+        }
+        
+        count++;
+        switch (u_info.msg_type) {
+        case MSG_TYPE_LOG:
+            log_info("TLSHub log: %s", u_info.msg);
+            break;
+        default:
+            log_warn("Unexpected TLSHub message type: 0x%02x", u_info.msg_type);
+            break;
+        }
+    }
+    
+    return count;
+}
+
+/**
+ * 发送一个请求并取回结果（一次尝试）：批量模式下与其他线程的请求合成一条批量消息，
+ * 否则经共用的流水线 socket 或线程私有 socket；批量结果转换为单条响应的格式
+ * @return: 成功返回 0，失败返回 -1、CALL_TIMEOUT 或 CALL_CANCELLED
+ */
+static int request_once(const struct my_msg *mmsg, union tlshub_msg *resp, __u64 deadline_ns) {
+    struct tlshub_batch_result result;
+    int ret;
+    
+    if (batching_enabled() &&
+        (ret = batch_submit(mmsg, &result, deadline_ns)) != BATCH_FALLBACK) {
+        if (ret == 0) {
+            resp->info.msg_type = result.msg_type;
+            memcpy(resp->info.msg, &result.key, sizeof(struct key_back));
+        }
+        return ret;
+    }
+    if (pipeline_enabled()) {
+        return pipeline_call(mmsg, sizeof(*mmsg), resp, sizeof(*resp), deadline_ns);
+    }
+    return netlink_call(mmsg, sizeof(*mmsg), resp, deadline_ns);
+}
+
+/**
+ * 按重试策略执行一个请求：超时或收发失败后退避重试，TLSHub 给出的结果（握手失败等）不重试
+ * @param hist: 记录含重试在内的整次调用耗时
+ * @return: 成功返回 0，超时或已取消返回 TLSHUB_TIMEOUT，其他失败返回 -1
+ */
+static int request_with_retry(const struct my_msg *mmsg, union tlshub_msg *resp,
+                              struct latency_hist *hist) {
+    __u64 start = now_ns();
+    int ret;
+    
+    stat_add(&request_stats.requests, 1);
+    for (__u32 attempt = 0;; attempt++) {
+        stat_add(&request_stats.attempts, 1);
+        ret = request_once(mmsg, resp, attempt_deadline());
+        if (ret == 0 || ret == CALL_CANCELLED) {
+            break;
+        }
+        stat_add(ret == CALL_TIMEOUT ? &request_stats.timeouts : &request_stats.errors, 1);
+        if (attempt >= retry_policy.retries) {
+            stat_add(&request_stats.gave_up, 1);
+            log_warn("TLSHub request (opcode %d) failed after %u attempts (%s)",
+                     mmsg->opcode, attempt + 1, ret == CALL_TIMEOUT ? "timeout" : "error");
+            break;
+        }
+        if (backoff_wait(attempt) == CALL_CANCELLED) {
+            ret = CALL_CANCELLED;
+            break;
+        }
+        stat_add(&request_stats.retries, 1);
+    }
+    if (ret == CALL_CANCELLED) {
+        stat_add(&request_stats.cancelled, 1);
+    }
+    latency_hist_record(hist, now_ns() - start);
+    
+    if (ret == CALL_TIMEOUT || ret == CALL_CANCELLED) {
+        return TLSHUB_TIMEOUT;
+    }
+    return ret < 0 ? -1 : 0;
+}
+
+/**
+ * 模块是否能处理该四元组：不声明 TLSHUB_FEATURE_IPV6 的模块只读取 IPv4 字段，
+ * IPv6 Pod 对发给它会按 0.0.0.0 协商，因此直接拒绝并记录错误
+ */
+static int family_supported(const struct flow_tuple *tuple) {
+    if (tuple->family != AF_INET6 || (module_features & TLSHUB_FEATURE_IPV6)) {
+        return 1;
+    }
+    log_error("TLSHub module (protocol version %u) does not support IPv6, "
+              "refusing to negotiate for an IPv6 pod pair", module_version);
+    return 0;
 }
 
 /**
@@ -180,72 +1404,39 @@ void tlshub_client_cleanup(void) {
  * 在点对点架构中，saddr = client_pod_ip, daddr = server_pod_ip
  */
 int tlshub_fetch_key(struct flow_tuple *tuple, struct tls_key_info *key_info) {
-    struct nlmsghdr *nlh = NULL;
-    user_msg_info u_info;
+    union tlshub_msg resp;
     int ret;
-    socklen_t len = sizeof(struct sockaddr_nl);
     struct key_back key;
     
-    if (netlink_sock < 0 || !tuple || !key_info) {
-        fprintf(stderr, "Invalid parameters for tlshub_fetch_key\n");
+    if (!tuple || !key_info) {
+        log_error("Invalid parameters for tlshub_fetch_key");
         return -1;
     }
-    
-    /* 分配 Netlink 消息 */
-    nlh = (struct nlmsghdr*)malloc(NLMSG_SPACE(MAX_PAYLOAD));
-    if (!nlh) {
-        fprintf(stderr, "Failed to allocate netlink message\n");
-        return -1;
+    if (!family_supported(tuple)) {
+        return TLSHUB_UNSUPPORTED;
     }
     
-    memset(nlh, 0, NLMSG_SPACE(MAX_PAYLOAD));
-    nlh->nlmsg_len = sizeof(struct nlmsghdr) + sizeof(struct my_msg);
-    nlh->nlmsg_flags = 0;
-    nlh->nlmsg_type = 0;
-    nlh->nlmsg_seq = 0;
-    nlh->nlmsg_pid = gettid();
-    
     /* 准备 fetch key 消息 */
     struct my_msg mmsg;
     memset(&mmsg, 0, sizeof(mmsg));
     mmsg.opcode = TLS_SERVICE_FETCH;
-    // 字节序说明：
-    // - tuple 中的 IP 已经是网络字节序（从 inet_addr 得到）
-    // - 内核会用 ntohl() 转换为主机序
-    mmsg.client_pod_ip = tuple->saddr;  // 网络字节序
-    mmsg.server_pod_ip = tuple->daddr;  // 网络字节序
-    mmsg.client_pod_port = htons(tuple->sport);  // 主机序 → 网络序
-    mmsg.server_pod_port = htons(tuple->dport);  // 主机序 → 网络序
-    mmsg.server = false;
-    
-    memcpy(NLMSG_DATA(nlh), &mmsg, sizeof(struct my_msg));
-    
-    /* 发送消息 */
-    ret = sendto(netlink_sock, nlh, nlh->nlmsg_len, 0,
-                 (struct sockaddr*)&dest_addr, sizeof(struct sockaddr_nl));
-    if (!ret) {
-        fprintf(stderr, "Failed to send fetch_key message\n");
-        free(nlh);
-        return -1;
-    }
+    fill_msg_tuple(&mmsg, tuple);
     
-    /* 接收响应 */
-    memset(&u_info, 0, sizeof(u_info));
-    ret = recvfrom(netlink_sock, &u_info, sizeof(user_msg_info), 0,
-                   (struct sockaddr*)&dest_addr, &len);
-    if (!ret) {
-        fprintf(stderr, "Failed to receive fetch_key response\n");
-        free(nlh);
-        return -1;
+    ret = request_with_retry(&mmsg, &resp, &request_stats.fetch_latency);
+    if (ret < 0) {
+        return ret;
     }
     
     /* 解析密钥 */
-    memcpy(&key, u_info.msg, sizeof(struct key_back));
-    
-    free(nlh);
+    memcpy(&key, resp.info.msg, sizeof(struct key_back));
     
+    if (key.status == -2) {
+        /* 节点对的会话密钥已过期，需要重新握手 */
+        log_debug("TLSHub reported expired key");
+        return TLSHUB_KEY_EXPIRED;
+    }
     if (key.status != 0) {
-        fprintf(stderr, "Fetch key failed with status: %d\n", key.status);
+        log_debug("Fetch key failed with status: %d", key.status);
         return -1;
     }
     
@@ -256,89 +1447,51 @@ int tlshub_fetch_key(struct flow_tuple *tuple, struct tls_key_info *key_info) {
     memset(key_info->iv, 0, 16);
     key_info->iv_len = 12;
     
-    printf("Fetched TLS key from TLSHub (status: %d)\n", key.status);
+    log_debug("Fetched TLS key from TLSHub (status: %d)", key.status);
     return 0;
 }
 
+/**
+ * 把握手结果类型转换为返回值
+ */
+static int handshake_result(char msg_type) {
+    switch (msg_type) {
+    case MSG_TYPE_HANDSHAKE_SUCCESS_FIRST:
+    case MSG_TYPE_HANDSHAKE_SUCCESS:
+    case MSG_TYPE_ALREADY_CONNECTED:
+        log_debug("TLSHub handshake completed successfully (type: 0x%02x)", msg_type);
+        return 0;
+    case MSG_TYPE_HANDSHAKE_FAILED:
+        log_warn("TLSHub handshake failed");
+        return TLSHUB_HANDSHAKE_FAILED;
+    default:
+        log_warn("Unexpected TLSHub handshake response type: 0x%02x", msg_type);
+        return -1;
+    }
+}
+
 /**
  * 通过 TLSHub 发起握手
  */
 int tlshub_handshake(struct flow_tuple *tuple) {
-    static __thread struct nlmsghdr *nlh = NULL;
-    user_msg_info u_info;
+    union tlshub_msg resp;
     int ret;
-    socklen_t len = sizeof(struct sockaddr_nl);
     
-    if (netlink_sock < 0 || !tuple) {
-        fprintf(stderr, "Invalid parameters for tlshub_handshake\n");
+    if (!tuple) {
+        log_error("Invalid parameters for tlshub_handshake");
         return -1;
     }
-    
-    /* 分配 Netlink 消息（thread-local，重复使用） */
-    if (nlh == NULL) {
-        nlh = (struct nlmsghdr*)malloc(NLMSG_SPACE(MAX_PAYLOAD));
-        if (!nlh) {
-            fprintf(stderr, "Failed to allocate netlink message\n");
-            return -1;
-        }
+    if (!family_supported(tuple)) {
+        return TLSHUB_UNSUPPORTED;
     }
     
-    memset(nlh, 0, NLMSG_SPACE(MAX_PAYLOAD));
-    nlh->nlmsg_len = sizeof(struct nlmsghdr) + sizeof(struct my_msg);
-    nlh->nlmsg_flags = 0;
-    nlh->nlmsg_type = 0;
-    nlh->nlmsg_seq = 0;
-    nlh->nlmsg_pid = gettid();
-    
     /* 准备握手消息 */
     struct my_msg mmsg;
     memset(&mmsg, 0, sizeof(mmsg));
     mmsg.opcode = TLS_SERVICE_START;
-    mmsg.client_pod_ip = tuple->saddr;  // 网络字节序
-    mmsg.server_pod_ip = tuple->daddr;  // 网络字节序
-    mmsg.client_pod_port = htons(tuple->sport);  // 主机序 → 网络序
-    mmsg.server_pod_port = htons(tuple->dport);  // 主机序 → 网络序
-    mmsg.server = false;
-    
-    memcpy(NLMSG_DATA(nlh), &mmsg, sizeof(struct my_msg));
-    
-    /* 发送握手消息 */
-    ret = sendto(netlink_sock, nlh, nlh->nlmsg_len, 0,
-                 (struct sockaddr*)&dest_addr, sizeof(struct sockaddr_nl));
-    if (!ret) {
-        fprintf(stderr, "Failed to send handshake message\n");
-        return -1;
-    }
+    fill_msg_tuple(&mmsg, tuple);
     
-    /* 等待握手响应 */
-    while (1) {
-        memset(&u_info, 0, sizeof(u_info));
-        ret = recvfrom(netlink_sock, &u_info, sizeof(user_msg_info), 0,
-                       (struct sockaddr*)&dest_addr, &len);
-        if (!ret) {
-            fprintf(stderr, "Failed to receive handshake response\n");
-            return -1;
-        }
-        
-        switch (u_info.msg_type) {
-        case MSG_TYPE_HANDSHAKE_SUCCESS_FIRST:
-        case MSG_TYPE_HANDSHAKE_SUCCESS:
-        case MSG_TYPE_ALREADY_CONNECTED:
-            printf("TLSHub handshake completed successfully (type: 0x%02x)\n", 
-                   u_info.msg_type);
-            return 0;
-        case MSG_TYPE_HANDSHAKE_FAILED:
-            fprintf(stderr, "TLSHub handshake failed\n");
-            return -1;
-        case MSG_TYPE_LOG:
-            printf("TLSHub log: %s\n", u_info.msg);
-            break;
-        default:
-            fprintf(stderr, "Unexpected message type during handshake: 0x%02x\n", 
-                    u_info.msg_type);
-            break;
-        }
-    }
-    
-    return 0;
+    /* 日志消息已由接收方处理，这里只会拿到最终结果 */
+    ret = request_with_retry(&mmsg, &resp, &request_stats.handshake_latency);
+    return ret < 0 ? ret : handshake_result(resp.info.msg_type);
 }
@@ -0,0 +1,694 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include "tlshub_standin.h"
+#include "tlshub_proto.h"
+
+/* 最多同时挂起的消息数，不小于流水线的最大深度 */
+#define STANDIN_MAX_PENDING 1024
+
+/* 最多同时服务的连接数 */
+#define STANDIN_MAX_CONNS 256
+
+/* 已握手 Pod 对哈希表的桶数 */
+#define STANDIN_PAIR_BUCKETS 4096
+
+/* 等待回复的消息，响应在收到请求时就已生成 */
+struct pending {
+    __u64 due_ns;
+    int fd;                 /* 回复的连接，连接关闭后为 -1 */
+    size_t len;
+    int log;                /* 回复前是否先发一条日志消息 */
+    union tlshub_msg msg;
+};
+
+/* 请求接收缓冲区，能容纳单条和批量请求 */
+union standin_request {
+    struct nlmsghdr hdr;
+    struct {
+        struct nlmsghdr hdr;
+        struct my_msg msg;
+    } single;
+    struct {
+        struct nlmsghdr hdr;
+        struct tlshub_batch_req req;
+    } batch;
+};
+
+/* 已握手的 Pod 对 */
+struct pod_pair {
+    __u32 client[4];
+    __u32 server[4];
+    struct pod_pair *next;
+};
+
+struct tlshub_standin {
+    struct tlshub_standin_config config;
+    pthread_t thread;
+    int stop;
+    int wake_fd;            /* eventfd，新增连接或停止时唤醒替身线程 */
+    int listen_fd;
+    char listen_path[108];
+
+    pthread_mutex_t lock;   /* 保护 conns */
+    int conns[STANDIN_MAX_CONNS];
+    __u32 conn_count;
+
+    /* 以下只由替身线程访问 */
+    struct pending *pool;
+    struct pending **free_list;
+    __u32 free_count;
+    struct pending **heap;  /* 按 due_ns 排序的最小堆 */
+    __u32 heap_len;
+    __u64 busy_until_ns;    /* 串行处理部分的完成时刻 */
+    __u64 replies;
+    unsigned int seed;
+    struct pod_pair *pairs[STANDIN_PAIR_BUCKETS];
+
+    struct tlshub_standin_stats stats;
+};
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void stat_add(__u64 *counter, __u64 value) {
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+static void heap_push(struct tlshub_standin *standin, struct pending *p) {
+    __u32 i = standin->heap_len++;
+
+    while (i > 0) {
+        __u32 parent = (i - 1) / 2;
+
+        if (standin->heap[parent]->due_ns <= p->due_ns) {
+            break;
+        }
+        standin->heap[i] = standin->heap[parent];
+        i = parent;
+    }
+    standin->heap[i] = p;
+}
+
+static struct pending *heap_pop(struct tlshub_standin *standin) {
+    struct pending *top = standin->heap[0];
+    struct pending *last = standin->heap[--standin->heap_len];
+    __u32 i = 0;
+
+    if (standin->heap_len == 0) {
+        return top;
+    }
+    for (;;) {
+        __u32 child = 2 * i + 1;
+
+        if (child >= standin->heap_len) {
+            break;
+        }
+        if (child + 1 < standin->heap_len &&
+            standin->heap[child + 1]->due_ns < standin->heap[child]->due_ns) {
+            child++;
+        }
+        if (last->due_ns <= standin->heap[child]->due_ns) {
+            break;
+        }
+        standin->heap[i] = standin->heap[child];
+        i = child;
+    }
+    standin->heap[i] = last;
+    return top;
+}
+
+/**
+ * 按配置的分布抽样一次握手耗时（纳秒）
+ */
+static __u64 sample_handshake_ns(struct tlshub_standin *standin) {
+    double mean = standin->config.handshake_us;
+    double u = (rand_r(&standin->seed) + 1.0) / ((double)RAND_MAX + 2.0);   /* (0, 1) */
+    double us;
+
+    switch (standin->config.handshake_dist) {
+    case LATENCY_DIST_UNIFORM:
+        us = mean + (2.0 * u - 1.0) * standin->config.handshake_spread_us;
+        break;
+    case LATENCY_DIST_EXPONENTIAL:
+        us = -mean * log(u);
+        break;
+    default:
+        us = mean;
+        break;
+    }
+    return us > 0 ? (__u64)(us * 1000) : 0;
+}
+
+static int chance(struct tlshub_standin *standin, __u32 percent) {
+    return percent > 0 && (__u32)(rand_r(&standin->seed) % 100) < percent;
+}
+
+/**
+ * 查找请求对应的 Pod 对
+ * @param create: 不存在时建立
+ * @param remove: 存在时删除
+ * @return: 操作前是否已存在
+ */
+static int pair_lookup(struct tlshub_standin *standin, const struct my_msg *req, int create, int remove) {
+    struct pod_pair key, **pp;
+    __u32 hash = 2166136261u;
+    __u32 bucket;
+
+    memset(&key, 0, sizeof(key));
+    if (req->family == AF_INET6) {
+        memcpy(key.client, req->client_pod_ip6, sizeof(key.client));
+        memcpy(key.server, req->server_pod_ip6, sizeof(key.server));
+    } else {
+        key.client[0] = req->client_pod_ip;
+        key.server[0] = req->server_pod_ip;
+    }
+    for (int i = 0; i < 4; i++) {
+        hash = (hash ^ key.client[i]) * 16777619u;
+        hash = (hash ^ key.server[i]) * 16777619u;
+    }
+    bucket = hash % STANDIN_PAIR_BUCKETS;
+
+    for (pp = &standin->pairs[bucket]; *pp; pp = &(*pp)->next) {
+        struct pod_pair *pair = *pp;
+
+        if (memcmp(pair->client, key.client, sizeof(key.client)) == 0 &&
+            memcmp(pair->server, key.server, sizeof(key.server)) == 0) {
+            if (remove) {
+                *pp = pair->next;
+                free(pair);
+            }
+            return 1;
+        }
+    }
+
+    if (create) {
+        struct pod_pair *pair = malloc(sizeof(*pair));
+
+        if (pair) {
+            *pair = key;
+            pair->next = standin->pairs[bucket];
+            standin->pairs[bucket] = pair;
+        }
+    }
+    return 0;
+}
+
+/**
+ * 由请求中的地址派生密钥
+ */
+static void derive_key(const struct my_msg *req, struct key_back *key) {
+    memset(key, 0, sizeof(*key));
+    key->status = 0;
+    if (req->family == AF_INET6) {
+        memcpy(key->masterkey, &req->client_pod_ip6[3], 4);
+        memcpy(key->masterkey + 4, &req->server_pod_ip6[3], 4);
+    } else {
+        memcpy(key->masterkey, &req->client_pod_ip, 4);
+        memcpy(key->masterkey + 4, &req->server_pod_ip, 4);
+    }
+}
+
+/**
+ * 处理一个请求项，返回结果类型
+ * @param latency_ns: 返回该项的往返延迟
+ * @param handshake: 该项为握手时置 1
+ */
+static char handle_entry(struct tlshub_standin *standin, const struct my_msg *req,
+                         struct key_back *key, __u64 *latency_ns, int *handshake) {
+    memset(key, 0, sizeof(*key));
+    *latency_ns = (__u64)standin->config.latency_us * 1000;
+
+    switch (req->opcode) {
+    case TLS_SERVICE_INIT:
+        return MSG_TYPE_INIT_COMPLETE;
+    case TLS_SERVICE_START:
+        *handshake = 1;
+        *latency_ns = sample_handshake_ns(standin);
+        stat_add(&standin->stats.handshakes, 1);
+        if (chance(standin, standin->config.fail_percent)) {
+            stat_add(&standin->stats.handshake_failures, 1);
+            return MSG_TYPE_HANDSHAKE_FAILED;
+        }
+        return pair_lookup(standin, req, 1, 0) ? MSG_TYPE_ALREADY_CONNECTED
+                                                : MSG_TYPE_HANDSHAKE_SUCCESS_FIRST;
+    case TLS_SERVICE_FETCH:
+        stat_add(&standin->stats.fetches, 1);
+        if (standin->config.require_handshake && !pair_lookup(standin, req, 0, 0)) {
+            stat_add(&standin->stats.fetch_misses, 1);
+            key->status = -1;
+            return 0;
+        }
+        if (chance(standin, standin->config.expire_percent)) {
+            /* 密钥过期，之后需要重新握手 */
+            stat_add(&standin->stats.expired, 1);
+            pair_lookup(standin, req, 0, 1);
+            key->status = -2;
+            return 0;
+        }
+        derive_key(req, key);
+        return 0;
+    default:
+        key->status = -1;
+        return MSG_TYPE_HANDSHAKE_FAILED;
+    }
+}
+
+/**
+ * 为一条请求生成响应
+ * @param latency_ns: 返回整条消息的往返延迟（各项中最长的）
+ * @param handshake: 含握手时置 1
+ * @return: 请求项数，请求格式错误时返回 0
+ */
+static __u32 build_response(struct tlshub_standin *standin, const union standin_request *in,
+                            size_t n, struct pending *p, __u64 *latency_ns, int *handshake) {
+    const struct my_msg *single = &in->single.msg;
+    const struct tlshub_batch_req *batch = &in->batch.req;
+    size_t payload = n - sizeof(struct nlmsghdr);
+    struct key_back key;
+    __u64 entry_ns;
+
+    memset(&p->msg.hdr, 0, sizeof(p->msg.hdr));
+    p->msg.hdr.nlmsg_seq = in->hdr.nlmsg_seq;
+    *latency_ns = 0;
+
+    if (payload >= offsetof(struct tlshub_batch_req, entries) &&
+        batch->opcode == TLS_SERVICE_BATCH) {
+        struct tlshub_batch_resp *resp = &p->msg.batch.resp;
+        __u32 count = batch->count;
+
+        if (count == 0 || count > TLSHUB_BATCH_MAX ||
+            payload < offsetof(struct tlshub_batch_req, entries) + count * sizeof(struct my_msg)) {
+            return 0;
+        }
+        memset(resp, 0, offsetof(struct tlshub_batch_resp, results));
+        resp->msg_type = MSG_TYPE_BATCH_RESULT;
+        resp->count = (unsigned char)count;
+        for (__u32 i = 0; i < count; i++) {
+            memset(resp->results[i].reserved, 0, sizeof(resp->results[i].reserved));
+            resp->results[i].msg_type = handle_entry(standin, &batch->entries[i],
+                                                     &resp->results[i].key, &entry_ns, handshake);
+            if (entry_ns > *latency_ns) {
+                *latency_ns = entry_ns;
+            }
+        }
+        p->len = sizeof(struct nlmsghdr) + offsetof(struct tlshub_batch_resp, results) +
+                 count * sizeof(struct tlshub_batch_result);
+        p->msg.hdr.nlmsg_len = p->len;
+        return count;
+    }
+
+    if (payload < offsetof(struct my_msg, family)) {
+        return 0;
+    }
+    memset(p->msg.info.msg, 0, sizeof(p->msg.info.msg));
+    p->msg.info.msg_type = handle_entry(standin, single, &key, latency_ns, handshake);
+    if (single->opcode == TLS_SERVICE_INIT) {
+        struct tlshub_init_info info = {
+            .magic = TLSHUB_INIT_MAGIC,
+            .version = TLSHUB_PROTO_VERSION,
+            .features = TLSHUB_FEATURE_IPV6,
+        };
+
+        if (!standin->config.legacy) {
+            memcpy(p->msg.info.msg, &info, sizeof(info));
+        }
+    } else {
+        memcpy(p->msg.info.msg, &key, sizeof(key));
+    }
+    p->len = sizeof(user_msg_info);
+    p->msg.hdr.nlmsg_len = p->len;
+    return 1;
+}
+
+/**
+ * 发送一条同 seq 的日志消息
+ */
+static void send_log(struct tlshub_standin *standin, int fd, __u32 seq) {
+    user_msg_info msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.hdr.nlmsg_len = sizeof(msg);
+    msg.hdr.nlmsg_seq = seq;
+    msg.msg_type = MSG_TYPE_LOG;
+    snprintf(msg.msg, sizeof(msg.msg), "stand-in: processing request %u", seq);
+    send(fd, &msg, sizeof(msg), MSG_NOSIGNAL);
+    stat_add(&standin->stats.logs, 1);
+}
+
+/**
+ * 读取一个连接上所有已到达的请求并排队
+ * @return: 对端关闭时返回 -1
+ */
+static int receive_requests(struct tlshub_standin *standin, int fd) {
+    union standin_request in;
+    ssize_t n;
+
+    while ((n = recv(fd, &in, sizeof(in), MSG_DONTWAIT)) > 0) {
+        struct pending *p;
+        __u64 latency_ns, now;
+        __u32 entries;
+        int handshake = 0;
+
+        if (standin->free_count == 0) {
+            fprintf(stderr, "TLSHub stand-in: too many pending requests, dropping one\n");
+            continue;
+        }
+        if ((size_t)n <= sizeof(struct nlmsghdr)) {
+            continue;
+        }
+
+        p = standin->free_list[standin->free_count - 1];
+        entries = build_response(standin, &in, n, p, &latency_ns, &handshake);
+        if (entries == 0) {
+            continue;
+        }
+        stat_add(&standin->stats.messages, 1);
+        stat_add(&standin->stats.entries, entries);
+        if (in.batch.req.opcode == TLS_SERVICE_BATCH) {
+            stat_add(&standin->stats.batches, 1);
+        }
+        if (in.single.msg.opcode != TLS_SERVICE_INIT &&
+            chance(standin, standin->config.hang_percent)) {
+            /* 请求已处理，但响应永远不会发出 */
+            stat_add(&standin->stats.hung, 1);
+            continue;
+        }
+        standin->free_count--;
+
+        /* 串行处理完成后再经过往返延迟，各消息的往返延迟互相重叠 */
+        now = now_ns();
+        if (standin->busy_until_ns < now) {
+            standin->busy_until_ns = now;
+        }
+        standin->busy_until_ns += (__u64)standin->config.message_cost_us * 1000 +
+                                  (__u64)standin->config.entry_cost_us * 1000 * entries;
+        p->due_ns = standin->busy_until_ns + latency_ns;
+        p->fd = fd;
+        p->log = handshake || (standin->config.log_every > 0 &&
+                               ++standin->replies % standin->config.log_every == 0);
+        heap_push(standin, p);
+    }
+    return n == 0 ? -1 : 0;
+}
+
+/**
+ * 关闭一个连接，发往它的待回复消息被丢弃
+ */
+static void drop_connection(struct tlshub_standin *standin, int fd) {
+    pthread_mutex_lock(&standin->lock);
+    for (__u32 i = 0; i < standin->conn_count; i++) {
+        if (standin->conns[i] == fd) {
+            standin->conns[i] = standin->conns[--standin->conn_count];
+            break;
+        }
+    }
+    __atomic_store_n(&standin->stats.connections, standin->conn_count, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&standin->lock);
+
+    for (__u32 i = 0; i < standin->heap_len; i++) {
+        if (standin->heap[i]->fd == fd) {
+            standin->heap[i]->fd = -1;
+        }
+    }
+    close(fd);
+}
+
+static void wake(struct tlshub_standin *standin) {
+    uint64_t one = 1;
+
+    if (write(standin->wake_fd, &one, sizeof(one)) != sizeof(one)) {
+        perror("TLSHub stand-in: write eventfd");
+    }
+}
+
+/**
+ * 替身线程：回复到期的消息，等待新请求、新连接或下一条消息到期
+ */
+static void *standin_main(void *arg) {
+    struct tlshub_standin *standin = arg;
+    struct pollfd pfds[STANDIN_MAX_CONNS + 2];
+
+    while (!__atomic_load_n(&standin->stop, __ATOMIC_RELAXED)) {
+        struct timespec timeout, *ptimeout = NULL;
+        __u64 now = now_ns();
+        nfds_t nfds = 0, first_conn;
+        int listen_fd;
+
+        while (standin->heap_len > 0 && standin->heap[0]->due_ns <= now) {
+            struct pending *p = heap_pop(standin);
+
+            if (p->fd >= 0) {
+                if (p->log) {
+                    send_log(standin, p->fd, p->msg.hdr.nlmsg_seq);
+                }
+                send(p->fd, &p->msg, p->len, MSG_NOSIGNAL);
+            }
+            standin->free_list[standin->free_count++] = p;
+        }
+
+        if (standin->heap_len > 0) {
+            __u64 wait = standin->heap[0]->due_ns - now;
+
+            timeout.tv_sec = wait / 1000000000ULL;
+            timeout.tv_nsec = wait % 1000000000ULL;
+            ptimeout = &timeout;
+        }
+
+        /* 每轮重建 pollfd：唤醒 eventfd、监听 socket、各连接 */
+        pfds[nfds].fd = standin->wake_fd;
+        pfds[nfds++].events = POLLIN;
+        listen_fd = __atomic_load_n(&standin->listen_fd, __ATOMIC_ACQUIRE);
+        if (listen_fd >= 0) {
+            pfds[nfds].fd = listen_fd;
+            pfds[nfds++].events = POLLIN;
+        }
+        first_conn = nfds;
+        pthread_mutex_lock(&standin->lock);
+        for (__u32 i = 0; i < standin->conn_count; i++) {
+            pfds[nfds].fd = standin->conns[i];
+            pfds[nfds++].events = POLLIN;
+        }
+        pthread_mutex_unlock(&standin->lock);
+
+        if (ppoll(pfds, nfds, ptimeout, NULL) <= 0) {
+            continue;
+        }
+
+        if (pfds[0].revents) {
+            uint64_t value;
+
+            if (read(standin->wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                perror("TLSHub stand-in: read eventfd");
+            }
+        }
+        if (listen_fd >= 0 && pfds[1].revents) {
+            int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+
+            if (fd >= 0) {
+                tlshub_standin_add_fd(standin, fd);
+            }
+        }
+        for (nfds_t i = first_conn; i < nfds; i++) {
+            if (pfds[i].revents && receive_requests(standin, pfds[i].fd) < 0) {
+                drop_connection(standin, pfds[i].fd);
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * 创建替身并启动其线程
+ */
+struct tlshub_standin *tlshub_standin_new(const struct tlshub_standin_config *config) {
+    struct tlshub_standin *standin;
+
+    if (!config) {
+        return NULL;
+    }
+
+    standin = calloc(1, sizeof(*standin));
+    if (!standin) {
+        return NULL;
+    }
+    standin->config = *config;
+    standin->listen_fd = -1;
+    standin->seed = (unsigned int)now_ns();
+    pthread_mutex_init(&standin->lock, NULL);
+
+    standin->pool = calloc(STANDIN_MAX_PENDING, sizeof(*standin->pool));
+    standin->free_list = calloc(STANDIN_MAX_PENDING, sizeof(*standin->free_list));
+    standin->heap = calloc(STANDIN_MAX_PENDING, sizeof(*standin->heap));
+    standin->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (!standin->pool || !standin->free_list || !standin->heap || standin->wake_fd < 0) {
+        goto err;
+    }
+    for (__u32 i = 0; i < STANDIN_MAX_PENDING; i++) {
+        standin->free_list[i] = &standin->pool[i];
+    }
+    standin->free_count = STANDIN_MAX_PENDING;
+
+    if (pthread_create(&standin->thread, NULL, standin_main, standin) != 0) {
+        fprintf(stderr, "Failed to start TLSHub stand-in thread\n");
+        goto err;
+    }
+    return standin;
+
+err:
+    if (standin->wake_fd >= 0) {
+        close(standin->wake_fd);
+    }
+    pthread_mutex_destroy(&standin->lock);
+    free(standin->heap);
+    free(standin->free_list);
+    free(standin->pool);
+    free(standin);
+    return NULL;
+}
+
+/**
+ * 交给替身一个已连接的 socket
+ */
+int tlshub_standin_add_fd(struct tlshub_standin *standin, int fd) {
+    if (!standin || fd < 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&standin->lock);
+    if (standin->conn_count >= STANDIN_MAX_CONNS) {
+        pthread_mutex_unlock(&standin->lock);
+        fprintf(stderr, "TLSHub stand-in: too many connections\n");
+        close(fd);
+        return -1;
+    }
+    standin->conns[standin->conn_count++] = fd;
+    __atomic_store_n(&standin->stats.connections, standin->conn_count, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&standin->lock);
+
+    wake(standin);
+    return 0;
+}
+
+/**
+ * 在 Unix 域 socket 路径上监听
+ */
+int tlshub_standin_listen(struct tlshub_standin *standin, const char *path) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if (!standin || !path || strlen(path) >= sizeof(addr.sun_path) || standin->listen_fd >= 0) {
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("TLSHub stand-in: socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+        fprintf(stderr, "TLSHub stand-in: cannot listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    strcpy(standin->listen_path, path);
+    __atomic_store_n(&standin->listen_fd, fd, __ATOMIC_RELEASE);
+    wake(standin);
+    return 0;
+}
+
+/**
+ * 创建替身并交给它一个已连接的 socket
+ */
+struct tlshub_standin *tlshub_standin_start(int fd, const struct tlshub_standin_config *config) {
+    struct tlshub_standin *standin;
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    standin = tlshub_standin_new(config);
+    if (!standin) {
+        return NULL;
+    }
+    if (tlshub_standin_add_fd(standin, fd) < 0) {
+        tlshub_standin_stop(standin);
+        return NULL;
+    }
+    return standin;
+}
+
+/**
+ * 获取替身统计
+ */
+void tlshub_standin_get_stats(struct tlshub_standin *standin, struct tlshub_standin_stats *stats) {
+    if (!standin || !stats) {
+        return;
+    }
+
+    stats->messages = __atomic_load_n(&standin->stats.messages, __ATOMIC_RELAXED);
+    stats->batches = __atomic_load_n(&standin->stats.batches, __ATOMIC_RELAXED);
+    stats->entries = __atomic_load_n(&standin->stats.entries, __ATOMIC_RELAXED);
+    stats->logs = __atomic_load_n(&standin->stats.logs, __ATOMIC_RELAXED);
+    stats->handshakes = __atomic_load_n(&standin->stats.handshakes, __ATOMIC_RELAXED);
+    stats->handshake_failures = __atomic_load_n(&standin->stats.handshake_failures, __ATOMIC_RELAXED);
+    stats->fetches = __atomic_load_n(&standin->stats.fetches, __ATOMIC_RELAXED);
+    stats->fetch_misses = __atomic_load_n(&standin->stats.fetch_misses, __ATOMIC_RELAXED);
+    stats->expired = __atomic_load_n(&standin->stats.expired, __ATOMIC_RELAXED);
+    stats->hung = __atomic_load_n(&standin->stats.hung, __ATOMIC_RELAXED);
+    stats->connections = __atomic_load_n(&standin->stats.connections, __ATOMIC_RELAXED);
+}
+
+/**
+ * 停止替身线程，关闭所有连接和监听 socket
+ */
+void tlshub_standin_stop(struct tlshub_standin *standin) {
+    if (!standin) {
+        return;
+    }
+
+    __atomic_store_n(&standin->stop, 1, __ATOMIC_RELAXED);
+    wake(standin);
+    pthread_join(standin->thread, NULL);
+
+    for (__u32 i = 0; i < standin->conn_count; i++) {
+        close(standin->conns[i]);
+    }
+    if (standin->listen_fd >= 0) {
+        close(standin->listen_fd);
+        unlink(standin->listen_path);
+    }
+    for (__u32 i = 0; i < STANDIN_PAIR_BUCKETS; i++) {
+        while (standin->pairs[i]) {
+            struct pod_pair *next = standin->pairs[i]->next;
+
+            free(standin->pairs[i]);
+            standin->pairs[i] = next;
+        }
+    }
+    close(standin->wake_fd);
+    pthread_mutex_destroy(&standin->lock);
+    free(standin->heap);
+    free(standin->free_list);
+    free(standin->pool);
+    free(standin);
+}
@@ -0,0 +1,260 @@
+/**
+ * 多核并发建连基准测试
+ *
+ * 每个线程绑定到一个 CPU，在本机循环执行 connect -> accept -> send 1 字节 -> close，
+ * 依次使用 1、2、4 ... N 个线程，分别在未加载 eBPF 和 fentry 模式下测量建连速率。
+ * fentry 模式下每个连接都会经过 tcp_v4_connect/tcp_sendmsg/inet_sock_set_state
+ * 上的 eBPF 程序，各 CPU 之间若存在共享状态的竞争，会表现为线程数增加后吞吐不再线性增长。
+ *
+ * 需要 root 权限，并在 capture/ 目录下运行：
+ *   make bench
+ *   sudo ./test/bench_connect --max-threads 16 --duration 5
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "capture.h"
+#include "bpf_loader.h"
+#include "event_source.h"
+
+static volatile int stop_flag = 0;
+
+/* 单个建连线程的状态 */
+struct worker {
+    pthread_t thread;
+    int cpu;
+    __u64 connects;
+};
+
+static void drop_event(void *ctx, const struct tcp_connect_event *event) {
+    (void)ctx;
+    (void)event;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * 创建线程私有的监听 socket，避免所有线程争用同一个 accept 队列
+ */
+static int make_listener(struct sockaddr_in *addr) {
+    socklen_t len = sizeof(*addr);
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)addr, sizeof(*addr)) < 0 ||
+        listen(fd, 128) < 0 ||
+        getsockname(fd, (struct sockaddr *)addr, &len) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * 绑定 CPU 后循环建连，以 RST 关闭避免 TIME_WAIT 堆积
+ */
+static void *connect_thread(void *arg) {
+    struct worker *w = arg;
+    struct linger lg = { .l_onoff = 1, .l_linger = 0 };
+    struct sockaddr_in addr;
+    cpu_set_t set;
+    char byte = 'x';
+    int lfd;
+
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    lfd = make_listener(&addr);
+    if (lfd < 0) {
+        perror("listen");
+        return NULL;
+    }
+
+    while (!stop_flag) {
+        int cfd, sfd;
+
+        cfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (cfd < 0) {
+            continue;
+        }
+        setsockopt(cfd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        if (connect(cfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            close(cfd);
+            continue;
+        }
+
+        sfd = accept(lfd, NULL, NULL);
+        if (send(cfd, &byte, 1, MSG_NOSIGNAL) == 1) {
+            w->connects++;
+        }
+        close(cfd);
+        if (sfd >= 0) {
+            close(sfd);
+        }
+    }
+
+    close(lfd);
+    return NULL;
+}
+
+/**
+ * 以 threads 个线程运行一轮，返回每秒建连数
+ * src 不为空时由主线程持续消费事件，避免事件通道写满
+ */
+static double run_round(int threads, int duration, struct event_source *src) {
+    struct worker *workers;
+    int ncpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    __u64 total = 0;
+    double start, elapsed;
+
+    workers = calloc(threads, sizeof(*workers));
+    if (!workers) {
+        return -1.0;
+    }
+
+    stop_flag = 0;
+    for (int i = 0; i < threads; i++) {
+        workers[i].cpu = i % ncpus;
+        pthread_create(&workers[i].thread, NULL, connect_thread, &workers[i]);
+    }
+
+    start = now_sec();
+    while (now_sec() - start < duration) {
+        if (src) {
+            event_source_poll(src, 100);
+        } else {
+            usleep(100000);
+        }
+    }
+    stop_flag = 1;
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        total += workers[i].connects;
+    }
+    elapsed = now_sec() - start;
+
+    free(workers);
+    return total / elapsed;
+}
+
+/**
+ * 加载 fentry 模式的 eBPF 程序后运行一轮
+ */
+static double run_with_fentry(int threads, int duration) {
+    struct capture_config config;
+    struct bpf_loader loader;
+    struct event_source *src;
+    double rate;
+
+    memset(&config, 0, sizeof(config));
+    config.transport = EVENT_TRANSPORT_AUTO;
+    config.ringbuf_wakeup_batch = 64;
+    config.hook = CAPTURE_HOOK_FENTRY;
+
+    if (bpf_loader_open(&loader, &config) < 0) {
+        return -1.0;
+    }
+    if (bpf_loader_attach(&loader) <= 0) {
+        bpf_loader_close(&loader);
+        return -1.0;
+    }
+
+    src = event_source_new(&loader, drop_event, NULL);
+    if (!src) {
+        bpf_loader_close(&loader);
+        return -1.0;
+    }
+
+    rate = run_round(threads, duration, src);
+
+    event_source_free(src);
+    bpf_loader_close(&loader);
+    return rate;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("  -n, --max-threads N   largest thread count (default: online CPUs)\n");
+    printf("  -d, --duration S      seconds per round (default: 5)\n");
+}
+
+int main(int argc, char **argv) {
+    static struct option long_options[] = {
+        {"max-threads", required_argument, 0, 'n'},
+        {"duration", required_argument, 0, 'd'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int duration = 5;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "n:d:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'n':
+                max_threads = atoi(optarg);
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (max_threads <= 0 || duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("=== Concurrent Connect Benchmark (up to %d threads, %ds per round) ===\n\n",
+           max_threads, duration);
+    printf("%-8s %14s %14s %10s\n", "threads", "none conn/s", "fentry conn/s", "overhead");
+
+    for (int threads = 1; ; threads *= 2) {
+        double base, fentry;
+
+        if (threads > max_threads) {
+            threads = max_threads;
+        }
+
+        base = run_round(threads, duration, NULL);
+        fentry = run_with_fentry(threads, duration);
+
+        if (fentry > 0 && base > 0) {
+            printf("%-8d %14.0f %14.0f %9.1f%%\n",
+                   threads, base, fentry, (base - fentry) * 100.0 / base);
+        } else {
+            printf("%-8d %14.0f %14s\n", threads, base, "failed");
+        }
+
+        if (threads == max_threads) {
+            break;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,317 @@
+/**
+ * 每 CPU 事件消费者基准测试
+ *
+ * 在 1、2、4 ... N 个 CPU 上各绑定一个线程循环建连（fentry 模式，perf buffer），
+ * 分别用两种方式消费事件：
+ *   loop   - 单个线程 perf_buffer__poll 所有 CPU 的缓冲区（原有方式）
+ *   percpu - 每个 CPU 一个绑定在该 CPU 上的消费者线程，只消费自己的缓冲区
+ * 与守护进程相同，事件回调只调用 key_worker_submit 把事件交给密钥协商工作线程池
+ * （每轮 cpus 个工作线程，percpu 方式下按消费者编号分成 cpus 个队列分片），
+ * 工作线程忙等 --work 纳秒模拟密钥协商开销。ev/s 为工作线程处理完成的事件数，
+ * lost/s 包括 perf buffer 丢失和工作队列满丢弃的事件。
+ * 单线程消费者或共享队列达到上限后表现为 events/s 不再增长、lost 快速上升。
+ *
+ * 需要 root 权限，并在 capture/ 目录下运行（依赖 capture_perf.bpf.o）：
+ *   make bench
+ *   sudo ./test/bench_consumers --max-cpus 16 --work 2000 --duration 5
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "capture.h"
+#include "bpf_loader.h"
+#include "event_source.h"
+#include "key_worker.h"
+
+#define BENCH_QUEUE_SIZE 4096
+
+static volatile int stop_flag = 0;
+static long work_ns = 2000;
+static struct key_worker_pool *pool;
+
+/* 单个建连线程的状态 */
+struct worker {
+    pthread_t thread;
+    int cpu;
+    __u64 connects;
+};
+
+/* 一轮测试的结果 */
+struct bench_result {
+    double connects;
+    double events;
+    double lost;
+};
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * 工作线程回调：模拟固定的密钥协商开销
+ */
+static void negotiate(void *ctx, const struct tcp_connect_event *event) {
+    __u64 end = now_ns() + work_ns;
+
+    (void)ctx;
+    (void)event;
+    while (now_ns() < end) {
+        ;
+    }
+}
+
+/**
+ * 事件回调：与守护进程一样只入队，由工作线程处理
+ */
+static void handle_event(void *ctx, const struct tcp_connect_event *event) {
+    (void)ctx;
+    key_worker_submit(pool, event);
+}
+
+/**
+ * 创建线程私有的监听 socket，避免所有线程争用同一个 accept 队列
+ */
+static int make_listener(struct sockaddr_in *addr) {
+    socklen_t len = sizeof(*addr);
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)addr, sizeof(*addr)) < 0 ||
+        listen(fd, 128) < 0 ||
+        getsockname(fd, (struct sockaddr *)addr, &len) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * 绑定 CPU 后循环建连，以 RST 关闭避免 TIME_WAIT 堆积
+ */
+static void *connect_thread(void *arg) {
+    struct worker *w = arg;
+    struct linger lg = { .l_onoff = 1, .l_linger = 0 };
+    struct sockaddr_in addr;
+    cpu_set_t set;
+    char byte = 'x';
+    int lfd;
+
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    lfd = make_listener(&addr);
+    if (lfd < 0) {
+        perror("listen");
+        return NULL;
+    }
+
+    while (!stop_flag) {
+        int cfd, sfd;
+
+        cfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (cfd < 0) {
+            continue;
+        }
+        setsockopt(cfd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        if (connect(cfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            close(cfd);
+            continue;
+        }
+
+        sfd = accept(lfd, NULL, NULL);
+        if (send(cfd, &byte, 1, MSG_NOSIGNAL) == 1) {
+            w->connects++;
+        }
+        close(cfd);
+        if (sfd >= 0) {
+            close(sfd);
+        }
+    }
+
+    close(lfd);
+    return NULL;
+}
+
+/**
+ * 在 cpus 个 CPU 上建连并运行一轮
+ * percpu 为 0 时由主线程轮询全部缓冲区，否则启动每 CPU 消费者线程
+ */
+static int run_round(int cpus, int percpu, int duration, struct bench_result *result) {
+    struct capture_config config;
+    struct bpf_loader loader;
+    struct event_source *src;
+    struct event_source_stats stats;
+    struct key_worker_stats pool_stats;
+    struct worker *workers;
+    __u64 connects = 0;
+    double elapsed;
+    __u64 start;
+
+    memset(&config, 0, sizeof(config));
+    config.transport = EVENT_TRANSPORT_PERFBUF;
+    config.hook = CAPTURE_HOOK_FENTRY;
+
+    if (bpf_loader_open(&loader, &config) < 0) {
+        return -1;
+    }
+    if (bpf_loader_attach(&loader) <= 0) {
+        bpf_loader_close(&loader);
+        return -1;
+    }
+
+    pool = key_worker_pool_new(cpus < KEY_WORKER_MAX_THREADS ? cpus : KEY_WORKER_MAX_THREADS,
+                               BENCH_QUEUE_SIZE, percpu ? cpus : 1, negotiate, NULL, NULL);
+    if (!pool) {
+        bpf_loader_close(&loader);
+        return -1;
+    }
+
+    src = event_source_new(&loader, handle_event, NULL);
+    if (!src) {
+        key_worker_pool_free(pool);
+        bpf_loader_close(&loader);
+        return -1;
+    }
+    if (percpu && event_source_start_consumers(src, EVENT_CONSUMERS_PER_CPU) < 0) {
+        event_source_free(src);
+        key_worker_pool_free(pool);
+        bpf_loader_close(&loader);
+        return -1;
+    }
+
+    workers = calloc(cpus, sizeof(*workers));
+    if (!workers) {
+        event_source_free(src);
+        key_worker_pool_free(pool);
+        bpf_loader_close(&loader);
+        return -1;
+    }
+
+    stop_flag = 0;
+    for (int i = 0; i < cpus; i++) {
+        workers[i].cpu = i;
+        pthread_create(&workers[i].thread, NULL, connect_thread, &workers[i]);
+    }
+
+    start = now_ns();
+    while (now_ns() - start < (__u64)duration * 1000000000ULL) {
+        if (percpu) {
+            usleep(100000);
+        } else {
+            event_source_poll(src, 100);
+        }
+    }
+    stop_flag = 1;
+
+    for (int i = 0; i < cpus; i++) {
+        pthread_join(workers[i].thread, NULL);
+        connects += workers[i].connects;
+    }
+    elapsed = (now_ns() - start) / 1e9;
+
+    event_source_stop_consumers(src);
+    event_source_get_stats(src, &stats);
+    key_worker_pool_stop(pool);
+    key_worker_get_stats(pool, &pool_stats);
+    result->connects = connects / elapsed;
+    result->events = pool_stats.completed / elapsed;
+    result->lost = (stats.lost + pool_stats.dropped) / elapsed;
+
+    free(workers);
+    event_source_free(src);
+    key_worker_pool_free(pool);
+    pool = NULL;
+    bpf_loader_close(&loader);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("  -n, --max-cpus N      largest number of connecting CPUs (default: online CPUs)\n");
+    printf("  -w, --work NS         simulated negotiation cost per event in ns (default: 2000)\n");
+    printf("  -d, --duration S      seconds per round (default: 5)\n");
+}
+
+int main(int argc, char **argv) {
+    static struct option long_options[] = {
+        {"max-cpus", required_argument, 0, 'n'},
+        {"work", required_argument, 0, 'w'},
+        {"duration", required_argument, 0, 'd'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int max_cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int duration = 5;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "n:w:d:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'n':
+                max_cpus = atoi(optarg);
+                break;
+            case 'w':
+                work_ns = atol(optarg);
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (max_cpus <= 0 || max_cpus > (int)sysconf(_SC_NPROCESSORS_ONLN) ||
+        work_ns < 0 || duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("=== Per-CPU Event Consumer Benchmark (up to %d CPUs, %ld ns per event, %ds per round) ===\n\n",
+           max_cpus, work_ns, duration);
+    printf("%-6s %12s %12s %12s %12s %12s %12s\n", "cpus",
+           "loop conn/s", "loop ev/s", "loop lost/s",
+           "cpu conn/s", "cpu ev/s", "cpu lost/s");
+
+    for (int cpus = 1; ; cpus *= 2) {
+        struct bench_result loop, percpu;
+
+        if (cpus > max_cpus) {
+            cpus = max_cpus;
+        }
+
+        if (run_round(cpus, 0, duration, &loop) < 0 ||
+            run_round(cpus, 1, duration, &percpu) < 0) {
+            printf("%-6d %12s\n", cpus, "failed");
+        } else {
+            printf("%-6d %12.0f %12.0f %12.0f %12.0f %12.0f %12.0f\n", cpus,
+                   loop.connects, loop.events, loop.lost,
+                   percpu.connects, percpu.events, percpu.lost);
+        }
+
+        if (cpus == max_cpus) {
+            break;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,293 @@
+/**
+ * 内核事件通道基准测试
+ *
+ * 在本机制造 TCP 连接风暴，分别使用 ring buffer 和 perf buffer 两种事件通道
+ * 消费 capture.bpf.c 产生的连接事件，统计事件吞吐（events/sec）和
+ * 消费者唤醒次数（wakeups/sec）。
+ *
+ * 需要 root 权限，并在 capture/ 目录下运行（依赖 capture.bpf.o 和 capture_perf.bpf.o）：
+ *   make bench
+ *   sudo ./test/bench_events --transport both --threads 8 --duration 10 --batch 32
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "capture.h"
+#include "bpf_loader.h"
+#include "event_source.h"
+
+static volatile int stop_flag = 0;
+static int listen_fd = -1;
+static struct sockaddr_in listen_addr;
+
+/* 单个事件通道的测试结果 */
+struct bench_result {
+    __u64 connects;
+    __u64 events;
+    __u64 wakeups;
+    double seconds;
+};
+
+static void count_event(void *ctx, const struct tcp_connect_event *event) {
+    (void)ctx;
+    (void)event;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * 接受并立即关闭所有连接
+ */
+static void *accept_thread(void *arg) {
+    (void)arg;
+    while (!stop_flag) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        close(fd);
+    }
+    return NULL;
+}
+
+/**
+ * 循环建立连接、发送 1 字节（触发首次发送）并以 RST 关闭，避免 TIME_WAIT 堆积
+ */
+static void *connect_thread(void *arg) {
+    __u64 *connects = arg;
+    struct linger lg = { .l_onoff = 1, .l_linger = 0 };
+    char byte = 'x';
+
+    while (!stop_flag) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            continue;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        if (connect(fd, (struct sockaddr *)&listen_addr, sizeof(listen_addr)) == 0) {
+            if (send(fd, &byte, 1, MSG_NOSIGNAL) == 1) {
+                (*connects)++;
+            }
+        }
+        close(fd);
+    }
+    return NULL;
+}
+
+static int setup_listener(void) {
+    socklen_t len = sizeof(listen_addr);
+    int one = 1;
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&listen_addr, 0, sizeof(listen_addr));
+    listen_addr.sin_family = AF_INET;
+    listen_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    listen_addr.sin_port = 0;
+
+    if (bind(listen_fd, (struct sockaddr *)&listen_addr, sizeof(listen_addr)) < 0 ||
+        listen(listen_fd, 4096) < 0 ||
+        getsockname(listen_fd, (struct sockaddr *)&listen_addr, &len) < 0) {
+        perror("listen");
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 使用指定事件通道运行一轮测试
+ */
+static int run_bench(enum event_transport transport, enum capture_hook hook, __u32 batch,
+                     int threads, int duration, struct bench_result *result) {
+    struct capture_config config;
+    struct bpf_loader loader;
+    struct event_source *src;
+    struct event_source_stats stats;
+    pthread_t acceptor;
+    pthread_t *workers;
+    __u64 *connects;
+    double start;
+
+    memset(&config, 0, sizeof(config));
+    config.transport = transport;
+    config.ringbuf_wakeup_batch = batch;
+    config.hook = hook;
+    strncpy(config.cgroup_path, "/sys/fs/cgroup", sizeof(config.cgroup_path) - 1);
+
+    if (bpf_loader_open(&loader, &config) < 0) {
+        return -1;
+    }
+    bpf_loader_attach(&loader);
+
+    src = event_source_new(&loader, count_event, NULL);
+    if (!src) {
+        bpf_loader_close(&loader);
+        return -1;
+    }
+
+    workers = calloc(threads, sizeof(pthread_t));
+    connects = calloc(threads, sizeof(__u64));
+    if (!workers || !connects) {
+        free(workers);
+        free(connects);
+        event_source_free(src);
+        bpf_loader_close(&loader);
+        return -1;
+    }
+
+    stop_flag = 0;
+    pthread_create(&acceptor, NULL, accept_thread, NULL);
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, connect_thread, &connects[i]);
+    }
+
+    start = now_sec();
+    while (now_sec() - start < duration) {
+        event_source_poll(src, 100);
+    }
+
+    stop_flag = 1;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    shutdown(listen_fd, SHUT_RDWR);
+    pthread_join(acceptor, NULL);
+
+    /* 取走尚未消费的事件 */
+    while (event_source_poll(src, 200) > 0) {
+        ;
+    }
+    result->seconds = now_sec() - start;
+
+    event_source_get_stats(src, &stats);
+    result->connects = 0;
+    for (int i = 0; i < threads; i++) {
+        result->connects += connects[i];
+    }
+    result->events = stats.events;
+    result->wakeups = stats.wakeups;
+
+    free(workers);
+    free(connects);
+    event_source_free(src);
+    bpf_loader_close(&loader);
+
+    /* 重新建立监听，供下一轮使用 */
+    close(listen_fd);
+    return setup_listener();
+}
+
+static void print_result(const char *name, __u32 batch, const struct bench_result *r) {
+    printf("%-10s %6u %12.0f %12.0f %12.0f %10.1f\n",
+           name, batch,
+           r->connects / r->seconds,
+           r->events / r->seconds,
+           r->wakeups / r->seconds,
+           r->wakeups ? (double)r->events / r->wakeups : 0.0);
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("  -t, --transport T   ringbuf, perfbuf or both (default: both)\n");
+    printf("  -b, --batch N       ring buffer wakeup batch (default: 1)\n");
+    printf("  -n, --threads N     connecting threads (default: 4)\n");
+    printf("  -d, --duration S    seconds per run (default: 10)\n");
+    printf("  -k, --hook H        sockops or fentry (default: sockops)\n");
+}
+
+int main(int argc, char **argv) {
+    static struct option long_options[] = {
+        {"transport", required_argument, 0, 't'},
+        {"batch", required_argument, 0, 'b'},
+        {"threads", required_argument, 0, 'n'},
+        {"duration", required_argument, 0, 'd'},
+        {"hook", required_argument, 0, 'k'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    const char *transport = "both";
+    __u32 batch = 1;
+    int threads = 4;
+    int duration = 10;
+    enum capture_hook hook = CAPTURE_HOOK_SOCKOPS;
+    struct bench_result result;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "t:b:n:d:k:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 't':
+                transport = optarg;
+                break;
+            case 'b':
+                batch = (__u32)strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                threads = atoi(optarg);
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            case 'k':
+                hook = strcmp(optarg, "fentry") == 0 ? CAPTURE_HOOK_FENTRY : CAPTURE_HOOK_SOCKOPS;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (threads <= 0 || duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (setup_listener() < 0) {
+        return 1;
+    }
+
+    printf("=== Event Transport Benchmark (%d threads, %ds per run) ===\n\n",
+           threads, duration);
+    printf("%-10s %6s %12s %12s %12s %10s\n",
+           "transport", "batch", "connects/s", "events/s", "wakeups/s", "ev/wakeup");
+
+    if (strcmp(transport, "ringbuf") == 0 || strcmp(transport, "both") == 0) {
+        if (run_bench(EVENT_TRANSPORT_RINGBUF, hook, batch, threads, duration, &result) == 0) {
+            print_result("ringbuf", batch, &result);
+        } else {
+            fprintf(stderr, "ringbuf run failed\n");
+        }
+    }
+
+    if (strcmp(transport, "perfbuf") == 0 || strcmp(transport, "both") == 0) {
+        if (run_bench(EVENT_TRANSPORT_PERFBUF, hook, batch, threads, duration, &result) == 0) {
+            print_result("perfbuf", 1, &result);
+        } else {
+            fprintf(stderr, "perfbuf run failed\n");
+        }
+    }
+
+    close(listen_fd);
+    return 0;
+}
@@ -0,0 +1,237 @@
+/**
+ * 密钥缓存基准测试
+ *
+ * 经过 key_provider 的 stub 模式（每次协商耗时 --latency 微秒），工作线程数从 1 倍增到
+ * --max-threads，每个线程循环为 --pairs 个 Pod 对中的随机一对请求密钥。对比：
+ *   off     - 不缓存，每个请求都经过 singleflight 合并后协商
+ *   cache   - 先查密钥缓存（容量为 Pod 对数的 2 倍），条目 --ttl 毫秒后过期，过期后由一次合并后的协商刷新
+ *   refresh - 在 cache 的基础上由后台线程在过期前 --lead 毫秒（加 --jitter 抖动）刷新
+ * 统计请求速率、每个请求的平均耗时（ns）、p99.9 和最大延迟、实际协商次数、命中率和查到过期条目的次数。
+ * 缓存开启时实际协商次数应约等于 Pod 对数 × (时长 / ttl + 1)，与线程数无关；
+ * 后台刷新开启时前台不再查到过期条目，p99.9 不再包含协商耗时。
+ *
+ * 不需要 root 权限，在 capture/ 目录下运行：
+ *   make bench
+ *   ./test/bench_key_cache --max-threads 16 --pairs 1024 --ttl 500 --lead 100
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "capture.h"
+#include "key_provider.h"
+#include "latency_hist.h"
+
+static volatile int stop_flag = 0;
+static int pairs = 1024;
+
+/* 每轮的缓存方式 */
+enum cache_mode {
+    CACHE_OFF,
+    CACHE_ON,
+    CACHE_REFRESH,
+};
+
+static const char *mode_names[] = { "off", "cache", "refresh" };
+
+/* 单个工作线程的状态 */
+struct worker {
+    pthread_t thread;
+    unsigned int seed;
+    __u64 requests;
+    __u64 failures;
+    __u64 latency_ns;
+    struct latency_hist hist;
+};
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    struct tls_key_info key;
+
+    while (!stop_flag) {
+        struct flow_tuple tuple;
+        __u32 pair = rand_r(&w->seed) % pairs;
+        __u64 t0;
+
+        memset(&tuple, 0, sizeof(tuple));
+        tuple.family = AF_INET;
+        tuple.role = FLOW_ROLE_CLIENT;
+        tuple.saddr = 0x0a000000 + (pair >> 8);
+        tuple.daddr = 0x0b000000 + (pair & 0xff);
+        tuple.sport = 40000 + rand_r(&w->seed) % 20000;
+        tuple.dport = 443;
+
+        t0 = now_ns();
+        if (key_provider_get_key(&tuple, &key) < 0) {
+            w->failures++;
+        }
+        t0 = now_ns() - t0;
+        w->latency_ns += t0;
+        latency_hist_record(&w->hist, t0);
+        w->requests++;
+    }
+    return NULL;
+}
+
+/**
+ * 以 workers 个线程按 mode 运行一轮
+ */
+static int run_round(int workers, enum cache_mode mode, int ttl_ms, int lead_ms, int jitter_ms,
+                     int duration) {
+    static struct latency_hist hist;
+    struct worker *threads;
+    struct key_provider_stats stats;
+    __u64 requests = 0, failures = 0, latency_ns = 0, negotiations, start, lookups;
+    double elapsed;
+
+    threads = calloc(workers, sizeof(*threads));
+    if (!threads) {
+        return -1;
+    }
+    key_provider_set_cache(mode != CACHE_OFF ? pairs * 2 : 0, ttl_ms);
+    key_provider_set_refresh(mode == CACHE_REFRESH ? lead_ms : 0, jitter_ms, 2);
+    if (key_provider_init(MODE_STUB) < 0) {
+        free(threads);
+        return -1;
+    }
+    key_provider_get_stats(&stats);
+    negotiations = stats.negotiations;
+
+    stop_flag = 0;
+    start = now_ns();
+    for (int i = 0; i < workers; i++) {
+        threads[i].seed = i + 1;
+        pthread_create(&threads[i].thread, NULL, worker_main, &threads[i]);
+    }
+    sleep(duration);
+    stop_flag = 1;
+    for (int i = 0; i < workers; i++) {
+        pthread_join(threads[i].thread, NULL);
+        requests += threads[i].requests;
+        failures += threads[i].failures;
+        latency_ns += threads[i].latency_ns;
+    }
+    latency_hist_reset(&hist);
+    for (int i = 0; i < workers; i++) {
+        for (__u32 b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+            hist.buckets[b] += threads[i].hist.buckets[b];
+        }
+        hist.count += threads[i].hist.count;
+        if (threads[i].hist.max_ns > hist.max_ns) {
+            hist.max_ns = threads[i].hist.max_ns;
+        }
+    }
+    elapsed = (now_ns() - start) / 1e9;
+
+    key_provider_get_stats(&stats);
+    lookups = stats.cache.hits + stats.cache.misses + stats.cache.expired;
+    printf("%7d %-7s %12.0f %11.0f %11.3f %10.3f %13llu %9.2f%% %10llu %9llu\n",
+           workers, mode_names[mode],
+           requests / elapsed,
+           requests ? (double)latency_ns / requests : 0.0,
+           latency_hist_quantile(&hist, 0.999) / 1e6,
+           hist.max_ns / 1e6,
+           stats.negotiations - negotiations,
+           lookups ? (double)stats.cache.hits * 100.0 / lookups : 0.0,
+           stats.cache.expired,
+           failures);
+
+    key_provider_cleanup();
+    free(threads);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("  -t, --max-threads N   maximum requesting threads, doubled from 1 (default: 8)\n");
+    printf("  -p, --pairs N         distinct pod pairs (default: 1024)\n");
+    printf("  -l, --latency US      simulated negotiation time in microseconds (default: 500)\n");
+    printf("  -e, --ttl MS          cache entry lifetime in milliseconds (default: 1000)\n");
+    printf("  -r, --lead MS         background refresh this long before expiry (default: 200)\n");
+    printf("  -j, --jitter MS       extra random refresh lead (default: 100)\n");
+    printf("  -d, --duration S      seconds per round (default: 3)\n");
+}
+
+int main(int argc, char **argv) {
+    static struct option long_options[] = {
+        {"max-threads", required_argument, 0, 't'},
+        {"pairs", required_argument, 0, 'p'},
+        {"latency", required_argument, 0, 'l'},
+        {"ttl", required_argument, 0, 'e'},
+        {"lead", required_argument, 0, 'r'},
+        {"jitter", required_argument, 0, 'j'},
+        {"duration", required_argument, 0, 'd'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int max_threads = 8;
+    int latency_us = 500;
+    int ttl_ms = 1000;
+    int lead_ms = 200;
+    int jitter_ms = 100;
+    int duration = 3;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "t:p:l:e:r:j:d:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 't':
+                max_threads = atoi(optarg);
+                break;
+            case 'p':
+                pairs = atoi(optarg);
+                break;
+            case 'l':
+                latency_us = atoi(optarg);
+                break;
+            case 'e':
+                ttl_ms = atoi(optarg);
+                break;
+            case 'r':
+                lead_ms = atoi(optarg);
+                break;
+            case 'j':
+                jitter_ms = atoi(optarg);
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (max_threads <= 0 || pairs <= 0 || pairs > 1000000 || latency_us < 0 || ttl_ms <= 0 ||
+        lead_ms <= 0 || jitter_ms < 0 || lead_ms + jitter_ms >= ttl_ms || duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    key_provider_set_stub_latency(latency_us);
+    key_provider_set_coalesce(KEY_COALESCE_POD);
+
+    printf("=== Key Cache Benchmark (%d pod pairs, %d us per negotiation, ttl %d ms, refresh %d+%d ms early, %ds per round) ===\n\n",
+           pairs, latency_us, ttl_ms, lead_ms, jitter_ms, duration);
+    printf("%7s %-7s %12s %11s %11s %10s %13s %10s %10s %9s\n", "threads", "mode", "requests/s",
+           "ns/request", "p99.9 ms", "max ms", "negotiations", "hit rate", "expired", "failures");
+
+    for (int workers = 1; workers <= max_threads; workers *= 2) {
+        for (int mode = CACHE_OFF; mode <= CACHE_REFRESH; mode++) {
+            if (run_round(workers, mode, ttl_ms, lead_ms, jitter_ms, duration) < 0) {
+                fprintf(stderr, "benchmark round failed\n");
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * 密钥协商工作线程池基准测试
+ *
+ * 以固定速率向线程池提交连接事件，每个事件在工作线程中模拟一次耗时为
+ * --latency 微秒的密钥协商，依次使用 1、2、4 ... N 个工作线程，统计：
+ *   submit ns  - 事件循环侧每次提交的平均耗时（应与协商耗时无关）
+ *   done/s     - 实际完成的协商速率
+ *   dropped    - 队列满被丢弃的事件数
+ *   wait       - 事件在队列中的平均/最长等待时间
+ *   util       - 工作线程利用率
+ *
+ * 不需要 root 权限，在 capture/ 目录下运行：
+ *   make bench
+ *   ./test/bench_key_workers --rate 20000 --latency 200 --max-workers 16
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include "capture.h"
+#include "key_worker.h"
+
+static int negotiation_us = 200;
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * 模拟一次阻塞的密钥协商（等待 Netlink 响应）
+ */
+static void slow_negotiation(void *ctx, const struct tcp_connect_event *event) {
+    (void)ctx;
+    (void)event;
+    usleep(negotiation_us);
+}
+
+/**
+ * 以 workers 个工作线程运行一轮
+ */
+static int run_round(__u32 workers, __u32 queue_size, long rate, int duration) {
+    struct key_worker_pool *pool;
+    struct key_worker_stats stats;
+    struct tcp_connect_event event;
+    __u64 start, end, next, submit_ns = 0, submits = 0;
+    __u64 interval_ns = 1000000000ULL / rate;
+
+    pool = key_worker_pool_new(workers, queue_size, 1, slow_negotiation, NULL, NULL);
+    if (!pool) {
+        return -1;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.family = CAPTURE_AF_INET;
+
+    start = now_ns();
+    end = start + (__u64)duration * 1000000000ULL;
+    next = start;
+    while (next < end) {
+        __u64 t0, t1;
+
+        while (now_ns() < next) {
+            ;
+        }
+        t0 = now_ns();
+        event.timestamp = t0;
+        key_worker_submit(pool, &event);
+        t1 = now_ns();
+
+        submit_ns += t1 - t0;
+        submits++;
+        next += interval_ns;
+    }
+
+    key_worker_get_stats(pool, &stats);
+    key_worker_pool_free(pool);
+
+    printf("%-8u %10.0f %10.0f %10llu %10.3f %10.3f %7.1f%%\n",
+           workers,
+           (double)submit_ns / submits,
+           stats.completed * 1e9 / stats.elapsed_ns,
+           stats.dropped,
+           stats.completed ? stats.wait_total_ns / 1e6 / stats.completed : 0.0,
+           stats.wait_max_ns / 1e6,
+           stats.busy_ns * 100.0 / ((double)stats.elapsed_ns * stats.workers));
+    return 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("  -r, --rate N          events submitted per second (default: 20000)\n");
+    printf("  -l, --latency US      simulated negotiation time in microseconds (default: 200)\n");
+    printf("  -n, --max-workers N   largest worker count (default: 16)\n");
+    printf("  -q, --queue N         queue capacity (default: %d)\n", KEY_WORKER_DEFAULT_QUEUE_SIZE);
+    printf("  -d, --duration S      seconds per round (default: 3)\n");
+}
+
+int main(int argc, char **argv) {
+    static struct option long_options[] = {
+        {"rate", required_argument, 0, 'r'},
+        {"latency", required_argument, 0, 'l'},
+        {"max-workers", required_argument, 0, 'n'},
+        {"queue", required_argument, 0, 'q'},
+        {"duration", required_argument, 0, 'd'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    long rate = 20000;
+    __u32 max_workers = 16;
+    __u32 queue_size = KEY_WORKER_DEFAULT_QUEUE_SIZE;
+    int duration = 3;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "r:l:n:q:d:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'r':
+                rate = atol(optarg);
+                break;
+            case 'l':
+                negotiation_us = atoi(optarg);
+                break;
+            case 'n':
+                max_workers = (__u32)strtoul(optarg, NULL, 10);
+                break;
+            case 'q':
+                queue_size = (__u32)strtoul(optarg, NULL, 10);
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (rate <= 0 || negotiation_us < 0 || max_workers == 0 ||
+        max_workers > KEY_WORKER_MAX_THREADS || queue_size == 0 || duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("=== Key Worker Pool Benchmark (%ld events/s, %d us per negotiation, %ds per round) ===\n\n",
+           rate, negotiation_us, duration);
+    printf("%-8s %10s %10s %10s %10s %10s %8s\n",
+           "workers", "submit ns", "done/s", "dropped", "wait ms", "max ms", "util");
+
+    for (__u32 workers = 1; ; workers *= 2) {
+        if (workers > max_workers) {
+            workers = max_workers;
+        }
+        if (run_round(workers, queue_size, rate, duration) < 0) {
+            fprintf(stderr, "round with %u workers failed\n", workers);
+        }
+        if (workers == max_workers) {
+            break;
+        }
+    }
+
+    return 0;
+}
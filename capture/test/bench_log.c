@@ -0,0 +1,207 @@
+/**
+ * 每连接日志开销基准测试
+ *
+ * 模拟密钥协商工作线程处理一个连接时输出的日志，依次使用 1、2、4 ... N 个线程，对比：
+ *   printf - 原来的做法：每个连接 9 行 printf，经过 stdio 锁同步格式化并写出
+ *   async  - 异步日志：一条 info 记录写入线程私有环形缓冲区，debug 日志在编译期删除，
+ *            格式化和写文件由后台线程完成
+ * 统计每个连接在调用线程上的日志耗时（ns/conn）和总吞吐（conn/s）。
+ * 输出写到 --output 指定的文件（默认 /dev/null），async 模式默认关闭限流以测量完整开销。
+ *
+ * 不需要 root 权限，在 capture/ 目录下运行：
+ *   make bench
+ *   ./test/bench_log --max-threads 8 --duration 3
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include "log.h"
+
+static volatile int stop_flag = 0;
+static int async_mode = 0;
+
+/* 单个线程的状态 */
+struct worker {
+    pthread_t thread;
+    __u64 connections;
+    __u64 log_ns;
+};
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * 原有实现中每个连接在工作线程上输出的日志
+ */
+static void log_connection_printf(const char *saddr, const char *daddr, unsigned int pid,
+                                  unsigned long long ts) {
+    printf("\n=== New TCP Connection Detected (%s) ===\n", "client");
+    printf("Client: %s:%u\n", saddr, 43512);
+    printf("Server: %s:%u\n", daddr, 443);
+    printf("PID: %u\n", pid);
+    printf("Timestamp: %llu\n", ts);
+    printf("Fetching TLS key...\n");
+    printf("Fetched TLS key from TLSHub (status: %d)\n", 0);
+    printf("TLS key obtained successfully (key_len: %u, iv_len: %u)\n", 32, 12);
+    printf("Note: Socket fd retrieval not implemented in this example\n");
+}
+
+/**
+ * 异步日志下同一个连接的日志（debug 级别在默认编译级别下不生成代码）
+ */
+static void log_connection_async(const char *saddr, const char *daddr, unsigned int pid,
+                                 unsigned long long ts) {
+    log_info("New TCP connection (%s): %s:%u -> %s:%u pid %u ts %llu",
+             "client", saddr, 43512, daddr, 443, pid, ts);
+    log_debug("Fetching TLS key...");
+    log_debug("Fetched TLS key from TLSHub (status: %d)", 0);
+    log_debug("TLS key obtained successfully (key_len: %u, iv_len: %u)", 32, 12);
+    log_debug("Socket fd retrieval not implemented, KTLS would be configured here");
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    const char *saddr = "10.244.1.23";
+    const char *daddr = "10.244.2.45";
+
+    while (!stop_flag) {
+        __u64 t0 = now_ns();
+
+        if (async_mode) {
+            log_connection_async(saddr, daddr, 4242, t0);
+        } else {
+            log_connection_printf(saddr, daddr, 4242, t0);
+        }
+        w->log_ns += now_ns() - t0;
+        w->connections++;
+    }
+    return NULL;
+}
+
+/**
+ * 以 threads 个线程运行一轮
+ */
+static void run_round(int threads, int duration, double *ns_per_conn, double *conn_per_sec) {
+    struct worker *workers = calloc(threads, sizeof(*workers));
+    __u64 conns = 0, log_ns = 0;
+    __u64 start;
+
+    stop_flag = 0;
+    start = now_ns();
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+    sleep(duration);
+    stop_flag = 1;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        conns += workers[i].connections;
+        log_ns += workers[i].log_ns;
+    }
+
+    *ns_per_conn = conns ? (double)log_ns / conns : 0.0;
+    *conn_per_sec = conns * 1e9 / (now_ns() - start);
+    free(workers);
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("  -n, --max-threads N   largest thread count (default: 8)\n");
+    printf("  -d, --duration S      seconds per round (default: 3)\n");
+    printf("  -o, --output FILE     where log output goes (default: /dev/null)\n");
+    printf("  -r, --rate-limit N    async records per thread per second, 0 = unlimited (default: 0)\n");
+}
+
+int main(int argc, char **argv) {
+    static struct option long_options[] = {
+        {"max-threads", required_argument, 0, 'n'},
+        {"duration", required_argument, 0, 'd'},
+        {"output", required_argument, 0, 'o'},
+        {"rate-limit", required_argument, 0, 'r'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    struct log_config cfg = { .level = LOG_LEVEL_INFO, .ring_size = 4096 };
+    struct log_stats stats;
+    const char *output = "/dev/null";
+    int max_threads = 8;
+    int duration = 3;
+    FILE *console;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "n:d:o:r:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'n':
+                max_threads = atoi(optarg);
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'r':
+                cfg.rate_limit = (__u32)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (max_threads <= 0 || duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    /* 结果写到终端，被测日志写到 output */
+    console = fdopen(dup(STDOUT_FILENO), "w");
+    if (!console || !freopen(output, "w", stdout)) {
+        perror("redirect stdout");
+        return 1;
+    }
+    setvbuf(console, NULL, _IOLBF, 0);
+    cfg.path = output;
+
+    fprintf(console, "=== Per-Connection Logging Benchmark (%ds per round, output %s) ===\n\n",
+            duration, output);
+    fprintf(console, "%-8s %12s %12s %12s %12s\n",
+            "threads", "printf ns", "printf c/s", "async ns", "async c/s");
+
+    for (int threads = 1; ; threads *= 2) {
+        double printf_ns, printf_rate, async_ns, async_rate;
+
+        if (threads > max_threads) {
+            threads = max_threads;
+        }
+
+        async_mode = 0;
+        run_round(threads, duration, &printf_ns, &printf_rate);
+
+        async_mode = 1;
+        if (log_init(&cfg) < 0) {
+            return 1;
+        }
+        run_round(threads, duration, &async_ns, &async_rate);
+        log_shutdown();
+
+        fprintf(console, "%-8d %12.0f %12.0f %12.0f %12.0f\n",
+                threads, printf_ns, printf_rate, async_ns, async_rate);
+
+        if (threads == max_threads) {
+            break;
+        }
+    }
+
+    log_get_stats(&stats);
+    fprintf(console, "\nasync: %llu written, %llu dropped (ring full), %llu suppressed\n",
+            stats.written, stats.dropped, stats.suppressed);
+    return 0;
+}
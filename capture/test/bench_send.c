@@ -0,0 +1,201 @@
+/**
+ * 数据发送路径开销基准测试
+ *
+ * 在一条已建立的本机 TCP 连接上循环调用 send()，分别在以下三种情况下测量
+ * 每次发送的平均耗时：
+ *   none    - 未加载任何 eBPF 程序（基线）
+ *   fentry  - fentry/fexit tcp_v4_connect + fentry tcp_sendmsg（每次发送都会读取 socket 本地存储）
+ *   sockops - cgroup sockops，仅在连接建立时触发
+ *
+ * 需要 root 权限，并在 capture/ 目录下运行：
+ *   make bench
+ *   sudo ./test/bench_send --sends 2000000 --size 64
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "capture.h"
+#include "bpf_loader.h"
+
+#define BENCH_CGROUP_PATH "/sys/fs/cgroup"
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * 接收端：读空所有数据直到对端关闭
+ */
+static void *drain_thread(void *arg) {
+    int fd = *(int *)arg;
+    char buf[65536];
+
+    while (recv(fd, buf, sizeof(buf), 0) > 0) {
+        ;
+    }
+    return NULL;
+}
+
+/**
+ * 建立一条本机 TCP 连接
+ */
+static int make_pair(int *client_fd, int *server_fd) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int one = 1;
+    int lfd;
+
+    lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (lfd < 0) {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(lfd, 1) < 0 ||
+        getsockname(lfd, (struct sockaddr *)&addr, &len) < 0) {
+        close(lfd);
+        return -1;
+    }
+
+    *client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (*client_fd < 0 ||
+        connect(*client_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(lfd);
+        return -1;
+    }
+    setsockopt(*client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    *server_fd = accept(lfd, NULL, NULL);
+    close(lfd);
+    return *server_fd < 0 ? -1 : 0;
+}
+
+/**
+ * 测量 sends 次发送的平均耗时（纳秒）
+ */
+static double measure_send(long sends, size_t size) {
+    int client_fd, server_fd;
+    pthread_t drainer;
+    char *buf;
+    __u64 start, end;
+
+    if (make_pair(&client_fd, &server_fd) < 0) {
+        perror("make_pair");
+        return -1.0;
+    }
+
+    buf = calloc(1, size);
+    pthread_create(&drainer, NULL, drain_thread, &server_fd);
+
+    /* 预热 */
+    for (long i = 0; i < sends / 10; i++) {
+        send(client_fd, buf, size, 0);
+    }
+
+    start = now_ns();
+    for (long i = 0; i < sends; i++) {
+        send(client_fd, buf, size, 0);
+    }
+    end = now_ns();
+
+    shutdown(client_fd, SHUT_WR);
+    pthread_join(drainer, NULL);
+    close(client_fd);
+    close(server_fd);
+    free(buf);
+
+    return (double)(end - start) / sends;
+}
+
+/**
+ * 以指定检测方式加载 eBPF 程序后测量
+ */
+static double measure_with_hook(enum capture_hook hook, long sends, size_t size) {
+    struct capture_config config;
+    struct bpf_loader loader;
+    double ns;
+
+    memset(&config, 0, sizeof(config));
+    config.transport = EVENT_TRANSPORT_AUTO;
+    config.ringbuf_wakeup_batch = 1;
+    config.hook = hook;
+    strncpy(config.cgroup_path, BENCH_CGROUP_PATH, sizeof(config.cgroup_path) - 1);
+
+    if (bpf_loader_open(&loader, &config) < 0) {
+        return -1.0;
+    }
+    if (bpf_loader_attach(&loader) <= 0) {
+        bpf_loader_close(&loader);
+        return -1.0;
+    }
+
+    ns = measure_send(sends, size);
+    bpf_loader_close(&loader);
+    return ns;
+}
+
+int main(int argc, char **argv) {
+    static struct option long_options[] = {
+        {"sends", required_argument, 0, 'n'},
+        {"size", required_argument, 0, 's'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    long sends = 1000000;
+    size_t size = 64;
+    double base, fentry, sockops;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "n:s:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'n':
+                sends = atol(optarg);
+                break;
+            case 's':
+                size = (size_t)atol(optarg);
+                break;
+            default:
+                printf("Usage: %s [--sends N] [--size BYTES]\n", argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (sends <= 0 || size == 0) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    printf("=== Per-Send Overhead Benchmark (%ld sends x %zu bytes) ===\n\n", sends, size);
+
+    base = measure_send(sends, size);
+    fentry = measure_with_hook(CAPTURE_HOOK_FENTRY, sends, size);
+    sockops = measure_with_hook(CAPTURE_HOOK_SOCKOPS, sends, size);
+
+    printf("%-10s %12s %12s\n", "hook", "ns/send", "overhead");
+    printf("%-10s %12.1f %12s\n", "none", base, "-");
+    if (fentry > 0) {
+        printf("%-10s %12.1f %+11.1f\n", "fentry", fentry, fentry - base);
+    } else {
+        printf("%-10s %12s\n", "fentry", "failed");
+    }
+    if (sockops > 0) {
+        printf("%-10s %12.1f %+11.1f\n", "sockops", sockops, sockops - base);
+    } else {
+        printf("%-10s %12s\n", "sockops", "failed");
+    }
+
+    return 0;
+}
@@ -0,0 +1,190 @@
+/**
+ * 并发密钥请求合并基准测试
+ *
+ * 模拟同一批 Pod 之间突发大量连接：--workers 个工作线程循环为随机的 Pod 对请求密钥，
+ * 每次协商耗时 --latency 微秒（等待 TLSHub 往返），Pod 对数由 --pairs 指定。对比：
+ *   off    - 每个请求各自协商（原有方式）
+ *   merged - singleflight：同一 Pod 对进行中的协商只执行一次，其余请求等待并复用结果
+ * 统计请求速率、实际协商次数、去重比例和平均请求延迟。
+ *
+ * 不需要 root 权限，在 capture/ 目录下运行：
+ *   make bench
+ *   ./test/bench_singleflight --workers 16 --pairs 4 --latency 500
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include "capture.h"
+#include "singleflight.h"
+
+static volatile int stop_flag = 0;
+static int negotiation_us = 500;
+static int pairs = 4;
+static struct singleflight *group = NULL;
+static __u64 negotiations = 0;
+
+/* 单个工作线程的状态 */
+struct worker {
+    pthread_t thread;
+    unsigned int seed;
+    __u64 requests;
+    __u64 latency_ns;
+};
+
+/* 请求的 Pod 对 */
+struct pod_pair {
+    __u32 client;
+    __u32 server;
+};
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * 模拟一次 TLSHub 协商
+ */
+static int negotiate(void *arg, void *result) {
+    struct tls_key_info *key = result;
+
+    (void)arg;
+    __atomic_fetch_add(&negotiations, 1, __ATOMIC_RELAXED);
+    usleep(negotiation_us);
+    memset(key, 0xab, sizeof(*key));
+    key->key_len = 32;
+    key->iv_len = 12;
+    return 0;
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    struct tls_key_info key;
+
+    while (!stop_flag) {
+        struct pod_pair pair = { 0 };
+        __u64 t0 = now_ns();
+
+        pair.client = 0x0af40100 + rand_r(&w->seed) % pairs;
+        pair.server = 0x0af40200;
+        if (group) {
+            singleflight_do(group, &pair, sizeof(pair), negotiate, NULL, &key, NULL);
+        } else {
+            negotiate(NULL, &key);
+        }
+        w->latency_ns += now_ns() - t0;
+        w->requests++;
+    }
+    return NULL;
+}
+
+/**
+ * 以 workers 个线程运行一轮，merged 为 1 时经过 singleflight
+ */
+static int run_round(int workers, int merged, int duration) {
+    struct worker *threads;
+    __u64 requests = 0, latency_ns = 0, start;
+    double elapsed;
+
+    threads = calloc(workers, sizeof(*threads));
+    if (!threads) {
+        return -1;
+    }
+    if (merged) {
+        group = singleflight_new(sizeof(struct tls_key_info));
+        if (!group) {
+            free(threads);
+            return -1;
+        }
+    }
+
+    negotiations = 0;
+    stop_flag = 0;
+    start = now_ns();
+    for (int i = 0; i < workers; i++) {
+        threads[i].seed = i + 1;
+        pthread_create(&threads[i].thread, NULL, worker_main, &threads[i]);
+    }
+    sleep(duration);
+    stop_flag = 1;
+    for (int i = 0; i < workers; i++) {
+        pthread_join(threads[i].thread, NULL);
+        requests += threads[i].requests;
+        latency_ns += threads[i].latency_ns;
+    }
+    elapsed = (now_ns() - start) / 1e9;
+
+    printf("%-8s %12.0f %14llu %10.2f%% %12.3f\n",
+           merged ? "merged" : "off",
+           requests / elapsed,
+           negotiations,
+           requests ? (double)(requests - negotiations) * 100.0 / requests : 0.0,
+           requests ? latency_ns / 1e6 / requests : 0.0);
+
+    singleflight_free(group);
+    group = NULL;
+    free(threads);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("  -w, --workers N       concurrent requesting threads (default: 16)\n");
+    printf("  -p, --pairs N         distinct pod pairs (default: 4)\n");
+    printf("  -l, --latency US      simulated negotiation time in microseconds (default: 500)\n");
+    printf("  -d, --duration S      seconds per round (default: 3)\n");
+}
+
+int main(int argc, char **argv) {
+    static struct option long_options[] = {
+        {"workers", required_argument, 0, 'w'},
+        {"pairs", required_argument, 0, 'p'},
+        {"latency", required_argument, 0, 'l'},
+        {"duration", required_argument, 0, 'd'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int workers = 16;
+    int duration = 3;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "w:p:l:d:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'w':
+                workers = atoi(optarg);
+                break;
+            case 'p':
+                pairs = atoi(optarg);
+                break;
+            case 'l':
+                negotiation_us = atoi(optarg);
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (workers <= 0 || pairs <= 0 || negotiation_us < 0 || duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("=== Key Request Coalescing Benchmark (%d workers, %d pod pairs, %d us per negotiation, %ds per round) ===\n\n",
+           workers, pairs, negotiation_us, duration);
+    printf("%-8s %12s %14s %11s %12s\n", "mode", "requests/s", "negotiations", "dedup", "latency ms");
+
+    if (run_round(workers, 0, duration) < 0 || run_round(workers, 1, duration) < 0) {
+        fprintf(stderr, "benchmark round failed\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,249 @@
+/**
+ * TLSHub 批量请求基准测试
+ *
+ * --threads 个线程经同一个流水线 socket 循环请求密钥（每 --handshake-every 次先发起一次握手，
+ * 模拟未命中时的 handshake + fetch），对端为本地替身（tlshub_standin.c）：
+ * 每条消息串行处理 --message-cost 微秒、每个请求项再加 --entry-cost 微秒，之后经过 --latency 微秒回复。
+ * 批量大小从 1（不合并，每个请求一条消息）倍增到 --max-batch，
+ * 统计请求速率、平均延迟、替身收到的消息数和每条消息平均携带的请求数。
+ *
+ * 不需要 root 权限，在 capture/ 目录下运行：
+ *   make bench
+ *   ./test/bench_tlshub_batch --threads 64 --max-batch 32 --delay 100
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "capture.h"
+#include "log.h"
+#include "tlshub_client.h"
+#include "tlshub_proto.h"
+#include "tlshub_standin.h"
+
+static volatile int stop_flag = 0;
+static int handshake_every = 8;
+static struct tlshub_standin_config standin_cfg = {
+    .latency_us = 200,
+    .message_cost_us = 10,
+    .entry_cost_us = 1,
+    .log_every = 16,
+};
+
+/* 单个请求线程的状态 */
+struct worker {
+    pthread_t thread;
+    __u32 index;
+    __u64 requests;
+    __u64 failures;
+    __u64 latency_ns;
+};
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    struct tls_key_info key;
+    struct flow_tuple tuple;
+    __u64 iteration = 0;
+
+    memset(&tuple, 0, sizeof(tuple));
+    tuple.family = AF_INET;
+    tuple.saddr = 0x0af40100 + w->index;
+    tuple.daddr = 0x0af40201;
+    tuple.dport = 443;
+
+    while (!stop_flag) {
+        __u64 t0 = now_ns();
+
+        tuple.sport = (__u16)(32768 + iteration % 28000);
+        if (handshake_every > 0 && iteration++ % handshake_every == 0) {
+            if (tlshub_handshake(&tuple) < 0) {
+                w->failures++;
+                continue;
+            }
+            w->requests++;
+        }
+        if (tlshub_fetch_key(&tuple, &key) < 0) {
+            w->failures++;
+            continue;
+        }
+        if (memcmp(key.key, &tuple.saddr, sizeof(tuple.saddr)) != 0 ||
+            memcmp(key.key + 4, &tuple.daddr, sizeof(tuple.daddr)) != 0) {
+            fprintf(stderr, "worker %u: received a key for another request\n", w->index);
+            w->failures++;
+        }
+        w->requests++;
+        w->latency_ns += now_ns() - t0;
+    }
+    return NULL;
+}
+
+/**
+ * 以 batch 项为上限运行一轮，batch 为 1 时不合并
+ */
+static int run_round(int threads, __u32 batch, __u32 delay_us, int duration) {
+    struct tlshub_standin_stats standin_stats;
+    struct tlshub_batch_stats batch_stats;
+    struct tlshub_standin *standin;
+    struct worker *workers;
+    __u64 requests = 0, failures = 0, latency_ns = 0, start;
+    double elapsed;
+    int sv[2];
+
+    workers = calloc(threads, sizeof(*workers));
+    if (!workers) {
+        return -1;
+    }
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+        perror("socketpair");
+        free(workers);
+        return -1;
+    }
+    if (tlshub_client_attach_pipeline(sv[0], threads) < 0 ||
+        (batch > 1 && tlshub_client_enable_batching(batch, delay_us) < 0)) {
+        tlshub_client_cleanup();
+        close(sv[1]);
+        free(workers);
+        return -1;
+    }
+    standin = tlshub_standin_start(sv[1], &standin_cfg);
+    if (!standin) {
+        tlshub_client_cleanup();
+        close(sv[1]);
+        free(workers);
+        return -1;
+    }
+
+    stop_flag = 0;
+    start = now_ns();
+    for (int i = 0; i < threads; i++) {
+        workers[i].index = i;
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+    sleep(duration);
+    stop_flag = 1;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        requests += workers[i].requests;
+        failures += workers[i].failures;
+        latency_ns += workers[i].latency_ns;
+    }
+    elapsed = (now_ns() - start) / 1e9;
+
+    tlshub_client_get_batch_stats(&batch_stats);
+    tlshub_standin_get_stats(standin, &standin_stats);
+    printf("%6u %12.0f %12.3f %12.0f %10.2f %10.1f%% %9llu\n",
+           batch,
+           requests / elapsed,
+           requests ? latency_ns / 1e6 / requests : 0.0,
+           standin_stats.messages / elapsed,
+           standin_stats.messages ? (double)standin_stats.entries / standin_stats.messages : 0.0,
+           batch_stats.batches ? batch_stats.deadline_flushes * 100.0 / batch_stats.batches : 0.0,
+           failures);
+
+    tlshub_client_cleanup();
+    tlshub_standin_stop(standin);
+    free(workers);
+    return failures ? -1 : 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("  -t, --threads N          concurrent requesting threads (default: 64)\n");
+    printf("  -b, --max-batch N        largest batch size to test (default: 32)\n");
+    printf("  -w, --delay US           how long a batch waits for more requests (default: 100)\n");
+    printf("  -l, --latency US         stand-in round-trip latency (default: 200)\n");
+    printf("  -c, --message-cost US    stand-in serial cost per message (default: 10)\n");
+    printf("  -e, --entry-cost US      stand-in serial cost per request in a message (default: 1)\n");
+    printf("  -s, --handshake-every N  start a handshake before every Nth fetch, 0 to disable (default: 8)\n");
+    printf("  -d, --duration S         seconds per round (default: 2)\n");
+}
+
+int main(int argc, char **argv) {
+    static struct option long_options[] = {
+        {"threads", required_argument, 0, 't'},
+        {"max-batch", required_argument, 0, 'b'},
+        {"delay", required_argument, 0, 'w'},
+        {"latency", required_argument, 0, 'l'},
+        {"message-cost", required_argument, 0, 'c'},
+        {"entry-cost", required_argument, 0, 'e'},
+        {"handshake-every", required_argument, 0, 's'},
+        {"duration", required_argument, 0, 'd'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    struct log_config log_cfg = { .level = LOG_LEVEL_WARN };
+    int threads = 64;
+    int max_batch = 32;
+    int delay_us = 100;
+    int duration = 2;
+    int ret = 0;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "t:b:w:l:c:e:s:d:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'b':
+                max_batch = atoi(optarg);
+                break;
+            case 'w':
+                delay_us = atoi(optarg);
+                break;
+            case 'l':
+                standin_cfg.latency_us = (__u32)atoi(optarg);
+                break;
+            case 'c':
+                standin_cfg.message_cost_us = (__u32)atoi(optarg);
+                break;
+            case 'e':
+                standin_cfg.entry_cost_us = (__u32)atoi(optarg);
+                break;
+            case 's':
+                handshake_every = atoi(optarg);
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (threads <= 0 || threads > TLSHUB_PIPELINE_MAX_DEPTH || max_batch <= 0 ||
+        max_batch > TLSHUB_BATCH_MAX || delay_us < 0 || handshake_every < 0 || duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    /* 日志消息按 debug 级别输出，这里只保留告警 */
+    log_init(&log_cfg);
+
+    printf("=== TLSHub Batch Benchmark (%d threads, stand-in %u us + %u us/msg + %u us/entry, %d us batch delay, %ds per round) ===\n\n",
+           threads, standin_cfg.latency_us, standin_cfg.message_cost_us,
+           standin_cfg.entry_cost_us, delay_us, duration);
+    printf("%6s %12s %12s %12s %10s %11s %9s\n",
+           "batch", "requests/s", "latency ms", "messages/s", "per msg", "deadline", "failures");
+
+    for (int batch = 1; batch <= max_batch; batch *= 2) {
+        if (run_round(threads, batch, delay_us, duration) < 0) {
+            fprintf(stderr, "benchmark round failed at batch size %d\n", batch);
+            ret = 1;
+            break;
+        }
+    }
+
+    log_shutdown();
+    return ret;
+}
@@ -0,0 +1,211 @@
+/**
+ * TLSHub 单 socket 流水线基准测试
+ *
+ * 本地替身（tlshub_standin.c）通过 socketpair 代替 TLSHub 内核模块：收到的每个 fetch 请求
+ * 在 --latency 微秒后按 nlmsg_seq 回复（请求之间互不阻塞，可以同时有任意多个在途），
+ * 每 --log-every 个请求先插入一条带相同 seq 的日志消息，模拟握手过程中推送的日志。
+ * 对深度 1、2、4 ... --max-depth 各运行一轮：在一个 socket 上以 depth 个线程循环调用
+ * tlshub_fetch_key，统计每个 socket 的 fetch 速率、平均延迟以及日志/无主响应数。
+ * 深度 1 相当于原有的“一个 socket 一次一个请求”。
+ *
+ * 不需要 root 权限，在 capture/ 目录下运行：
+ *   make bench
+ *   ./test/bench_tlshub_pipeline --latency 200 --max-depth 64
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "capture.h"
+#include "log.h"
+#include "tlshub_client.h"
+#include "tlshub_standin.h"
+
+static volatile int stop_flag = 0;
+static struct tlshub_standin_config standin_cfg = {
+    .latency_us = 200,
+    .log_every = 16,
+};
+
+/* 单个请求线程的状态 */
+struct worker {
+    pthread_t thread;
+    __u32 index;
+    __u64 fetches;
+    __u64 failures;
+    __u64 latency_ns;
+};
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    struct tls_key_info key;
+    struct flow_tuple tuple;
+
+    memset(&tuple, 0, sizeof(tuple));
+    tuple.family = AF_INET;
+    tuple.saddr = 0x0af40100 + w->index;
+    tuple.daddr = 0x0af40201;
+    tuple.dport = 443;
+
+    while (!stop_flag) {
+        __u64 t0 = now_ns();
+
+        tuple.sport = (__u16)(32768 + w->fetches % 28000);
+        if (tlshub_fetch_key(&tuple, &key) < 0) {
+            w->failures++;
+            continue;
+        }
+        if (memcmp(key.key, &tuple.saddr, sizeof(tuple.saddr)) != 0) {
+            fprintf(stderr, "worker %u: received a key for another request\n", w->index);
+            w->failures++;
+        }
+        w->latency_ns += now_ns() - t0;
+        w->fetches++;
+    }
+    return NULL;
+}
+
+/**
+ * 以 depth 个并发请求运行一轮
+ */
+static int run_round(__u32 depth, int duration) {
+    struct tlshub_pipeline_stats stats;
+    struct worker *threads;
+    struct tlshub_standin *standin;
+    __u64 fetches = 0, failures = 0, latency_ns = 0, start;
+    double elapsed;
+    int sv[2];
+
+    threads = calloc(depth, sizeof(*threads));
+    if (!threads) {
+        return -1;
+    }
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+        perror("socketpair");
+        free(threads);
+        return -1;
+    }
+    if (tlshub_client_attach_pipeline(sv[0], depth) < 0) {
+        close(sv[0]);
+        close(sv[1]);
+        free(threads);
+        return -1;
+    }
+    standin = tlshub_standin_start(sv[1], &standin_cfg);
+    if (!standin) {
+        tlshub_client_cleanup();
+        close(sv[1]);
+        free(threads);
+        return -1;
+    }
+
+    stop_flag = 0;
+    start = now_ns();
+    for (__u32 i = 0; i < depth; i++) {
+        threads[i].index = i;
+        pthread_create(&threads[i].thread, NULL, worker_main, &threads[i]);
+    }
+    sleep(duration);
+    stop_flag = 1;
+    for (__u32 i = 0; i < depth; i++) {
+        pthread_join(threads[i].thread, NULL);
+        fetches += threads[i].fetches;
+        failures += threads[i].failures;
+        latency_ns += threads[i].latency_ns;
+    }
+    elapsed = (now_ns() - start) / 1e9;
+
+    tlshub_client_get_pipeline_stats(&stats);
+    printf("%6u %12.0f %12.3f %10llu %8llu %8llu %9llu\n",
+           depth,
+           fetches / elapsed,
+           fetches ? latency_ns / 1e6 / fetches : 0.0,
+           stats.max_outstanding,
+           stats.logs,
+           stats.orphans,
+           failures);
+
+    tlshub_client_cleanup();
+    tlshub_standin_stop(standin);
+    free(threads);
+    return failures || stats.orphans ? -1 : 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("  -l, --latency US      stand-in reply latency in microseconds (default: 200)\n");
+    printf("  -m, --max-depth N     largest pipeline depth to test (default: 64)\n");
+    printf("  -g, --log-every N     send a log message before every Nth reply, 0 to disable (default: 16)\n");
+    printf("  -d, --duration S      seconds per round (default: 2)\n");
+}
+
+int main(int argc, char **argv) {
+    static struct option long_options[] = {
+        {"latency", required_argument, 0, 'l'},
+        {"max-depth", required_argument, 0, 'm'},
+        {"log-every", required_argument, 0, 'g'},
+        {"duration", required_argument, 0, 'd'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int max_depth = 64;
+    int duration = 2;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "l:m:g:d:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'l':
+                standin_cfg.latency_us = (__u32)atoi(optarg);
+                break;
+            case 'm':
+                max_depth = atoi(optarg);
+                break;
+            case 'g':
+                standin_cfg.log_every = (__u32)atoi(optarg);
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (max_depth <= 0 || max_depth > TLSHUB_PIPELINE_MAX_DEPTH || duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct log_config log_cfg = { .level = LOG_LEVEL_WARN };
+    int ret = 0;
+
+    /* 日志消息按 debug 级别输出，这里只保留告警 */
+    log_init(&log_cfg);
+
+    printf("=== TLSHub Pipeline Benchmark (%u us stand-in latency, %ds per round) ===\n\n",
+           standin_cfg.latency_us, duration);
+    printf("%6s %12s %12s %10s %8s %8s %9s\n",
+           "depth", "fetches/s", "latency ms", "max inflt", "logs", "orphans", "failures");
+
+    for (int depth = 1; depth <= max_depth; depth *= 2) {
+        if (run_round(depth, duration) < 0) {
+            fprintf(stderr, "benchmark round failed at depth %d\n", depth);
+            ret = 1;
+            break;
+        }
+    }
+
+    log_shutdown();
+    return ret;
+}
@@ -0,0 +1,365 @@
+/**
+ * TLSHub 传输层端到端基准测试
+ *
+ * 经过完整的用户态密钥路径：key_provider（MODE_TLSHUB，按 Pod 对合并）-> tlshub_client
+ * -> 传输 -> 本地替身（tlshub_standin.c）。替身按真实模块的语义应答：
+ * fetch 未握手返回 -1，握手后才能取到密钥，按 --expire 比例返回 -2（之后需重新握手），
+ * 按 --fail 比例握手失败，握手耗时按 --dist 分布抽样，握手结果前插入日志消息。
+ * --hang 比例的请求不回复，客户端按 --timeout 超时、按 --retries 重试。
+ * --threads 个线程在 --pairs 个 Pod 对中随机取密钥，依次测试 mock（进程内 socketpair）
+ * 和 unix（Unix 域 socket）两种传输，统计请求速率、延迟分位数以及替身侧的握手/过期/失败数。
+ *
+ * 不需要 root 权限和 TLSHub 内核模块，在 capture/ 目录下运行：
+ *   make bench
+ *   ./test/bench_tlshub_transport --threads 32 --pairs 256 --handshake 2000 --dist exponential
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "capture.h"
+#include "key_provider.h"
+#include "latency_hist.h"
+#include "log.h"
+#include "tlshub_client.h"
+#include "tlshub_standin.h"
+
+static volatile int stop_flag = 0;
+static __u32 pairs = 256;
+static struct tlshub_standin_config standin_cfg = {
+    .latency_us = 50,
+    .handshake_us = 2000,
+    .handshake_dist = LATENCY_DIST_EXPONENTIAL,
+    .log_every = 16,
+    .expire_percent = 1,
+    .fail_percent = 0,
+    .require_handshake = 1,
+};
+static struct tlshub_retry_policy retry_policy = {
+    .timeout_ms = TLSHUB_DEFAULT_TIMEOUT_MS,
+    .retries = TLSHUB_DEFAULT_RETRIES,
+    .backoff_ms = TLSHUB_DEFAULT_BACKOFF_MS,
+    .backoff_max_ms = TLSHUB_DEFAULT_BACKOFF_MAX_MS,
+};
+
+/* 单个请求线程的状态 */
+struct worker {
+    pthread_t thread;
+    __u32 index;
+    __u64 requests;
+    __u64 failures;
+    __u64 wrong_keys;
+    struct latency_hist hist;
+};
+
+static __u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    struct tls_key_info key;
+    struct flow_tuple tuple;
+    unsigned int seed = w->index + 1;
+    __u64 iteration = 0;
+
+    memset(&tuple, 0, sizeof(tuple));
+    tuple.family = AF_INET;
+    tuple.role = FLOW_ROLE_CLIENT;
+    tuple.dport = 443;
+
+    while (!stop_flag) {
+        __u32 pair = (__u32)rand_r(&seed) % pairs;
+        __u64 t0 = now_ns();
+
+        tuple.saddr = 0x0af40100 + pair;
+        tuple.daddr = 0x0af50100 + pair % 16;
+        tuple.sport = (__u16)(32768 + iteration++ % 28000);
+        if (key_provider_get_key(&tuple, &key) < 0) {
+            w->failures++;
+            continue;
+        }
+        latency_hist_record(&w->hist, now_ns() - t0);
+        if (memcmp(key.key, &tuple.saddr, sizeof(tuple.saddr)) != 0 ||
+            memcmp(key.key + 4, &tuple.daddr, sizeof(tuple.daddr)) != 0) {
+            w->wrong_keys++;
+        }
+        w->requests++;
+    }
+
+    key_provider_thread_cleanup();
+    return NULL;
+}
+
+/**
+ * 在一种传输上运行一轮，结果写入 row（初始化过程会打印信息，结果最后统一输出）
+ */
+static int run_round(enum tlshub_transport transport, int threads, int duration,
+                     char *row, size_t row_size) {
+    struct tlshub_standin_stats standin_stats;
+    struct key_provider_stats kp_before, kp_stats;
+    struct tlshub_standin *standin = NULL;
+    struct latency_hist *total;
+    struct worker *workers;
+    __u64 requests = 0, failures = 0, wrong_keys = 0, start;
+    char path[108];
+    double elapsed;
+    int ret = 0;
+
+    workers = calloc(threads, sizeof(*workers));
+    total = calloc(1, sizeof(*total));
+    if (!workers || !total) {
+        free(workers);
+        free(total);
+        return -1;
+    }
+
+    if (transport == TLSHUB_TRANSPORT_UNIX) {
+        /* 替身在 Unix 域 socket 上监听，客户端按路径连接 */
+        snprintf(path, sizeof(path), "/tmp/bench_tlshub_%d.sock", getpid());
+        standin = tlshub_standin_new(&standin_cfg);
+        if (!standin || tlshub_standin_listen(standin, path) < 0) {
+            tlshub_standin_stop(standin);
+            free(workers);
+            free(total);
+            return -1;
+        }
+        key_provider_set_tlshub_transport(TLSHUB_TRANSPORT_UNIX, path, NULL);
+    } else {
+        key_provider_set_tlshub_transport(TLSHUB_TRANSPORT_MOCK, NULL, &standin_cfg);
+    }
+
+    /* 密钥提供者的统计跨轮累计，取差值 */
+    key_provider_get_stats(&kp_before);
+    if (key_provider_init(MODE_TLSHUB) < 0) {
+        tlshub_standin_stop(standin);
+        free(workers);
+        free(total);
+        return -1;
+    }
+
+    stop_flag = 0;
+    start = now_ns();
+    for (int i = 0; i < threads; i++) {
+        workers[i].index = i;
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+    sleep(duration);
+    stop_flag = 1;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        requests += workers[i].requests;
+        failures += workers[i].failures;
+        wrong_keys += workers[i].wrong_keys;
+        for (__u32 b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+            total->buckets[b] += workers[i].hist.buckets[b];
+        }
+        total->count += workers[i].hist.count;
+        total->sum_ns += workers[i].hist.sum_ns;
+        if (workers[i].hist.max_ns > total->max_ns) {
+            total->max_ns = workers[i].hist.max_ns;
+        }
+    }
+    elapsed = (now_ns() - start) / 1e9;
+
+    key_provider_get_stats(&kp_stats);
+    memset(&standin_stats, 0, sizeof(standin_stats));
+    if (standin) {
+        tlshub_standin_get_stats(standin, &standin_stats);
+    } else {
+        tlshub_client_get_mock_stats(&standin_stats);
+    }
+    snprintf(row, row_size, "%-9s %11.0f %9.3f %9.3f %9.3f %9.3f %10llu %10llu %8llu %8llu %8llu %8llu %8llu %9llu\n",
+           transport == TLSHUB_TRANSPORT_UNIX ? "unix" : "mock",
+           requests / elapsed,
+           latency_hist_quantile(total, 0.50) / 1e6,
+           latency_hist_quantile(total, 0.99) / 1e6,
+           latency_hist_quantile(total, 0.999) / 1e6,
+           total->max_ns / 1e6,
+           kp_stats.negotiations - kp_before.negotiations,
+           standin_stats.handshakes,
+           standin_stats.handshake_failures,
+           standin_stats.expired,
+           standin_stats.logs,
+           kp_stats.tlshub.timeouts - kp_before.tlshub.timeouts,
+           kp_stats.tlshub.retries - kp_before.tlshub.retries,
+           failures);
+
+    if (wrong_keys > 0) {
+        fprintf(stderr, "%llu requests received a key for another pod pair\n", wrong_keys);
+        ret = -1;
+    }
+    /* 未注入过期、握手失败和不回复时每个请求都应取到密钥（握手后重取仍可能遇到过期） */
+    if (standin_cfg.fail_percent == 0 && standin_cfg.expire_percent == 0 &&
+        standin_cfg.hang_percent == 0 && failures > 0) {
+        ret = -1;
+    }
+
+    key_provider_cleanup();
+    tlshub_standin_stop(standin);
+    free(workers);
+    free(total);
+    return ret;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("  -t, --threads N          concurrent requesting threads (default: 32)\n");
+    printf("  -p, --pairs N            distinct pod pairs to request keys for (default: 256)\n");
+    printf("  -T, --transport NAME     mock, unix or all (default: all)\n");
+    printf("  -s, --handshake US       mean handshake latency (default: 2000)\n");
+    printf("  -D, --dist NAME          handshake latency distribution: fixed, uniform, exponential (default: exponential)\n");
+    printf("  -S, --spread US          half width of the uniform distribution (default: 0)\n");
+    printf("  -f, --fetch US           fetch round-trip latency (default: 50)\n");
+    printf("  -x, --expire PCT         percent of fetches answered as expired (default: 1)\n");
+    printf("  -F, --fail PCT           percent of handshakes that fail (default: 0)\n");
+    printf("  -H, --hang PCT           percent of fetches/handshakes never answered (default: 0)\n");
+    printf("  -o, --timeout MS         per-request deadline, 0 for none (default: %d)\n", TLSHUB_DEFAULT_TIMEOUT_MS);
+    printf("  -r, --retries N          retries after a timeout or I/O error (default: %d)\n", TLSHUB_DEFAULT_RETRIES);
+    printf("  -P, --pipeline N         share one socket with N requests in flight, 0 for per-thread sockets (default: 0)\n");
+    printf("  -b, --batch N            batch up to N requests per message, 0 to disable (default: 0)\n");
+    printf("  -d, --duration S         seconds per round (default: 2)\n");
+}
+
+int main(int argc, char **argv) {
+    static struct option long_options[] = {
+        {"threads", required_argument, 0, 't'},
+        {"pairs", required_argument, 0, 'p'},
+        {"transport", required_argument, 0, 'T'},
+        {"handshake", required_argument, 0, 's'},
+        {"dist", required_argument, 0, 'D'},
+        {"spread", required_argument, 0, 'S'},
+        {"fetch", required_argument, 0, 'f'},
+        {"expire", required_argument, 0, 'x'},
+        {"fail", required_argument, 0, 'F'},
+        {"hang", required_argument, 0, 'H'},
+        {"timeout", required_argument, 0, 'o'},
+        {"retries", required_argument, 0, 'r'},
+        {"pipeline", required_argument, 0, 'P'},
+        {"batch", required_argument, 0, 'b'},
+        {"duration", required_argument, 0, 'd'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    struct log_config log_cfg = { .level = LOG_LEVEL_ERROR };
+    const char *transport = "all";
+    const char *dist = "exponential";
+    char rows[2][320] = { "", "" };
+    int threads = 32;
+    int pipeline_depth = 0;
+    int batch = 0;
+    int duration = 2;
+    int ret = 0;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "t:p:T:s:D:S:f:x:F:H:o:r:P:b:d:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'p':
+                pairs = (__u32)atoi(optarg);
+                break;
+            case 'T':
+                transport = optarg;
+                break;
+            case 's':
+                standin_cfg.handshake_us = (__u32)atoi(optarg);
+                break;
+            case 'D':
+                dist = optarg;
+                break;
+            case 'S':
+                standin_cfg.handshake_spread_us = (__u32)atoi(optarg);
+                break;
+            case 'f':
+                standin_cfg.latency_us = (__u32)atoi(optarg);
+                break;
+            case 'x':
+                standin_cfg.expire_percent = (__u32)atoi(optarg);
+                break;
+            case 'F':
+                standin_cfg.fail_percent = (__u32)atoi(optarg);
+                break;
+            case 'H':
+                standin_cfg.hang_percent = (__u32)atoi(optarg);
+                break;
+            case 'o':
+                retry_policy.timeout_ms = (__u32)atoi(optarg);
+                break;
+            case 'r':
+                retry_policy.retries = (__u32)atoi(optarg);
+                break;
+            case 'P':
+                pipeline_depth = atoi(optarg);
+                break;
+            case 'b':
+                batch = atoi(optarg);
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (strcmp(dist, "fixed") == 0) {
+        standin_cfg.handshake_dist = LATENCY_DIST_FIXED;
+    } else if (strcmp(dist, "uniform") == 0) {
+        standin_cfg.handshake_dist = LATENCY_DIST_UNIFORM;
+    } else if (strcmp(dist, "exponential") == 0) {
+        standin_cfg.handshake_dist = LATENCY_DIST_EXPONENTIAL;
+    } else {
+        usage(argv[0]);
+        return 1;
+    }
+    /* mock 传输每个线程一条连接，替身最多服务 256 条 */
+    if (threads <= 0 || threads > 200 || pairs == 0 || duration <= 0 ||
+        standin_cfg.expire_percent > 100 || standin_cfg.fail_percent > 100 ||
+        standin_cfg.hang_percent > 100 ||
+        pipeline_depth < 0 || pipeline_depth > TLSHUB_PIPELINE_MAX_DEPTH || batch < 0 ||
+        (strcmp(transport, "mock") != 0 && strcmp(transport, "unix") != 0 &&
+         strcmp(transport, "all") != 0)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    /* 握手失败和日志消息按 warn/info 输出，这里只保留错误 */
+    log_init(&log_cfg);
+    key_provider_set_pipeline_depth(pipeline_depth);
+    key_provider_set_batching(batch, 100);
+    key_provider_set_tlshub_retry(&retry_policy);
+
+    if (strcmp(transport, "unix") != 0 &&
+        run_round(TLSHUB_TRANSPORT_MOCK, threads, duration, rows[0], sizeof(rows[0])) < 0) {
+        fprintf(stderr, "benchmark round failed on the mock transport\n");
+        ret = 1;
+    }
+    if (strcmp(transport, "mock") != 0 &&
+        run_round(TLSHUB_TRANSPORT_UNIX, threads, duration, rows[1], sizeof(rows[1])) < 0) {
+        fprintf(stderr, "benchmark round failed on the unix transport\n");
+        ret = 1;
+    }
+
+    printf("\n=== TLSHub Transport Benchmark (%d threads, %u pod pairs, handshake %u us %s, fetch %u us, "
+           "%u%% expired, %u%% failed, %u%% hung, timeout %u ms, %u retries, %ds per round) ===\n\n",
+           threads, pairs, standin_cfg.handshake_us, dist, standin_cfg.latency_us,
+           standin_cfg.expire_percent, standin_cfg.fail_percent, standin_cfg.hang_percent,
+           retry_policy.timeout_ms, retry_policy.retries, duration);
+    printf("%-9s %11s %9s %9s %9s %9s %10s %10s %8s %8s %8s %8s %8s %9s\n",
+           "transport", "requests/s", "p50 ms", "p99 ms", "p99.9 ms", "max ms",
+           "negotiate", "handshakes", "hs fail", "expired", "logs", "timeouts", "retries", "failures");
+    printf("%s%s", rows[0], rows[1]);
+
+    log_shutdown();
+    return ret;
+}
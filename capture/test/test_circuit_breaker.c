@@ -0,0 +1,247 @@
+/*
+ * 熔断器状态转换确定性检查
+ * 请求结果和耗时由测试直接交给 circuit_breaker_record，后台探测的结果由测试逐个放行，
+ * 检查 closed → open（min_requests 和失败率/慢调用率阈值）、open → half-open（探测成功）、
+ * half-open → closed（half_open_requests 个试探成功）和 half-open → open（一个试探失败）；
+ * 结果不符时打印位置并 abort()
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "../include/circuit_breaker.h"
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        abort(); \
+    } \
+} while (0)
+
+/* 等待探测线程完成状态转换的上限，超过视为失败 */
+#define WAIT_LIMIT_MS 5000
+
+#define MIN_REQUESTS 10
+#define FAILURE_PERCENT 50
+#define HALF_OPEN_REQUESTS 3
+
+/* 由测试控制的探测：每次探测等待测试放行，返回预先设定的结果 */
+struct probe_script {
+    sem_t go;
+    int result;
+    int stopping;           /* 释放熔断器前置 1，之后的探测直接失败 */
+    int calls;
+    int last_data;          /* 探测收到的数据 */
+};
+
+static int scripted_probe(void *arg, const void *data) {
+    struct probe_script *script = arg;
+
+    if (__atomic_load_n(&script->stopping, __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+    while (sem_wait(&script->go) < 0 && errno == EINTR) {
+        ;
+    }
+    memcpy(&script->last_data, data, sizeof(int));
+    __atomic_fetch_add(&script->calls, 1, __ATOMIC_RELEASE);
+    return __atomic_load_n(&script->result, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * 放行一次探测并等待它返回
+ */
+static void run_probe(struct probe_script *script, int result) {
+    int calls = __atomic_load_n(&script->calls, __ATOMIC_ACQUIRE);
+    struct timespec ts = { .tv_nsec = 1000000 };
+
+    __atomic_store_n(&script->result, result, __ATOMIC_RELEASE);
+    sem_post(&script->go);
+    for (int i = 0; __atomic_load_n(&script->calls, __ATOMIC_ACQUIRE) == calls; i++) {
+        CHECK(i < WAIT_LIMIT_MS);
+        nanosleep(&ts, NULL);
+    }
+}
+
+static __u64 state_of(struct circuit_breaker *breaker) {
+    struct circuit_breaker_stats stats;
+
+    circuit_breaker_get_stats(breaker, &stats);
+    return stats.state;
+}
+
+/**
+ * 等待探测线程把状态切换为 state（探测返回后还要重新加锁才切换）
+ */
+static void wait_state(struct circuit_breaker *breaker, int state) {
+    struct timespec ts = { .tv_nsec = 1000000 };
+
+    for (int i = 0; state_of(breaker) != (__u64)state; i++) {
+        CHECK(i < WAIT_LIMIT_MS);
+        nanosleep(&ts, NULL);
+    }
+}
+
+/**
+ * 记录一个正常放行的请求
+ */
+static void record(struct circuit_breaker *breaker, int success, __u64 latency_ms, int data) {
+    int ticket = circuit_breaker_allow(breaker);
+
+    CHECK(ticket == CIRCUIT_BREAKER_PASS);
+    circuit_breaker_record(breaker, ticket, success, latency_ms * 1000000ULL, &data);
+}
+
+/**
+ * 以失败率断开：请求数未到 min_requests 时不断开，达到后失败率恰好到阈值才断开
+ */
+static void trip_by_failures(struct circuit_breaker *breaker, int data) {
+    for (int i = 0; i < 5; i++) {
+        record(breaker, 1, 0, data);
+    }
+    for (int i = 0; i < 4; i++) {
+        record(breaker, 0, 0, data);
+    }
+    /* 9 个请求中 4 个失败：未到 min_requests */
+    CHECK(state_of(breaker) == CIRCUIT_BREAKER_CLOSED);
+    /* 4/10、5/11 低于 50% */
+    record(breaker, 1, 0, data);
+    CHECK(state_of(breaker) == CIRCUIT_BREAKER_CLOSED);
+    record(breaker, 0, 0, data);
+    CHECK(state_of(breaker) == CIRCUIT_BREAKER_CLOSED);
+    /* 6/12 达到 50% */
+    record(breaker, 0, 0, data);
+    CHECK(state_of(breaker) == CIRCUIT_BREAKER_OPEN);
+}
+
+static struct circuit_breaker *breaker_new(struct probe_script *script, __u32 failure_percent,
+                                           __u32 slow_ms, __u32 slow_percent) {
+    struct circuit_breaker_config config = {
+        .window_ms = 600000,            /* 足够长，检查期间的请求都在同一窗口内 */
+        .min_requests = MIN_REQUESTS,
+        .failure_percent = failure_percent,
+        .slow_ms = slow_ms,
+        .slow_percent = slow_percent,
+        .open_ms = 1,
+        .half_open_requests = HALF_OPEN_REQUESTS,
+        .data_size = sizeof(int),
+    };
+    struct circuit_breaker *breaker;
+
+    memset(script, 0, sizeof(*script));
+    sem_init(&script->go, 0, 0);
+    breaker = circuit_breaker_new(&config, &(struct circuit_breaker_ops){
+                                      .probe = scripted_probe,
+                                  }, script);
+    CHECK(breaker != NULL);
+    return breaker;
+}
+
+static void breaker_free(struct circuit_breaker *breaker, struct probe_script *script) {
+    /* 探测线程可能正阻塞在探测中 */
+    __atomic_store_n(&script->stopping, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&script->result, -1, __ATOMIC_RELEASE);
+    sem_post(&script->go);
+    circuit_breaker_free(breaker);
+    sem_destroy(&script->go);
+}
+
+/**
+ * closed → open → half-open → closed → open → half-open → open
+ */
+static void check_transitions(void) {
+    struct probe_script script;
+    struct circuit_breaker *breaker = breaker_new(&script, FAILURE_PERCENT, 0, 0);
+    struct circuit_breaker_stats stats;
+    int tickets[HALF_OPEN_REQUESTS];
+
+    trip_by_failures(breaker, 7);
+    CHECK(circuit_breaker_allow(breaker) == CIRCUIT_BREAKER_REJECT);
+
+    /* open：探测失败仍断开，探测成功才转为半开，探测使用最近一次请求的数据 */
+    run_probe(&script, -1);
+    CHECK(script.last_data == 7);
+    CHECK(state_of(breaker) == CIRCUIT_BREAKER_OPEN);
+    CHECK(circuit_breaker_allow(breaker) == CIRCUIT_BREAKER_REJECT);
+    run_probe(&script, 0);
+    wait_state(breaker, CIRCUIT_BREAKER_HALF_OPEN);
+
+    /* half-open：只放行 half_open_requests 个试探，全部成功后闭合 */
+    for (int i = 0; i < HALF_OPEN_REQUESTS; i++) {
+        tickets[i] = circuit_breaker_allow(breaker);
+        CHECK(tickets[i] == CIRCUIT_BREAKER_TRIAL);
+    }
+    CHECK(circuit_breaker_allow(breaker) == CIRCUIT_BREAKER_REJECT);
+    for (int i = 0; i < HALF_OPEN_REQUESTS; i++) {
+        CHECK(state_of(breaker) == CIRCUIT_BREAKER_HALF_OPEN);
+        circuit_breaker_record(breaker, tickets[i], 1, 0, &(int){ 8 });
+    }
+    CHECK(state_of(breaker) == CIRCUIT_BREAKER_CLOSED);
+    circuit_breaker_get_stats(breaker, &stats);
+    CHECK(stats.opened == 1 && stats.half_opened == 1 && stats.closed == 1);
+    CHECK(stats.probes == 2 && stats.probe_failures == 1);
+    CHECK(stats.rejected == 3);
+    CHECK(stats.window_requests == 0);      /* 闭合时清空窗口 */
+
+    /* 闭合后窗口重新计数，同样的序列再次断开 */
+    trip_by_failures(breaker, 9);
+    run_probe(&script, 0);
+    CHECK(script.last_data == 9);
+    wait_state(breaker, CIRCUIT_BREAKER_HALF_OPEN);
+
+    /* half-open：第一个试探成功不改变状态，任何一个试探失败立即重新断开 */
+    tickets[0] = circuit_breaker_allow(breaker);
+    tickets[1] = circuit_breaker_allow(breaker);
+    CHECK(tickets[0] == CIRCUIT_BREAKER_TRIAL && tickets[1] == CIRCUIT_BREAKER_TRIAL);
+    circuit_breaker_record(breaker, tickets[0], 1, 0, &(int){ 9 });
+    CHECK(state_of(breaker) == CIRCUIT_BREAKER_HALF_OPEN);
+    circuit_breaker_record(breaker, tickets[1], 0, 0, &(int){ 9 });
+    CHECK(state_of(breaker) == CIRCUIT_BREAKER_OPEN);
+    CHECK(circuit_breaker_allow(breaker) == CIRCUIT_BREAKER_REJECT);
+
+    circuit_breaker_get_stats(breaker, &stats);
+    CHECK(stats.opened == 3 && stats.half_opened == 2 && stats.closed == 1);
+
+    breaker_free(breaker, &script);
+}
+
+/**
+ * 按慢调用率断开，半开时成功但慢的试探同样重新断开
+ */
+static void check_slow_calls(void) {
+    struct probe_script script;
+    struct circuit_breaker *breaker = breaker_new(&script, 0, 1000, 80);
+    int ticket;
+
+    /* 失败率阈值为 0：全部失败也不断开 */
+    for (int i = 0; i < MIN_REQUESTS; i++) {
+        record(breaker, 0, 0, 1);
+    }
+    CHECK(state_of(breaker) == CIRCUIT_BREAKER_CLOSED);
+    /* 10 个快速请求之后，第 40 个慢调用时达到 40/50 = 80% */
+    for (int i = 0; i < 39; i++) {
+        record(breaker, 1, 2000, 1);
+        CHECK(state_of(breaker) == CIRCUIT_BREAKER_CLOSED);
+    }
+    record(breaker, 1, 2000, 1);
+    CHECK(state_of(breaker) == CIRCUIT_BREAKER_OPEN);
+
+    run_probe(&script, 0);
+    wait_state(breaker, CIRCUIT_BREAKER_HALF_OPEN);
+    ticket = circuit_breaker_allow(breaker);
+    CHECK(ticket == CIRCUIT_BREAKER_TRIAL);
+    circuit_breaker_record(breaker, ticket, 1, 2000 * 1000000ULL, &(int){ 1 });
+    CHECK(state_of(breaker) == CIRCUIT_BREAKER_OPEN);
+
+    breaker_free(breaker, &script);
+}
+
+int main(void) {
+    check_transitions();
+    check_slow_calls();
+    printf("circuit breaker: all checks passed\n");
+    return 0;
+}
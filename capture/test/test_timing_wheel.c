@@ -0,0 +1,240 @@
+/*
+ * 时间轮确定性检查
+ * 用合成的 tick 逐个推进时间轮，检查跨层定时器经级联后在正确的 tick 到期，
+ * 以及在级联发生的 tick 上删除、重新添加定时器的行为；结果不符时打印位置并 abort()
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/timing_wheel.h"
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        abort(); \
+    } \
+} while (0)
+
+/* 第 n 层的一个槽位覆盖的 tick 数 */
+#define LEVEL_SPAN(n) (1ULL << (TIMING_WHEEL_BITS * (n)))
+
+struct test_timer {
+    struct timer_node node;
+    __u64 fired_at;                 /* 到期时的 tick，0 表示未到期 */
+    __u32 fired;                    /* 到期次数 */
+};
+
+#define NODE_TIMER(n) ((struct test_timer *)(n))
+
+/**
+ * 推进一个 tick，记录到期的定时器
+ * @return: 到期的定时器链表
+ */
+static struct timer_node *tick(struct timing_wheel *wheel, __u64 now) {
+    struct timer_node *expired, *node;
+    __u32 n, seen = 0;
+
+    n = timing_wheel_advance(wheel, now, &expired);
+    for (node = expired; node; node = node->next) {
+        CHECK(!timing_wheel_pending(node));
+        NODE_TIMER(node)->fired_at = now;
+        NODE_TIMER(node)->fired++;
+        seen++;
+    }
+    CHECK(seen == n);
+    return expired;
+}
+
+/**
+ * 各层的定时器都在到期 tick 上恰好到期一次，不提前也不延后
+ */
+static void check_cascade_ticks(void) {
+    struct timing_wheel wheel;
+    struct test_timer t[] = {
+        { .node.expires = 5 },                          /* 第 0 层 */
+        { .node.expires = 300 },                        /* 第 1 层，级联一次 */
+        { .node.expires = LEVEL_SPAN(1) * 2 },          /* 正好落在级联的 tick 上 */
+        { .node.expires = LEVEL_SPAN(2) + 5 },          /* 第 2 层，级联两次 */
+        { .node.expires = LEVEL_SPAN(2) * 3 - 1 },      /* 级联前的最后一个 tick */
+        { .node.expires = LEVEL_SPAN(3) + 7 },          /* 第 3 层，级联三次 */
+    };
+    size_t n = sizeof(t) / sizeof(t[0]);
+    __u64 last = LEVEL_SPAN(3) + 8;
+
+    timing_wheel_init(&wheel, 0);
+    for (size_t i = 0; i < n; i++) {
+        __u64 expires = t[i].node.expires;
+
+        memset(&t[i].node, 0, sizeof(t[i].node));
+        timing_wheel_add(&wheel, &t[i].node, expires);
+    }
+    CHECK(wheel.count == n);
+
+    for (__u64 now = 1; now <= last; now++) {
+        tick(&wheel, now);
+    }
+    for (size_t i = 0; i < n; i++) {
+        CHECK(t[i].fired == 1);
+        CHECK(t[i].fired_at == t[i].node.expires);
+    }
+    CHECK(wheel.count == 0);
+}
+
+/**
+ * 一次推进跨过多次级联时，到期的定时器都在这一次中取下，未到期的保留
+ */
+static void check_jump(void) {
+    struct timing_wheel wheel;
+    struct test_timer a = { 0 }, b = { 0 };
+    struct timer_node *expired;
+
+    timing_wheel_init(&wheel, 100);
+    timing_wheel_add(&wheel, &a.node, 100 + LEVEL_SPAN(2));
+    timing_wheel_add(&wheel, &b.node, 100 + LEVEL_SPAN(2) + 1);
+
+    CHECK(timing_wheel_advance(&wheel, 100 + LEVEL_SPAN(2), &expired) == 1);
+    CHECK(expired == &a.node && !expired->next);
+    CHECK(timing_wheel_pending(&b.node));
+    CHECK(timing_wheel_advance(&wheel, 100 + LEVEL_SPAN(2) + 1, &expired) == 1);
+    CHECK(expired == &b.node);
+    CHECK(wheel.count == 0);
+
+    /* 已过期的到期时间在下一次推进时到期 */
+    timing_wheel_add(&wheel, &a.node, 3);
+    CHECK(timing_wheel_advance(&wheel, wheel.next_tick, &expired) == 1);
+    CHECK(expired == &a.node);
+}
+
+/**
+ * 在级联发生的 tick 上处理到期定时器时删除刚被级联下来的定时器、重新添加定时器，
+ * 以及删除上层槽位中尚未级联的定时器后用同一节点重新添加
+ */
+static void check_cancel_readd_during_cascade(void) {
+    struct timing_wheel wheel;
+    struct test_timer x = { 0 }, y = { 0 }, z = { 0 }, w = { 0 };
+    struct timer_node *expired;
+    __u64 base = LEVEL_SPAN(1) * 2;     /* 第 0 层转过一圈、级联第 1 层的 tick */
+    __u64 now;
+
+    timing_wheel_init(&wheel, 0);
+    timing_wheel_add(&wheel, &x.node, base);
+    timing_wheel_add(&wheel, &y.node, base + 3);
+    timing_wheel_add(&wheel, &z.node, base + 10);
+    timing_wheel_add(&wheel, &w.node, base + LEVEL_SPAN(1) + 1);
+
+    /* 级联前删除 z 再以同一槽位内的到期时间重新添加，只应到期一次 */
+    timing_wheel_del(&wheel, &z.node);
+    CHECK(!timing_wheel_pending(&z.node));
+    timing_wheel_del(&wheel, &z.node);
+    timing_wheel_add(&wheel, &z.node, base + 12);
+    CHECK(wheel.count == 4);
+
+    for (now = 1; now < base; now++) {
+        CHECK(tick(&wheel, now) == NULL);
+    }
+
+    /* 级联的 tick：x 到期，y、z 已从第 1 层挪到第 0 层 */
+    expired = tick(&wheel, base);
+    CHECK(expired == &x.node && !expired->next);
+    CHECK(timing_wheel_pending(&y.node) && timing_wheel_pending(&z.node));
+
+    /* 在处理 x 时删除刚级联下来的 y，并把 x、y 重新添加到跨过下一次级联的位置 */
+    timing_wheel_del(&wheel, &y.node);
+    CHECK(!timing_wheel_pending(&y.node));
+    timing_wheel_add(&wheel, &x.node, base + LEVEL_SPAN(1) + 1);
+    timing_wheel_add(&wheel, &y.node, base + LEVEL_SPAN(1) - 1);
+    /* 删除仍在上层等待级联的 w 再原样添加回去 */
+    timing_wheel_del(&wheel, &w.node);
+    timing_wheel_add(&wheel, &w.node, base + LEVEL_SPAN(1) + 1);
+    CHECK(wheel.count == 4);
+
+    for (now = base + 1; now <= base + LEVEL_SPAN(1) + 2; now++) {
+        tick(&wheel, now);
+    }
+    CHECK(x.fired == 2 && x.fired_at == base + LEVEL_SPAN(1) + 1);
+    CHECK(y.fired == 1 && y.fired_at == base + LEVEL_SPAN(1) - 1);
+    CHECK(z.fired == 1 && z.fired_at == base + 12);
+    CHECK(w.fired == 1 && w.fired_at == base + LEVEL_SPAN(1) + 1);
+    CHECK(wheel.count == 0);
+}
+
+/* 固定种子的线性同余生成器，保证每次运行相同 */
+static __u64 rng_state = 0x9e3779b97f4a7c15ULL;
+
+static __u32 rng(void) {
+    rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (__u32)(rng_state >> 33);
+}
+
+#define RANDOM_TIMERS 512
+#define RANDOM_TICKS 200000
+
+/**
+ * 随机添加、删除和重新添加，与逐个定时器记录的期望到期 tick 对照
+ */
+static void check_random(void) {
+    static struct test_timer t[RANDOM_TIMERS];
+    static __u64 want[RANDOM_TIMERS];   /* 期望的到期 tick，0 表示不在时间轮上 */
+    struct timing_wheel wheel;
+    __u64 pending = 0;
+
+    memset(t, 0, sizeof(t));
+    memset(want, 0, sizeof(want));
+    timing_wheel_init(&wheel, 0);
+
+    for (__u64 now = 1; now <= RANDOM_TICKS; now++) {
+        struct timer_node *expired, *node;
+        __u32 ops = rng() % 4;
+
+        for (__u32 i = 0; i < ops; i++) {
+            __u32 k = rng() % RANDOM_TIMERS;
+            __u64 delta;
+
+            if (timing_wheel_pending(&t[k].node)) {
+                timing_wheel_del(&wheel, &t[k].node);
+                want[k] = 0;
+                pending--;
+                if (rng() % 2) {
+                    continue;
+                }
+            }
+            /* 多数落在前两层，少量跨到第 2 层，偶尔已过期 */
+            switch (rng() % 8) {
+                case 0:
+                    delta = LEVEL_SPAN(1) + rng() % (LEVEL_SPAN(2) - LEVEL_SPAN(1));
+                    break;
+                case 1:
+                    delta = 0;
+                    break;
+                default:
+                    delta = rng() % (LEVEL_SPAN(1) * 4);
+                    break;
+            }
+            timing_wheel_add(&wheel, &t[k].node, now - 1 + delta);
+            want[k] = delta == 0 ? now : now - 1 + delta;
+            pending++;
+        }
+
+        timing_wheel_advance(&wheel, now, &expired);
+        for (node = expired; node; node = node->next) {
+            size_t k = NODE_TIMER(node) - t;
+
+            CHECK(want[k] == now);
+            want[k] = 0;
+            pending--;
+        }
+        CHECK(wheel.count == pending);
+    }
+    for (size_t k = 0; k < RANDOM_TIMERS; k++) {
+        CHECK(want[k] == 0 || want[k] > RANDOM_TICKS);
+    }
+}
+
+int main(void) {
+    check_cascade_ticks();
+    check_jump();
+    check_cancel_readd_during_cascade();
+    check_random();
+    printf("timing wheel: all checks passed\n");
+    return 0;
+}